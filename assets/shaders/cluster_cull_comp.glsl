@@ -0,0 +1,133 @@
+#version 450
+
+// One workgroup per meshlet, see ClusterCuller. The first invocation culls
+// the cluster and reserves room in its instance's output range, then the
+// whole group copies the indices. Objects with no indices are not drawn
+// through their clusters this frame (coarser LOD or imposter).
+layout(local_size_x = 64) in;
+
+struct Object
+{
+    mat4 model;
+    vec4 boundsMin;
+    vec4 boundsMax;
+    uvec4 draw; // indexCount, firstIndex, vertexOffset, bucket
+    uvec4 bucket;
+};
+
+struct Cluster
+{
+    vec4 sphere; // local center, radius
+    vec4 cone;   // local axis, cutoff (1 never culls)
+    uint firstIndex;
+    uint indexCount;
+    uint instance;
+    uint pad;
+};
+
+struct Instance
+{
+    uint object;
+    uint outputOffset;
+    uint pad0;
+    uint pad1;
+};
+
+struct DrawCommand
+{
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Objects
+{
+    Object objects[];
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer Clusters
+{
+    Cluster clusters[];
+};
+
+layout(std430, set = 0, binding = 2) readonly buffer ClusterIndices
+{
+    uint clusterIndices[];
+};
+
+layout(std430, set = 0, binding = 3) readonly buffer Instances
+{
+    Instance instances[];
+};
+
+layout(std430, set = 0, binding = 4) buffer Commands
+{
+    DrawCommand commands[];
+};
+
+layout(std430, set = 0, binding = 5) writeonly buffer Output
+{
+    uint outIndices[];
+};
+
+layout(push_constant) uniform ClusterPush
+{
+    mat4 viewProj;
+    vec4 eye;
+    uint clusterCount;
+} pc;
+
+shared uint s_outputOffset;
+shared bool s_visible;
+
+bool IsVisible(Cluster c, mat4 model)
+{
+    vec3 center = (model * vec4(c.sphere.xyz, 1.0)).xyz;
+    float scale = max(length(model[0].xyz), max(length(model[1].xyz), length(model[2].xyz)));
+    float radius = c.sphere.w * scale;
+
+    // Clip planes of a GL style projection, -w <= x, y, z <= w
+    mat4 m = transpose(pc.viewProj);
+    vec4 planes[6] = vec4[6](m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[3] + m[2], m[3] - m[2]);
+    for (int i = 0; i < 6; ++i)
+    {
+        if (dot(planes[i].xyz, center) + planes[i].w < -radius * length(planes[i].xyz))
+            return false;
+    }
+
+    if (c.cone.w >= 1.0)
+        return true;
+
+    // Every triangle faces away from the eye
+    vec3 axis = normalize(transpose(inverse(mat3(model))) * c.cone.xyz);
+    vec3 toCenter = center - pc.eye.xyz;
+    return dot(toCenter, axis) < c.cone.w * length(toCenter) + radius;
+}
+
+void main()
+{
+    uint id = gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x;
+    if (id >= pc.clusterCount)
+        return;
+
+    Cluster c = clusters[id];
+
+    if (gl_LocalInvocationIndex == 0)
+    {
+        Instance instance = instances[c.instance];
+        Object o = objects[instance.object];
+        s_visible = o.draw.x != 0 && IsVisible(c, o.model);
+        if (s_visible)
+            s_outputOffset = instance.outputOffset + atomicAdd(commands[c.instance].indexCount, c.indexCount);
+    }
+
+    barrier();
+
+    if (!s_visible)
+        return;
+
+    for (uint i = gl_LocalInvocationIndex; i < c.indexCount; i += gl_WorkGroupSize.x)
+        outIndices[s_outputOffset + i] = clusterIndices[c.firstIndex + i];
+}
@@ -0,0 +1,106 @@
+#version 450
+
+layout(location = 0) in vec3 vWorldPos;
+layout(location = 1) in vec3 vNormal;
+layout(location = 2) in vec2 vUV;
+layout(location = 3) in vec3 vColor;
+layout(location = 4) in float vViewDepth;
+
+layout(location = 0) out vec4 outColor;
+
+layout(set = 1, binding = 0) uniform sampler2D baseColorTexture;
+
+layout(push_constant) uniform PushData
+{
+    mat4 u_model;
+    vec4 u_color;
+    vec4 u_params;
+    vec4 u_cameraPos;
+} pc;
+
+// Must match ClusteredLighting::kGridX/Y/Z
+const uint GRID_X = 16;
+const uint GRID_Y = 9;
+const uint GRID_Z = 24;
+
+struct GpuLight
+{
+    vec4 positionRadius; // world xyz, radius
+    vec4 colorIntensity; // rgb, intensity
+};
+
+struct GpuCluster
+{
+    uint offset;
+    uint count;
+};
+
+layout(set = 2, binding = 0) uniform ClusterParams
+{
+    uvec4 gridSize; // x, y, z, light count
+    vec4 zParams;   // slice scale, slice bias, near, far
+    vec4 screen;    // width, height, 1/width, 1/height
+} cluster;
+
+layout(std430, set = 2, binding = 1) readonly buffer Lights
+{
+    GpuLight lights[];
+};
+
+layout(std430, set = 2, binding = 2) readonly buffer Clusters
+{
+    GpuCluster clusters[];
+};
+
+layout(std430, set = 2, binding = 3) readonly buffer LightIndices
+{
+    uint lightIndices[];
+};
+
+uint ClusterIndex()
+{
+    vec2 uv = gl_FragCoord.xy * cluster.screen.zw;
+    uint x = min(uint(uv.x * GRID_X), GRID_X - 1);
+    uint y = min(uint(uv.y * GRID_Y), GRID_Y - 1);
+
+    float slice = log(max(vViewDepth, cluster.zParams.z)) * cluster.zParams.x + cluster.zParams.y;
+    uint z = min(uint(max(slice, 0.0)), GRID_Z - 1);
+
+    return (z * GRID_Y + y) * GRID_X + x;
+}
+
+void main()
+{
+    vec3 albedo = texture(baseColorTexture, vUV).rgb * vColor;
+    vec3 N = normalize(vNormal);
+    vec3 V = normalize(pc.u_cameraPos.xyz - vWorldPos);
+
+    vec3 color = albedo * 0.1;
+
+    GpuCluster c = clusters[ClusterIndex()];
+    for (uint i = 0; i < c.count; ++i)
+    {
+        GpuLight light = lights[lightIndices[c.offset + i]];
+
+        vec3 toLight = light.positionRadius.xyz - vWorldPos;
+        float dist = length(toLight);
+        float radius = light.positionRadius.w;
+        if (dist >= radius)
+            continue;
+
+        vec3 L = toLight / dist;
+        vec3 H = normalize(L + V);
+
+        // Windowed inverse-square falloff, reaches zero at the radius
+        float window = clamp(1.0 - pow(dist / radius, 4.0), 0.0, 1.0);
+        float attenuation = window * window / (dist * dist + 1.0);
+
+        float diffuse = max(dot(N, L), 0.0);
+        float specular = pow(max(dot(N, H), 0.0), 32.0) * 0.5;
+
+        vec3 radiance = light.colorIntensity.rgb * light.colorIntensity.w * attenuation;
+        color += (albedo * diffuse + specular) * radiance;
+    }
+
+    outColor = vec4(color, 1.0);
+}
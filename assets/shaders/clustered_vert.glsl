@@ -0,0 +1,40 @@
+#version 450
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec2 inUV;
+layout(location = 3) in vec3 inNormal;
+
+layout(set = 0, binding = 0) uniform CameraUBO
+{
+    mat4 view;
+    mat4 proj;
+} camera;
+
+layout(push_constant) uniform PushData
+{
+    mat4 u_model;
+    vec4 u_color;
+    vec4 u_params;
+    vec4 u_cameraPos;
+} pc;
+
+layout(location = 0) out vec3 vWorldPos;
+layout(location = 1) out vec3 vNormal;
+layout(location = 2) out vec2 vUV;
+layout(location = 3) out vec3 vColor;
+layout(location = 4) out float vViewDepth;
+
+void main()
+{
+    vec4 world = pc.u_model * vec4(inPosition, 1.0);
+    vec4 view = camera.view * world;
+
+    vWorldPos = world.xyz;
+    vNormal = mat3(transpose(inverse(pc.u_model))) * inNormal;
+    vUV = inUV;
+    vColor = inColor * pc.u_color.rgb;
+    vViewDepth = -view.z;
+
+    gl_Position = camera.proj * view;
+}
@@ -0,0 +1,192 @@
+#version 450
+
+layout(local_size_x = 64) in;
+
+struct Object
+{
+    mat4 model;
+    vec4 boundsMin;
+    vec4 boundsMax;
+    uint indexCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint bucket;
+    uint commandBase;
+    uint pad0;
+    uint pad1;
+    uint pad2;
+};
+
+struct DrawCommand
+{
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Objects
+{
+    Object objects[];
+};
+
+layout(std430, set = 0, binding = 1) writeonly buffer Commands
+{
+    DrawCommand commands[];
+};
+
+layout(std430, set = 0, binding = 2) buffer Counts
+{
+    uint counts[];
+};
+
+layout(std430, set = 0, binding = 3) buffer DrawnEarly
+{
+    uint drawnEarly[];
+};
+
+// Max depth pyramid, see HiZPyramid
+layout(set = 0, binding = 4) uniform sampler2D pyramid;
+
+layout(std430, set = 0, binding = 5) buffer Stats
+{
+    uint frustumVisible;
+    uint statDrawnEarly;
+    uint statDrawnLate;
+    uint occluded;
+} stats;
+
+struct CullParams
+{
+    mat4 viewProj;
+    mat4 occlusionViewProj;
+    uint objectCount;
+    uint mipCount;
+    uint commandOffset;
+    uint countOffset;
+    vec4 pyramidSize;
+};
+
+layout(std140, set = 0, binding = 6) uniform Params
+{
+    CullParams phases[2];
+} params;
+
+layout(push_constant) uniform CullPush
+{
+    uint phase; // 0 early, 1 late
+} pc;
+
+vec3 Corner(vec3 bmin, vec3 bmax, int i)
+{
+    return vec3((i & 1) != 0 ? bmax.x : bmin.x,
+                (i & 2) != 0 ? bmax.y : bmin.y,
+                (i & 4) != 0 ? bmax.z : bmin.z);
+}
+
+bool IsInFrustum(mat4 viewProj, vec3 bmin, vec3 bmax)
+{
+    // Culled when all corners are outside the same clip plane
+    ivec3 below = ivec3(0);
+    ivec3 above = ivec3(0);
+    for (int i = 0; i < 8; ++i)
+    {
+        vec4 c = viewProj * vec4(Corner(bmin, bmax, i), 1.0);
+        below += ivec3(lessThan(c.xyz, vec3(-c.w)));
+        above += ivec3(greaterThan(c.xyz, vec3(c.w)));
+    }
+    return all(lessThan(below, ivec3(8))) && all(lessThan(above, ivec3(8)));
+}
+
+bool IsOccluded(CullParams p, vec3 bmin, vec3 bmax)
+{
+    if (p.mipCount == 0)
+        return false;
+
+    vec2 uvMin = vec2(1.0);
+    vec2 uvMax = vec2(0.0);
+    float zMin = 1.0;
+    for (int i = 0; i < 8; ++i)
+    {
+        vec4 c = p.occlusionViewProj * vec4(Corner(bmin, bmax, i), 1.0);
+        if (c.w <= 1e-5)
+            return false; // crosses the near plane
+
+        vec3 ndc = c.xyz / c.w;
+        // The matrix is GL style, the camera UBO flips Y when rendering
+        vec2 uv = vec2(ndc.x * 0.5 + 0.5, 0.5 - ndc.y * 0.5);
+        uvMin = min(uvMin, uv);
+        uvMax = max(uvMax, uv);
+        zMin = min(zMin, ndc.z);
+    }
+
+    uvMin = clamp(uvMin, vec2(0.0), vec2(1.0));
+    uvMax = clamp(uvMax, vec2(0.0), vec2(1.0));
+
+    // Pick the level where the rect covers at most 2x2 texels
+    vec2 sizePx = (uvMax - uvMin) * p.pyramidSize.xy;
+    float level = ceil(log2(max(max(sizePx.x, sizePx.y), 1.0)));
+    if (level >= float(p.mipCount))
+        return false;
+
+    float d = textureLod(pyramid, uvMin, level).r;
+    d = max(d, textureLod(pyramid, vec2(uvMax.x, uvMin.y), level).r);
+    d = max(d, textureLod(pyramid, vec2(uvMin.x, uvMax.y), level).r);
+    d = max(d, textureLod(pyramid, uvMax, level).r);
+
+    return zMin > d;
+}
+
+void main()
+{
+    uint id = gl_GlobalInvocationID.x;
+    CullParams p = params.phases[pc.phase];
+    if (id >= p.objectCount)
+        return;
+
+    Object o = objects[id];
+
+    // Drawn some other way this frame (clusters, imposter), left out of the stats
+    if (o.indexCount == 0)
+    {
+        if (pc.phase == 0)
+            drawnEarly[id] = 0;
+        return;
+    }
+
+    if (pc.phase == 1 && drawnEarly[id] != 0)
+        return;
+
+    bool visible = IsInFrustum(p.viewProj, o.boundsMin.xyz, o.boundsMax.xyz);
+    if (pc.phase == 0 && visible)
+        atomicAdd(stats.frustumVisible, 1u);
+
+    if (visible && IsOccluded(p, o.boundsMin.xyz, o.boundsMax.xyz))
+    {
+        if (pc.phase == 1)
+            atomicAdd(stats.occluded, 1u);
+        visible = false;
+    }
+
+    if (pc.phase == 0)
+        drawnEarly[id] = visible ? 1 : 0;
+
+    if (!visible)
+        return;
+
+    if (pc.phase == 0)
+        atomicAdd(stats.statDrawnEarly, 1u);
+    else
+        atomicAdd(stats.statDrawnLate, 1u);
+
+    uint slot = atomicAdd(counts[p.countOffset + o.bucket], 1u);
+
+    DrawCommand cmd;
+    cmd.indexCount = o.indexCount;
+    cmd.instanceCount = 1;
+    cmd.firstIndex = o.firstIndex;
+    cmd.vertexOffset = o.vertexOffset;
+    cmd.firstInstance = id; // gl_InstanceIndex in indirect_vert
+    commands[p.commandOffset + o.commandBase + slot] = cmd;
+}
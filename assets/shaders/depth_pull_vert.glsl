@@ -0,0 +1,64 @@
+#version 450
+#extension GL_EXT_buffer_reference : require
+#extension GL_EXT_buffer_reference_uvec2 : require
+
+// depth_vert.glsl with the position fetched like indirect_pull_vert.glsl
+
+layout(set = 0, binding = 0) uniform CameraUBO
+{
+    mat4 view;
+    mat4 proj;
+} camera;
+
+struct Object
+{
+    mat4 model;
+    vec4 boundsMin;
+    vec4 boundsMax;
+    uvec4 draw;
+    uvec4 bucket;
+};
+
+layout(std430, set = 3, binding = 0) readonly buffer Objects
+{
+    Object objects[];
+};
+
+struct VertexFormat
+{
+    uvec2 streams[2];
+    uvec4 attribs;
+    uvec4 strides;
+};
+
+layout(std430, set = 3, binding = 1) readonly buffer VertexFormats
+{
+    VertexFormat formats[];
+};
+
+layout(buffer_reference, std430, buffer_reference_align = 4) readonly buffer Words
+{
+    uint w[];
+};
+
+invariant gl_Position;
+
+void main()
+{
+    Object o = objects[gl_InstanceIndex];
+    VertexFormat f = formats[o.bucket.z];
+
+    // Positions are Float32 or Float16, see VertexQuantizer
+    uint a = f.attribs[0];
+    uint binding = (a >> 8) & 0xFu;
+    uint word = (uint(gl_VertexIndex) * f.strides[binding] + (a >> 16)) >> 2;
+    Words data = Words(f.streams[binding]);
+
+    vec3 position;
+    if ((a & 0xFu) == 0u)
+        position = vec3(uintBitsToFloat(data.w[word]), uintBitsToFloat(data.w[word + 1u]), uintBitsToFloat(data.w[word + 2u]));
+    else
+        position = vec3(unpackHalf2x16(data.w[word]), unpackHalf2x16(data.w[word + 1u]).x);
+
+    gl_Position = camera.proj * (camera.view * (o.model * vec4(position, 1.0)));
+}
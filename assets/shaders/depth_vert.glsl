@@ -0,0 +1,32 @@
+#version 450
+
+layout(location = 0) in vec3 inPosition;
+
+layout(set = 0, binding = 0) uniform CameraUBO
+{
+    mat4 view;
+    mat4 proj;
+} camera;
+
+struct Object
+{
+    mat4 model;
+    vec4 boundsMin;
+    vec4 boundsMax;
+    uvec4 draw;
+    uvec4 bucket;
+};
+
+layout(std430, set = 3, binding = 0) readonly buffer Objects
+{
+    Object objects[];
+};
+
+// Must produce bit identical depth to indirect_vert.glsl
+invariant gl_Position;
+
+void main()
+{
+    mat4 model = objects[gl_InstanceIndex].model;
+    gl_Position = camera.proj * (camera.view * (model * vec4(inPosition, 1.0)));
+}
@@ -0,0 +1,30 @@
+#version 450
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(set = 0, binding = 0) uniform sampler2D srcDepth;
+layout(set = 0, binding = 1, r32f) uniform writeonly image2D dstMip;
+
+layout(push_constant) uniform HiZPush
+{
+    uvec2 srcSize;
+    uvec2 dstSize;
+} pc;
+
+void main()
+{
+    uvec2 p = gl_GlobalInvocationID.xy;
+    if (p.x >= pc.dstSize.x || p.y >= pc.dstSize.y)
+        return;
+
+    // Level 0 is smaller than depth: take the max over every texel the footprint touches
+    uvec2 lo = (p * pc.srcSize) / pc.dstSize;
+    uvec2 hi = min(((p + 1u) * pc.srcSize + pc.dstSize - 1u) / pc.dstSize, pc.srcSize);
+
+    float d = 0.0;
+    for (uint y = lo.y; y < hi.y; ++y)
+        for (uint x = lo.x; x < hi.x; ++x)
+            d = max(d, texelFetch(srcDepth, ivec2(x, y), 0).r);
+
+    imageStore(dstMip, ivec2(p), vec4(d));
+}
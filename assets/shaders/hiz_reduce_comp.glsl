@@ -0,0 +1,30 @@
+#version 450
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(set = 0, binding = 0) uniform sampler2D srcMip;
+layout(set = 0, binding = 1, r32f) uniform writeonly image2D dstMip;
+
+layout(push_constant) uniform HiZPush
+{
+    uvec2 srcSize;
+    uvec2 dstSize;
+} pc;
+
+void main()
+{
+    uvec2 p = gl_GlobalInvocationID.xy;
+    if (p.x >= pc.dstSize.x || p.y >= pc.dstSize.y)
+        return;
+
+    // Sizes are powers of two; clamp only once one axis reached 1
+    ivec2 maxCoord = ivec2(pc.srcSize) - 1;
+    ivec2 s = ivec2(p * 2u);
+
+    float d = texelFetch(srcMip, min(s, maxCoord), 0).r;
+    d = max(d, texelFetch(srcMip, min(s + ivec2(1, 0), maxCoord), 0).r);
+    d = max(d, texelFetch(srcMip, min(s + ivec2(0, 1), maxCoord), 0).r);
+    d = max(d, texelFetch(srcMip, min(s + ivec2(1, 1), maxCoord), 0).r);
+
+    imageStore(dstMip, ivec2(p), vec4(d));
+}
@@ -0,0 +1,22 @@
+#version 450
+
+layout(location = 0) in vec3 vNormal;
+layout(location = 1) in vec2 vUV;
+layout(location = 2) in vec3 vColor;
+
+layout(location = 0) out vec4 outColor;
+
+layout(set = 0, binding = 0) uniform sampler2D baseColorTexture;
+
+void main()
+{
+    vec4 albedo = texture(baseColorTexture, vUV);
+    if (albedo.a < 0.5)
+        discard;
+
+    // Local space sky term: the frames do not depend on scene lights, so
+    // upward facing surfaces are just a bit brighter than the rest
+    float sky = mix(0.55, 1.0, normalize(vNormal).y * 0.5 + 0.5);
+
+    outColor = vec4(albedo.rgb * vColor * sky, 1.0);
+}
@@ -0,0 +1,24 @@
+#version 450
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec2 inUV;
+layout(location = 3) in vec3 inNormal;
+
+layout(push_constant) uniform BakePush
+{
+    mat4 viewProj;
+} pc;
+
+layout(location = 0) out vec3 vNormal;
+layout(location = 1) out vec2 vUV;
+layout(location = 2) out vec3 vColor;
+
+void main()
+{
+    vNormal = inNormal;
+    vUV = inUV;
+    vColor = inColor;
+
+    gl_Position = pc.viewProj * vec4(inPosition, 1.0);
+}
@@ -0,0 +1,16 @@
+#version 450
+
+layout(location = 0) in vec2 vUV;
+
+layout(location = 0) out vec4 outColor;
+
+layout(set = 1, binding = 0) uniform sampler2D atlas;
+
+void main()
+{
+    vec4 color = texture(atlas, vUV);
+    if (color.a < 0.5)
+        discard;
+
+    outColor = vec4(color.rgb, 1.0);
+}
@@ -0,0 +1,78 @@
+#version 450
+
+// One instance per object, the model matrix by columns
+layout(location = 0) in vec4 inModel0;
+layout(location = 1) in vec4 inModel1;
+layout(location = 2) in vec4 inModel2;
+layout(location = 3) in vec4 inModel3;
+
+layout(set = 0, binding = 0) uniform CameraUBO
+{
+    mat4 view;
+    mat4 proj;
+} camera;
+
+layout(push_constant) uniform ImposterPush
+{
+    vec4 centerRadius; // local space bounding sphere of the baked frames
+} pc;
+
+// Must match ImposterBaker::kFrames
+const uint FRAMES = 8;
+
+layout(location = 0) out vec2 vUV;
+
+const vec2 kCorners[6] = vec2[](
+    vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0),
+    vec2(-1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0));
+
+vec2 SignNotZero(vec2 v)
+{
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// Full sphere octahedral mapping, same as ImposterBaker.cpp
+vec2 OctahedralEncode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.xy;
+    if (n.z < 0.0)
+        e = (1.0 - abs(e.yx)) * SignNotZero(e);
+    return e;
+}
+
+vec3 OctahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * SignNotZero(n.xy);
+    return normalize(n);
+}
+
+void main()
+{
+    mat4 model = mat4(inModel0, inModel1, inModel2, inModel3);
+    mat3 basis = mat3(model);
+
+    vec3 center = (model * vec4(pc.centerRadius.xyz, 1.0)).xyz;
+    vec3 eye = -transpose(mat3(camera.view)) * camera.view[3].xyz;
+
+    // Frame whose bake direction is closest to the local view direction
+    vec3 localDir = normalize(inverse(basis) * (eye - center));
+    vec2 cellUV = OctahedralEncode(localDir) * 0.5 + 0.5;
+    uvec2 cell = min(uvec2(cellUV * float(FRAMES)), uvec2(FRAMES - 1));
+    vec3 frameDir = OctahedralDecode((vec2(cell) + 0.5) / float(FRAMES) * 2.0 - 1.0);
+
+    // Same camera basis as the bake (glm::lookAt), taken to world space, so
+    // the quad is the frame's image plane and the object keeps its rotation
+    vec3 up = abs(frameDir.y) > 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+    vec3 right = normalize(cross(-frameDir, up));
+    up = cross(right, -frameDir);
+
+    vec2 corner = kCorners[gl_VertexIndex];
+    vec3 local = pc.centerRadius.xyz + (corner.x * right + corner.y * up) * pc.centerRadius.w;
+
+    vUV = (vec2(cell) + vec2(corner.x * 0.5 + 0.5, 0.5 - corner.y * 0.5)) / float(FRAMES);
+
+    gl_Position = camera.proj * (camera.view * (model * vec4(local, 1.0)));
+}
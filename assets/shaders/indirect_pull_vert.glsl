@@ -0,0 +1,151 @@
+#version 450
+#extension GL_EXT_buffer_reference : require
+#extension GL_EXT_buffer_reference_uvec2 : require
+
+// indirect_vert.glsl without vertex input state: attributes are fetched and
+// decoded from the geometry page of the object, see GpuVertexFormat.
+
+layout(set = 0, binding = 0) uniform CameraUBO
+{
+    mat4 view;
+    mat4 proj;
+} camera;
+
+struct Object
+{
+    mat4 model;
+    vec4 boundsMin;
+    vec4 boundsMax;
+    uvec4 draw;
+    uvec4 bucket; // x bucket, y commandBase, z vertexPage
+};
+
+layout(std430, set = 3, binding = 0) readonly buffer Objects
+{
+    Object objects[];
+};
+
+struct VertexFormat
+{
+    uvec2 streams[2];
+    uvec4 attribs;
+    uvec4 strides;
+};
+
+layout(std430, set = 3, binding = 1) readonly buffer VertexFormats
+{
+    VertexFormat formats[];
+};
+
+layout(buffer_reference, std430, buffer_reference_align = 4) readonly buffer Words
+{
+    uint w[];
+};
+
+layout(push_constant) uniform PushData
+{
+    mat4 u_model;
+    vec4 u_color;
+    vec4 u_params;
+    vec4 u_cameraPos;
+} pc;
+
+layout(location = 0) out vec3 vWorldPos;
+layout(location = 1) out vec3 vNormal;
+layout(location = 2) out vec2 vUV;
+layout(location = 3) out vec3 vColor;
+layout(location = 4) out float vViewDepth;
+
+// Matches indirect_vert.glsl and depth_pull_vert.glsl
+invariant gl_Position;
+
+// AttribType in VertexLayout.h
+const uint kFloat32 = 0u;
+const uint kFloat16 = 1u;
+const uint kSNorm16 = 2u;
+const uint kUNorm16 = 3u;
+const uint kSNorm8 = 4u;
+const uint kUNorm8 = 5u;
+const uint kSNorm10_10_10_2 = 6u;
+const uint kAttribPresent = 1u << 12;
+
+vec4 fetchAttrib(VertexFormat f, uint location, uint vertex, vec4 fallback)
+{
+    uint a = f.attribs[location];
+    if ((a & kAttribPresent) == 0u)
+        return fallback;
+
+    uint type = a & 0xFu;
+    uint comps = (a >> 4) & 0xFu;
+    uint binding = (a >> 8) & 0xFu;
+    uint word = (vertex * f.strides[binding] + (a >> 16)) >> 2;
+    Words data = Words(f.streams[binding]);
+
+    vec4 v;
+    if (type == kFloat32)
+    {
+        for (uint i = 0u; i < 4u; ++i)
+            v[i] = i < comps ? uintBitsToFloat(data.w[word + i]) : 0.0;
+    }
+    else if (type == kFloat16)
+    {
+        v.xy = unpackHalf2x16(data.w[word]);
+        v.zw = comps > 2u ? unpackHalf2x16(data.w[word + 1u]) : vec2(0.0);
+    }
+    else if (type == kSNorm16)
+    {
+        v.xy = unpackSnorm2x16(data.w[word]);
+        v.zw = comps > 2u ? unpackSnorm2x16(data.w[word + 1u]) : vec2(0.0);
+    }
+    else if (type == kUNorm16)
+    {
+        v.xy = unpackUnorm2x16(data.w[word]);
+        v.zw = comps > 2u ? unpackUnorm2x16(data.w[word + 1u]) : vec2(0.0);
+    }
+    else if (type == kSNorm8)
+    {
+        v = unpackSnorm4x8(data.w[word]);
+    }
+    else if (type == kUNorm8)
+    {
+        v = unpackUnorm4x8(data.w[word]);
+    }
+    else
+    {
+        int p = int(data.w[word]);
+        v = max(vec4(bitfieldExtract(p, 0, 10), bitfieldExtract(p, 10, 10),
+                     bitfieldExtract(p, 20, 10), bitfieldExtract(p, 30, 2)) /
+                    vec4(511.0, 511.0, 511.0, 1.0),
+                vec4(-1.0));
+    }
+
+    for (uint i = comps; i < 4u; ++i)
+        v[i] = fallback[i];
+    return v;
+}
+
+void main()
+{
+    // firstInstance of the indirect command is the object index
+    Object o = objects[gl_InstanceIndex];
+    VertexFormat f = formats[o.bucket.z];
+    uint vertex = uint(gl_VertexIndex);
+
+    vec3 inPosition = fetchAttrib(f, 0u, vertex, vec4(0.0, 0.0, 0.0, 1.0)).xyz;
+    vec3 inColor = fetchAttrib(f, 1u, vertex, vec4(1.0)).rgb;
+    vec2 inUV = fetchAttrib(f, 2u, vertex, vec4(0.0)).xy;
+    vec3 inNormal = fetchAttrib(f, 3u, vertex, vec4(0.0, 0.0, 1.0, 0.0)).xyz;
+
+    mat4 model = o.model;
+
+    vec4 world = model * vec4(inPosition, 1.0);
+    vec4 view = camera.view * world;
+
+    vWorldPos = world.xyz;
+    vNormal = mat3(transpose(inverse(model))) * inNormal;
+    vUV = inUV;
+    vColor = inColor * pc.u_color.rgb;
+    vViewDepth = -view.z;
+
+    gl_Position = camera.proj * view;
+}
@@ -0,0 +1,60 @@
+#version 450
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec2 inUV;
+layout(location = 3) in vec3 inNormal;
+
+layout(set = 0, binding = 0) uniform CameraUBO
+{
+    mat4 view;
+    mat4 proj;
+} camera;
+
+struct Object
+{
+    mat4 model;
+    vec4 boundsMin;
+    vec4 boundsMax;
+    uvec4 draw;
+    uvec4 bucket;
+};
+
+layout(std430, set = 3, binding = 0) readonly buffer Objects
+{
+    Object objects[];
+};
+
+layout(push_constant) uniform PushData
+{
+    mat4 u_model;
+    vec4 u_color;
+    vec4 u_params;
+    vec4 u_cameraPos;
+} pc;
+
+layout(location = 0) out vec3 vWorldPos;
+layout(location = 1) out vec3 vNormal;
+layout(location = 2) out vec2 vUV;
+layout(location = 3) out vec3 vColor;
+layout(location = 4) out float vViewDepth;
+
+// Matches depth_vert.glsl for the depth prepass
+invariant gl_Position;
+
+void main()
+{
+    // firstInstance of the indirect command is the object index
+    mat4 model = objects[gl_InstanceIndex].model;
+
+    vec4 world = model * vec4(inPosition, 1.0);
+    vec4 view = camera.view * world;
+
+    vWorldPos = world.xyz;
+    vNormal = mat3(transpose(inverse(model))) * inNormal;
+    vUV = inUV;
+    vColor = inColor * pc.u_color.rgb;
+    vViewDepth = -view.z;
+
+    gl_Position = camera.proj * view;
+}
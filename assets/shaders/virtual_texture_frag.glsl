@@ -0,0 +1,164 @@
+#version 450
+
+layout(location = 0) in vec3 vWorldPos;
+layout(location = 1) in vec3 vNormal;
+layout(location = 2) in vec2 vUV;
+layout(location = 3) in vec3 vColor;
+layout(location = 4) in float vViewDepth;
+
+layout(location = 0) out vec4 outColor;
+
+// Hidden fragments must not request pages
+layout(early_fragment_tests) in;
+
+// See VirtualTextureSystem
+layout(set = 1, binding = 0) uniform sampler2D pageCache;
+layout(set = 1, binding = 1) uniform usampler2D pageTable;
+
+layout(set = 1, binding = 2) uniform VirtualTextureParams
+{
+    uvec4 info;     // id, level count, width, height
+    uvec4 feedback; // width, height in slots, jitter x, y
+    vec4 cache;     // page size, border, 1 / cache size, tile size
+} vt;
+
+layout(std430, set = 1, binding = 3) writeonly buffer Feedback
+{
+    uint requests[];
+};
+
+// Must match VirtualTextureSystem::kFeedbackScale
+const uint FEEDBACK_SCALE = 8;
+
+layout(push_constant) uniform PushData
+{
+    mat4 u_model;
+    vec4 u_color;
+    vec4 u_params;
+    vec4 u_cameraPos;
+} pc;
+
+// Must match ClusteredLighting::kGridX/Y/Z
+const uint GRID_X = 16;
+const uint GRID_Y = 9;
+const uint GRID_Z = 24;
+
+struct GpuLight
+{
+    vec4 positionRadius; // world xyz, radius
+    vec4 colorIntensity; // rgb, intensity
+};
+
+struct GpuCluster
+{
+    uint offset;
+    uint count;
+};
+
+layout(set = 2, binding = 0) uniform ClusterParams
+{
+    uvec4 gridSize; // x, y, z, light count
+    vec4 zParams;   // slice scale, slice bias, near, far
+    vec4 screen;    // width, height, 1/width, 1/height
+} cluster;
+
+layout(std430, set = 2, binding = 1) readonly buffer Lights
+{
+    GpuLight lights[];
+};
+
+layout(std430, set = 2, binding = 2) readonly buffer Clusters
+{
+    GpuCluster clusters[];
+};
+
+layout(std430, set = 2, binding = 3) readonly buffer LightIndices
+{
+    uint lightIndices[];
+};
+
+uint ClusterIndex()
+{
+    vec2 uv = gl_FragCoord.xy * cluster.screen.zw;
+    uint x = min(uint(uv.x * GRID_X), GRID_X - 1);
+    uint y = min(uint(uv.y * GRID_Y), GRID_Y - 1);
+
+    float slice = log(max(vViewDepth, cluster.zParams.z)) * cluster.zParams.x + cluster.zParams.y;
+    uint z = min(uint(max(slice, 0.0)), GRID_Z - 1);
+
+    return (z * GRID_Y + y) * GRID_X + x;
+}
+
+// Texel of the page that covers texel at level, clamped to the last tile
+uvec2 TileOf(vec2 texel, uint level)
+{
+    uvec2 tiles = uvec2(textureSize(pageTable, int(level)));
+    return min(uvec2(texel / (vt.cache.w * exp2(float(level)))), tiles - 1u);
+}
+
+vec3 SampleVirtual(vec2 uv)
+{
+    vec2 texel = clamp(uv, 0.0, 1.0) * vec2(vt.info.zw);
+
+    // Level the hardware would pick for a texture of the full size
+    vec2 dx = dFdx(uv * vec2(vt.info.zw));
+    vec2 dy = dFdy(uv * vec2(vt.info.zw));
+    float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8));
+    uint level = uint(clamp(floor(lod), 0.0, float(vt.info.y - 1u)));
+    uvec2 tile = TileOf(texel, level);
+
+    // One pixel of every FEEDBACK_SCALE^2 block reports, a different one each frame
+    uvec2 pixel = uvec2(gl_FragCoord.xy);
+    if (all(equal(pixel % FEEDBACK_SCALE, vt.feedback.zw)))
+    {
+        uvec2 slot = pixel / FEEDBACK_SCALE;
+        if (slot.x < vt.feedback.x && slot.y < vt.feedback.y)
+            requests[slot.y * vt.feedback.x + slot.x] = vt.info.x << 24 | level << 20 | tile.y << 10 | tile.x;
+    }
+
+    // x, y of the cache page, the level it holds, valid
+    uvec4 entry = texelFetch(pageTable, ivec2(tile), int(level));
+    if (entry.a == 0u)
+        return vec3(0.5);
+
+    vec2 resident = texel * exp2(-float(entry.b));
+    vec2 inPage = resident - vec2(TileOf(texel, entry.b)) * vt.cache.w;
+    vec2 cacheTexel = vec2(entry.rg) * vt.cache.x + vt.cache.y + inPage;
+    return textureLod(pageCache, cacheTexel * vt.cache.z, 0.0).rgb;
+}
+
+void main()
+{
+    vec3 albedo = SampleVirtual(vUV) * vColor;
+    vec3 N = normalize(vNormal);
+    vec3 V = normalize(pc.u_cameraPos.xyz - vWorldPos);
+
+    vec3 color = albedo * 0.1;
+
+    GpuCluster c = clusters[ClusterIndex()];
+    for (uint i = 0; i < c.count; ++i)
+    {
+        GpuLight light = lights[lightIndices[c.offset + i]];
+
+        vec3 toLight = light.positionRadius.xyz - vWorldPos;
+        float dist = length(toLight);
+        float radius = light.positionRadius.w;
+        if (dist >= radius)
+            continue;
+
+        vec3 L = toLight / dist;
+        vec3 H = normalize(L + V);
+
+        // Windowed inverse-square falloff, reaches zero at the radius
+        float window = clamp(1.0 - pow(dist / radius, 4.0), 0.0, 1.0);
+        float attenuation = window * window / (dist * dist + 1.0);
+
+        float diffuse = max(dot(N, L), 0.0);
+        float specular = pow(max(dot(N, H), 0.0), 32.0) * 0.5;
+
+        vec3 radiance = light.colorIntensity.rgb * light.colorIntensity.w * attenuation;
+        color += (albedo * diffuse + specular) * radiance;
+    }
+
+    outColor = vec4(color, 1.0);
+}
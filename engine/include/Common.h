@@ -11,12 +11,22 @@ namespace eng
         glm::mat4 viewMatrix;
         glm::mat4 projectionMatrix;
         glm::vec3 position;
+        float nearPlane = 0.1f;
+        float farPlane = 1000.f;
     };
 
     struct LightData
     {
         glm::vec3 color;
         glm::vec3 position;
+        float radius = 10.f;
+        float intensity = 1.f;
+    };
+
+    struct AABB
+    {
+        glm::vec3 min = glm::vec3(0.f);
+        glm::vec3 max = glm::vec3(0.f);
     };
 
 }
\ No newline at end of file
@@ -5,8 +5,10 @@
 #include "graphics/Texture.h"
 #include "vk/VulkanContext.h"
 #include "render/RenderQueue.h"
+#include "render/RenderScene.h"
 #include "scene/Scene.h"
 #include "io/FileSystem.h"
+#include "jobs/JobSystem.h"
 
 #include <memory>
 #include <chrono>
@@ -40,20 +42,32 @@ namespace eng
         VulkanContext &GetVulkanContext();
         GraphicsAPI &GetGraphicsAPI();
         RenderQueue &GetRenderQueue();
+        RenderScene &GetRenderScene();
         FileSystem &GetFileSystem();
         TextureManager &GetTextureManager();
+        JobSystem &GetJobSystem();
 
         void SetScene(Scene *scene);
         Scene *GetScene();
 
+        // Culling and streaming counters are logged this often, in seconds
+        static constexpr float kStatsInterval = 1.f;
+
+    private:
+        void LogStats();
+
     private:
         std::unique_ptr<Application> m_application;
         std::chrono::steady_clock::time_point m_lastTimePoint;
+        float m_statsTime = 0.f;
+        uint32_t m_statsFrames = 0;
+        JobSystem m_jobSystem;
         SDL_Window *m_window = nullptr;
         InputManager m_inputManager;
         VulkanContext m_vulkanContext;
         GraphicsAPI m_graphicsAPI;
         RenderQueue m_renderQueue;
+        RenderScene m_renderScene;
         FileSystem m_fileSystem;
         TextureManager m_textureManager;
         std::unique_ptr<Scene> m_currentScene;
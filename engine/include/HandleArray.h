@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace eng
+{
+    // Densely packed items addressed by stable handles. Removal swaps the
+    // last item into the hole, so iteration order is not preserved.
+    template <typename T>
+    class HandleArray
+    {
+    public:
+        using Handle = uint32_t;
+        static constexpr Handle kInvalid = UINT32_MAX;
+
+        Handle Add(const T &item)
+        {
+            Handle handle;
+            if (!m_freeHandles.empty())
+            {
+                handle = m_freeHandles.back();
+                m_freeHandles.pop_back();
+            }
+            else
+            {
+                handle = (Handle)m_handleToIndex.size();
+                m_handleToIndex.push_back(0);
+            }
+
+            m_handleToIndex[handle] = (uint32_t)m_items.size();
+            m_items.push_back(item);
+            m_indexToHandle.push_back(handle);
+            return handle;
+        }
+
+        void Remove(Handle handle)
+        {
+            const uint32_t index = m_handleToIndex[handle];
+            const uint32_t last = (uint32_t)m_items.size() - 1;
+
+            if (index != last)
+            {
+                m_items[index] = std::move(m_items[last]);
+                m_indexToHandle[index] = m_indexToHandle[last];
+                m_handleToIndex[m_indexToHandle[index]] = index;
+            }
+
+            m_items.pop_back();
+            m_indexToHandle.pop_back();
+            m_freeHandles.push_back(handle);
+        }
+
+        T &Get(Handle handle) { return m_items[m_handleToIndex[handle]]; }
+        const T &Get(Handle handle) const { return m_items[m_handleToIndex[handle]]; }
+
+        const std::vector<T> &GetItems() const { return m_items; }
+        Handle GetHandle(uint32_t index) const { return m_indexToHandle[index]; }
+        size_t Size() const { return m_items.size(); }
+
+        void Clear()
+        {
+            m_items.clear();
+            m_indexToHandle.clear();
+            m_handleToIndex.clear();
+            m_freeHandles.clear();
+        }
+
+    private:
+        std::vector<T> m_items;
+        std::vector<Handle> m_indexToHandle;
+        std::vector<uint32_t> m_handleToIndex;
+        std::vector<Handle> m_freeHandles;
+    };
+}
@@ -18,4 +18,5 @@
 #include "scene/components/CameraComponent.h"
 #include "scene/components/PlayerControllerComponent.h"
 #include "scene/components/LightComponent.h"
-#include "io/FileSystem.h"
\ No newline at end of file
+#include "io/FileSystem.h"
+#include "jobs/JobSystem.h"
\ No newline at end of file
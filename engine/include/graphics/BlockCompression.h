@@ -0,0 +1,51 @@
+#pragma once
+
+#include "graphics/TextureContainer.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+namespace eng
+{
+    class JobSystem;
+
+    // CPU decoders for the BCn formats TextureContainer reads. Used when the
+    // device cannot sample a format (no textureCompressionBC).
+    //
+    // Every decoder writes a 4x4 block of RGBA8 texels, row major. BC4 and
+    // BC5 fill the missing channels with 0 and alpha with 255.
+    void DecodeBC1Block(const uint8_t *block, uint8_t *rgba);
+    void DecodeBC3Block(const uint8_t *block, uint8_t *rgba);
+    void DecodeBC4Block(const uint8_t *block, uint8_t *rgba);
+    void DecodeBC5Block(const uint8_t *block, uint8_t *rgba);
+    void DecodeBC7Block(const uint8_t *block, uint8_t *rgba);
+
+    // False for formats without a decoder (BC2, BC6H, signed BC4/BC5)
+    bool DecodeBlock(VkFormat format, const uint8_t *block, uint8_t *rgba);
+
+    // Whole mip chain to RGBA8, keeping the color space of the source
+    bool DecompressTexture(const TextureImage &in, TextureImage &out);
+
+    // CPU encoders for the same formats, used by the texture cooker. Input is
+    // a 4x4 block of RGBA8 texels in the layout the decoders produce.
+    //
+    // Endpoints start on the principal axis of the block and are refined by
+    // least squares. BC1 switches to the three color mode when a texel has
+    // alpha below 128. BC7 uses mode 6 and also tries mode 1 on the best
+    // scoring partitions for opaque blocks, mode 5 for the others.
+    void EncodeBC1Block(const uint8_t *rgba, uint8_t *block);
+    void EncodeBC3Block(const uint8_t *rgba, uint8_t *block);
+    void EncodeBC4Block(const uint8_t *rgba, uint8_t *block);
+    void EncodeBC5Block(const uint8_t *rgba, uint8_t *block);
+    void EncodeBC7Block(const uint8_t *rgba, uint8_t *block);
+
+    bool EncodeBlock(VkFormat format, const uint8_t *rgba, uint8_t *block);
+
+    // RGBA8 mip chain to format. Rows of blocks are spread over jobs when
+    // one is given, otherwise encoded on the calling thread.
+    bool CompressTexture(const TextureImage &in, VkFormat format, TextureImage &out, JobSystem *jobs = nullptr);
+
+    // SIMD level the encoder index search was compiled for (ENGINE_SIMD)
+    extern const char *const kBlockEncoderSimdName;
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "graphics/VertexLayout.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace eng
+{
+    // Where a mesh lives inside the pool. Offsets are in vertices/indices,
+    // ready to be passed to vkCmdDrawIndexed.
+    struct GeometryAllocation
+    {
+        static constexpr uint32_t kInvalidPage = UINT32_MAX;
+
+        uint32_t page = kInvalidPage;
+        uint32_t indexPage = kInvalidPage;
+        uint32_t firstVertex = 0;
+        uint32_t vertexCount = 0;
+        uint32_t firstIndex = 0;
+        uint32_t indexCount = 0;
+
+        bool IsValid() const { return page != kInvalidPage; }
+    };
+
+    // Vertex format of a page as read by shaders that pull their vertices,
+    // must match VertexFormat in indirect_pull_vert.glsl. One word per
+    // location: type | components << 4 | binding << 8 | kAttribPresent | offset << 16.
+    struct GpuVertexFormat
+    {
+        static constexpr uint32_t kAttribPresent = 1u << 12;
+        static constexpr uint32_t kMaxLocations = 4;
+
+        VkDeviceAddress streams[2]{};
+        uint32_t attribs[kMaxLocations]{};
+        uint32_t strides[4]{};
+    };
+
+    // Sub-allocates mesh data from a few large device local buffers. Every
+    // vertex page holds a single vertex layout, multi stream layouts keep one
+    // region per stream in it. Indices live in separate pages per index type
+    // that are shared by all layouts, so meshes of different formats can be
+    // drawn from one index buffer when their vertices are pulled in the shader.
+    class GeometryPool
+    {
+    public:
+        static constexpr VkDeviceSize kVertexPageSize = 32ull * 1024 * 1024;
+        static constexpr VkDeviceSize kIndexPageSize = 16ull * 1024 * 1024;
+        // Freed ranges stay reserved until the frames that may use them are done.
+        static constexpr uint32_t kRetireFrames = 3;
+
+        GeometryPool() = default;
+        GeometryPool(const GeometryPool &) = delete;
+        GeometryPool &operator=(const GeometryPool &) = delete;
+
+        // Uploads through a staging buffer on the graphics queue and waits for the copy.
+        // vertices holds vertexCount * layout.stride bytes, indices indexCount of indexType.
+        // Layouts with several streams pass them one after the other.
+        GeometryAllocation Allocate(const VertexLayout &layout, const void *vertices, uint32_t vertexCount,
+                                    const void *indices, uint32_t indexCount, VkIndexType indexType);
+        void Free(const GeometryAllocation &allocation);
+
+        // Called once per frame after the frame fence was waited on.
+        void NextFrame();
+        void Destroy();
+
+        // Binds the vertex streams of a page, resp. an index page.
+        void Bind(VkCommandBuffer cmd, uint32_t page) const;
+        void BindIndices(VkCommandBuffer cmd, uint32_t indexPage) const;
+
+        VkBuffer GetVertexBuffer(uint32_t page) const { return m_pages[page].vertexBuffer; }
+        VkBuffer GetIndexBuffer(uint32_t indexPage) const { return m_indexPages[indexPage].buffer; }
+        const VertexLayout &GetLayout(uint32_t page) const { return m_pages[page].layout; }
+        VkIndexType GetIndexType(uint32_t indexPage) const { return m_indexPages[indexPage].type; }
+        uint32_t GetPageCount() const { return (uint32_t)m_pages.size(); }
+
+        // Vertex buffers get device addresses once enabled, before the first allocation.
+        void SetDeviceAddresses(bool enabled) { m_deviceAddresses = enabled; }
+        bool HasDeviceAddresses() const { return m_deviceAddresses; }
+        // Only meaningful with device addresses enabled
+        GpuVertexFormat GetVertexFormat(uint32_t page) const;
+
+    private:
+        // First fit free list over [0, capacity), adjacent ranges are merged on free.
+        struct RangeAllocator
+        {
+            struct Range
+            {
+                uint32_t offset = 0;
+                uint32_t size = 0;
+            };
+
+            std::vector<Range> free;
+
+            void Init(uint32_t capacity);
+            bool Allocate(uint32_t size, uint32_t &outOffset);
+            void Free(uint32_t offset, uint32_t size);
+        };
+
+        struct Page
+        {
+            VertexLayout layout;
+            // Where each stream of the layout starts in vertexBuffer
+            std::vector<VkDeviceSize> streamOffsets;
+            VkBuffer vertexBuffer = VK_NULL_HANDLE;
+            VkDeviceMemory vertexMemory = VK_NULL_HANDLE;
+            VkDeviceAddress address = 0;
+            RangeAllocator vertices;
+        };
+
+        struct IndexPage
+        {
+            VkIndexType type = VK_INDEX_TYPE_UINT32;
+            VkBuffer buffer = VK_NULL_HANDLE;
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            RangeAllocator indices;
+        };
+
+        struct PendingFree
+        {
+            GeometryAllocation allocation;
+            uint32_t framesLeft = 0;
+        };
+
+        uint32_t CreatePage(const VertexLayout &layout, uint32_t vertexCapacity);
+        uint32_t CreateIndexPage(VkIndexType indexType, uint32_t indexCapacity);
+        void Release(const GeometryAllocation &allocation);
+
+    private:
+        std::mutex m_lock;
+        std::vector<Page> m_pages;
+        std::vector<IndexPage> m_indexPages;
+        std::vector<PendingFree> m_pendingFrees;
+        bool m_deviceAddresses = false;
+    };
+}
@@ -6,6 +6,8 @@
 
 #include <vulkan/vulkan.h>
 
+#include "graphics/GeometryPool.h"
+
 namespace eng
 {
     class ShaderProgram;
@@ -25,23 +27,55 @@ namespace eng
         std::shared_ptr<ShaderProgram> CreateShaderProgram(const std::string &vertSpv,
                                                            const std::string &fragSpv,
                                                            const VertexLayout &layout);
+        // Set 1 laid out by textureSetLayout instead of the single sampler of texture sets
+        std::shared_ptr<ShaderProgram> CreateShaderProgram(const std::string &vertSpv,
+                                                           const std::string &fragSpv,
+                                                           const VertexLayout &layout,
+                                                           VkDescriptorSetLayout textureSetLayout);
 
         const std::shared_ptr<ShaderProgram> &GetDefaultShaderProgram();
+        // Default program variant for IndirectRenderer: the model matrix comes from set 3.
+        const std::shared_ptr<ShaderProgram> &GetIndirectShaderProgram();
+        // Position only, no fragment stage. Reads just the position stream.
+        const std::shared_ptr<ShaderProgram> &GetDepthShaderProgram();
+        // No vertex input state: vertices are fetched through the page's
+        // GpuVertexFormat, so one pipeline draws every vertex layout.
+        const std::shared_ptr<ShaderProgram> &GetPullShaderProgram();
+        const std::shared_ptr<ShaderProgram> &GetPullDepthShaderProgram();
+        // Default program sampling a virtual texture, see VirtualTextureSystem.
+        // nullptr when virtual texturing is not supported.
+        const std::shared_ptr<ShaderProgram> &GetVirtualTextureShaderProgram();
 
         void SetClearColor(float r, float g, float b, float a);
 
-        void Begin(VkCommandBuffer cmd) { m_cmd = cmd; }
+        void Begin(VkCommandBuffer cmd)
+        {
+            m_cmd = cmd;
+            m_boundGeometryPage = GeometryAllocation::kInvalidPage;
+            m_boundIndexPage = GeometryAllocation::kInvalidPage;
+            m_currentProgram = nullptr;
+        }
         void End() { m_cmd = VK_NULL_HANDLE; }
 
         VkCommandBuffer GetCmd() const { return m_cmd; }
 
         void SetCurrentPipelineLayout(VkPipelineLayout l) { m_currentLayout = l; }
+        void SetCurrentShaderProgram(ShaderProgram *program) { m_currentProgram = program; }
         VkPipelineLayout GetCurrentPipelineLayout() const { return m_currentLayout; }
 
         void BindShaderProgram(ShaderProgram *shaderProgram);
         void BindMaterial(Material *material);
         void BindMesh(Mesh *mesh);
-        void DrawMesh(Mesh *mesh);
+        void DrawMesh(Mesh *mesh, uint32_t lod = 0);
+        void DrawMeshRange(Mesh *mesh, uint32_t firstIndex, uint32_t indexCount);
+
+        GeometryPool &GetGeometryPool() { return m_geometryPool; }
+        // Skips the bind when the page is already bound in this command buffer.
+        // Also picks the pipeline variant of the bound program for the page's vertex layout.
+        void BindGeometryPage(uint32_t page);
+        void BindIndexPage(uint32_t indexPage);
+        // Index buffers outside the pool, forgets the bound index page
+        void BindIndexBuffer(VkBuffer buffer, VkIndexType indexType);
 
         VkBuffer CreateVertexBuffer(const std::vector<float> &vertices);
         VkBuffer CreateIndexBuffer(const std::vector<uint32_t> &indices);
@@ -55,17 +89,30 @@ namespace eng
         void SetCurrentTextureSet(VkDescriptorSet set) { m_textureSet = set; }
         VkDescriptorSet GetCurrentTextureSet() const { return m_textureSet; }
 
+        void SetCurrentLightSet(VkDescriptorSet set) { m_lightSet = set; }
+        VkDescriptorSet GetCurrentLightSet() const { return m_lightSet; }
+
     private:
         VkCommandBuffer m_cmd = VK_NULL_HANDLE;
         VkPipelineLayout m_currentLayout = VK_NULL_HANDLE;
+        ShaderProgram *m_currentProgram = nullptr;
         float m_clearColor[4] = {0.05f, 0.05f, 0.08f, 1.0f};
 
         std::vector<BufferResource> m_ownedBuffers;
+        GeometryPool m_geometryPool;
+        uint32_t m_boundGeometryPage = GeometryAllocation::kInvalidPage;
+        uint32_t m_boundIndexPage = GeometryAllocation::kInvalidPage;
 
         VkDescriptorSet m_cameraSet = VK_NULL_HANDLE;
         VkDescriptorSet m_textureSet = VK_NULL_HANDLE;
+        VkDescriptorSet m_lightSet = VK_NULL_HANDLE;
 
         std::shared_ptr<ShaderProgram> m_defaultShaderProgram;
+        std::shared_ptr<ShaderProgram> m_indirectShaderProgram;
+        std::shared_ptr<ShaderProgram> m_depthShaderProgram;
+        std::shared_ptr<ShaderProgram> m_pullShaderProgram;
+        std::shared_ptr<ShaderProgram> m_pullDepthShaderProgram;
+        std::shared_ptr<ShaderProgram> m_virtualTextureShaderProgram;
     };
 
 }
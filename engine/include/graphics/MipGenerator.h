@@ -0,0 +1,23 @@
+#pragma once
+
+#include "graphics/TextureContainer.h"
+
+namespace eng
+{
+    class JobSystem;
+
+    // CPU mip chains for RGBA8 images, so every format gets its levels without
+    // a blit chain on the GPU (which needs linear filter support and records a
+    // blit and a barrier per level).
+    //
+    // 2x2 box filter down to 1x1, odd sides drop or repeat their last texel.
+    // sRGB color is averaged in linear space, alpha always is linear. Each
+    // level is filtered from the 8 bit level above it and rounded to nearest.
+    //
+    // Replaces every level below level 0. Rows are spread over jobs when one
+    // is given. False for formats other than RGBA8.
+    bool GenerateMipChain(TextureImage &image, JobSystem *jobs = nullptr);
+
+    // SIMD level the filter was compiled for (ENGINE_SIMD)
+    extern const char *const kMipGeneratorSimdName;
+}
@@ -3,6 +3,7 @@
 #include <string>
 #include <memory>
 #include <unordered_map>
+#include <vector>
 
 #include <vulkan/vulkan.h>
 #include <glm/glm.hpp>
@@ -21,10 +22,14 @@ namespace eng
         ShaderProgram(const ShaderProgram &) = delete;
         ShaderProgram &operator=(const ShaderProgram &) = delete;
 
+        // layout lists the vertex inputs the shaders read; pipelines for other mesh
+        // layouts only declare those locations and the bindings they live in.
+        // An empty fragSpv makes a depth only program without color writes.
         void Create(VkDevice device, VkRenderPass renderPass, VkExtent2D extent,
                     const VertexLayout &layout,
                     const std::string &vertSpv, const std::string &fragSpv,
-                    VkDescriptorSetLayout cameraSetLayout, VkDescriptorSetLayout textureSetLayout);
+                    VkDescriptorSetLayout cameraSetLayout, VkDescriptorSetLayout textureSetLayout,
+                    VkDescriptorSetLayout lightSetLayout, VkDescriptorSetLayout objectSetLayout);
 
         // swapchain recreate
         void Recreate(VkRenderPass rp, VkExtent2D extent);
@@ -32,6 +37,9 @@ namespace eng
         void Destroy();
 
         void Bind();
+        // Switches to the pipeline variant for meshes stored in layout. Called by
+        // GraphicsAPI::BindGeometryPage on the bound program, variants are created lazily.
+        void BindVertexLayout(const VertexLayout &layout);
         void SetUniform(const std::string &name, float v);
         void SetUniform(const std::string &name, float v0, float v1);
         void SetUniform(const std::string &name, const glm::vec3 &v);
@@ -47,9 +55,7 @@ namespace eng
             glm::mat4 u_model = glm::mat4(1.0f);                // 64 bytes
             glm::vec4 u_color = glm::vec4(1.f, 1.f, 1.f, 1.f);  // 16 bytes
             glm::vec4 u_params = glm::vec4(0.f, 0.f, 1.f, 0.f); // x=time, y=value, z=strength, w=unused
-
-            glm::vec4 u_lightPos = glm::vec4(0.f, 0.f, 0.f, 1.f);
-            glm::vec4 u_lightColor = glm::vec4(1.f, 1.f, 1.f, 1.f);
+            // Lights are in the clustered lighting buffers (set 2)
             glm::vec4 u_cameraPos = glm::vec4(0.f, 0.f, 0.f, 1.f);
         };
 
@@ -57,22 +63,33 @@ namespace eng
         VkShaderModule loadModule(const std::string &spvPath);
         void createPipelineLayoutIfNeeded();
         void recreatePipelineInternal(); // uses m_renderPass/m_extent
+        VkPipeline createPipeline(const VertexLayout &layout);
         void pushConstantsNow();         // vkCmdPushConstants if cmd is active
 
     private:
         VkDevice m_device = VK_NULL_HANDLE;
         VkRenderPass m_renderPass = VK_NULL_HANDLE;
         VkExtent2D m_extent{};
-        VertexLayout m_vlayout{};
+        VertexLayout m_inputs;
         std::string m_vertPath, m_fragPath;
 
         VkPipelineLayout m_layout = VK_NULL_HANDLE;
-        VkPipeline m_pipeline = VK_NULL_HANDLE;
+        // One pipeline per vertex layout, [0] is the layout passed to Create
+        struct Variant
+        {
+            VertexLayout layout;
+            VkPipeline pipeline = VK_NULL_HANDLE;
+        };
+        std::vector<Variant> m_variants;
+        uint32_t m_boundVariant = UINT32_MAX;
+        uint32_t m_lastVariant = 0;
 
         PushData m_pc{};
 
         VkDescriptorSetLayout m_cameraSetLayout = VK_NULL_HANDLE;
         VkDescriptorSetLayout m_textureSetLayout = VK_NULL_HANDLE;
+        VkDescriptorSetLayout m_lightSetLayout = VK_NULL_HANDLE;
+        VkDescriptorSetLayout m_objectSetLayout = VK_NULL_HANDLE;
     };
 
 }
@@ -1,15 +1,21 @@
 #pragma once
 
+#include "graphics/TextureContainer.h"
+#include "graphics/TextureStreamer.h"
+#include "jobs/JobSystem.h"
+
 #include <vulkan/vulkan.h>
 
 #include <cstdint>
 #include <string>
 #include <filesystem>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
+#include <vector>
 
 namespace eng
 {
-
     class Texture
     {
     public:
@@ -19,7 +25,10 @@ namespace eng
         Texture(const Texture &) = delete;
         Texture &operator=(const Texture &) = delete;
 
-        // Load via stb_image (RGBA8)
+        // KTX2 and DDS files are uploaded as stored, block compressed with their
+        // mip chain. Other images are decoded via stb_image (RGBA8) unless a
+        // .ktx2 with the same name sits next to them; their mip chain is built
+        // on the CPU (GenerateMipChain) and uploaded in the same copy.
         bool LoadFromFile(VkPhysicalDevice gpu,
                           VkDevice device,
                           VkQueue graphicsQueue,
@@ -27,17 +36,63 @@ namespace eng
                           const std::filesystem::path &path,
                           bool srgb);
 
+        // Uploads an image that is already in memory
+        bool LoadFromImage(VkPhysicalDevice gpu,
+                           VkDevice device,
+                           VkQueue graphicsQueue,
+                           VkCommandPool cmdPool,
+                           const TextureImage &image);
+
         static std::shared_ptr<Texture> Load(VkPhysicalDevice gpu, VkDevice device,
                                              VkQueue graphicsQueue, VkCommandPool cmdPool,
                                              const std::string &path);
 
+        // The CPU half of LoadFromFile, safe to run on any thread. container
+        // gets the KTX2 or DDS file the image came from, if it came from one.
+        static bool ReadImage(const std::filesystem::path &path, bool srgb, TextureImage &out,
+                              std::filesystem::path *container = nullptr);
+        // Decodes formats the device cannot sample to RGBA8, builds the mip
+        // chain of single level RGBA8 images
+        static bool PrepareForDevice(VkPhysicalDevice gpu, TextureImage &image);
+
         void Destroy();
 
-        VkImageView View() const { return m_view; }
-        VkSampler Sampler() const { return m_sampler; }
+        // Until an async load is resident these are the placeholder's
+        VkImageView View() const { return m_view || !m_fallback ? m_view : m_fallback->View(); }
+        VkSampler Sampler() const { return m_sampler || !m_fallback ? m_sampler : m_fallback->Sampler(); }
+        VkDescriptorSet GetTextureSet() const { return m_textureSet || !m_fallback ? m_textureSet : m_fallback->GetTextureSet(); }
+        bool IsResident() const { return m_view != VK_NULL_HANDLE; }
+
+        VkFormat GetFormat() const { return m_format; }
+        // Of level 0, also when it is not resident
+        uint32_t GetWidth() const { return m_width; }
+        uint32_t GetHeight() const { return m_height; }
+        // Of the resident levels
+        VkDeviceSize GetMemorySize() const { return m_memorySize; }
+
+        // Async loads with a mip chain keep only part of it resident, starting
+        // at GetBaseMip. See TextureStreamer. The other levels are read again
+        // from the KTX2 or DDS file; decoded images keep the chain in memory.
+        bool IsStreamed() const { return m_source != nullptr; }
+        uint32_t GetBaseMip() const { return m_baseMip; }
 
     private:
+        friend class TextureManager;
+        friend class TextureStreamer;
+
+        // Staging layout of levels baseMip.. of image, each aligned for the
+        // copy. Returns the size, writes the levels when dst is given.
+        static VkDeviceSize PackLevels(const TextureImage &image, uint32_t baseMip, uint8_t *dst = nullptr);
+
         void createSampler();
+        // Creates the next image, holding levels baseMip.. of image
+        void createImage(VkPhysicalDevice gpu, VkDevice device, const TextureImage &image, uint32_t baseMip);
+        // Copies the levels of the next image from staging, packed at stagingOffset
+        void recordUpload(VkCommandBuffer cmd, VkBuffer staging, VkDeviceSize stagingOffset, const TextureImage &image);
+        // Makes the next image current once its copy has completed. The
+        // previous image, view and set must have been taken by the caller.
+        void finishUpload();
+        bool upload(const TextureImage &image, VkQueue graphicsQueue, VkCommandPool cmdPool);
 
         VkImageView CreateImageView(VkDevice device, VkImage image, VkFormat format);
 
@@ -49,20 +104,122 @@ namespace eng
         VkDeviceMemory m_memory = VK_NULL_HANDLE;
         VkImageView m_view = VK_NULL_HANDLE;
         VkSampler m_sampler = VK_NULL_HANDLE;
+        VkDescriptorSet m_textureSet = VK_NULL_HANDLE;
+        std::shared_ptr<Texture> m_fallback;
 
         uint32_t m_width = 0;
         uint32_t m_height = 0;
         uint32_t m_mipLevels = 1;
+        VkDeviceSize m_memorySize = 0;
         VkFormat m_format = VK_FORMAT_R8G8B8A8_SRGB; // good default for color textures
+
+        // Upload in flight, swapped in by finishUpload
+        VkImage m_nextImage = VK_NULL_HANDLE;
+        VkDeviceMemory m_nextMemory = VK_NULL_HANDLE;
+        VkDeviceSize m_nextMemorySize = 0;
+        uint32_t m_nextBaseMip = 0;
+        uint32_t m_nextMipLevels = 1;
+
+        // Streaming state, owned by TextureStreamer. m_source has no data
+        // when m_sourceFile is set, only the layout of the levels.
+        std::shared_ptr<const TextureImage> m_source;
+        std::filesystem::path m_sourceFile;
+        // Levels m_nextBaseMip.. are being read from m_sourceFile
+        bool m_reading = false;
+        uint32_t m_baseMip = 0;
+        uint32_t m_requestedMip = 0;
+        uint64_t m_requestFrame = 0;
     };
 
     class TextureManager
     {
     public:
+        // Streamed out images stay alive until the frames that may use them are done
+        static constexpr uint32_t kRetireFrames = 3;
+
+        // Loads and uploads on the calling thread
         std::shared_ptr<Texture> GetOrLoadTexture(const std::string &path);
 
+        // Returns at once. The file is decoded on the job system and uploaded
+        // by Update, meanwhile the texture samples a placeholder. Requests for
+        // a path that is loading or loaded share one texture.
+        std::shared_ptr<Texture> GetOrLoadTextureAsync(const std::string &path);
+
+        // Main thread, once per frame before drawing. Makes the textures of
+        // finished copies resident, then submits the decoded ones and the
+        // streaming changes as one batch.
+        void Update();
+        // Called once per frame after the frame fence was waited on
+        void NextFrame();
+        void Destroy();
+
+        // Requested asynchronously and not resident yet
+        uint32_t GetPendingCount() const { return m_pending; }
+
+        TextureStreamer &GetStreamer() { return m_streamer; }
+
     private:
+        struct DecodedTexture
+        {
+            std::shared_ptr<Texture> texture;
+            TextureImage image;
+            // Empty unless every level is stored as read from the file
+            std::filesystem::path container;
+            bool ok = false;
+        };
+
+        // Levels of a streaming change, read from the texture's file
+        struct ReadLevels
+        {
+            std::shared_ptr<Texture> texture;
+            TextureImage image;
+            uint32_t baseMip = 0;
+            bool ok = false;
+        };
+
+        struct Upload
+        {
+            std::shared_ptr<Texture> texture;
+            std::shared_ptr<const TextureImage> image;
+            uint32_t baseMip = 0;
+        };
+
+        // Replaced by a streaming change, kept until the frames using it are done
+        struct RetiredImage
+        {
+            VkImage image = VK_NULL_HANDLE;
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            VkImageView view = VK_NULL_HANDLE;
+            VkDescriptorSet set = VK_NULL_HANDLE;
+            uint32_t framesLeft = 0;
+        };
+
+        struct UploadBatch
+        {
+            VkCommandBuffer cmd = VK_NULL_HANDLE;
+            VkFence fence = VK_NULL_HANDLE;
+            VkBuffer staging = VK_NULL_HANDLE;
+            VkDeviceMemory stagingMemory = VK_NULL_HANDLE;
+            std::vector<std::shared_ptr<Texture>> textures;
+        };
+
+        void createPlaceholder();
+        void submitBatch(std::vector<Upload> &uploads);
+        void destroyBatch(UploadBatch &batch);
+        void destroyRetired(RetiredImage &retired);
+
         std::unordered_map<std::string, std::weak_ptr<Texture>> m_textures;
+
+        std::shared_ptr<Texture> m_placeholder;
+        VkCommandPool m_uploadPool = VK_NULL_HANDLE;
+        JobCounter m_decodeJobs;
+        std::mutex m_decodedMutex;
+        std::vector<DecodedTexture> m_decoded;
+        std::vector<ReadLevels> m_read;
+        std::vector<UploadBatch> m_batches;
+        std::vector<RetiredImage> m_retired;
+        TextureStreamer m_streamer;
+        uint32_t m_pending = 0;
     };
 
 }
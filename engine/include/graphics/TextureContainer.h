@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace eng
+{
+    // An image and its mip chain as stored in a texture container. Block
+    // compressed payloads are kept as they are, ready for a buffer to image copy.
+    struct TextureImage
+    {
+        struct Level
+        {
+            size_t offset = 0;
+            size_t size = 0;
+            uint32_t width = 0;
+            uint32_t height = 0;
+        };
+
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        // Level 0 is the full resolution
+        std::vector<Level> levels;
+        std::vector<uint8_t> data;
+        // Where each level starts in the container it was read from. Empty,
+        // or shorter than levels, when some levels were decoded or generated.
+        std::vector<size_t> fileOffsets;
+    };
+
+    // BC1..BC7 (4x4 blocks) and RGBA8 are the formats textures are loaded in.
+    bool IsBlockCompressed(VkFormat format);
+    bool IsSrgbFormat(VkFormat format);
+    // Bytes per 4x4 block, or per texel for RGBA8. 0 for unsupported formats.
+    uint32_t FormatBlockBytes(VkFormat format);
+    size_t TextureLevelSize(VkFormat format, uint32_t width, uint32_t height);
+
+    // KTX2 without supercompression: 2D, one layer, one face.
+    bool ReadKtx2(const std::vector<char> &file, TextureImage &out);
+    // DDS with a DX10 header or the DXT1/DXT5/ATI1/ATI2/BC4U/BC5U FourCCs.
+    // The legacy FourCCs carry no color space, srgb picks it for BC1 and BC3.
+    bool ReadDds(const std::vector<char> &file, bool srgb, TextureImage &out);
+
+    // Picks the reader by extension (.ktx2 or .dds)
+    bool ReadTextureContainer(const std::filesystem::path &path, bool srgb, TextureImage &out);
+    // Levels firstLevel.. of an image ReadTextureContainer read from path,
+    // straight from the file. out gets the layout of image with only those
+    // levels in data.
+    bool ReadTextureLevels(const std::filesystem::path &path, const TextureImage &image, uint32_t firstLevel, TextureImage &out);
+
+    // KTX2 with a basic data format descriptor, levels as ReadKtx2 expects
+    bool WriteKtx2(const std::filesystem::path &path, const TextureImage &image);
+}
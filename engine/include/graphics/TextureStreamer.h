@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace eng
+{
+    class Texture;
+    class RenderScene;
+    struct CameraData;
+    struct TextureImage;
+
+    // Keeps the textures that have a mip chain partly resident. Visible
+    // proxies request the level that matches the texel density their mesh
+    // has on screen, and levels are streamed in and out so the resident
+    // total stays under a budget. A change uploads a new image holding the
+    // wanted levels; the old one is sampled until the copy completes.
+    class TextureStreamer
+    {
+    public:
+        struct Transition
+        {
+            std::shared_ptr<Texture> texture;
+            uint32_t baseMip = 0;
+        };
+
+        struct Stats
+        {
+            uint32_t textures = 0;
+            // Allocated for the resident levels
+            VkDeviceSize residentBytes = 0;
+            // Levels the requests would need without a budget
+            VkDeviceSize requestedBytes = 0;
+            // Changes started by the last Update
+            uint32_t streamedIn = 0;
+            uint32_t streamedOut = 0;
+        };
+
+        // Levels no larger than this are loaded first and never streamed out
+        static constexpr uint32_t kTailSize = 64;
+        // Frames a request is remembered, after that the texture counts as unused
+        static constexpr uint32_t kRequestFrames = 60;
+        static constexpr VkDeviceSize kDefaultBudget = 256ull << 20;
+
+        // First level of image that is at most kTailSize
+        static uint32_t GetTailMip(const TextureImage &image);
+
+        void Add(const std::shared_ptr<Texture> &texture);
+
+        // Main thread, with the camera of the frame being recorded
+        void RequestMips(const RenderScene &renderScene, const CameraData &camera, float viewportHeight);
+
+        // Picks the resident levels of every texture and appends the changes
+        // whose staging fits in uploadBudget. Levels nobody asked for go
+        // first when over budget, then the finest ones.
+        void Update(VkDeviceSize uploadBudget, std::vector<Transition> &out);
+
+        void SetBudget(VkDeviceSize bytes) { m_budget = bytes; }
+        VkDeviceSize GetBudget() const { return m_budget; }
+        const Stats &GetStats() const { return m_stats; }
+
+        void Clear() { m_textures.clear(); }
+
+    private:
+        std::vector<std::weak_ptr<Texture>> m_textures;
+        VkDeviceSize m_budget = kDefaultBudget;
+        uint64_t m_frame = 0;
+        Stats m_stats;
+    };
+}
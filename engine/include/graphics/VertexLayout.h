@@ -9,7 +9,14 @@ namespace eng
 
     enum class AttribType : uint8_t
     {
-        Float32
+        Float32,
+        Float16,
+        SNorm16,
+        UNorm16,
+        SNorm8,
+        UNorm8,
+        // x y z w in one uint32, always 4 components
+        SNorm10_10_10_2
     };
 
     struct VertexElement
@@ -17,37 +24,70 @@ namespace eng
         uint32_t index;  // location
         uint32_t size;   // components 1..4
         AttribType type; // сейчас достаточно Float32
-        uint32_t offset; // bytes offset
+        uint32_t offset; // bytes offset inside its binding
+        uint32_t binding = 0;
 
         static constexpr uint32_t Position = 0;
         static constexpr uint32_t Color = 1;
         static constexpr uint32_t UV = 2;
         static constexpr uint32_t Normal = 3;
+
+        bool operator==(const VertexElement &) const = default;
     };
 
     struct VertexLayout
     {
         std::vector<VertexElement> elements;
+        // Bytes per vertex over all bindings
         uint32_t stride = 0;
+        // Bytes per vertex of every binding, each stored as its own stream.
+        // Empty for a single interleaved binding of stride bytes.
+        std::vector<uint32_t> streams;
+
+        uint32_t GetStreamCount() const { return streams.empty() ? 1u : (uint32_t)streams.size(); }
+        uint32_t GetStreamStride(uint32_t binding) const { return streams.empty() ? stride : streams[binding]; }
+
+        bool operator==(const VertexLayout &) const = default;
     };
 
     inline VkFormat ToVkFormat(AttribType t, uint32_t comps)
     {
-        if (t == AttribType::Float32)
+        static constexpr VkFormat kFormats[][4] = {
+            {VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT},
+            {VK_FORMAT_R16_SFLOAT, VK_FORMAT_R16G16_SFLOAT, VK_FORMAT_R16G16B16_SFLOAT, VK_FORMAT_R16G16B16A16_SFLOAT},
+            {VK_FORMAT_R16_SNORM, VK_FORMAT_R16G16_SNORM, VK_FORMAT_R16G16B16_SNORM, VK_FORMAT_R16G16B16A16_SNORM},
+            {VK_FORMAT_R16_UNORM, VK_FORMAT_R16G16_UNORM, VK_FORMAT_R16G16B16_UNORM, VK_FORMAT_R16G16B16A16_UNORM},
+            {VK_FORMAT_R8_SNORM, VK_FORMAT_R8G8_SNORM, VK_FORMAT_R8G8B8_SNORM, VK_FORMAT_R8G8B8A8_SNORM},
+            {VK_FORMAT_R8_UNORM, VK_FORMAT_R8G8_UNORM, VK_FORMAT_R8G8B8_UNORM, VK_FORMAT_R8G8B8A8_UNORM},
+        };
+
+        if (t == AttribType::SNorm10_10_10_2)
+            return VK_FORMAT_A2B10G10R10_SNORM_PACK32;
+
+        const size_t type = (size_t)t;
+        if (type >= sizeof(kFormats) / sizeof(kFormats[0]) || comps < 1 || comps > 4)
+            return VK_FORMAT_UNDEFINED;
+        return kFormats[type][comps - 1];
+    }
+
+    // Bytes one element takes in the vertex
+    inline uint32_t AttribSize(AttribType t, uint32_t comps)
+    {
+        switch (t)
         {
-            switch (comps)
-            {
-            case 1:
-                return VK_FORMAT_R32_SFLOAT;
-            case 2:
-                return VK_FORMAT_R32G32_SFLOAT;
-            case 3:
-                return VK_FORMAT_R32G32B32_SFLOAT;
-            case 4:
-                return VK_FORMAT_R32G32B32A32_SFLOAT;
-            }
+        case AttribType::Float32:
+            return 4 * comps;
+        case AttribType::Float16:
+        case AttribType::SNorm16:
+        case AttribType::UNorm16:
+            return 2 * comps;
+        case AttribType::SNorm8:
+        case AttribType::UNorm8:
+            return comps;
+        case AttribType::SNorm10_10_10_2:
+            return 4;
         }
-        return VK_FORMAT_UNDEFINED;
+        return 0;
     }
 
 }
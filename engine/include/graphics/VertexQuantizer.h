@@ -0,0 +1,32 @@
+#pragma once
+
+#include "graphics/VertexLayout.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace eng
+{
+    // Half precision positions are only used while they stay this close to the
+    // source, relative to the mesh extent and absolute (in meters).
+    static constexpr float kQuantizeRelativeError = 1.f / 4096.f;
+    static constexpr float kQuantizeMaxError = 0.001f;
+
+    // Picks a compact GPU format for every Float32 element of layout, as far as
+    // the data allows:
+    //   Position  Float16 x4 within the error limits above, Float32 otherwise
+    //   Color     UNorm8 x4 inside [0, 1], Float16 x4 otherwise
+    //   UV        UNorm16 x2 inside [0, 1], Float32 otherwise
+    //   Normal    SNorm10_10_10_2, or SNorm8 x4 without packedNormals
+    // Other elements keep their format. Offsets stay 4 byte aligned. Shaders
+    // read the same float inputs, the vertex fetch does the conversion.
+    // Position goes to binding 0 and everything else to binding 1, so depth
+    // only pipelines fetch just the position stream.
+    VertexLayout QuantizeLayout(const VertexLayout &layout, const std::vector<float> &vertices, bool packedNormals);
+
+    // Converts float vertices stored in layout to the quantized layout returned
+    // by QuantizeLayout, one stream after the other. Missing components are
+    // filled with 0, w with 1.
+    std::vector<uint8_t> QuantizeVertices(const VertexLayout &layout, const std::vector<float> &vertices,
+                                          const VertexLayout &quantized);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "graphics/TextureContainer.h"
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+namespace eng
+{
+    class JobSystem;
+
+    // Tiled texture for virtual texturing (.vtex). Every level down to the
+    // one that fits a single tile is cut into kTileSize tiles. Each tile is
+    // stored with a kTileBorder texel border taken from its neighbours, so a
+    // page can be sampled bilinearly without seeing the pages next to it in
+    // the cache. Tiles are RGBA8 or block compressed.
+    //
+    // Width and height are powers of two, at least kTileSize.
+    class VirtualTextureFile
+    {
+    public:
+        static constexpr uint32_t kTileSize = 128;
+        static constexpr uint32_t kTileBorder = 4;
+        static constexpr uint32_t kPageSize = kTileSize + 2 * kTileBorder;
+
+        bool Open(const std::filesystem::path &path);
+
+        // Any thread. kPageSize^2 RGBA8 texels, block compressed tiles are decoded.
+        bool ReadTile(uint32_t level, uint32_t x, uint32_t y, std::vector<uint8_t> &rgba) const;
+
+        // Format the tiles are stored in
+        VkFormat GetFormat() const { return m_format; }
+        bool IsSrgb() const { return IsSrgbFormat(m_format); }
+        uint32_t GetWidth() const { return m_width; }
+        uint32_t GetHeight() const { return m_height; }
+        uint32_t GetLevelCount() const { return m_levelCount; }
+        uint32_t GetTilesX(uint32_t level) const { return TileCount(m_width, level); }
+        uint32_t GetTilesY(uint32_t level) const { return TileCount(m_height, level); }
+
+        static uint32_t TileCount(uint32_t size, uint32_t level)
+        {
+            return (std::max(size >> level, 1u) + kTileSize - 1) / kTileSize;
+        }
+        // Levels until both sides fit one tile
+        static uint32_t LevelCount(uint32_t width, uint32_t height);
+
+    private:
+        struct Tile
+        {
+            uint64_t offset = 0;
+            uint32_t size = 0;
+        };
+
+        VkFormat m_format = VK_FORMAT_UNDEFINED;
+        uint32_t m_width = 0;
+        uint32_t m_height = 0;
+        uint32_t m_levelCount = 0;
+        // Index of the first tile of each level in m_tiles
+        std::vector<uint32_t> m_firstTile;
+        std::vector<Tile> m_tiles;
+
+        mutable std::mutex m_mutex;
+        mutable std::ifstream m_stream;
+    };
+
+    // Cuts image into a .vtex. image is RGBA8 with its full mip chain; tiles
+    // are compressed to tileFormat when that is a BCn format, over jobs when
+    // given.
+    bool WriteVirtualTexture(const std::filesystem::path &path, const TextureImage &image, VkFormat tileFormat,
+                             JobSystem *jobs = nullptr);
+}
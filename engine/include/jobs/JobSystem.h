@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace eng
+{
+    struct Job;
+
+    // Counts outstanding jobs. Jobs scheduled with a dependency on a counter
+    // are held back until that counter drops to zero.
+    class JobCounter
+    {
+    public:
+        JobCounter() = default;
+        JobCounter(const JobCounter &) = delete;
+        JobCounter &operator=(const JobCounter &) = delete;
+
+        int Get() const { return m_value.load(std::memory_order_acquire); }
+        bool IsDone() const { return Get() == 0; }
+
+    private:
+        std::atomic<int> m_value{0};
+        std::mutex m_lock;
+        std::vector<Job *> m_continuations;
+
+        friend class JobSystem;
+    };
+
+    class JobSystem
+    {
+    public:
+        using JobFunction = std::function<void()>;
+        using RangeFunction = std::function<void(size_t begin, size_t end)>;
+
+        static constexpr uint32_t kMainThreadIndex = 0;
+
+        JobSystem();
+        ~JobSystem();
+
+        JobSystem(const JobSystem &) = delete;
+        JobSystem &operator=(const JobSystem &) = delete;
+
+        // Must be called from the main thread. workerCount = 0 picks
+        // hardware_concurrency - 1 (the main thread helps while waiting).
+        bool Init(uint32_t workerCount = 0);
+        void Shutdown();
+
+        // Schedules fn. If counter is set it is incremented now and decremented
+        // when fn finishes. If dependency is set, fn starts only after it is done.
+        void Run(JobFunction fn, JobCounter *counter = nullptr, JobCounter *dependency = nullptr);
+
+        // Executes other jobs until counter reaches zero. The counter may be
+        // destroyed as soon as Wait returns.
+        void Wait(JobCounter &counter);
+
+        // Splits [0, count) into chunks of at most grain items and blocks until all are done.
+        void ParallelFor(size_t count, size_t grain, const RangeFunction &fn);
+
+        // SDL and window calls must stay on the main thread; jobs can hand work back here.
+        void RunOnMainThread(JobFunction fn);
+        void ProcessMainThreadJobs();
+        bool IsMainThread() const;
+
+        // Main thread + workers. Valid upper bound for GetThreadIndex().
+        uint32_t GetThreadCount() const { return (uint32_t)m_workers.size(); }
+
+        // 0 for the main thread, 1..N for workers.
+        static uint32_t GetThreadIndex();
+
+    private:
+        struct Worker;
+
+        void workerLoop(uint32_t index);
+        void schedule(Job *job);
+        void execute(Job *job);
+        Job *findJob(uint32_t index);
+        void finish(JobCounter *counter);
+
+    private:
+        std::vector<std::unique_ptr<Worker>> m_workers;
+        std::vector<std::thread> m_threads;
+        std::atomic<bool> m_running{false};
+
+        // Jobs submitted from threads the system does not own.
+        std::mutex m_injectLock;
+        std::vector<Job *> m_injected;
+
+        std::mutex m_sleepLock;
+        std::condition_variable m_wake;
+        std::atomic<int> m_queuedJobs{0};
+
+        std::mutex m_mainThreadLock;
+        std::vector<JobFunction> m_mainThreadJobs;
+        std::thread::id m_mainThreadId;
+    };
+
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace eng
+{
+    class GraphicsAPI;
+    class Material;
+    class Mesh;
+    class ShaderProgram;
+
+    // Per meshlet culling for IndirectRenderer objects whose mesh has meshlets.
+    // A compute pass tests every cluster against the frustum and its normal
+    // cone and copies the indices of the visible ones into a compacted index
+    // buffer, one region per instance. Each instance is then one regular
+    // indexed draw over its region, so no mesh shader support is needed.
+    class ClusterCuller
+    {
+    public:
+        // Workgroup size of cluster_cull_comp.glsl, one workgroup per cluster
+        static constexpr uint32_t kGroupSize = 64;
+
+        struct Instance
+        {
+            // Index into the IndirectRenderer object buffer, gl_InstanceIndex of the draw
+            uint32_t object = 0;
+            const Mesh *mesh = nullptr;
+            Material *material = nullptr;
+            uint32_t page = 0;
+            uint32_t firstVertex = 0;
+        };
+
+        ClusterCuller() = default;
+        ClusterCuller(const ClusterCuller &) = delete;
+        ClusterCuller &operator=(const ClusterCuller &) = delete;
+
+        void Init(VkDevice device, VkPhysicalDevice gpu, uint32_t framesInFlight);
+        void Destroy();
+
+        // Instances sorted by material and page
+        void Build(const std::vector<Instance> &instances);
+        bool IsEmpty() const { return m_instanceCount == 0; }
+        uint32_t GetClusterCount() const { return (uint32_t)m_clusters.size(); }
+
+        // Outside the render pass. objects is this frame's IndirectRenderer object buffer.
+        void Cull(VkCommandBuffer cmd, uint32_t frame, VkBuffer objects, const glm::mat4 &viewProj, const glm::vec3 &eye);
+        // Inside the render pass. Binds set 3 itself, the vertex page too unless vertices are pulled.
+        void Draw(GraphicsAPI &graphicsAPI, uint32_t frame, ShaderProgram &program, VkDescriptorSet objectSet,
+                  bool pullVertices, bool depthOnly);
+
+    private:
+        // Must match cluster_cull_comp.glsl
+        struct GpuCluster
+        {
+            glm::vec4 sphere;
+            glm::vec4 cone;
+            uint32_t firstIndex = 0;
+            uint32_t indexCount = 0;
+            uint32_t instance = 0;
+            uint32_t pad = 0;
+        };
+
+        struct GpuInstance
+        {
+            uint32_t object = 0;
+            uint32_t outputOffset = 0;
+            uint32_t pad[2]{};
+        };
+
+        struct Push
+        {
+            glm::mat4 viewProj;
+            glm::vec4 eye;
+            uint32_t clusterCount = 0;
+            uint32_t pad[3]{};
+        };
+
+        // Consecutive instances sharing material and page, one multi draw
+        struct Group
+        {
+            Material *material = nullptr;
+            uint32_t page = 0;
+            uint32_t firstInstance = 0;
+            uint32_t instanceCount = 0;
+        };
+
+        struct Buffer
+        {
+            VkBuffer buffer = VK_NULL_HANDLE;
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            void *mapped = nullptr;
+            VkDeviceSize size = 0;
+        };
+
+        struct FrameResources
+        {
+            // Host visible copies of the Build output
+            Buffer clusters;
+            Buffer indices;
+            Buffer instances;
+            Buffer templates;
+            // Written by the compute pass
+            Buffer commands;
+            Buffer output;
+
+            VkDescriptorSet set = VK_NULL_HANDLE;
+            VkBuffer boundObjects = VK_NULL_HANDLE;
+            uint64_t uploadedVersion = UINT64_MAX;
+        };
+
+        void CreateBuffer(Buffer &buffer, VkDeviceSize size, VkBufferUsageFlags usage, bool hostVisible);
+        void DestroyBuffer(Buffer &buffer);
+        void CreateFrameBuffers();
+        void DestroyFrameBuffers();
+
+    private:
+        VkDevice m_device = VK_NULL_HANDLE;
+        VkPhysicalDevice m_gpu = VK_NULL_HANDLE;
+
+        VkDescriptorSetLayout m_setLayout = VK_NULL_HANDLE;
+        VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+        VkPipelineLayout m_layout = VK_NULL_HANDLE;
+        VkPipeline m_pipeline = VK_NULL_HANDLE;
+
+        std::vector<FrameResources> m_frames;
+
+        // CPU side of the current Build
+        std::vector<GpuCluster> m_clusters;
+        std::vector<uint32_t> m_indices;
+        std::vector<GpuInstance> m_instances;
+        std::vector<VkDrawIndexedIndirectCommand> m_templates;
+        std::vector<Group> m_groups;
+        uint32_t m_instanceCount = 0;
+        uint32_t m_outputCapacity = 0;
+        uint64_t m_version = 0;
+    };
+}
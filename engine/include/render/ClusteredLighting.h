@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Common.h"
+
+#include <glm/vec4.hpp>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace eng
+{
+    // Bins point lights into view space froxels (screen tiles x exponential
+    // depth slices) on the job system. The result is uploaded as-is into the
+    // set=2 buffers read by clustered_frag.glsl; layouts must match std430/std140.
+    class ClusteredLighting
+    {
+    public:
+        static constexpr uint32_t kGridX = 16;
+        static constexpr uint32_t kGridY = 9;
+        static constexpr uint32_t kGridZ = 24;
+        static constexpr uint32_t kClusterCount = kGridX * kGridY * kGridZ;
+
+        static constexpr uint32_t kMaxLights = 4096;
+        static constexpr uint32_t kMaxLightIndices = 512 * 1024;
+
+        struct GpuLight
+        {
+            glm::vec4 positionRadius; // world space
+            glm::vec4 colorIntensity;
+        };
+
+        struct GpuCluster
+        {
+            uint32_t offset;
+            uint32_t count;
+        };
+
+        struct Params
+        {
+            glm::uvec4 gridSize; // x, y, z, light count
+            glm::vec4 zParams;   // slice scale, slice bias, near, far
+            glm::vec4 screen;    // width, height, 1/width, 1/height
+        };
+
+        void Build(std::span<const LightData> lights, const CameraData &camera, uint32_t width, uint32_t height);
+
+        const Params &GetParams() const { return m_params; }
+        const std::vector<GpuLight> &GetLights() const { return m_lights; }
+        const std::vector<GpuCluster> &GetClusters() const { return m_clusters; }
+        const std::vector<uint32_t> &GetLightIndices() const { return m_lightIndices; }
+
+    private:
+        struct LightBounds
+        {
+            uint16_t minX, maxX;
+            uint16_t minY, maxY;
+            uint16_t minZ, maxZ;
+            bool visible;
+        };
+
+        struct Slice
+        {
+            std::vector<uint32_t> counts; // kGridX * kGridY
+            std::vector<uint32_t> cursor;
+            std::vector<uint32_t> indices;
+        };
+
+        void ComputeBounds(size_t begin, size_t end, const CameraData &camera);
+        void BinSlice(uint32_t z);
+
+    private:
+        Params m_params{};
+        std::vector<GpuLight> m_lights;
+        std::vector<LightBounds> m_bounds;
+        std::vector<Slice> m_slices;
+
+        std::vector<GpuCluster> m_clusters;
+        std::vector<uint32_t> m_lightIndices;
+
+        bool m_warnedOverflow = false;
+    };
+}
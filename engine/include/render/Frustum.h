@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Common.h"
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+#include <glm/geometric.hpp>
+
+namespace eng
+{
+    // Six planes (left, right, bottom, top, near, far) facing inwards,
+    // extracted from a view-projection matrix (Gribb/Hartmann).
+    struct Frustum
+    {
+        glm::vec4 planes[6];
+
+        static Frustum FromMatrix(const glm::mat4 &viewProj)
+        {
+            const glm::vec4 r0(viewProj[0][0], viewProj[1][0], viewProj[2][0], viewProj[3][0]);
+            const glm::vec4 r1(viewProj[0][1], viewProj[1][1], viewProj[2][1], viewProj[3][1]);
+            const glm::vec4 r2(viewProj[0][2], viewProj[1][2], viewProj[2][2], viewProj[3][2]);
+            const glm::vec4 r3(viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3]);
+
+            Frustum f;
+            f.planes[0] = r3 + r0;
+            f.planes[1] = r3 - r0;
+            f.planes[2] = r3 + r1;
+            f.planes[3] = r3 - r1;
+            f.planes[4] = r3 + r2;
+            f.planes[5] = r3 - r2;
+
+            for (auto &p : f.planes)
+                p /= glm::length(glm::vec3(p));
+
+            return f;
+        }
+
+        bool Intersects(const AABB &box) const
+        {
+            const glm::vec3 center = (box.min + box.max) * 0.5f;
+            const glm::vec3 extent = (box.max - box.min) * 0.5f;
+
+            for (const auto &p : planes)
+            {
+                const float r = glm::dot(extent, glm::abs(glm::vec3(p)));
+                if (glm::dot(glm::vec3(p), center) + p.w < -r)
+                    return false;
+            }
+            return true;
+        }
+    };
+}
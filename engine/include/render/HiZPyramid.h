@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace eng
+{
+    class Swapchain;
+    class VulkanContext;
+
+    // Max-depth mip chain of the scene depth buffer, used for occlusion culling.
+    // Level 0 is the depth extent rounded down to a power of two; every texel
+    // holds the farthest depth of the area it covers, so a bounds test against
+    // it is conservative. The image stays in GENERAL layout.
+    class HiZPyramid
+    {
+    public:
+        static constexpr uint32_t kGroupSize = 8;
+
+        HiZPyramid() = default;
+        HiZPyramid(const HiZPyramid &) = delete;
+        HiZPyramid &operator=(const HiZPyramid &) = delete;
+
+        void Init(VulkanContext &vk);
+        void Destroy();
+
+        // (Re)creates the pyramid for the current swapchain depth. Call after the
+        // swapchain was created or recreated; the old contents are lost.
+        // Needs a depth format with SAMPLED_IMAGE support, see CanBuild().
+        void Resize(const Swapchain &swapchain);
+
+        // Outside a render pass, after depth was stored. Leaves depth in
+        // DEPTH_STENCIL_ATTACHMENT_OPTIMAL and the pyramid readable by compute.
+        void Build(VkCommandBuffer cmd);
+
+        bool CanBuild() const { return m_buildable; }
+        VkImageView GetView() const { return m_view; }
+        VkSampler GetSampler() const { return m_sampler; }
+        uint32_t GetWidth() const { return m_width; }
+        uint32_t GetHeight() const { return m_height; }
+        uint32_t GetMipCount() const { return m_mipCount; }
+
+    private:
+        VkPipeline CreatePipeline(const char *path);
+        void DestroyImage();
+
+    private:
+        VulkanContext *m_vk = nullptr;
+        VkDevice m_device = VK_NULL_HANDLE;
+        VkPhysicalDevice m_gpu = VK_NULL_HANDLE;
+
+        VkDescriptorSetLayout m_setLayout = VK_NULL_HANDLE;
+        VkPipelineLayout m_layout = VK_NULL_HANDLE;
+        VkPipeline m_initPipeline = VK_NULL_HANDLE;
+        VkPipeline m_initMsPipeline = VK_NULL_HANDLE;
+        VkPipeline m_reducePipeline = VK_NULL_HANDLE;
+        VkSampler m_sampler = VK_NULL_HANDLE;
+
+        VkImage m_image = VK_NULL_HANDLE;
+        VkDeviceMemory m_memory = VK_NULL_HANDLE;
+        VkImageView m_view = VK_NULL_HANDLE;
+        std::vector<VkImageView> m_mipViews;
+        VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+        std::vector<VkDescriptorSet> m_sets;
+
+        // Source depth, owned by the swapchain
+        VkImage m_depthImage = VK_NULL_HANDLE;
+        VkImageAspectFlags m_depthAspect = 0;
+        bool m_depthMultisampled = false;
+        bool m_buildable = false;
+
+        uint32_t m_width = 0;
+        uint32_t m_height = 0;
+        uint32_t m_mipCount = 0;
+    };
+}
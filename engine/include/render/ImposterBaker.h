@@ -0,0 +1,78 @@
+#pragma once
+
+#include "graphics/VertexLayout.h"
+
+#include <vulkan/vulkan.h>
+#include <glm/vec3.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace eng
+{
+    class Material;
+    class Mesh;
+    class VulkanContext;
+
+    // Atlas of one Mesh + Material seen from kFrames x kFrames directions.
+    // Frame (x, y) looks at the mesh from the direction OctahedralDecode
+    // returns for the center of that cell, see imposter_vert.glsl.
+    struct Imposter
+    {
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkDescriptorSet textureSet = VK_NULL_HANDLE;
+
+        // Local space bounding sphere every frame is fitted to
+        glm::vec3 center{0.f};
+        float radius = 0.f;
+    };
+
+    // Renders imposter atlases with an offscreen render pass. Each frame is an
+    // orthographic view of the bounding sphere; the color is the material
+    // texture times the vertex color with a fixed sky term, alpha is coverage.
+    class ImposterBaker
+    {
+    public:
+        static constexpr uint32_t kFrames = 8;
+        static constexpr uint32_t kFrameSize = 128;
+        static constexpr uint32_t kAtlasSize = kFrames * kFrameSize;
+        // Down to 8 texel frames, every level stays frame aligned
+        static constexpr uint32_t kMipLevels = 5;
+        static constexpr VkFormat kColorFormat = VK_FORMAT_R8G8B8A8_SRGB;
+        static constexpr VkFormat kDepthFormat = VK_FORMAT_D16_UNORM;
+
+        ImposterBaker() = default;
+        ImposterBaker(const ImposterBaker &) = delete;
+        ImposterBaker &operator=(const ImposterBaker &) = delete;
+
+        void Init(VulkanContext &vk);
+        void Destroy();
+
+        // Blocks until the atlas is done. Needs the CPU copy of the mesh and a
+        // textured material; returns false otherwise.
+        bool Bake(const Mesh &mesh, const Material &material, Imposter &out);
+        void DestroyImposter(Imposter &imposter);
+
+    private:
+        VkPipeline GetPipeline(const VertexLayout &layout);
+
+    private:
+        VulkanContext *m_vk = nullptr;
+        VkDevice m_device = VK_NULL_HANDLE;
+        VkPhysicalDevice m_gpu = VK_NULL_HANDLE;
+
+        VkRenderPass m_renderPass = VK_NULL_HANDLE;
+        VkPipelineLayout m_layout = VK_NULL_HANDLE;
+        VkSampler m_sampler = VK_NULL_HANDLE;
+
+        // One pipeline per CPU vertex layout, created on first use
+        struct Variant
+        {
+            VertexLayout layout;
+            VkPipeline pipeline = VK_NULL_HANDLE;
+        };
+        std::vector<Variant> m_variants;
+    };
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "render/ImposterBaker.h"
+
+#include <vulkan/vulkan.h>
+#include <glm/mat4x4.hpp>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace eng
+{
+    class Material;
+    class Mesh;
+    class RenderScene;
+    class VulkanContext;
+    struct CameraData;
+
+    // Draws proxies that carry an Imposter as one camera facing quad each,
+    // instanced per atlas, instead of their mesh. Atlases are cached per
+    // Mesh + Material: baked up front with GetOrBake, or queued by Get and
+    // baked one per frame by NextFrame. Entries of destroyed meshes or
+    // materials are dropped once no frame in flight can sample them.
+    class ImposterRenderer
+    {
+    public:
+        ImposterRenderer() = default;
+        ImposterRenderer(const ImposterRenderer &) = delete;
+        ImposterRenderer &operator=(const ImposterRenderer &) = delete;
+
+        void Init(VulkanContext &vk, uint32_t framesInFlight);
+        void Destroy();
+
+        // Swapchain render pass changed
+        void Recreate(VkRenderPass renderPass);
+
+        // Bakes right away (load time). nullptr when the pair cannot be baked,
+        // see ImposterBaker::Bake, or its texture is not resident yet.
+        const Imposter *GetOrBake(const std::shared_ptr<Mesh> &mesh, const std::shared_ptr<Material> &material);
+        // Never bakes: nullptr until the atlas exists, a missing one is queued.
+        const Imposter *Get(const std::shared_ptr<Mesh> &mesh, const std::shared_ptr<Material> &material);
+
+        // Once per frame after its fence wait: bakes one queued atlas, prunes dead entries
+        void NextFrame();
+
+        // Inside the scene render pass
+        void Draw(VkCommandBuffer cmd, uint32_t frame, VkDescriptorSet cameraSet,
+                  const RenderScene &renderScene, const CameraData &cameraData);
+
+        // Quads drawn by the last Draw
+        uint32_t GetDrawnCount() const { return m_drawnCount; }
+
+    private:
+        struct Entry
+        {
+            std::weak_ptr<Mesh> mesh;
+            std::weak_ptr<Material> material;
+            Imposter imposter;
+            bool baked = false;
+            // A bake ran, whatever its result
+            bool tried = false;
+            bool queued = false;
+            // Frame count from which a dead entry is destroyed, 0 while alive
+            uint64_t retireFrame = 0;
+        };
+
+        struct Push
+        {
+            glm::vec4 centerRadius;
+        };
+
+        struct FrameResources
+        {
+            VkBuffer buffer = VK_NULL_HANDLE;
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            void *mapped = nullptr;
+            uint32_t capacity = 0;
+        };
+
+        struct Batch
+        {
+            const Imposter *imposter = nullptr;
+            uint32_t firstInstance = 0;
+            uint32_t instanceCount = 0;
+        };
+
+        Entry &GetEntry(const std::shared_ptr<Mesh> &mesh, const std::shared_ptr<Material> &material);
+        bool TryBake(Entry &entry, const Mesh &mesh, const Material &material);
+        void CreatePipeline();
+        void EnsureCapacity(FrameResources &frame, uint32_t count);
+
+    private:
+        VulkanContext *m_vk = nullptr;
+        VkDevice m_device = VK_NULL_HANDLE;
+        VkPhysicalDevice m_gpu = VK_NULL_HANDLE;
+        VkRenderPass m_renderPass = VK_NULL_HANDLE;
+
+        ImposterBaker m_baker;
+        std::map<std::pair<const Mesh *, const Material *>, std::unique_ptr<Entry>> m_cache;
+        std::vector<std::pair<std::weak_ptr<Mesh>, std::weak_ptr<Material>>> m_pending;
+        uint64_t m_frameCount = 0;
+
+        VkPipelineLayout m_layout = VK_NULL_HANDLE;
+        VkPipeline m_pipeline = VK_NULL_HANDLE;
+
+        std::vector<FrameResources> m_frames;
+        // Scratch of Draw: proxy index per instance, grouped by imposter
+        std::vector<uint32_t> m_order;
+        std::vector<Batch> m_batches;
+        uint32_t m_drawnCount = 0;
+    };
+}
@@ -0,0 +1,263 @@
+#pragma once
+
+#include "render/ClusterCuller.h"
+#include "render/RenderScene.h"
+#include "Common.h"
+
+#include <vulkan/vulkan.h>
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace eng
+{
+    class GraphicsAPI;
+    class HiZPyramid;
+    class Material;
+    class ShaderProgram;
+    class VulkanContext;
+    struct RenderProxy;
+
+    // GPU driven path for RenderScene proxies. Object data lives in storage
+    // buffers, a compute pass frustum culls it and writes compacted
+    // VkDrawIndexedIndirectCommand entries plus one count per bucket
+    // (material + geometry page), and every bucket is drawn with a single
+    // vkCmdDrawIndexedIndirectCount.
+    //
+    // Objects whose mesh has meshlets get a second object that ClusterCuller
+    // draws at level 0 (early phase only), the per object one covers the other
+    // levels. An object with indexCount 0 is skipped by both culls, which is how
+    // LOD and imposter switches take effect without reordering anything.
+    //
+    // Proxies with DrawRanges (static batches) get one object per range, so
+    // the merged mesh is still culled per source object.
+    //
+    // With vertex pulling on, buckets only split by material and index page:
+    // shaders fetch vertices through the GpuVertexFormat of each object's
+    // vertex page, so meshes of any layout share one pipeline and one draw.
+    //
+    // With occlusion culling on, drawing happens in two phases. The early phase
+    // draws what passes the previous frame's Hi-Z pyramid (reprojected with the
+    // previous view-projection). The pyramid is then rebuilt from that depth and
+    // the late phase draws the remaining objects that it does not occlude, which
+    // catches everything that became visible this frame.
+    class IndirectRenderer
+    {
+    public:
+        static constexpr uint32_t kInitialCapacity = 4096;
+        static constexpr uint32_t kCullGroupSize = 64;
+        static constexpr uint32_t kCullBindingCount = 7;
+        // Size of the vertex format table, vertex pulling turns itself off beyond it
+        static constexpr uint32_t kMaxVertexPages = 256;
+
+        // Must match the Object struct in cull_comp.glsl / indirect_vert.glsl
+        struct GpuObject
+        {
+            glm::mat4 model;
+            glm::vec4 boundsMin;
+            glm::vec4 boundsMax;
+            uint32_t indexCount = 0;
+            uint32_t firstIndex = 0;
+            int32_t vertexOffset = 0;
+            uint32_t bucket = 0;
+            uint32_t commandBase = 0;
+            uint32_t vertexPage = 0;
+            uint32_t pad[2]{};
+        };
+
+        // Read back for the frame slot once its fence was waited on,
+        // so the values are MAX_FRAMES frames old.
+        struct OcclusionStats
+        {
+            uint32_t frustumVisible = 0;
+            uint32_t drawnEarly = 0;
+            uint32_t drawnLate = 0;
+            uint32_t occluded = 0;
+        };
+
+        IndirectRenderer() = default;
+        IndirectRenderer(const IndirectRenderer &) = delete;
+        IndirectRenderer &operator=(const IndirectRenderer &) = delete;
+
+        // Needs drawIndirectCount, multiDrawIndirect and drawIndirectFirstInstance.
+        // Without them the renderer stays disabled and proxies take the CPU path.
+        void Init(VulkanContext &vk, bool supported, uint32_t framesInFlight);
+        void Destroy();
+
+        bool IsEnabled() const { return m_enabled; }
+        VkDescriptorSetLayout GetObjectSetLayout() const { return m_objectSetLayout; }
+
+        // Proxies this renderer draws, imposters included (with no indices).
+        // RenderQueue skips them while enabled.
+        static bool IsEligible(const RenderProxy &proxy);
+
+        // Binds the pyramid to the culling sets and drops the occlusion history.
+        // Call whenever the pyramid was resized.
+        void SetPyramid(const HiZPyramid &pyramid);
+        void SetOcclusionCulling(bool enabled) { m_occlusionCulling = enabled; }
+        bool IsOcclusionCulling() const { return m_occlusionCulling; }
+        // Lay down depth with the position only program before the color pass,
+        // so expensive fragments only run once per pixel.
+        void SetDepthPrepass(bool enabled) { m_depthPrepass = enabled; }
+        bool IsDepthPrepass() const { return m_depthPrepass; }
+        // Only level 0 of a mesh is clustered, coarser LODs take the per object path
+        void SetClusterCulling(bool enabled);
+        bool IsClusterCulling() const { return m_clusterCulling; }
+        // Needs bufferDeviceAddress, ignored without it
+        void SetVertexPulling(bool enabled);
+        bool IsVertexPulling() const { return m_vertexPulling; }
+
+        // Outside the render pass: upload changed object data and run the early culling dispatch.
+        void Cull(VkCommandBuffer cmd, uint32_t frame, const RenderScene &renderScene, const glm::mat4 &viewProj,
+                  const glm::vec3 &eye);
+        // True when this frame needs the pyramid built and the late phase recorded.
+        bool NeedsLatePass() const { return m_latePass; }
+        // Outside the render pass, after the pyramid was built from the early depth.
+        void CullLate(VkCommandBuffer cmd, uint32_t frame);
+        // Inside the render pass.
+        void Draw(GraphicsAPI &graphicsAPI, uint32_t frame, const CameraData &cameraData, bool late = false);
+
+        const OcclusionStats &GetStats() const { return m_stats; }
+
+        uint32_t GetObjectCount() const { return (uint32_t)m_objects.size(); }
+        uint32_t GetBucketCount() const { return (uint32_t)m_buckets.size(); }
+        uint32_t GetClusterCount() const { return m_clusters.GetClusterCount(); }
+
+    private:
+        struct Bucket
+        {
+            Material *material = nullptr;
+            // Vertex page, unused while pulling vertices
+            uint32_t page = 0;
+            uint32_t indexPage = 0;
+            uint32_t commandBase = 0;
+            uint32_t maxCount = 0;
+        };
+
+        struct FrameResources
+        {
+            VkBuffer objects = VK_NULL_HANDLE;
+            VkDeviceMemory objectsMemory = VK_NULL_HANDLE;
+            void *objectsMapped = nullptr;
+
+            VkBuffer commands = VK_NULL_HANDLE;
+            VkDeviceMemory commandsMemory = VK_NULL_HANDLE;
+
+            VkBuffer counts = VK_NULL_HANDLE;
+            VkDeviceMemory countsMemory = VK_NULL_HANDLE;
+
+            // One uint per object, set when the early phase drew it
+            VkBuffer drawnEarly = VK_NULL_HANDLE;
+            VkDeviceMemory drawnEarlyMemory = VK_NULL_HANDLE;
+
+            VkBuffer stats = VK_NULL_HANDLE;
+            VkDeviceMemory statsMemory = VK_NULL_HANDLE;
+            void *statsMapped = nullptr;
+
+            VkBuffer params = VK_NULL_HANDLE;
+            VkDeviceMemory paramsMemory = VK_NULL_HANDLE;
+            void *paramsMapped = nullptr;
+
+            // GpuVertexFormat per geometry page
+            VkBuffer formats = VK_NULL_HANDLE;
+            VkDeviceMemory formatsMemory = VK_NULL_HANDLE;
+            void *formatsMapped = nullptr;
+
+            VkDescriptorSet cullSet = VK_NULL_HANDLE;
+            VkDescriptorSet objectSet = VK_NULL_HANDLE;
+
+            // Object slots written since this frame last uploaded, all of them when fullUpload
+            std::vector<uint32_t> dirty;
+            bool fullUpload = true;
+        };
+
+        static constexpr uint32_t kNoObject = UINT32_MAX;
+
+        // Where a proxy's objects are: count per object ones from first (one per
+        // DrawRange), plus the ClusterCuller one when its mesh has meshlets
+        struct ProxyObjects
+        {
+            uint32_t first = kNoObject;
+            uint32_t count = 0;
+            uint32_t cluster = kNoObject;
+        };
+
+        enum CullPhase : uint32_t
+        {
+            kPhaseEarly = 0,
+            kPhaseLate = 1,
+        };
+
+        // Must match cull_comp.glsl. One entry per phase in a per-frame UBO,
+        // the phase index is the only push constant.
+        // occlusionViewProj is the previous frame's matrix for the early phase.
+        // mipCount 0 skips the occlusion test.
+        struct CullParams
+        {
+            glm::mat4 viewProj{1.f};
+            glm::mat4 occlusionViewProj{1.f};
+            uint32_t objectCount = 0;
+            uint32_t mipCount = 0;
+            uint32_t commandOffset = 0;
+            uint32_t countOffset = 0;
+            glm::vec4 pyramidSize{0.f};
+        };
+
+        void CreatePipelines();
+        void CreateFrameBuffers(uint32_t capacity, uint32_t bucketCapacity);
+        void DestroyFrameBuffers();
+        void RebuildObjects(const RenderScene &renderScene);
+        // Rewrites the objects of proxies changed since m_builtVersion. False when
+        // RenderScene no longer has the changes, RebuildObjects then.
+        bool UpdateObjects(const RenderScene &renderScene);
+        // Transform, bounds and index range, the bucket fields are set by RebuildObjects
+        void WriteObjects(const RenderProxy &proxy, const ProxyObjects &slots);
+        void MarkDirty(uint32_t slot);
+        void Dispatch(VkCommandBuffer cmd, const FrameResources &frame, CullPhase phase);
+        void DrawBuckets(GraphicsAPI &graphicsAPI, uint32_t frame, ShaderProgram &program,
+                         bool late, bool depthOnly);
+
+    private:
+        VkDevice m_device = VK_NULL_HANDLE;
+        VkPhysicalDevice m_gpu = VK_NULL_HANDLE;
+        bool m_enabled = false;
+
+        VkDescriptorSetLayout m_cullSetLayout = VK_NULL_HANDLE;
+        VkDescriptorSetLayout m_objectSetLayout = VK_NULL_HANDLE;
+        VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+        VkPipelineLayout m_cullLayout = VK_NULL_HANDLE;
+        VkPipeline m_cullPipeline = VK_NULL_HANDLE;
+
+        std::vector<FrameResources> m_frames;
+        uint32_t m_capacity = 0;
+        uint32_t m_bucketCapacity = 0;
+
+        // CPU copy. Sorted into buckets only when proxies are added or removed,
+        // other changes rewrite the objects of the changed proxies in place and
+        // only those slots are copied to each frame's buffer. The first
+        // m_drawObjectCount objects are culled per object, the rest per cluster.
+        std::vector<GpuObject> m_objects;
+        uint32_t m_drawObjectCount = 0;
+        ClusterCuller m_clusters;
+        std::vector<Bucket> m_buckets;
+        // By proxy handle
+        std::vector<ProxyObjects> m_proxyObjects;
+        std::vector<RenderScene::ProxyHandle> m_changed;
+        uint64_t m_builtStructure = UINT64_MAX;
+        uint64_t m_builtVersion = UINT64_MAX;
+
+        const HiZPyramid *m_pyramid = nullptr;
+        bool m_occlusionCulling = true;
+        bool m_depthPrepass = false;
+        bool m_clusterCulling = true;
+        bool m_pullingSupported = false;
+        bool m_vertexPulling = false;
+        bool m_latePass = false;
+        // The pyramid holds a depth from a previous frame
+        bool m_hasHistory = false;
+        glm::mat4 m_prevViewProj{1.f};
+        OcclusionStats m_stats;
+    };
+}
@@ -10,6 +10,7 @@ namespace eng
 {
     class ShaderProgram;
     class Texture;
+    class VirtualTexture;
 
     class Material
     {
@@ -18,11 +19,19 @@ namespace eng
         void SetParam(const std::string &name, float value);
         void SetParam(const std::string &name, float v0, float v1);
         void SetTexture(const std::string &name, const std::shared_ptr<Texture> &texture);
+        // Sampled in place of the texture, needs a program built on
+        // VirtualTextureSystem::GetSetLayout
+        void SetVirtualTexture(const std::shared_ptr<VirtualTexture> &texture);
         void Bind();
 
         static std::shared_ptr<Material> Load(const std::string &path);
 
         ShaderProgram *GetShaderProgram();
+        const std::shared_ptr<Texture> &GetTexture() const { return m_texture; }
+        const std::shared_ptr<VirtualTexture> &GetVirtualTexture() const { return m_virtualTexture; }
+        // Owned by the texture, the placeholder's while it is still loading
+        VkDescriptorSet GetTextureSet() const;
+        bool IsTextureResident() const;
 
     private:
         std::shared_ptr<ShaderProgram> m_shaderProgram;
@@ -31,6 +40,6 @@ namespace eng
 
         std::shared_ptr<Texture> m_texture;
         std::unordered_map<std::string, std::shared_ptr<Texture>> m_textures;
-        VkDescriptorSet m_textureSet = VK_NULL_HANDLE;
+        std::shared_ptr<VirtualTexture> m_virtualTexture;
     };
 }
\ No newline at end of file
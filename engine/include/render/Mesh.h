@@ -1,24 +1,95 @@
 #pragma once
 
+#include "graphics/GeometryPool.h"
 #include "graphics/VertexLayout.h"
+#include "Common.h"
 
 #include <vulkan/vulkan.h>
 
 #include <memory>
+#include <span>
 #include <string>
+#include <vector>
 
 namespace eng
 {
+    // One level of detail. All levels index the same vertices.
+    struct MeshLod
+    {
+        uint32_t firstIndex = 0;
+        uint32_t indexCount = 0;
+        // Simplification error relative to the bounding sphere radius, 0 for level 0
+        float error = 0.f;
+    };
+
+    // Cluster of level 0 triangles, culled on the GPU as a unit.
+    struct Meshlet
+    {
+        // Relative to the start of level 0
+        uint32_t firstIndex = 0;
+        uint32_t indexCount = 0;
+        // Local space bounding sphere
+        glm::vec3 center{0.f};
+        float radius = 0.f;
+        // Every triangle faces away from eyes with
+        // dot(center - eye, coneAxis) >= coneCutoff * length(center - eye) + radius.
+        // A cutoff of 1 never culls.
+        glm::vec3 coneAxis{0.f, 0.f, 1.f};
+        float coneCutoff = 1.f;
+    };
+
     class Mesh
     {
     public:
+        static constexpr uint32_t kMaxLods = 5;
+        // Meshlet limits, also the workgroup size of cluster_cull_comp.glsl
+        static constexpr uint32_t kMeshletMaxVertices = 64;
+        static constexpr uint32_t kMeshletMaxTriangles = 124;
+
         Mesh(const VertexLayout &layout, const std::vector<float> &vertices, const std::vector<uint32_t> &indices);
+        // indices holds every level back to back, lods[0] the full resolution
+        // range. firstIndex of each level is relative to the start of indices.
+        Mesh(const VertexLayout &layout, const std::vector<float> &vertices, const std::vector<uint32_t> &indices,
+             const std::vector<MeshLod> &lods, const std::vector<Meshlet> &meshlets = {});
         Mesh(const VertexLayout &layout, const std::vector<float> &vertices);
+        ~Mesh();
         Mesh(const Mesh &) = delete;
         Mesh &operator=(const Mesh &) = delete;
 
         void Bind();
-        void Draw();
+        void Draw(uint32_t lod = 0);
+        // Part of level 0, firstIndex relative to its start
+        void DrawRange(uint32_t firstIndex, uint32_t indexCount);
+
+        // Local space bounds of the Position attribute
+        const AABB &GetBounds() const { return m_bounds; }
+        // UV units per local unit over level 0, 0 without UVs. Used to pick texture mips.
+        float GetUvDensity() const { return m_uvDensity; }
+
+        // Float layout of the CPU copy, see GetVertices
+        const VertexLayout &GetVertexLayout() const { return m_vertexLayout; }
+        // Quantized layout of the uploaded vertices, see VertexQuantizer
+        const VertexLayout &GetGpuLayout() const { return m_gpuLayout; }
+        size_t GetVertexCount() const { return m_vertexCount; }
+        size_t GetIndexCount() const { return m_indexCount; }
+        const GeometryAllocation &GetGeometry() const { return m_geometry; }
+
+        // Index ranges are absolute, ready for vkCmdDrawIndexed. Out of range levels clamp to the last one.
+        uint32_t GetLodCount() const { return (uint32_t)m_lods.size(); }
+        const MeshLod &GetLod(uint32_t lod) const { return m_lods[lod < m_lods.size() ? lod : m_lods.size() - 1]; }
+
+        // Clusters of level 0, empty for meshes that are always drawn whole
+        const std::vector<Meshlet> &GetMeshlets() const { return m_meshlets; }
+
+        // CPU copy of the uploaded data, kept for load time processing (static batching,
+        // imposter baking) and occluders. Empty once released.
+        const std::vector<float> &GetVertices() const { return m_vertices; }
+        // Level 0 of the CPU copy
+        std::span<const uint32_t> GetIndices() const { return GetLodIndices(0); }
+        // One level of the CPU copy, clamped like GetLod
+        std::span<const uint32_t> GetLodIndices(uint32_t lod) const;
+        // Frees the CPU copy. Indices stay with meshlets, ClusterCuller reads them.
+        void ReleaseCpuData();
 
         static std::shared_ptr<Mesh> CreateCube();
 
@@ -26,10 +97,18 @@ namespace eng
 
     private:
         VertexLayout m_vertexLayout;
-        VkBuffer m_VBO = VK_NULL_HANDLE;
-        VkBuffer m_EBO = VK_NULL_HANDLE;
+        VertexLayout m_gpuLayout;
+        GeometryAllocation m_geometry;
 
         size_t m_vertexCount = 0;
         size_t m_indexCount = 0;
+
+        AABB m_bounds;
+        float m_uvDensity = 0.f;
+        std::vector<MeshLod> m_lods;
+        std::vector<Meshlet> m_meshlets;
+
+        std::vector<float> m_vertices;
+        std::vector<uint32_t> m_indices;
     };
 }
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "graphics/VertexLayout.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace eng
+{
+    struct Meshlet;
+
+    // Post transform cache size assumed by the optimizer and the stats, FIFO
+    static constexpr uint32_t kVertexCacheSize = 16;
+
+    struct VertexCacheStats
+    {
+        // Transformed vertices per triangle, 0.5 at best, 3 at worst
+        float acmr = 0.f;
+        // Transformed vertices per referenced vertex, 1 at best
+        float atvr = 0.f;
+    };
+
+    VertexCacheStats AnalyzeVertexCache(const std::vector<uint32_t> &indices, size_t vertexCount);
+
+    // Drops a trailing partial triangle and triangles with an index past vertexCount.
+    // Returns the number dropped, a partial one included. The functions below expect clean lists.
+    size_t RemoveInvalidTriangles(std::vector<uint32_t> &indices, size_t vertexCount);
+
+    // Merges bitwise identical vertices and rewrites the indices. Returns the new vertex count.
+    size_t WeldVertices(std::vector<float> &vertices, size_t floatsPerVertex, std::vector<uint32_t> &indices);
+
+    // Tipsify (Sander et al. 2007) triangle order. Optionally returns the first
+    // triangle of every run that had to restart after a dead end.
+    void OptimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount,
+                             std::vector<uint32_t> *outClusters = nullptr);
+
+    // Splits the cache ordered triangles into clusters whose ACMR stays within
+    // threshold of the whole mesh, then draws outward facing clusters first.
+    // positions: x y z of vertex i at positions[i * stride], stride in floats.
+    void OptimizeOverdraw(std::vector<uint32_t> &indices, const float *positions, size_t stride, size_t vertexCount,
+                          const std::vector<uint32_t> &clusters, float threshold = 1.05f);
+
+    // Reorders vertices by first use and rewrites the indices.
+    void OptimizeVertexFetch(std::vector<float> &vertices, size_t floatsPerVertex, std::vector<uint32_t> &indices);
+
+    // Grows clusters of at most maxVertices / maxTriangles over shared vertices
+    // and reorders the triangles so every cluster is one contiguous index range.
+    // Fills in local space bounding spheres and normal cones.
+    void BuildMeshlets(std::vector<uint32_t> &indices, const float *positions, size_t stride, size_t vertexCount,
+                       std::vector<Meshlet> &outMeshlets,
+                       uint32_t maxVertices = 64, uint32_t maxTriangles = 124);
+
+    // Import pipeline: weld, vertex cache, overdraw, vertex fetch.
+    struct MeshOptimizeReport
+    {
+        size_t vertexCountBefore = 0;
+        size_t vertexCountAfter = 0;
+        VertexCacheStats before;
+        VertexCacheStats after;
+    };
+
+    MeshOptimizeReport OptimizeMesh(const VertexLayout &layout, std::vector<float> &vertices, std::vector<uint32_t> &indices);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "graphics/VertexLayout.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace eng
+{
+    struct MeshLod;
+
+    // Quadric error metric edge collapse (Garland & Heckbert). Vertices are
+    // only ever merged into existing ones, so the result indexes the same
+    // vertex data. Vertices split by attribute seams and non manifold border
+    // vertices are locked; open borders only collapse along themselves.
+    //
+    // positions: x y z of vertex i at positions[i * stride], stride in floats.
+    // Stops at targetIndexCount or once the next collapse would exceed
+    // targetError, relative to the largest extent of the mesh. outError gets
+    // the error of the result in the same unit.
+    std::vector<uint32_t> SimplifyMesh(const float *positions, size_t vertexCount, size_t stride,
+                                       const std::vector<uint32_t> &indices,
+                                       size_t targetIndexCount, float targetError, float *outError = nullptr);
+
+    // Import time LOD chain: halves the triangle count per level for up to
+    // Mesh::kMaxLods levels and stops early once simplification stalls.
+    // outIndices holds every level back to back, level 0 being the source
+    // indices. MeshLod::error is relative to the bounding sphere radius.
+    void BuildLodChain(const VertexLayout &layout, const std::vector<float> &vertices,
+                       const std::vector<uint32_t> &indices,
+                       std::vector<uint32_t> &outIndices, std::vector<MeshLod> &outLods);
+}
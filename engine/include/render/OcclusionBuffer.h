@@ -0,0 +1,103 @@
+#pragma once
+
+#include "render/RenderScene.h"
+#include "Common.h"
+
+#include <glm/mat4x4.hpp>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace eng
+{
+    class JobSystem;
+    class Mesh;
+
+    struct Occluder
+    {
+        const Mesh *mesh = nullptr;
+        glm::mat4 transform = glm::mat4(1.f);
+        // Without a mesh: xyz per vertex, triangle list indices (none for unindexed)
+        std::span<const float> positions;
+        std::span<const uint32_t> indices;
+        // With a mesh: level 0 of these ranges only, the whole level 0 when empty
+        std::span<const DrawRange> ranges;
+    };
+
+    // Low resolution software depth buffer for CPU occlusion culling.
+    // Occluder triangles are rasterized with fixed point edge functions,
+    // kSimdLanes pixels at a time (SSE4.1, AVX2 or scalar, picked at compile
+    // time by ENGINE_SIMD). Every lane runs the same integer and float ops as
+    // the scalar path, so all builds produce bit identical buffers; the scalar
+    // path is always built so `enginebench --occlusion` can check that.
+    // Rows are split into tile bands that are rasterized on the job system;
+    // each band also keeps the farthest depth of every kTileSize tile.
+    class OcclusionBuffer
+    {
+    public:
+        static constexpr uint32_t kDefaultWidth = 320;
+        static constexpr uint32_t kDefaultHeight = 192;
+        static constexpr uint32_t kTileSize = 8;
+        static constexpr uint32_t kMaxSize = 1024;
+        static const uint32_t kSimdLanes;
+        static const char *const kSimdName;
+
+        // Width and height are rounded up to kTileSize and clamped to kMaxSize.
+        void Init(uint32_t width = kDefaultWidth, uint32_t height = kDefaultHeight);
+
+        // Clears and rasterizes the occluders. viewProj is the GL style camera matrix.
+        void Render(std::span<const Occluder> occluders, const glm::mat4 &viewProj, JobSystem &jobSystem);
+
+        // Conservative: false only if the box is off screen or behind the occluders.
+        bool IsVisible(const AABB &bounds) const;
+
+        // Rasterize and test with the scalar path whatever ENGINE_SIMD is
+        void SetScalar(bool scalar) { m_scalar = scalar; }
+        bool IsScalar() const { return m_scalar; }
+
+        uint32_t GetWidth() const { return m_width; }
+        uint32_t GetHeight() const { return m_height; }
+        uint32_t GetTriangleCount() const { return (uint32_t)m_triangles.size(); }
+        // Row major, NDC depth, 1 where nothing was drawn
+        const std::vector<float> &GetDepth() const { return m_depth; }
+
+    private:
+        struct Triangle
+        {
+            int32_t a[3];
+            int32_t b[3];
+            int32_t c[3];
+            // z = zc + za * x + zb * y at pixel centers
+            float za = 0.f;
+            float zb = 0.f;
+            float zc = 0.f;
+            int32_t minX = 0;
+            int32_t maxX = 0;
+            int32_t minY = 0;
+            int32_t maxY = 0;
+        };
+
+        void SetupOccluder(const Occluder &occluder, std::vector<Triangle> &out) const;
+        void SetupTriangle(const glm::vec4 &v0, const glm::vec4 &v1, const glm::vec4 &v2, std::vector<Triangle> &out) const;
+        template <typename Ops>
+        void RasterizeBand(uint32_t band);
+        template <typename Ops>
+        bool IsVisibleWith(const AABB &bounds) const;
+
+    private:
+        uint32_t m_width = 0;
+        uint32_t m_height = 0;
+        uint32_t m_tilesX = 0;
+        uint32_t m_tilesY = 0;
+        bool m_scalar = false;
+
+        glm::mat4 m_viewProj = glm::mat4(1.f);
+        std::vector<float> m_depth;
+        std::vector<float> m_tileMax;
+
+        // One bucket per job system thread during setup
+        std::vector<std::vector<Triangle>> m_threadTriangles;
+        std::vector<Triangle> m_triangles;
+    };
+}
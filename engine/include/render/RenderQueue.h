@@ -1,9 +1,11 @@
 #pragma once
 
 #include "Common.h"
+#include "render/OcclusionBuffer.h"
 
 #include <glm/mat4x4.hpp>
 
+#include <cstdint>
 #include <vector>
 
 namespace eng
@@ -11,6 +13,8 @@ namespace eng
     class Mesh;
     class Material;
     class GraphicsAPI;
+    class RenderScene;
+    struct RenderProxy;
 
     struct RenderCommand
     {
@@ -22,10 +26,57 @@ namespace eng
     class RenderQueue
     {
     public:
+        struct OcclusionStats
+        {
+            uint32_t occluders = 0;
+            uint32_t triangles = 0;
+            uint32_t tested = 0;
+            uint32_t culled = 0;
+            float rasterMs = 0.f;
+            float testMs = 0.f;
+        };
+
+        // One submit bucket per job system thread, so Submit needs no lock.
+        void Init(uint32_t threadCount);
+
+        // Transient, one-frame draws. Safe to call from any job system thread.
         void Submit(const RenderCommand &command);
-        void Draw(GraphicsAPI &graphicsAPI, const CameraData &cameraData, const std::vector<LightData> &lights);
+        // Draws the retained proxies of renderScene, then the submitted commands.
+        // With skipIndirect, proxies drawn by the IndirectRenderer are left out.
+        void Draw(GraphicsAPI &graphicsAPI, const RenderScene &renderScene, const CameraData &cameraData,
+                  bool skipIndirect = false);
+
+        // CPU occlusion culling for when the GPU driven path is off: occluder
+        // proxies are rasterized into an OcclusionBuffer on the job system and
+        // every other proxy and command is tested against it before drawing.
+        void SetOcclusionCulling(bool enabled) { m_occlusionCulling = enabled; }
+        bool IsOcclusionCulling() const { return m_occlusionCulling; }
+        const OcclusionStats &GetOcclusionStats() const { return m_occlusionStats; }
 
     private:
+        void MergeBuckets();
+        // Returns false when there is nothing to cull against this frame.
+        bool RenderOccluders(const RenderScene &renderScene, const CameraData &cameraData);
+        void BindItem(GraphicsAPI &graphicsAPI, Mesh *mesh, Material *material, const glm::mat4 &modelMatrix,
+                      const CameraData &cameraData);
+        void DrawItem(GraphicsAPI &graphicsAPI, Mesh *mesh, Material *material, const glm::mat4 &modelMatrix,
+                      const CameraData &cameraData, uint32_t lod = 0);
+        // Visible ranges of a merged proxy, consecutive ones in one draw
+        void DrawRanges(GraphicsAPI &graphicsAPI, const RenderProxy &proxy, const uint8_t *visible,
+                        const CameraData &cameraData);
+
+    private:
+        std::vector<std::vector<RenderCommand>> m_buckets;
         std::vector<RenderCommand> m_commands;
+
+        OcclusionBuffer m_occlusion;
+        std::vector<Occluder> m_occluders;
+        // Proxies first, then commands. uint8_t: written from several jobs.
+        std::vector<uint8_t> m_visible;
+        // Per DrawRange of the proxies that have them, m_rangeFirst[i] is where proxy i starts
+        std::vector<uint8_t> m_rangeVisible;
+        std::vector<uint32_t> m_rangeFirst;
+        bool m_occlusionCulling = true;
+        OcclusionStats m_occlusionStats;
     };
 }
\ No newline at end of file
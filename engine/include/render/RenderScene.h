@@ -0,0 +1,116 @@
+#pragma once
+
+#include "Common.h"
+#include "HandleArray.h"
+
+#include <glm/mat4x4.hpp>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace eng
+{
+    class Mesh;
+    class Material;
+    struct Imposter;
+
+    // Index range of one source object inside a merged mesh, see StaticBatcher.
+    // Index offsets are relative to level 0 of the mesh.
+    struct DrawRange
+    {
+        static constexpr uint32_t kMaxLevels = 5;
+
+        struct Level
+        {
+            uint32_t firstIndex = 0;
+            uint32_t indexCount = 0;
+            // Simplification error relative to radius, see MeshLod
+            float error = 0.f;
+        };
+
+        // Level drawn, one of levels. Empty once the source object is gone.
+        uint32_t firstIndex = 0;
+        uint32_t indexCount = 0;
+        AABB worldBounds;
+
+        Level levels[kMaxLevels];
+        uint32_t levelCount = 1;
+        uint32_t lod = 0;
+        // World space bounding sphere radius of the source mesh
+        float radius = 0.f;
+    };
+
+    struct RenderProxy
+    {
+        Mesh *mesh = nullptr;
+        Material *material = nullptr;
+        glm::mat4 transform = glm::mat4(1.f);
+        AABB worldBounds;
+        // Rasterized into the CPU occlusion buffer, see RenderQueue
+        bool occluder = false;
+        // Mesh level of detail, picked by the owning MeshComponent
+        uint32_t lod = 0;
+        // Drawn as a quad by ImposterRenderer instead of the mesh when set
+        const Imposter *imposter = nullptr;
+        // Culled range by range when set, owned by whoever merged the mesh
+        std::span<const DrawRange> ranges;
+    };
+
+    // World space box of a transformed local box
+    AABB TransformBounds(const AABB &local, const glm::mat4 &m);
+
+    // Persistent draw items. Proxies are stored densely for iteration and
+    // addressed through stable handles that survive removals.
+    class RenderScene
+    {
+    public:
+        using ProxyHandle = HandleArray<RenderProxy>::Handle;
+        static constexpr ProxyHandle kInvalidProxy = HandleArray<RenderProxy>::kInvalid;
+
+        ProxyHandle AddProxy(Mesh *mesh, Material *material, const glm::mat4 &transform);
+        void UpdateTransform(ProxyHandle handle, const glm::mat4 &transform);
+        void SetOccluder(ProxyHandle handle, bool occluder);
+        void SetLod(ProxyHandle handle, uint32_t lod);
+        void SetImposter(ProxyHandle handle, const Imposter *imposter);
+        void SetRanges(ProxyHandle handle, std::span<const DrawRange> ranges);
+        // The ranges were edited in place (level switch, removed source)
+        void UpdateRanges(ProxyHandle handle);
+        void RemoveProxy(ProxyHandle handle);
+
+        const std::vector<RenderProxy> &GetProxies() const { return m_proxies.GetItems(); }
+        const RenderProxy &GetProxy(ProxyHandle handle) const { return m_proxies.Get(handle); }
+        // Handle of GetProxies()[index]
+        ProxyHandle GetHandle(uint32_t index) const { return m_proxies.GetHandle(index); }
+
+        // Bumped on every change, lets GPU side copies skip unchanged frames.
+        uint64_t GetVersion() const { return m_version; }
+        // Version of the last add, remove or SetRanges. Copies sorted by mesh or
+        // material only need a rebuild when this moves.
+        uint64_t GetStructureVersion() const { return m_structureVersion; }
+        // Appends the handles of proxies changed after version (may repeat).
+        // False when the change log no longer reaches back that far, or the
+        // structure changed since, the caller then rebuilds from GetProxies.
+        bool GetChangedSince(uint64_t version, std::vector<ProxyHandle> &changed) const;
+
+    private:
+        void MarkChanged(ProxyHandle handle);
+        void MarkStructureChanged();
+
+        struct Change
+        {
+            uint64_t version = 0;
+            ProxyHandle handle = kInvalidProxy;
+        };
+
+        // The log is cut once it outgrows the proxies, then readers behind it rebuild
+        static constexpr size_t kMinChangeLog = 1024;
+
+        HandleArray<RenderProxy> m_proxies;
+        uint64_t m_version = 0;
+        uint64_t m_structureVersion = 0;
+        // Every change after m_logStart, oldest first
+        std::vector<Change> m_changes;
+        uint64_t m_logStart = 0;
+    };
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "render/RenderScene.h"
+#include "Common.h"
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace eng
+{
+    class GameObject;
+    class Material;
+    class Mesh;
+    class MeshComponent;
+
+    struct StaticBatch
+    {
+        std::shared_ptr<Material> material;
+        std::shared_ptr<Mesh> mesh;
+        // One per source object, culled separately (see RenderProxy::ranges)
+        std::vector<DrawRange> ranges;
+        // Source of each range, null once removed
+        std::vector<MeshComponent *> components;
+        RenderScene::ProxyHandle proxy = RenderScene::kInvalidProxy;
+    };
+
+    // Merges the meshes of static objects into world space buffers, one batch per
+    // material, vertex layout and occluder flag, and draws each batch as a single
+    // RenderScene proxy. The proxy keeps the index range of every source object:
+    // RenderQueue occlusion tests and draws them range by range, IndirectRenderer
+    // turns each into its own GPU object, so culling stays per source object.
+    //
+    // Every level of detail is merged too, level after level, and UpdateLods
+    // picks the level of each range the way MeshComponent does for its own
+    // proxy. Meshlets are dropped, ranges replace cluster culling. Components
+    // with an imposter distance are left alone: a single proxy cannot switch
+    // to an imposter per source.
+    class StaticBatcher
+    {
+    public:
+        // Splits batches so a single draw stays within a reasonable buffer size.
+        static constexpr size_t kMaxBatchVertices = 1u << 20;
+
+        StaticBatcher() = default;
+        ~StaticBatcher();
+
+        StaticBatcher(const StaticBatcher &) = delete;
+        StaticBatcher &operator=(const StaticBatcher &) = delete;
+
+        // Components that are already batched are skipped.
+        void Build(std::span<MeshComponent *const> components);
+        // Batched components get their own proxy back.
+        void Clear();
+        // Empties the range of a destroyed or moved component, the other
+        // ranges keep their place. Unknown components are ignored.
+        void Remove(MeshComponent *component);
+
+        // Level selection of the ranges, ticked by the Scene after RenderExtract
+        void UpdateLods(float deltaTime, GameObject *cameraObject);
+
+        const std::vector<StaticBatch> &GetBatches() const { return m_batches; }
+
+    private:
+        struct SourceSlot
+        {
+            uint32_t batch = 0;
+            uint32_t range = 0;
+        };
+
+        std::vector<StaticBatch> m_batches;
+        std::unordered_map<const MeshComponent *, SourceSlot> m_sources;
+        float m_lodAccumulator = 0.f;
+    };
+}
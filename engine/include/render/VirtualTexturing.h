@@ -0,0 +1,223 @@
+#pragma once
+
+#include "graphics/VirtualTextureFile.h"
+#include "jobs/JobSystem.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace eng
+{
+    class VirtualTextureSystem;
+    class VulkanContext;
+
+    // A .vtex opened for sampling through the page cache. Materials bind its
+    // set in place of a texture set, see VirtualTextureSystem::GetSetLayout.
+    class VirtualTexture
+    {
+    public:
+        VirtualTexture() = default;
+        ~VirtualTexture();
+
+        VirtualTexture(const VirtualTexture &) = delete;
+        VirtualTexture &operator=(const VirtualTexture &) = delete;
+
+        // For the frame being recorded
+        VkDescriptorSet GetTextureSet() const;
+
+        uint32_t GetWidth() const { return m_file->GetWidth(); }
+        uint32_t GetHeight() const { return m_file->GetHeight(); }
+        // Every tile of the coarsest level is in the cache
+        bool IsReady() const { return m_ready; }
+
+    private:
+        friend class VirtualTextureSystem;
+
+        VirtualTextureSystem *m_system = nullptr;
+        std::shared_ptr<VirtualTextureFile> m_file;
+        uint32_t m_id = 0;
+
+        // Page table, one mip per level, RGBA8_UINT: cache page x, y, resident level, valid
+        VkImage m_pageTable = VK_NULL_HANDLE;
+        VkDeviceMemory m_pageTableMemory = VK_NULL_HANDLE;
+        VkImageView m_pageTableView = VK_NULL_HANDLE;
+        // Level offsets into m_entries, which mirrors the page table
+        std::vector<uint32_t> m_levelOffsets;
+        std::vector<uint32_t> m_entries;
+        bool m_dirty = true;
+        bool m_ready = false;
+
+        // Per frame parameters and sets
+        VkBuffer m_params = VK_NULL_HANDLE;
+        VkDeviceMemory m_paramsMemory = VK_NULL_HANDLE;
+        uint8_t *m_paramsMapped = nullptr;
+        std::vector<VkDescriptorSet> m_sets;
+    };
+
+    // Software virtual texturing. Textures are split into pages (see
+    // VirtualTextureFile) and only the pages the camera sees sit in one
+    // physical cache texture shared by all virtual textures; memory is bound
+    // by the cache, not by the size of the textures.
+    //
+    // Shaders look up a per texture page table to find where a page lives,
+    // falling back to the nearest resident coarser level, and write the page
+    // they wanted into a feedback buffer at 1/kFeedbackScale resolution. The
+    // buffer is read back MAX_FRAMES later, once its frame fence signalled.
+    // Missing pages are read and decoded by jobs and copied into the least
+    // recently used cache pages.
+    class VirtualTextureSystem
+    {
+    public:
+        // Cache side in pages: 30 * 136 = 4080 texels, under the 4096 every device supports
+        static constexpr uint32_t kCachePages = 30;
+        static constexpr uint32_t kFeedbackScale = 8;
+        static constexpr uint32_t kMaxLoadsInFlight = 32;
+        static constexpr uint32_t kMaxUploadsPerFrame = 16;
+        // Ids are 8 bits of the page id, 0xFF is the empty feedback slot
+        static constexpr uint32_t kMaxTextures = 255;
+
+        VirtualTextureSystem() = default;
+        VirtualTextureSystem(const VirtualTextureSystem &) = delete;
+        VirtualTextureSystem &operator=(const VirtualTextureSystem &) = delete;
+
+        // supported: fragmentStoresAndAtomics, needed for the feedback writes
+        void Init(VulkanContext &vk, bool supported, uint32_t framesInFlight);
+        void Destroy();
+        // Feedback buffers follow the swapchain extent, device must be idle
+        void Resize(VkExtent2D extent);
+
+        bool IsSupported() const { return m_supported; }
+
+        // nullptr when unsupported or the file cannot be opened. Requests for
+        // the same path share one texture.
+        std::shared_ptr<VirtualTexture> Load(const std::string &path);
+
+        // Outside the render pass, after the frame fence was waited on: reads
+        // the feedback of this frame slot, uploads loaded pages and changed
+        // page tables and clears the feedback buffer.
+        void BeginFrame(VkCommandBuffer cmd, uint32_t frame);
+        // After the passes that draw virtual textures
+        void EndFrame(VkCommandBuffer cmd);
+
+        // Set 1 of programs that sample virtual textures: 0 cache, 1 page
+        // table, 2 parameters, 3 feedback buffer
+        VkDescriptorSetLayout GetSetLayout() const { return m_setLayout; }
+        uint32_t GetFrame() const { return m_frame; }
+
+        uint32_t GetResidentPageCount() const { return (uint32_t)m_pageSlots.size(); }
+
+    private:
+        friend class VirtualTexture;
+
+        // Page key: texture id, level, tile y, tile x. Same packing as the
+        // feedback buffer.
+        static uint32_t PageId(uint32_t id, uint32_t level, uint32_t x, uint32_t y)
+        {
+            return id << 24 | level << 20 | y << 10 | x;
+        }
+
+        struct Slot
+        {
+            uint32_t page = UINT32_MAX;
+            uint64_t lastUsed = 0;
+            // Coarsest level, never evicted
+            bool pinned = false;
+        };
+
+        struct LoadedPage
+        {
+            std::weak_ptr<VirtualTexture> texture;
+            uint32_t page = 0;
+            std::vector<uint8_t> rgba;
+            bool ok = false;
+        };
+
+        struct FrameResources
+        {
+            VkBuffer feedback = VK_NULL_HANDLE;
+            VkDeviceMemory feedbackMemory = VK_NULL_HANDLE;
+            const uint32_t *feedbackMapped = nullptr;
+            bool feedbackWritten = false;
+
+            VkBuffer staging = VK_NULL_HANDLE;
+            VkDeviceMemory stagingMemory = VK_NULL_HANDLE;
+            uint8_t *stagingMapped = nullptr;
+            VkDeviceSize stagingSize = 0;
+        };
+
+        // GPU objects of a destroyed texture, kept until its frames are done
+        struct Retired
+        {
+            VkImage image = VK_NULL_HANDLE;
+            VkDeviceMemory imageMemory = VK_NULL_HANDLE;
+            VkImageView view = VK_NULL_HANDLE;
+            VkBuffer params = VK_NULL_HANDLE;
+            VkDeviceMemory paramsMemory = VK_NULL_HANDLE;
+            std::vector<VkDescriptorSet> sets;
+            uint32_t framesLeft = 0;
+        };
+
+        void createCache();
+        void createFeedback();
+        void destroyFeedback();
+        void writeSets(VirtualTexture &texture);
+        void ensureStaging(FrameResources &frame, VkDeviceSize size);
+
+        void readFeedback(FrameResources &frame);
+        void request(VirtualTexture &texture, uint32_t level, uint32_t x, uint32_t y);
+        void startLoads();
+        // Returns the slot index, UINT32_MAX when every slot is in use this frame
+        uint32_t allocateSlot();
+        void updatePageTable(VirtualTexture &texture);
+
+        void release(VirtualTexture &texture);
+        void destroyRetired(Retired &retired);
+
+    private:
+        VulkanContext *m_vk = nullptr;
+        VkDevice m_device = VK_NULL_HANDLE;
+        VkPhysicalDevice m_gpu = VK_NULL_HANDLE;
+        bool m_supported = false;
+
+        VkDescriptorSetLayout m_setLayout = VK_NULL_HANDLE;
+        VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+        VkSampler m_cacheSampler = VK_NULL_HANDLE;
+        VkSampler m_pageTableSampler = VK_NULL_HANDLE;
+
+        // Mutable format, viewed as sRGB or UNORM to match each texture
+        VkImage m_cache = VK_NULL_HANDLE;
+        VkDeviceMemory m_cacheMemory = VK_NULL_HANDLE;
+        VkImageView m_cacheViewSrgb = VK_NULL_HANDLE;
+        VkImageView m_cacheViewUnorm = VK_NULL_HANDLE;
+        bool m_cacheInitialized = false;
+
+        std::vector<Slot> m_slots;
+        // Page id to slot index
+        std::unordered_map<uint32_t, uint32_t> m_pageSlots;
+
+        std::vector<FrameResources> m_frames;
+        VkExtent2D m_feedbackExtent{};
+        uint32_t m_frame = 0;
+        uint64_t m_frameCounter = 0;
+
+        std::unordered_map<std::string, std::weak_ptr<VirtualTexture>> m_byPath;
+        // Indexed by texture id
+        std::vector<std::weak_ptr<VirtualTexture>> m_textures;
+        std::vector<Retired> m_retired;
+
+        // Page ids wanted by the last readback, coarsest first
+        std::vector<uint32_t> m_requests;
+        // Read by a job or waiting for upload
+        std::unordered_set<uint32_t> m_loading;
+        JobCounter m_loadJobs;
+        std::mutex m_loadedMutex;
+        std::vector<LoadedPage> m_loaded;
+    };
+}
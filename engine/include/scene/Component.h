@@ -1,18 +1,58 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+
 namespace eng
 {
     class GameObject;
 
+    // Scene::Update runs the phases in this order.
+    enum class TickPhase
+    {
+        PrePhysics = 0,
+        Update,
+        PostUpdate,
+        RenderExtract,
+        Count
+    };
+
+    // Components do not tick unless they opt in with SetTickEnabled(true).
+    // Only registered, awake components are visited by Scene::Update.
     class Component
     {
     public:
         virtual ~Component() = default;
-        virtual void Update(float DeltaTime) = 0;
+        // DeltaTime is the time since this component last ticked.
+        virtual void Update(float DeltaTime) {}
         virtual size_t GetTypeId() const = 0;
 
+        // Called on the main thread when the owner's world transform was resolved.
+        virtual void OnTransformChanged() {}
+
+        virtual TickPhase GetTickPhase() const { return TickPhase::Update; }
+
+        // Parallel-safe components are updated on worker threads. They may only
+        // write to their own owner and must not create, reparent or destroy objects.
+        virtual bool IsParallelSafe() const { return false; }
+
         GameObject *GetOwner();
 
+        void SetTickEnabled(bool enabled);
+        bool IsTickEnabled() const;
+
+        // Tick every Nth frame (1 = every frame).
+        void SetTickInterval(uint32_t frames);
+        // Tick at most hz times per second, 0 disables the limit.
+        void SetTickRate(float hz);
+
+        // A sleeping component keeps its settings but is removed from the tick list until Wake.
+        void Sleep();
+        void Wake();
+        bool IsSleeping() const;
+
+        bool WantsTick() const;
+
         template <typename T>
         static size_t StaticTypeId()
         {
@@ -24,9 +64,23 @@ namespace eng
         GameObject *m_owner = nullptr;
 
         friend class GameObject;
+        friend class Scene;
+
+    private:
+        void RefreshTick();
 
     private:
         static size_t nextId;
+
+        bool m_tickEnabled = false;
+        bool m_sleeping = false;
+        uint32_t m_tickIntervalFrames = 1;
+        float m_tickIntervalSeconds = 0.f;
+
+        // Owned by Scene
+        int32_t m_tickIndex = -1;
+        uint32_t m_tickCountdown = 0;
+        float m_tickAccumulator = 0.f;
     };
 
 #define COMPONENT(ComponentClass)                                                \
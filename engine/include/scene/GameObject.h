@@ -2,6 +2,7 @@
 
 #include "scene/Component.h"
 
+#include <atomic>
 #include <string>
 #include <vector>
 #include <memory>
@@ -17,8 +18,11 @@ namespace eng
     class GameObject
     {
     public:
-        virtual ~GameObject() = default;
+        virtual ~GameObject();
+        // Per-object hook, only called once SetTickEnabled(true) was set.
         virtual void Update(float DeltaTime);
+        void SetTickEnabled(bool enabled);
+        bool IsTickEnabled() const;
         const std::string &GetName() const;
         void SetName(const std::string &name);
         GameObject *GetParent();
@@ -27,6 +31,11 @@ namespace eng
         bool IsAlive() const;
         void MarkForDestroy();
 
+        // Static objects (and everything below them) are expected not to move;
+        // their meshes are merged by Scene::BuildStaticBatches.
+        void SetStatic(bool isStatic);
+        bool IsStatic() const;
+
         void AddComponent(Component *component);
         template <typename T, typename = typename std::enable_if_t<std::is_base_of_v<Component, T>>>
         T *GetComponent()
@@ -55,13 +64,19 @@ namespace eng
         void SetScale(const glm::vec3 &scale);
 
         glm::mat4 GetLocalTransform() const;
+        // Cached once Scene resolved it. While this object or an ancestor
+        // is dirty the matrix is recomputed on the fly.
         glm::mat4 GetWorldTransform() const;
+        bool IsTransformDirty() const;
 
         static GameObject *LoadGLTF(const std::string &path);
 
     protected:
         GameObject() = default;
 
+    private:
+        void MarkTransformDirty();
+
     private:
         std::string m_name;
         GameObject *m_parent = nullptr;
@@ -69,11 +84,17 @@ namespace eng
         std::vector<std::unique_ptr<GameObject>> m_children;
         std::vector<std::unique_ptr<Component>> m_components;
         bool m_isAlive = true;
+        bool m_tickEnabled = false;
+        bool m_static = false;
+        int32_t m_tickIndex = -1;
 
         glm::vec3 m_position = glm::vec3(0.f);
         glm::quat m_rotation = glm::quat(1.f, 0.f, 0.f, 0.f);
         glm::vec3 m_scale = glm::vec3(1.f);
 
+        glm::mat4 m_worldTransform = glm::mat4(1.f);
+        std::atomic<bool> m_transformDirty{false};
+
         friend class Scene;
     };
 
@@ -1,18 +1,33 @@
 #pragma once
 
 #include "scene/GameObject.h"
+#include "render/StaticBatcher.h"
 #include "Common.h"
+#include "HandleArray.h"
 
+#include <array>
+#include <atomic>
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <memory>
+#include <span>
 
 namespace eng
 {
 
+    // While Update is running, CreateObject/SetParent/DestroyObject are recorded
+    // per thread and applied in one batch after the last phase: creates first,
+    // then reparents, then destroys, each in call order.
     class Scene
     {
     public:
+        Scene();
+        ~Scene();
+
+        Scene(const Scene &) = delete;
+        Scene &operator=(const Scene &) = delete;
+
         void Update(float DeltaTime);
         void Clear();
 
@@ -24,25 +39,103 @@ namespace eng
             auto obj = new T();
             obj->SetName(name);
             obj->m_scene = this;
-            SetParent(obj, parent);
+            AddObject(obj, parent);
 
             return obj;
         }
 
+        // Deferred during Update: returns true and validates (cycles, etc.) at the sync point.
         bool SetParent(GameObject *obj, GameObject *parent);
+        void DestroyObject(GameObject *obj);
+        bool IsUpdating() const;
+
+        // Merges the meshes of every static object into per-material batches.
+        // Call once the level is loaded. Static objects should not move afterwards,
+        // a moved one leaves its batch (see MeshComponent::SetBatched).
+        // Frees the CPU copies of meshes that are not used by an occluder or an
+        // imposter, later calls and occluders added later find them empty.
+        void BuildStaticBatches();
 
         void SetMainCamera(GameObject *camera);
         GameObject *GetMainCamera();
 
-        std::vector<LightData> CollectLights();
+        // Dense and stable for the frame, maintained by LightComponent.
+        std::span<const LightData> GetLights() const;
+
+        using LightHandle = HandleArray<LightData>::Handle;
+        LightHandle AddLight(const LightData &light);
+        void UpdateLight(LightHandle handle, const LightData &light);
+        void RemoveLight(LightHandle handle);
+
+        friend class Component;
+        friend class GameObject;
 
     private:
-        void CollectLightsRecursive(GameObject *obj, std::vector<LightData> &out);
+        enum class CommandType : uint8_t
+        {
+            Create = 0,
+            SetParent,
+            RefreshTick,
+            Destroy
+        };
+
+        struct SceneCommand
+        {
+            CommandType type = CommandType::Create;
+            uint64_t sequence = 0;
+            GameObject *object = nullptr;
+            GameObject *parent = nullptr;
+            Component *component = nullptr;
+        };
+
+        void RunPhase(TickPhase phase, float DeltaTime);
+        static void TickComponent(Component *component, float DeltaTime);
+
+        // Called by Component/GameObject when their tick state changes; deferred during Update.
+        void RefreshTick(Component *component);
+        void RefreshTick(GameObject *obj);
+        void RefreshTicks(GameObject *obj);
+        void ApplyTick(Component *component);
+        void ApplyTick(GameObject *obj);
+        void UnregisterTicks(GameObject *obj);
+
+        // Dirty objects are resolved top-down on the main thread.
+        void QueueTransformUpdate(GameObject *obj);
+        void ForceTransformUpdate(GameObject *obj);
+        void UpdateTransforms();
+        void UpdateTransformRecursive(GameObject *obj, const glm::mat4 &parentWorld);
+        void FlushChanges();
+        std::vector<Component *> &GetTickList(Component *component);
+
+        void AddObject(GameObject *obj, GameObject *parent);
+        bool ApplySetParent(GameObject *obj, GameObject *parent);
+        void RecordCommand(CommandType type, GameObject *obj, GameObject *parent, Component *component = nullptr);
+        void ApplyCommands();
+        void SweepDestroyed(std::vector<std::unique_ptr<GameObject>> &objects);
+        void CollectMeshes(GameObject *obj, bool staticOnly, std::vector<MeshComponent *> &out);
 
     private:
         std::vector<std::unique_ptr<GameObject>>
             m_objects;
         GameObject *m_mainCamera = nullptr;
+
+        // Compact tick lists indexed by TickPhase. Entries are swap-removed,
+        // so the order inside a list is not stable.
+        static constexpr size_t kPhaseCount = static_cast<size_t>(TickPhase::Count);
+        std::vector<GameObject *> m_tickObjects;
+        std::array<std::vector<Component *>, kPhaseCount> m_serialComponents;
+        std::array<std::vector<Component *>, kPhaseCount> m_parallelComponents;
+
+        bool m_updating = false;
+        bool m_needsSweep = false;
+        std::atomic<uint64_t> m_commandSequence{0};
+        // One bucket per job system thread, see JobSystem::GetThreadIndex.
+        std::vector<std::vector<SceneCommand>> m_commandBuckets;
+        std::vector<SceneCommand> m_pendingCommands;
+        std::vector<std::vector<GameObject *>> m_transformBuckets;
+
+        HandleArray<LightData> m_lights;
+        StaticBatcher m_staticBatcher;
     };
 
 }
\ No newline at end of file
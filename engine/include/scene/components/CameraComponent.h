@@ -12,11 +12,14 @@ namespace eng
         COMPONENT(CameraComponent)
 
     public:
-        void Update(float DeltaTime) override;
-
         glm::mat4 GetViewMatrix() const;
         glm::mat4 GetProjectionMatrix(float aspect) const;
 
+        // Vertical, in degrees
+        float GetFov() const;
+        float GetNearPlane() const;
+        float GetFarPlane() const;
+
     private:
         float m_fov = 60.f;
         float m_nearPlane = 0.1f;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "scene/Component.h"
+#include "scene/Scene.h"
 
 #include <glm/vec3.hpp>
 
@@ -12,13 +13,31 @@ namespace eng
         COMPONENT(LightComponent)
 
     public:
-        void Update(float DeltaTime) override;
+        ~LightComponent() override;
 
         void SetColor(const glm::vec3 &color);
         const glm::vec3 &GetColor() const;
 
+        // Light has no influence beyond radius (world units)
+        void SetRadius(float radius);
+        float GetRadius() const;
+
+        void SetIntensity(float intensity);
+        float GetIntensity() const;
+
+        // Registers with the owner's Scene on the first resolve, then keeps the entry in sync.
+        void OnTransformChanged() override;
+
+    private:
+        void SyncLight();
+
     private:
         glm::vec3 m_color = glm::vec3(1.f);
+        float m_radius = 10.f;
+        float m_intensity = 1.f;
+
+        Scene *m_scene = nullptr;
+        Scene::LightHandle m_light = HandleArray<LightData>::kInvalid;
     };
 
 }
\ No newline at end of file
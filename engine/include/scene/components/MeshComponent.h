@@ -1,6 +1,7 @@
 #pragma once
 
 #include "scene/Component.h"
+#include "render/RenderScene.h"
 
 #include <memory>
 
@@ -8,6 +9,8 @@ namespace eng
 {
     class Material;
     class Mesh;
+    class StaticBatcher;
+    struct Imposter;
 
     class MeshComponent : public Component
     {
@@ -15,11 +18,57 @@ namespace eng
 
     public:
         MeshComponent(const std::shared_ptr<Material> &material, const std::shared_ptr<Mesh> &mesh);
-        void Update(float DeltaTime) override;
+        ~MeshComponent() override;
+
+        // Keeps the RenderScene proxy in sync. Only meshes with LODs tick, to pick one.
+        void OnTransformChanged() override;
+        void Update(float deltaTime) override;
+        TickPhase GetTickPhase() const override { return TickPhase::RenderExtract; }
+
+        const std::shared_ptr<Material> &GetMaterial() const { return m_material; }
+        const std::shared_ptr<Mesh> &GetMesh() const { return m_mesh; }
+
+        // Set by the StaticBatcher once the geometry lives in one of its batches:
+        // the component drops its own proxy. Destroying it empties its range,
+        // moving it takes it out of the batch again with a warning.
+        void SetBatched(StaticBatcher *batcher);
+        bool IsBatched() const { return m_batcher != nullptr; }
+
+        // Occluders are rasterized into the CPU occlusion buffer and hide other
+        // proxies behind them. Best used on large, simple meshes (walls, terrain).
+        void SetOccluder(bool occluder);
+        bool IsOccluder() const { return m_occluder; }
+
+        // Coarser levels are used once their simplification error, projected
+        // with the bounding sphere, stays under kLodErrorThreshold of half the
+        // screen height. Refining happens at the threshold, coarsening only
+        // below kLodHysteresis of it, so objects near a switch distance do not pop.
+        static constexpr float kLodErrorThreshold = 0.003f;
+        static constexpr float kLodHysteresis = 0.75f;
+        static constexpr float kLodTickRate = 15.f;
+
+        uint32_t GetLod() const { return m_lod; }
+
+        // Past this distance from the camera the mesh is replaced by a quad
+        // sampling its baked imposter atlas, see ImposterRenderer. Baked here,
+        // or later if the texture is not resident yet. Switches back below
+        // kLodHysteresis of it; 0 disables.
+        void SetImposterDistance(float distance);
+        float GetImposterDistance() const { return m_imposterDistance; }
+        bool IsImposter() const { return m_imposter != nullptr; }
+
+    private:
+        uint32_t SelectLod(float screenSize) const;
 
     private:
         std::shared_ptr<Material> m_material;
         std::shared_ptr<Mesh> m_mesh;
+        RenderScene::ProxyHandle m_proxy = RenderScene::kInvalidProxy;
+        StaticBatcher *m_batcher = nullptr;
+        bool m_occluder = false;
+        uint32_t m_lod = 0;
+        float m_imposterDistance = 0.f;
+        const Imposter *m_imposter = nullptr;
     };
 
 }
\ No newline at end of file
@@ -9,6 +9,7 @@ namespace eng
     {
         COMPONENT(PlayerControllerComponent)
     public:
+        PlayerControllerComponent();
         void Update(float DeltaTime) override;
 
     private:
@@ -11,6 +11,12 @@
 
 #include <glm/mat4x4.hpp>
 
+#include "render/ClusteredLighting.h"
+#include "render/HiZPyramid.h"
+#include "render/ImposterRenderer.h"
+#include "render/IndirectRenderer.h"
+#include "render/VirtualTexturing.h"
+
 namespace eng
 {
     class ShaderProgram;
@@ -42,10 +48,17 @@ namespace eng
         VkExtent2D extent() const { return m_extent; }
 
         VkFormat depthFormat() const { return m_depthFormat; }
+        VkImage depthImage() const { return m_depthImage; }
+        VkImageView depthView() const { return m_depthView; }
+        // Depth can be read by the Hi-Z pass
+        bool depthSampleable() const { return m_depthSampleable; }
+        VkSampleCountFlagBits msaaSamples() const { return m_msaaSamples; }
 
         size_t imageCount() const { return m_images.size(); }
         VkFramebuffer framebuffer(size_t i) const { return m_framebuffers[i]; }
         VkRenderPass renderPass() const { return m_renderPass; }
+        // Compatible with renderPass() but loads color/depth, for a second pass in the same frame
+        VkRenderPass renderPassLoad() const { return m_renderPassLoad; }
 
         static bool hasAdequateSupport(VkPhysicalDevice gpu, VkSurfaceKHR surface);
 
@@ -62,7 +75,7 @@ namespace eng
         static VkPresentModeKHR choosePresentMode(const std::vector<VkPresentModeKHR> &modes);
         static VkExtent2D chooseExtent(const VkSurfaceCapabilitiesKHR &caps, SDL_Window *window);
 
-        static VkFormat findSupportedDepthFormat(VkPhysicalDevice gpu);
+        static VkFormat findSupportedDepthFormat(VkPhysicalDevice gpu, bool &outSampleable);
 
         void createImageViews();
         void createDepthResources();
@@ -99,7 +112,9 @@ namespace eng
         VkImageView m_depthView = VK_NULL_HANDLE;
 
         VkRenderPass m_renderPass = VK_NULL_HANDLE;
+        VkRenderPass m_renderPassLoad = VK_NULL_HANDLE;
         std::vector<VkFramebuffer> m_framebuffers;
+        bool m_depthSampleable = false;
 
         VkSampleCountFlagBits m_msaaSamples = VK_SAMPLE_COUNT_1_BIT;
     };
@@ -179,6 +194,7 @@ namespace eng
         VkDevice GetDevice() const { return m_device; }
         VkPhysicalDevice GetGPU() const { return m_gpu; }
         VkQueue GetGraphicsQueue() const { return m_graphicsQueue; }
+        uint32_t GetGraphicsQueueFamily() const { return m_qGraphics; }
         VkCommandPool GetCommandPool() const { return m_cmdPool.handle(); }
 
         VkRenderPass GetRenderPass() const { return m_swapchain.renderPass(); }
@@ -189,6 +205,16 @@ namespace eng
 
         VkDescriptorSetLayout GetTextureSetLayout() const { return m_textureSetLayout; }
         VkDescriptorSet CreateTextureSet(VkImageView view, VkSampler sampler);
+        void FreeTextureSet(VkDescriptorSet set);
+
+        VkDescriptorSetLayout GetLightSetLayout() const { return m_lightSetLayout; }
+        VkDescriptorSet CurrentLightSet() const { return m_lightSets[m_sync.frameIndex()]; }
+
+        VkDescriptorSetLayout GetObjectSetLayout() const { return m_indirectRenderer.GetObjectSetLayout(); }
+        IndirectRenderer &GetIndirectRenderer() { return m_indirectRenderer; }
+        bool IsVertexPullingSupported() const { return m_vertexPullingSupported; }
+        ImposterRenderer &GetImposterRenderer() { return m_imposters; }
+        VirtualTextureSystem &GetVirtualTextures() { return m_virtualTextures; }
 
         VkSampleCountFlagBits GetMsaaSamples() const { return m_msaaSamples; }
 
@@ -206,6 +232,15 @@ namespace eng
             glm::mat4 proj{1.0f};
         };
 
+        // set=2: 0 params UBO, 1 lights, 2 clusters, 3 light indices (SSBOs)
+        static constexpr uint32_t kLightBindingCount = 4;
+        struct LightFrameBuffers
+        {
+            VkBuffer buffers[kLightBindingCount]{};
+            VkDeviceMemory memories[kLightBindingCount]{};
+            void *mapped[kLightBindingCount]{};
+        };
+
     private:
         void createInstance(SDL_Window *window);
         void setupDebugMessenger();
@@ -232,6 +267,10 @@ namespace eng
         void createTextureDescriptors();
         void destroyTextureDescriptors();
 
+        void createLightBuffers();
+        void destroyLightBuffers();
+        void updateLightBuffers();
+
     private:
 #ifndef NDEBUG
         static constexpr bool kEnableValidation = true;
@@ -276,6 +315,25 @@ namespace eng
         VkDescriptorSetLayout m_textureSetLayout = VK_NULL_HANDLE;
         VkDescriptorPool m_textureDescPool = VK_NULL_HANDLE;
 
+        // Clustered lighting: set=2, one set and buffer group per frame in flight
+        VkDescriptorSetLayout m_lightSetLayout = VK_NULL_HANDLE;
+        VkDescriptorPool m_lightDescPool = VK_NULL_HANDLE;
+        std::vector<VkDescriptorSet> m_lightSets;
+        std::vector<LightFrameBuffers> m_lightFrames;
+        ClusteredLighting m_clusteredLighting;
+
+        IndirectRenderer m_indirectRenderer;
+        // Built from the early depth each frame when occlusion culling is on
+        HiZPyramid m_hiz;
+        ImposterRenderer m_imposters;
+        VirtualTextureSystem m_virtualTextures;
+        // drawIndirectCount + multiDrawIndirect + drawIndirectFirstInstance
+        bool m_gpuDrivenSupported = false;
+        // GPU driven path + bufferDeviceAddress for vertex fetch in shaders
+        bool m_vertexPullingSupported = false;
+        // Needed by VirtualTextureSystem
+        bool m_fragmentStoresSupported = false;
+
         VkSampleCountFlagBits m_msaaSamples = VK_SAMPLE_COUNT_1_BIT;
     };
 
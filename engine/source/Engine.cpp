@@ -65,6 +65,9 @@ namespace eng
             return false;
         }
 
+        m_jobSystem.Init();
+        m_renderQueue.Init(m_jobSystem.GetThreadCount());
+
         if (!SDL_Init(SDL_INIT_VIDEO))
         {
             SDL_Log("SDL_Init failed: %s", SDL_GetError());
@@ -122,20 +125,57 @@ namespace eng
                 }
             }
 
+            m_jobSystem.ProcessMainThreadJobs();
+
             auto now = std::chrono::high_resolution_clock::now();
             float deltaTime = std::chrono::duration<float>(now - m_lastTimePoint).count();
             m_lastTimePoint = now;
 
             m_application->Update(deltaTime);
+            m_textureManager.Update();
 
             m_vulkanContext.drawFrame(m_window, resized);
             m_inputManager.SetMousePositionOld(m_inputManager.GetMousePositionCurrent());
             resized = false;
+
+            m_statsTime += deltaTime;
+            ++m_statsFrames;
+            if (m_statsTime >= kStatsInterval)
+            {
+                LogStats();
+                m_statsTime = 0.f;
+                m_statsFrames = 0;
+            }
         }
 
         m_vulkanContext.waitIdle();
     }
 
+    void Engine::LogStats()
+    {
+        SDL_Log("Frame: %.1f fps, %.2f ms", m_statsFrames / m_statsTime, 1000.f * m_statsTime / m_statsFrames);
+
+        auto &indirect = m_vulkanContext.GetIndirectRenderer();
+        if (indirect.IsEnabled())
+        {
+            const auto &gpu = indirect.GetStats();
+            SDL_Log("GPU culling: %u in frustum, %u drawn early, %u drawn late, %u occluded",
+                    gpu.frustumVisible, gpu.drawnEarly, gpu.drawnLate, gpu.occluded);
+        }
+
+        const auto &cpu = m_renderQueue.GetOcclusionStats();
+        if (cpu.occluders > 0)
+        {
+            SDL_Log("CPU occlusion: %u occluders, %u triangles, %u of %u culled, raster %.2f ms, test %.2f ms",
+                    cpu.occluders, cpu.triangles, cpu.culled, cpu.tested, cpu.rasterMs, cpu.testMs);
+        }
+
+        const auto &streaming = m_textureManager.GetStreamer().GetStats();
+        SDL_Log("Texture streaming: %u textures, %.1f / %.1f MB resident / requested, %u in and %u out last frame",
+                streaming.textures, streaming.residentBytes / (1024.0 * 1024.0), streaming.requestedBytes / (1024.0 * 1024.0),
+                streaming.streamedIn, streaming.streamedOut);
+    }
+
     void Engine::Destroy()
     {
         if (m_application)
@@ -145,6 +185,9 @@ namespace eng
         }
 
         m_vulkanContext.waitIdle();
+        m_textureManager.Destroy();
+        m_jobSystem.Shutdown();
+
         m_graphicsAPI.DestroyBuffers();
 
         if (m_window)
@@ -186,6 +229,11 @@ namespace eng
         return m_renderQueue;
     }
 
+    RenderScene &Engine::GetRenderScene()
+    {
+        return m_renderScene;
+    }
+
     FileSystem &Engine::GetFileSystem()
     {
         return m_fileSystem;
@@ -196,6 +244,11 @@ namespace eng
         return m_textureManager;
     }
 
+    JobSystem &Engine::GetJobSystem()
+    {
+        return m_jobSystem;
+    }
+
     void Engine::SetScene(Scene *scene)
     {
         m_currentScene.reset(scene);
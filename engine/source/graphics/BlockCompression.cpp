@@ -0,0 +1,1294 @@
+#include "graphics/BlockCompression.h"
+
+#include "jobs/JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+namespace eng
+{
+    // Partition of every texel, bit i (2 subsets) or bits 2i..2i+1 (3 subsets)
+    static constexpr uint16_t kBc7Partitions2[64] = {
+        0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+        0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+        0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+        0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+        0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+        0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+        0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+        0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22};
+
+    static constexpr uint32_t kBc7Partitions3[64] = {
+        0xAA685050, 0x6A5A5040, 0x5A5A4200, 0x5450A0A8, 0xA5A50000, 0xA0A05050, 0x5555A0A0, 0x5A5A5050,
+        0xAA550000, 0xAA555500, 0xAAAA5500, 0x90909090, 0x94949494, 0xA4A4A4A4, 0xA9A59450, 0x2A0A4250,
+        0xA5945040, 0x0A425054, 0xA5A5A500, 0x55A0A0A0, 0xA8A85454, 0x6A6A4040, 0xA4A45000, 0x1A1A0500,
+        0x0050A4A4, 0xAAA59090, 0x14696914, 0x69691400, 0xA08585A0, 0xAA821414, 0x50A4A450, 0x6A5A0200,
+        0xA9A58000, 0x5090A0A8, 0xA8A09050, 0x24242424, 0x00AA5500, 0x24924924, 0x24499224, 0x50A50A50,
+        0x500AA550, 0xAAAA4444, 0x66660000, 0xA5A0A5A0, 0x50A050A0, 0x69286928, 0x44AAAA44, 0x66666600,
+        0xAA444444, 0x54A854A8, 0x95809580, 0x96969600, 0xA85454A8, 0x80959580, 0xAA141414, 0x96960000,
+        0xAAAA1414, 0xA05050A0, 0xA0A5A5A0, 0x96000000, 0x40804080, 0xA9A8A9A8, 0xAAAAAA44, 0x2A4A5254};
+
+    // Texel whose index drops its top bit, for subset 1 (and 2)
+    static constexpr uint8_t kBc7Anchor2[64] = {
+        15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+        15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+        15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6,
+        6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15};
+
+    static constexpr uint8_t kBc7Anchor3a[64] = {
+        3, 3, 15, 15, 8, 3, 15, 15, 8, 8, 6, 6, 6, 5, 3, 3,
+        3, 3, 8, 15, 3, 3, 6, 10, 5, 8, 8, 6, 8, 5, 15, 15,
+        8, 15, 3, 5, 6, 10, 8, 15, 15, 3, 15, 5, 15, 15, 15, 15,
+        3, 15, 5, 5, 5, 8, 5, 10, 5, 10, 8, 13, 15, 12, 3, 3};
+
+    static constexpr uint8_t kBc7Anchor3b[64] = {
+        15, 8, 8, 3, 15, 15, 3, 8, 15, 15, 15, 15, 15, 15, 15, 8,
+        15, 8, 15, 3, 15, 8, 15, 8, 3, 15, 6, 10, 15, 15, 10, 8,
+        15, 3, 15, 10, 10, 8, 9, 10, 6, 15, 8, 15, 3, 6, 6, 8,
+        15, 3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 3, 15, 15, 8};
+
+    static constexpr uint8_t kBc7Weights2[4] = {0, 21, 43, 64};
+    static constexpr uint8_t kBc7Weights3[8] = {0, 9, 18, 27, 37, 46, 55, 64};
+    static constexpr uint8_t kBc7Weights4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    struct Bc7Mode
+    {
+        uint8_t subsets;
+        uint8_t partitionBits;
+        uint8_t rotationBits;
+        uint8_t indexSelectionBits;
+        uint8_t colorBits;
+        uint8_t alphaBits;
+        uint8_t endpointPBits;
+        uint8_t sharedPBits;
+        uint8_t indexBits;
+        uint8_t indexBits2;
+    };
+
+    static constexpr Bc7Mode kBc7Modes[8] = {
+        {3, 4, 0, 0, 4, 0, 1, 0, 3, 0},
+        {2, 6, 0, 0, 6, 0, 0, 1, 3, 0},
+        {3, 6, 0, 0, 5, 0, 0, 0, 2, 0},
+        {2, 6, 0, 0, 7, 0, 1, 0, 2, 0},
+        {1, 0, 2, 1, 5, 6, 0, 0, 2, 3},
+        {1, 0, 2, 0, 7, 8, 0, 0, 2, 2},
+        {1, 0, 0, 0, 7, 7, 1, 0, 4, 0},
+        {2, 6, 0, 0, 5, 5, 1, 0, 2, 0}};
+
+    struct BlockBitReader
+    {
+        const uint8_t *data;
+        uint32_t pos = 0;
+
+        uint32_t Read(uint32_t count)
+        {
+            uint32_t value = 0;
+            for (uint32_t i = 0; i < count; ++i, ++pos)
+                value |= (uint32_t)((data[pos >> 3] >> (pos & 7)) & 1) << i;
+            return value;
+        }
+    };
+
+    static void Expand565(uint16_t c, uint8_t *rgb)
+    {
+        const uint32_t r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+        rgb[0] = (uint8_t)(r << 3 | r >> 2);
+        rgb[1] = (uint8_t)(g << 2 | g >> 4);
+        rgb[2] = (uint8_t)(b << 3 | b >> 2);
+    }
+
+    // BC1 color block; BC2/BC3 always use the four color mode
+    static void DecodeColorBlock(const uint8_t *block, uint8_t *rgba, bool allowPunchThrough)
+    {
+        uint16_t c0, c1;
+        uint32_t indices;
+        std::memcpy(&c0, block, 2);
+        std::memcpy(&c1, block + 2, 2);
+        std::memcpy(&indices, block + 4, 4);
+
+        uint8_t palette[4][4];
+        Expand565(c0, palette[0]);
+        Expand565(c1, palette[1]);
+        palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+
+        for (int ch = 0; ch < 3; ++ch)
+        {
+            if (c0 > c1 || !allowPunchThrough)
+            {
+                palette[2][ch] = (uint8_t)((2 * palette[0][ch] + palette[1][ch]) / 3);
+                palette[3][ch] = (uint8_t)((palette[0][ch] + 2 * palette[1][ch]) / 3);
+            }
+            else
+            {
+                palette[2][ch] = (uint8_t)((palette[0][ch] + palette[1][ch]) / 2);
+                palette[3][ch] = 0;
+            }
+        }
+        if (c0 <= c1 && allowPunchThrough)
+            palette[3][3] = 0;
+
+        for (int i = 0; i < 16; ++i)
+            std::memcpy(rgba + i * 4, palette[(indices >> (2 * i)) & 3], 4);
+    }
+
+    // BC3 alpha / BC4 / BC5 channel block, written to one channel of rgba
+    static void DecodeChannelBlock(const uint8_t *block, uint8_t *rgba, int channel)
+    {
+        const uint32_t a0 = block[0], a1 = block[1];
+        uint8_t palette[8];
+        palette[0] = (uint8_t)a0;
+        palette[1] = (uint8_t)a1;
+        if (a0 > a1)
+        {
+            for (uint32_t i = 1; i < 7; ++i)
+                palette[i + 1] = (uint8_t)(((7 - i) * a0 + i * a1) / 7);
+        }
+        else
+        {
+            for (uint32_t i = 1; i < 5; ++i)
+                palette[i + 1] = (uint8_t)(((5 - i) * a0 + i * a1) / 5);
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+
+        uint64_t indices = 0;
+        for (int i = 0; i < 6; ++i)
+            indices |= (uint64_t)block[2 + i] << (8 * i);
+
+        for (int i = 0; i < 16; ++i)
+            rgba[i * 4 + channel] = palette[(indices >> (3 * i)) & 7];
+    }
+
+    void DecodeBC1Block(const uint8_t *block, uint8_t *rgba)
+    {
+        DecodeColorBlock(block, rgba, true);
+    }
+
+    void DecodeBC3Block(const uint8_t *block, uint8_t *rgba)
+    {
+        DecodeColorBlock(block + 8, rgba, false);
+        DecodeChannelBlock(block, rgba, 3);
+    }
+
+    void DecodeBC4Block(const uint8_t *block, uint8_t *rgba)
+    {
+        for (int i = 0; i < 16; ++i)
+        {
+            rgba[i * 4 + 1] = rgba[i * 4 + 2] = 0;
+            rgba[i * 4 + 3] = 255;
+        }
+        DecodeChannelBlock(block, rgba, 0);
+    }
+
+    void DecodeBC5Block(const uint8_t *block, uint8_t *rgba)
+    {
+        for (int i = 0; i < 16; ++i)
+        {
+            rgba[i * 4 + 2] = 0;
+            rgba[i * 4 + 3] = 255;
+        }
+        DecodeChannelBlock(block, rgba, 0);
+        DecodeChannelBlock(block + 8, rgba, 1);
+    }
+
+    void DecodeBC7Block(const uint8_t *block, uint8_t *rgba)
+    {
+        BlockBitReader bits{block};
+
+        uint32_t mode = 0;
+        while (mode < 8 && bits.Read(1) == 0)
+            ++mode;
+        if (mode == 8)
+        {
+            // Reserved mode, decodes to transparent black
+            std::memset(rgba, 0, 64);
+            return;
+        }
+
+        const Bc7Mode &m = kBc7Modes[mode];
+        const uint32_t partition = bits.Read(m.partitionBits);
+        const uint32_t rotation = bits.Read(m.rotationBits);
+        const uint32_t indexSelection = bits.Read(m.indexSelectionBits);
+
+        // [subset][endpoint][channel]
+        uint32_t endpoints[3][2][4]{};
+        for (int ch = 0; ch < 3; ++ch)
+            for (uint32_t s = 0; s < m.subsets; ++s)
+                for (int e = 0; e < 2; ++e)
+                    endpoints[s][e][ch] = bits.Read(m.colorBits);
+        if (m.alphaBits)
+        {
+            for (uint32_t s = 0; s < m.subsets; ++s)
+                for (int e = 0; e < 2; ++e)
+                    endpoints[s][e][3] = bits.Read(m.alphaBits);
+        }
+
+        const uint32_t pBit = m.endpointPBits | m.sharedPBits;
+        if (m.endpointPBits)
+        {
+            for (uint32_t s = 0; s < m.subsets; ++s)
+                for (int e = 0; e < 2; ++e)
+                {
+                    const uint32_t p = bits.Read(1);
+                    for (int ch = 0; ch < 4; ++ch)
+                        endpoints[s][e][ch] = endpoints[s][e][ch] << 1 | p;
+                }
+        }
+        else if (m.sharedPBits)
+        {
+            for (uint32_t s = 0; s < m.subsets; ++s)
+            {
+                const uint32_t p = bits.Read(1);
+                for (int e = 0; e < 2; ++e)
+                    for (int ch = 0; ch < 4; ++ch)
+                        endpoints[s][e][ch] = endpoints[s][e][ch] << 1 | p;
+            }
+        }
+
+        const uint32_t colorPrecision = m.colorBits + pBit;
+        const uint32_t alphaPrecision = m.alphaBits ? m.alphaBits + pBit : 0;
+        for (uint32_t s = 0; s < m.subsets; ++s)
+            for (int e = 0; e < 2; ++e)
+                for (int ch = 0; ch < 4; ++ch)
+                {
+                    const uint32_t precision = ch < 3 ? colorPrecision : alphaPrecision;
+                    uint32_t &v = endpoints[s][e][ch];
+                    if (precision == 0)
+                        v = 255;
+                    else
+                    {
+                        v <<= 8 - precision;
+                        v |= v >> precision;
+                    }
+                }
+
+        auto subsetOf = [&](uint32_t texel) -> uint32_t
+        {
+            if (m.subsets == 2)
+                return (kBc7Partitions2[partition] >> texel) & 1;
+            if (m.subsets == 3)
+                return (kBc7Partitions3[partition] >> (2 * texel)) & 3;
+            return 0;
+        };
+        auto isAnchor = [&](uint32_t texel)
+        {
+            if (texel == 0)
+                return true;
+            if (m.subsets == 2)
+                return texel == kBc7Anchor2[partition];
+            if (m.subsets == 3)
+                return texel == kBc7Anchor3a[partition] || texel == kBc7Anchor3b[partition];
+            return false;
+        };
+
+        uint32_t indices[16], indices2[16]{};
+        for (uint32_t i = 0; i < 16; ++i)
+            indices[i] = bits.Read(m.indexBits - (isAnchor(i) ? 1 : 0));
+        if (m.indexBits2)
+        {
+            for (uint32_t i = 0; i < 16; ++i)
+                indices2[i] = bits.Read(m.indexBits2 - (i == 0 ? 1 : 0));
+        }
+
+        auto weight = [](uint32_t indexBits, uint32_t index) -> uint32_t
+        {
+            return indexBits == 2 ? kBc7Weights2[index] : indexBits == 3 ? kBc7Weights3[index]
+                                                                         : kBc7Weights4[index];
+        };
+
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            const uint32_t s = subsetOf(i);
+            uint32_t colorWeight = weight(m.indexBits, indices[i]);
+            uint32_t alphaWeight = colorWeight;
+            if (m.indexBits2)
+            {
+                alphaWeight = weight(m.indexBits2, indices2[i]);
+                if (indexSelection)
+                    std::swap(colorWeight, alphaWeight);
+            }
+
+            uint8_t *texel = rgba + i * 4;
+            for (int ch = 0; ch < 4; ++ch)
+            {
+                const uint32_t w = ch < 3 ? colorWeight : alphaWeight;
+                texel[ch] = (uint8_t)(((64 - w) * endpoints[s][0][ch] + w * endpoints[s][1][ch] + 32) >> 6);
+            }
+
+            if (rotation)
+                std::swap(texel[3], texel[rotation - 1]);
+        }
+    }
+
+    bool DecodeBlock(VkFormat format, const uint8_t *block, uint8_t *rgba)
+    {
+        switch (format)
+        {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+            DecodeBC1Block(block, rgba);
+            return true;
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+            DecodeBC3Block(block, rgba);
+            return true;
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+            DecodeBC4Block(block, rgba);
+            return true;
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+            DecodeBC5Block(block, rgba);
+            return true;
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            DecodeBC7Block(block, rgba);
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    bool DecompressTexture(const TextureImage &in, TextureImage &out)
+    {
+        const uint32_t blockBytes = FormatBlockBytes(in.format);
+        uint8_t probe[64];
+        if (!IsBlockCompressed(in.format) || in.data.size() < blockBytes || !DecodeBlock(in.format, in.data.data(), probe))
+            return false;
+
+        out.format = IsSrgbFormat(in.format) ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+        out.width = in.width;
+        out.height = in.height;
+        out.levels.resize(in.levels.size());
+
+        size_t total = 0;
+        for (size_t i = 0; i < in.levels.size(); ++i)
+        {
+            out.levels[i].width = in.levels[i].width;
+            out.levels[i].height = in.levels[i].height;
+            out.levels[i].size = TextureLevelSize(out.format, in.levels[i].width, in.levels[i].height);
+            out.levels[i].offset = total;
+            total += out.levels[i].size;
+        }
+        out.data.resize(total);
+
+        for (size_t l = 0; l < in.levels.size(); ++l)
+        {
+            const auto &src = in.levels[l];
+            const auto &dst = out.levels[l];
+            const uint32_t blocksX = (src.width + 3) / 4;
+            const uint32_t blocksY = (src.height + 3) / 4;
+
+            for (uint32_t by = 0; by < blocksY; ++by)
+            {
+                for (uint32_t bx = 0; bx < blocksX; ++bx)
+                {
+                    uint8_t texels[64];
+                    DecodeBlock(in.format, in.data.data() + src.offset + (by * blocksX + bx) * blockBytes, texels);
+
+                    // Edge blocks of small or odd sized levels hang over the image
+                    const uint32_t w = std::min(4u, src.width - bx * 4);
+                    const uint32_t h = std::min(4u, src.height - by * 4);
+                    for (uint32_t y = 0; y < h; ++y)
+                    {
+                        uint8_t *row = out.data.data() + dst.offset + ((size_t)(by * 4 + y) * dst.width + bx * 4) * 4;
+                        std::memcpy(row, texels + y * 16, w * 4);
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    // Encoders. The index search is written once over these wrappers and
+    // runs 8, 4 or 1 texels at a time depending on ENGINE_SIMD.
+    namespace
+    {
+        namespace simd
+        {
+#if defined(__AVX2__)
+            constexpr uint32_t kLanes = 8;
+            constexpr const char *kName = "AVX2";
+            using VecF = __m256;
+
+            inline VecF SetF(float v) { return _mm256_set1_ps(v); }
+            inline VecF LoadF(const float *p) { return _mm256_load_ps(p); }
+            inline void StoreF(float *p, VecF v) { _mm256_store_ps(p, v); }
+            inline VecF SubF(VecF a, VecF b) { return _mm256_sub_ps(a, b); }
+            inline VecF MulF(VecF a, VecF b) { return _mm256_mul_ps(a, b); }
+            inline VecF AddF(VecF a, VecF b) { return _mm256_add_ps(a, b); }
+            inline VecF LessF(VecF a, VecF b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+            inline VecF Select(VecF a, VecF b, VecF mask) { return _mm256_blendv_ps(a, b, mask); }
+#elif defined(__SSE4_1__)
+            constexpr uint32_t kLanes = 4;
+            constexpr const char *kName = "SSE4.1";
+            using VecF = __m128;
+
+            inline VecF SetF(float v) { return _mm_set1_ps(v); }
+            inline VecF LoadF(const float *p) { return _mm_load_ps(p); }
+            inline void StoreF(float *p, VecF v) { _mm_store_ps(p, v); }
+            inline VecF SubF(VecF a, VecF b) { return _mm_sub_ps(a, b); }
+            inline VecF MulF(VecF a, VecF b) { return _mm_mul_ps(a, b); }
+            inline VecF AddF(VecF a, VecF b) { return _mm_add_ps(a, b); }
+            inline VecF LessF(VecF a, VecF b) { return _mm_cmplt_ps(a, b); }
+            inline VecF Select(VecF a, VecF b, VecF mask) { return _mm_blendv_ps(a, b, mask); }
+#else
+            constexpr uint32_t kLanes = 1;
+            constexpr const char *kName = "scalar";
+            using VecF = float;
+
+            inline VecF SetF(float v) { return v; }
+            inline VecF LoadF(const float *p) { return *p; }
+            inline void StoreF(float *p, VecF v) { *p = v; }
+            inline VecF SubF(VecF a, VecF b) { return a - b; }
+            inline VecF MulF(VecF a, VecF b) { return a * b; }
+            inline VecF AddF(VecF a, VecF b) { return a + b; }
+            inline VecF LessF(VecF a, VecF b) { return a < b ? 1.f : 0.f; }
+            inline VecF Select(VecF a, VecF b, VecF mask) { return mask != 0.f ? b : a; }
+#endif
+        }
+    }
+
+    const char *const kBlockEncoderSimdName = simd::kName;
+
+    // One 4x4 block split into channels, values 0..255
+    struct TexelBlock
+    {
+        alignas(32) float channels[4][16];
+    };
+
+    static void LoadTexelBlock(const uint8_t *rgba, TexelBlock &out)
+    {
+        for (int i = 0; i < 16; ++i)
+            for (int ch = 0; ch < 4; ++ch)
+                out.channels[ch][i] = rgba[i * 4 + ch];
+    }
+
+    // Nearest palette entry of every texel by weighted squared distance.
+    // Returns the error summed over the texels in mask.
+    static float SelectIndices(const TexelBlock &block, const float (*palette)[4], uint32_t count, const float *weights, uint32_t mask, uint8_t *indices)
+    {
+        alignas(32) float bestError[16];
+        alignas(32) float bestIndex[16];
+
+        const simd::VecF w[4] = {simd::SetF(weights[0]), simd::SetF(weights[1]), simd::SetF(weights[2]), simd::SetF(weights[3])};
+        for (uint32_t i = 0; i < 16; i += simd::kLanes)
+        {
+            simd::VecF texel[4];
+            for (int ch = 0; ch < 4; ++ch)
+                texel[ch] = simd::LoadF(block.channels[ch] + i);
+
+            simd::VecF best = simd::SetF(std::numeric_limits<float>::max());
+            simd::VecF index = simd::SetF(0.f);
+            for (uint32_t p = 0; p < count; ++p)
+            {
+                simd::VecF error = simd::SetF(0.f);
+                for (int ch = 0; ch < 4; ++ch)
+                {
+                    const simd::VecF d = simd::SubF(texel[ch], simd::SetF(palette[p][ch]));
+                    error = simd::AddF(error, simd::MulF(simd::MulF(d, d), w[ch]));
+                }
+                const simd::VecF closer = simd::LessF(error, best);
+                best = simd::Select(best, error, closer);
+                index = simd::Select(index, simd::SetF((float)p), closer);
+            }
+            simd::StoreF(bestError + i, best);
+            simd::StoreF(bestIndex + i, index);
+        }
+
+        float total = 0.f;
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            indices[i] = (uint8_t)bestIndex[i];
+            if (mask >> i & 1)
+                total += bestError[i];
+        }
+        return total;
+    }
+
+    // Largest eigenvalue of a symmetric matrix and its unit eigenvector, by
+    // power iteration from the row of the largest diagonal entry
+    static float DominantEigenvector(const float (*matrix)[4], uint32_t size, int iterations, float *vector)
+    {
+        uint32_t largest = 0;
+        for (uint32_t a = 1; a < size; ++a)
+            if (matrix[a][a] > matrix[largest][largest])
+                largest = a;
+
+        float v[4]{};
+        for (uint32_t a = 0; a < size; ++a)
+            v[a] = matrix[largest][a];
+        for (int iteration = 0; iteration < iterations; ++iteration)
+        {
+            float next[4]{};
+            float scale = 0.f;
+            for (uint32_t a = 0; a < size; ++a)
+            {
+                for (uint32_t b = 0; b < size; ++b)
+                    next[a] += matrix[a][b] * v[b];
+                scale = std::max(scale, std::abs(next[a]));
+            }
+            if (scale <= 0.f)
+                return 0.f;
+            const float inverse = 1.f / scale;
+            for (uint32_t a = 0; a < size; ++a)
+                v[a] = next[a] * inverse;
+        }
+
+        float length = 0.f;
+        for (uint32_t a = 0; a < size; ++a)
+            length += v[a] * v[a];
+        length = std::sqrt(length);
+
+        float lambda = 0.f;
+        for (uint32_t a = 0; a < size; ++a)
+        {
+            vector[a] = v[a] / length;
+            for (uint32_t b = 0; b < size; ++b)
+                lambda += v[a] * matrix[a][b] * v[b];
+        }
+        return lambda / (length * length);
+    }
+
+    // Ends of the segment the texels in mask project onto, along their
+    // principal axis over channels [firstChannel, channelEnd)
+    static void FitEndpoints(const TexelBlock &block, uint32_t mask, uint32_t firstChannel, uint32_t channelEnd, float *e0, float *e1)
+    {
+        const uint32_t size = channelEnd - firstChannel;
+        const float *channels[4];
+        for (uint32_t a = 0; a < size; ++a)
+            channels[a] = block.channels[firstChannel + a];
+
+        float mean[4]{};
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            if (!(mask >> i & 1))
+                continue;
+            for (uint32_t a = 0; a < size; ++a)
+                mean[a] += channels[a][i];
+            ++count;
+        }
+        if (count == 0)
+            return;
+        for (uint32_t a = 0; a < size; ++a)
+            mean[a] /= (float)count;
+
+        float cov[4][4]{};
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            if (!(mask >> i & 1))
+                continue;
+            for (uint32_t a = 0; a < size; ++a)
+                for (uint32_t b = 0; b < size; ++b)
+                    cov[a][b] += (channels[a][i] - mean[a]) * (channels[b][i] - mean[b]);
+        }
+
+        float axis[4]{};
+        if (DominantEigenvector(cov, size, 6, axis) <= 0.f)
+        {
+            for (uint32_t a = 0; a < size; ++a)
+                e0[firstChannel + a] = e1[firstChannel + a] = mean[a];
+            return;
+        }
+
+        float lo = 0.f, hi = 0.f;
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            if (!(mask >> i & 1))
+                continue;
+            float t = 0.f;
+            for (uint32_t a = 0; a < size; ++a)
+                t += (channels[a][i] - mean[a]) * axis[a];
+            lo = std::min(lo, t);
+            hi = std::max(hi, t);
+        }
+        for (uint32_t a = 0; a < size; ++a)
+        {
+            e0[firstChannel + a] = std::clamp(mean[a] + axis[a] * lo, 0.f, 255.f);
+            e1[firstChannel + a] = std::clamp(mean[a] + axis[a] * hi, 0.f, 255.f);
+        }
+    }
+
+    // Texel count, RGB sums and sums of products of a set of texels. Subsets
+    // are ranked from these without touching the texels again.
+    struct ColorMoments
+    {
+        float count = 0.f;
+        float sum[3]{};
+        float products[3][3]{};
+
+        static ColorMoments Of(const TexelBlock &block, uint32_t texel)
+        {
+            ColorMoments result;
+            result.count = 1.f;
+            for (int a = 0; a < 3; ++a)
+            {
+                result.sum[a] = block.channels[a][texel];
+                for (int b = 0; b < 3; ++b)
+                    result.products[a][b] = block.channels[a][texel] * block.channels[b][texel];
+            }
+            return result;
+        }
+
+        ColorMoments &operator+=(const ColorMoments &other)
+        {
+            count += other.count;
+            for (int a = 0; a < 3; ++a)
+            {
+                sum[a] += other.sum[a];
+                for (int b = 0; b < 3; ++b)
+                    products[a][b] += other.products[a][b];
+            }
+            return *this;
+        }
+
+        ColorMoments operator-(const ColorMoments &other) const
+        {
+            ColorMoments result;
+            result.count = count - other.count;
+            for (int a = 0; a < 3; ++a)
+            {
+                result.sum[a] = sum[a] - other.sum[a];
+                for (int b = 0; b < 3; ++b)
+                    result.products[a][b] = products[a][b] - other.products[a][b];
+            }
+            return result;
+        }
+
+        // Summed squared distance of the texels to their best fit line
+        float LineError() const
+        {
+            if (count <= 0.f)
+                return 0.f;
+            float cov[4][4]{};
+            float trace = 0.f;
+            for (int a = 0; a < 3; ++a)
+            {
+                for (int b = 0; b < 3; ++b)
+                    cov[a][b] = products[a][b] - sum[a] * sum[b] / count;
+                trace += cov[a][a];
+            }
+            // Only ranks partitions, a rough eigenvalue does
+            float axis[4];
+            return std::max(trace - DominantEigenvector(cov, 3, 2, axis), 0.f);
+        }
+    };
+
+    // Least squares endpoints for fixed indices, over channels
+    // [firstChannel, channelEnd). weights[index] is the position of a
+    // palette entry between e0 (0) and e1 (1).
+    static bool RefineEndpoints(const TexelBlock &block, uint32_t mask, uint32_t firstChannel, uint32_t channelEnd, const uint8_t *indices, const float *weights, float *e0, float *e1)
+    {
+        float aa = 0.f, ab = 0.f, bb = 0.f;
+        float ax[4]{}, bx[4]{};
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            if (!(mask >> i & 1))
+                continue;
+            const float b = weights[indices[i]];
+            const float a = 1.f - b;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            for (uint32_t ch = firstChannel; ch < channelEnd; ++ch)
+            {
+                ax[ch] += a * block.channels[ch][i];
+                bx[ch] += b * block.channels[ch][i];
+            }
+        }
+
+        const float det = aa * bb - ab * ab;
+        if (std::abs(det) < 1e-6f)
+            return false;
+        for (uint32_t ch = firstChannel; ch < channelEnd; ++ch)
+        {
+            e0[ch] = std::clamp((bb * ax[ch] - ab * bx[ch]) / det, 0.f, 255.f);
+            e1[ch] = std::clamp((aa * bx[ch] - ab * ax[ch]) / det, 0.f, 255.f);
+        }
+        return true;
+    }
+
+    static uint16_t Quantize565(const float *rgb)
+    {
+        const auto r = (uint32_t)std::lround(rgb[0] * 31.f / 255.f);
+        const auto g = (uint32_t)std::lround(rgb[1] * 63.f / 255.f);
+        const auto b = (uint32_t)std::lround(rgb[2] * 31.f / 255.f);
+        return (uint16_t)(r << 11 | g << 5 | b);
+    }
+
+    // BC1 color block. Texels outside opaque get the transparent index of the
+    // three color mode, which allowPunchThrough must permit.
+    static void EncodeColorBlock(const TexelBlock &block, uint32_t opaque, bool allowPunchThrough, uint8_t *out)
+    {
+        static constexpr float kWeights[4] = {1.f, 1.f, 1.f, 0.f};
+        static constexpr float kFourColor[4] = {0.f, 1.f, 1.f / 3.f, 2.f / 3.f};
+        static constexpr float kThreeColor[4] = {0.f, 1.f, 0.5f, 0.f};
+
+        const bool threeColor = opaque != 0xFFFF;
+        if (opaque == 0)
+        {
+            std::memset(out, 0, 4);
+            std::memset(out + 4, 0xFF, 4);
+            return;
+        }
+
+        float bestError = std::numeric_limits<float>::max();
+        uint16_t bestC0 = 0, bestC1 = 0;
+        uint8_t bestIndices[16]{};
+
+        float e0[4]{}, e1[4]{};
+        FitEndpoints(block, opaque, 0, 3, e0, e1);
+
+        for (int iteration = 0; iteration < 3; ++iteration)
+        {
+            uint16_t c0 = Quantize565(e0), c1 = Quantize565(e1);
+            // The endpoint order selects the mode
+            if (threeColor ? c0 > c1 : c0 < c1)
+                std::swap(c0, c1);
+            const bool fourColor = c0 > c1 || !allowPunchThrough;
+
+            uint8_t rgb0[3], rgb1[3];
+            Expand565(c0, rgb0);
+            Expand565(c1, rgb1);
+            float palette[4][4]{};
+            for (int ch = 0; ch < 3; ++ch)
+            {
+                palette[0][ch] = rgb0[ch];
+                palette[1][ch] = rgb1[ch];
+                if (fourColor)
+                {
+                    palette[2][ch] = (float)((2 * rgb0[ch] + rgb1[ch]) / 3);
+                    palette[3][ch] = (float)((rgb0[ch] + 2 * rgb1[ch]) / 3);
+                }
+                else
+                    palette[2][ch] = (float)((rgb0[ch] + rgb1[ch]) / 2);
+            }
+
+            uint8_t indices[16];
+            const float error = SelectIndices(block, palette, fourColor ? 4 : 3, kWeights, opaque, indices);
+            if (error < bestError)
+            {
+                bestError = error;
+                bestC0 = c0;
+                bestC1 = c1;
+                std::memcpy(bestIndices, indices, 16);
+            }
+            else
+                break;
+
+            for (int ch = 0; ch < 3; ++ch)
+            {
+                e0[ch] = palette[0][ch];
+                e1[ch] = palette[1][ch];
+            }
+            if (error == 0.f || !RefineEndpoints(block, opaque, 0, 3, indices, fourColor ? kFourColor : kThreeColor, e0, e1))
+                break;
+        }
+
+        uint32_t bits = 0;
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            const uint32_t index = (opaque >> i & 1) ? bestIndices[i] : 3;
+            bits |= index << (2 * i);
+        }
+        std::memcpy(out, &bestC0, 2);
+        std::memcpy(out + 2, &bestC1, 2);
+        std::memcpy(out + 4, &bits, 4);
+    }
+
+    // BC3 alpha / BC4 / BC5 channel block from one channel of the block
+    static void EncodeChannelBlock(const TexelBlock &block, uint32_t channel, uint8_t *out)
+    {
+        static constexpr float kEightValues[8] = {0.f, 1.f, 1.f / 7, 2.f / 7, 3.f / 7, 4.f / 7, 5.f / 7, 6.f / 7};
+        static constexpr float kSixValues[8] = {0.f, 1.f, 1.f / 5, 2.f / 5, 3.f / 5, 4.f / 5, 0.f, 0.f};
+
+        float weights[4]{};
+        weights[channel] = 1.f;
+        const float *values = block.channels[channel];
+
+        float lo = 255.f, hi = 0.f, innerLo = 255.f, innerHi = 0.f;
+        for (int i = 0; i < 16; ++i)
+        {
+            lo = std::min(lo, values[i]);
+            hi = std::max(hi, values[i]);
+            if (values[i] > 0.f && values[i] < 255.f)
+            {
+                innerLo = std::min(innerLo, values[i]);
+                innerHi = std::max(innerHi, values[i]);
+            }
+        }
+
+        float bestError = std::numeric_limits<float>::max();
+        uint8_t bestA0 = 0, bestA1 = 0;
+        uint8_t bestIndices[16]{};
+
+        // a0 > a1 interpolates six values; the other order interpolates four
+        // and has explicit 0 and 255 entries
+        auto encode = [&](float first, float second, bool eightValues)
+        {
+            for (int iteration = 0; iteration < 3; ++iteration)
+            {
+                auto a0 = (uint32_t)std::lround(first), a1 = (uint32_t)std::lround(second);
+                if (eightValues ? a0 < a1 : a0 > a1)
+                    std::swap(a0, a1);
+
+                float palette[8][4]{};
+                palette[0][channel] = (float)a0;
+                palette[1][channel] = (float)a1;
+                if (a0 > a1)
+                {
+                    for (uint32_t i = 1; i < 7; ++i)
+                        palette[i + 1][channel] = (float)(((7 - i) * a0 + i * a1) / 7);
+                }
+                else
+                {
+                    for (uint32_t i = 1; i < 5; ++i)
+                        palette[i + 1][channel] = (float)(((5 - i) * a0 + i * a1) / 5);
+                    palette[7][channel] = 255.f;
+                }
+
+                uint8_t indices[16];
+                const float error = SelectIndices(block, palette, 8, weights, 0xFFFF, indices);
+                if (error >= bestError)
+                    return;
+                bestError = error;
+                bestA0 = (uint8_t)a0;
+                bestA1 = (uint8_t)a1;
+                std::memcpy(bestIndices, indices, 16);
+
+                // Only texels on the interpolated entries take part in the fit
+                uint32_t mask = 0;
+                for (uint32_t i = 0; i < 16; ++i)
+                    if (a0 > a1 || indices[i] < 6)
+                        mask |= 1u << i;
+
+                float e0[4]{}, e1[4]{};
+                if (error == 0.f || !RefineEndpoints(block, mask, channel, channel + 1, indices, a0 > a1 ? kEightValues : kSixValues, e0, e1))
+                    return;
+                first = e0[channel];
+                second = e1[channel];
+            }
+        };
+
+        encode(hi, lo, true);
+        if (innerLo <= innerHi && (lo == 0.f || hi == 255.f))
+            encode(innerLo, innerHi, false);
+
+        uint64_t bits = 0;
+        for (uint32_t i = 0; i < 16; ++i)
+            bits |= (uint64_t)bestIndices[i] << (3 * i);
+        out[0] = bestA0;
+        out[1] = bestA1;
+        for (int i = 0; i < 6; ++i)
+            out[2 + i] = (uint8_t)(bits >> (8 * i));
+    }
+
+    void EncodeBC1Block(const uint8_t *rgba, uint8_t *block)
+    {
+        TexelBlock texels;
+        LoadTexelBlock(rgba, texels);
+
+        uint32_t opaque = 0;
+        for (uint32_t i = 0; i < 16; ++i)
+            if (rgba[i * 4 + 3] >= 128)
+                opaque |= 1u << i;
+        EncodeColorBlock(texels, opaque, true, block);
+    }
+
+    void EncodeBC3Block(const uint8_t *rgba, uint8_t *block)
+    {
+        TexelBlock texels;
+        LoadTexelBlock(rgba, texels);
+        EncodeChannelBlock(texels, 3, block);
+        EncodeColorBlock(texels, 0xFFFF, false, block + 8);
+    }
+
+    void EncodeBC4Block(const uint8_t *rgba, uint8_t *block)
+    {
+        TexelBlock texels;
+        LoadTexelBlock(rgba, texels);
+        EncodeChannelBlock(texels, 0, block);
+    }
+
+    void EncodeBC5Block(const uint8_t *rgba, uint8_t *block)
+    {
+        TexelBlock texels;
+        LoadTexelBlock(rgba, texels);
+        EncodeChannelBlock(texels, 0, block);
+        EncodeChannelBlock(texels, 1, block + 8);
+    }
+
+    struct BlockBitWriter
+    {
+        uint8_t *data;
+        uint32_t pos = 0;
+
+        void Write(uint32_t value, uint32_t count)
+        {
+            for (uint32_t i = 0; i < count; ++i, ++pos)
+                data[pos >> 3] |= (uint8_t)(((value >> i) & 1) << (pos & 7));
+        }
+    };
+
+    // How a BC7 mode stores the endpoints of one subset, or of the color and
+    // alpha halves of mode 5
+    struct Bc7EndpointFormat
+    {
+        uint32_t firstChannel;
+        uint32_t channelEnd;
+        // Per channel, without the p-bit
+        uint32_t bits;
+        // 0, 1 shared by both endpoints or 2 one per endpoint
+        uint32_t pBits;
+        uint32_t indexBits;
+    };
+
+    static constexpr Bc7EndpointFormat kBc7Mode1 = {0, 3, 6, 1, 3};
+    static constexpr Bc7EndpointFormat kBc7Mode5Color = {0, 3, 7, 0, 2};
+    static constexpr Bc7EndpointFormat kBc7Mode5Alpha = {3, 4, 8, 0, 2};
+    static constexpr Bc7EndpointFormat kBc7Mode6 = {0, 4, 7, 2, 4};
+
+    // Endpoint channel as the decoder expands it
+    static uint32_t ExpandBc7(uint32_t q, const Bc7EndpointFormat &format, uint32_t p)
+    {
+        const uint32_t precision = format.pBits ? format.bits + 1 : format.bits;
+        const uint32_t v = (format.pBits ? q << 1 | p : q) << (8 - precision);
+        return v | v >> precision;
+    }
+
+    static uint32_t QuantizeBc7(float value, const Bc7EndpointFormat &format, uint32_t p)
+    {
+        const int maxQ = (1 << format.bits) - 1;
+        const int guess = (int)std::lround(value / 255.f * (float)maxQ);
+        uint32_t best = 0;
+        float bestError = std::numeric_limits<float>::max();
+        for (int q = std::max(guess - 1, 0); q <= std::min(guess + 1, maxQ); ++q)
+        {
+            const float error = std::abs((float)ExpandBc7((uint32_t)q, format, p) - value);
+            if (error < bestError)
+            {
+                bestError = error;
+                best = (uint32_t)q;
+            }
+        }
+        return best;
+    }
+
+    struct Bc7Endpoints
+    {
+        uint32_t q[2][4]{};
+        uint32_t p[2]{};
+        float error = std::numeric_limits<float>::max();
+    };
+
+    // Fits, quantizes and indexes the texels in mask. Only their entries of
+    // indices are written.
+    static void EncodeBc7Endpoints(const TexelBlock &block, uint32_t mask, const Bc7EndpointFormat &format, Bc7Endpoints &out, uint8_t *indices)
+    {
+        const uint8_t *table = format.indexBits == 4 ? kBc7Weights4 : format.indexBits == 3 ? kBc7Weights3
+                                                                                           : kBc7Weights2;
+        const uint32_t count = 1u << format.indexBits;
+
+        float weights[4]{};
+        for (uint32_t ch = format.firstChannel; ch < format.channelEnd; ++ch)
+            weights[ch] = 1.f;
+        float positions[16];
+        for (uint32_t i = 0; i < count; ++i)
+            positions[i] = table[i] / 64.f;
+
+        float e[2][4]{};
+        FitEndpoints(block, mask, format.firstChannel, format.channelEnd, e[0], e[1]);
+
+        for (int iteration = 0; iteration < 3; ++iteration)
+        {
+            // Quantize with every p-bit choice, keep the one landing closest
+            uint32_t candidates[2][2][4]{};
+            float pError[2][2]{};
+            for (uint32_t p = 0; p < (format.pBits ? 2u : 1u); ++p)
+                for (int end = 0; end < 2; ++end)
+                    for (uint32_t ch = format.firstChannel; ch < format.channelEnd; ++ch)
+                    {
+                        candidates[p][end][ch] = QuantizeBc7(e[end][ch], format, p);
+                        const float d = (float)ExpandBc7(candidates[p][end][ch], format, p) - e[end][ch];
+                        pError[p][end] += d * d;
+                    }
+
+            Bc7Endpoints trial;
+            uint32_t expanded[2][4]{};
+            for (int end = 0; end < 2; ++end)
+            {
+                uint32_t p = 0;
+                if (format.pBits == 1)
+                    p = pError[1][0] + pError[1][1] < pError[0][0] + pError[0][1] ? 1 : 0;
+                else if (format.pBits == 2)
+                    p = pError[1][end] < pError[0][end] ? 1 : 0;
+                trial.p[end] = p;
+                for (uint32_t ch = format.firstChannel; ch < format.channelEnd; ++ch)
+                {
+                    trial.q[end][ch] = candidates[p][end][ch];
+                    expanded[end][ch] = ExpandBc7(trial.q[end][ch], format, p);
+                }
+            }
+
+            float palette[16][4]{};
+            for (uint32_t i = 0; i < count; ++i)
+                for (uint32_t ch = format.firstChannel; ch < format.channelEnd; ++ch)
+                    palette[i][ch] = (float)(((64 - table[i]) * expanded[0][ch] + table[i] * expanded[1][ch] + 32) >> 6);
+
+            uint8_t trialIndices[16];
+            trial.error = SelectIndices(block, palette, count, weights, mask, trialIndices);
+            if (trial.error >= out.error)
+                break;
+            out = trial;
+            for (uint32_t i = 0; i < 16; ++i)
+                if (mask >> i & 1)
+                    indices[i] = trialIndices[i];
+
+            for (int end = 0; end < 2; ++end)
+                for (uint32_t ch = format.firstChannel; ch < format.channelEnd; ++ch)
+                    e[end][ch] = (float)expanded[end][ch];
+            if (trial.error == 0.f || !RefineEndpoints(block, mask, format.firstChannel, format.channelEnd, trialIndices, positions, e[0], e[1]))
+                break;
+        }
+    }
+
+    // The anchor texel stores its index without the top bit, so that bit has
+    // to be zero. Swapping the endpoints mirrors the indices to get there.
+    static void FixBc7Anchor(Bc7Endpoints &endpoints, uint32_t mask, uint32_t anchor, uint32_t indexBits, uint8_t *indices)
+    {
+        const uint32_t maxIndex = (1u << indexBits) - 1;
+        if (indices[anchor] <= maxIndex >> 1)
+            return;
+        std::swap(endpoints.q[0], endpoints.q[1]);
+        std::swap(endpoints.p[0], endpoints.p[1]);
+        for (uint32_t i = 0; i < 16; ++i)
+            if (mask >> i & 1)
+                indices[i] = (uint8_t)(maxIndex - indices[i]);
+    }
+
+    // Two subset partitions fully encoded in mode 1 after the line fit ranking
+    static constexpr int kBc7PartitionCandidates = 4;
+
+    void EncodeBC7Block(const uint8_t *rgba, uint8_t *block)
+    {
+        TexelBlock texels;
+        LoadTexelBlock(rgba, texels);
+
+        // Mode 6: one subset, RGBA on a single line
+        uint8_t mode6Indices[16]{};
+        Bc7Endpoints mode6;
+        EncodeBc7Endpoints(texels, 0xFFFF, kBc7Mode6, mode6, mode6Indices);
+
+        bool opaque = true;
+        for (uint32_t i = 0; i < 16; ++i)
+            opaque = opaque && rgba[i * 4 + 3] == 255;
+
+        // Mode 1: two RGB subsets for opaque blocks
+        uint32_t partition = 0;
+        Bc7Endpoints mode1[2];
+        uint8_t mode1Indices[16]{};
+        float mode1Error = std::numeric_limits<float>::max();
+        if (opaque && mode6.error > 0.f)
+        {
+            ColorMoments all, moments[16];
+            for (uint32_t i = 0; i < 16; ++i)
+            {
+                moments[i] = ColorMoments::Of(texels, i);
+                all += moments[i];
+            }
+
+            std::pair<float, uint32_t> ranked[64];
+            for (uint32_t candidate = 0; candidate < 64; ++candidate)
+            {
+                ColorMoments second;
+                for (uint32_t i = 0; i < 16; ++i)
+                    if (kBc7Partitions2[candidate] >> i & 1)
+                        second += moments[i];
+                ranked[candidate] = {(all - second).LineError() + second.LineError(), candidate};
+            }
+            std::partial_sort(ranked, ranked + kBc7PartitionCandidates, ranked + 64);
+
+            for (int c = 0; c < kBc7PartitionCandidates; ++c)
+            {
+                const uint32_t candidate = ranked[c].second;
+                const uint32_t mask = kBc7Partitions2[candidate];
+                Bc7Endpoints subsets[2];
+                uint8_t indices[16]{};
+                EncodeBc7Endpoints(texels, ~mask & 0xFFFF, kBc7Mode1, subsets[0], indices);
+                EncodeBc7Endpoints(texels, mask, kBc7Mode1, subsets[1], indices);
+
+                const float error = subsets[0].error + subsets[1].error;
+                if (error < mode1Error)
+                {
+                    mode1Error = error;
+                    partition = candidate;
+                    mode1[0] = subsets[0];
+                    mode1[1] = subsets[1];
+                    std::memcpy(mode1Indices, indices, 16);
+                }
+            }
+        }
+
+        // Mode 5: color and alpha indexed separately, for blocks where alpha
+        // does not follow the color
+        Bc7Endpoints mode5Color, mode5Alpha;
+        uint8_t mode5ColorIndices[16]{}, mode5AlphaIndices[16]{};
+        float mode5Error = std::numeric_limits<float>::max();
+        if (!opaque && mode6.error > 0.f)
+        {
+            EncodeBc7Endpoints(texels, 0xFFFF, kBc7Mode5Color, mode5Color, mode5ColorIndices);
+            EncodeBc7Endpoints(texels, 0xFFFF, kBc7Mode5Alpha, mode5Alpha, mode5AlphaIndices);
+            mode5Error = mode5Color.error + mode5Alpha.error;
+        }
+
+        std::memset(block, 0, 16);
+        BlockBitWriter bits{block};
+        if (mode1Error < mode6.error)
+        {
+            const uint32_t mask = kBc7Partitions2[partition];
+            const uint32_t anchor = kBc7Anchor2[partition];
+            FixBc7Anchor(mode1[0], ~mask & 0xFFFF, 0, 3, mode1Indices);
+            FixBc7Anchor(mode1[1], mask, anchor, 3, mode1Indices);
+
+            bits.Write(1u << 1, 2);
+            bits.Write(partition, 6);
+            for (int ch = 0; ch < 3; ++ch)
+                for (const auto &subset : mode1)
+                    for (int end = 0; end < 2; ++end)
+                        bits.Write(subset.q[end][ch], 6);
+            for (const auto &subset : mode1)
+                bits.Write(subset.p[0], 1);
+            for (uint32_t i = 0; i < 16; ++i)
+                bits.Write(mode1Indices[i], i == 0 || i == anchor ? 2 : 3);
+        }
+        else if (mode5Error < mode6.error)
+        {
+            FixBc7Anchor(mode5Color, 0xFFFF, 0, 2, mode5ColorIndices);
+            FixBc7Anchor(mode5Alpha, 0xFFFF, 0, 2, mode5AlphaIndices);
+
+            // No rotation
+            bits.Write(1u << 5, 6);
+            bits.Write(0, 2);
+            for (int ch = 0; ch < 3; ++ch)
+                for (int end = 0; end < 2; ++end)
+                    bits.Write(mode5Color.q[end][ch], 7);
+            for (int end = 0; end < 2; ++end)
+                bits.Write(mode5Alpha.q[end][3], 8);
+            for (uint32_t i = 0; i < 16; ++i)
+                bits.Write(mode5ColorIndices[i], i == 0 ? 1 : 2);
+            for (uint32_t i = 0; i < 16; ++i)
+                bits.Write(mode5AlphaIndices[i], i == 0 ? 1 : 2);
+        }
+        else
+        {
+            FixBc7Anchor(mode6, 0xFFFF, 0, 4, mode6Indices);
+
+            bits.Write(1u << 6, 7);
+            for (int ch = 0; ch < 4; ++ch)
+                for (int end = 0; end < 2; ++end)
+                    bits.Write(mode6.q[end][ch], 7);
+            bits.Write(mode6.p[0], 1);
+            bits.Write(mode6.p[1], 1);
+            for (uint32_t i = 0; i < 16; ++i)
+                bits.Write(mode6Indices[i], i == 0 ? 3 : 4);
+        }
+    }
+
+    bool EncodeBlock(VkFormat format, const uint8_t *rgba, uint8_t *block)
+    {
+        switch (format)
+        {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+            EncodeBC1Block(rgba, block);
+            return true;
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+            EncodeBC3Block(rgba, block);
+            return true;
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+            EncodeBC4Block(rgba, block);
+            return true;
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+            EncodeBC5Block(rgba, block);
+            return true;
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            EncodeBC7Block(rgba, block);
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    bool CompressTexture(const TextureImage &in, VkFormat format, TextureImage &out, JobSystem *jobs)
+    {
+        const uint32_t blockBytes = FormatBlockBytes(format);
+        uint8_t probe[16];
+        const uint8_t texels[64]{};
+        if (IsBlockCompressed(in.format) || FormatBlockBytes(in.format) != 4 || !IsBlockCompressed(format) || !EncodeBlock(format, texels, probe))
+            return false;
+
+        out.format = format;
+        out.width = in.width;
+        out.height = in.height;
+        out.levels.resize(in.levels.size());
+
+        size_t total = 0;
+        for (size_t i = 0; i < in.levels.size(); ++i)
+        {
+            out.levels[i].width = in.levels[i].width;
+            out.levels[i].height = in.levels[i].height;
+            out.levels[i].size = TextureLevelSize(format, in.levels[i].width, in.levels[i].height);
+            out.levels[i].offset = total;
+            total += out.levels[i].size;
+        }
+        out.data.resize(total);
+
+        for (size_t l = 0; l < in.levels.size(); ++l)
+        {
+            const auto &src = in.levels[l];
+            const auto &dst = out.levels[l];
+            const uint32_t blocksX = (src.width + 3) / 4;
+
+            auto encodeRows = [&](size_t begin, size_t end)
+            {
+                uint8_t rgba[64];
+                for (size_t by = begin; by < end; ++by)
+                {
+                    for (uint32_t bx = 0; bx < blocksX; ++bx)
+                    {
+                        // Edge blocks repeat the last row and column
+                        for (uint32_t y = 0; y < 4; ++y)
+                        {
+                            const uint32_t sy = std::min((uint32_t)by * 4 + y, src.height - 1);
+                            for (uint32_t x = 0; x < 4; ++x)
+                            {
+                                const uint32_t sx = std::min(bx * 4 + x, src.width - 1);
+                                std::memcpy(rgba + (y * 4 + x) * 4, in.data.data() + src.offset + ((size_t)sy * src.width + sx) * 4, 4);
+                            }
+                        }
+                        EncodeBlock(format, rgba, out.data.data() + dst.offset + (by * blocksX + bx) * blockBytes);
+                    }
+                }
+            };
+
+            const uint32_t blocksY = (src.height + 3) / 4;
+            if (jobs)
+                jobs->ParallelFor(blocksY, 1, encodeRows);
+            else
+                encodeRows(0, blocksY);
+        }
+        return true;
+    }
+}
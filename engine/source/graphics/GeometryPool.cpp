@@ -0,0 +1,335 @@
+#include "graphics/GeometryPool.h"
+
+#include "Engine.h"
+#include "vk/VkHelpers.h"
+#include "vk/VulkanContext.h"
+
+#include <SDL3/SDL.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace eng
+{
+    static VkDeviceSize IndexSize(VkIndexType indexType)
+    {
+        return indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+    }
+
+    void GeometryPool::RangeAllocator::Init(uint32_t capacity)
+    {
+        free.clear();
+        if (capacity > 0)
+            free.push_back({0, capacity});
+    }
+
+    bool GeometryPool::RangeAllocator::Allocate(uint32_t size, uint32_t &outOffset)
+    {
+        if (size == 0)
+        {
+            outOffset = 0;
+            return true;
+        }
+
+        for (size_t i = 0; i < free.size(); ++i)
+        {
+            auto &range = free[i];
+            if (range.size < size)
+                continue;
+
+            outOffset = range.offset;
+            range.offset += size;
+            range.size -= size;
+            if (range.size == 0)
+                free.erase(free.begin() + i);
+            return true;
+        }
+        return false;
+    }
+
+    void GeometryPool::RangeAllocator::Free(uint32_t offset, uint32_t size)
+    {
+        if (size == 0)
+            return;
+
+        auto it = std::lower_bound(free.begin(), free.end(), offset, [](const Range &r, uint32_t o)
+                                   { return r.offset < o; });
+        it = free.insert(it, {offset, size});
+
+        auto next = it + 1;
+        if (next != free.end() && it->offset + it->size == next->offset)
+        {
+            it->size += next->size;
+            free.erase(next);
+        }
+
+        if (it != free.begin())
+        {
+            auto prev = it - 1;
+            if (prev->offset + prev->size == it->offset)
+            {
+                prev->size += it->size;
+                free.erase(it);
+            }
+        }
+    }
+
+    uint32_t GeometryPool::CreatePage(const VertexLayout &layout, uint32_t vertexCapacity)
+    {
+        auto &vk = Engine::GetInstance().GetVulkanContext();
+
+        Page page;
+        page.layout = layout;
+
+        VkDeviceSize streamOffset = 0;
+        for (uint32_t s = 0; s < layout.GetStreamCount(); ++s)
+        {
+            page.streamOffsets.push_back(streamOffset);
+            streamOffset += (VkDeviceSize)vertexCapacity * layout.GetStreamStride(s);
+        }
+
+        // Storage usage so later passes can read geometry from shaders
+        VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+        if (m_deviceAddresses)
+            usage |= VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+
+        vkutil::CreateBuffer(vk.GetGPU(), vk.GetDevice(), (VkDeviceSize)vertexCapacity * layout.stride,
+                             usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                             page.vertexBuffer, page.vertexMemory);
+        page.vertices.Init(vertexCapacity);
+
+        if (m_deviceAddresses)
+        {
+            VkBufferDeviceAddressInfo ai{VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO};
+            ai.buffer = page.vertexBuffer;
+            page.address = vkGetBufferDeviceAddress(vk.GetDevice(), &ai);
+        }
+
+        m_pages.push_back(std::move(page));
+        return (uint32_t)m_pages.size() - 1;
+    }
+
+    uint32_t GeometryPool::CreateIndexPage(VkIndexType indexType, uint32_t indexCapacity)
+    {
+        auto &vk = Engine::GetInstance().GetVulkanContext();
+
+        IndexPage page;
+        page.type = indexType;
+
+        vkutil::CreateBuffer(vk.GetGPU(), vk.GetDevice(), (VkDeviceSize)indexCapacity * IndexSize(indexType),
+                             VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                             page.buffer, page.memory);
+        page.indices.Init(indexCapacity);
+
+        m_indexPages.push_back(std::move(page));
+        return (uint32_t)m_indexPages.size() - 1;
+    }
+
+    GeometryAllocation GeometryPool::Allocate(const VertexLayout &layout, const void *vertices, uint32_t vertexCount,
+                                              const void *indices, uint32_t indexCount, VkIndexType indexType)
+    {
+        GeometryAllocation result;
+        if (!vertices || vertexCount == 0 || layout.stride == 0)
+            return result;
+
+        if (!indices)
+            indexCount = 0;
+
+        const VkDeviceSize indexSize = IndexSize(indexType);
+        const VkDeviceSize vertexBytes = (VkDeviceSize)vertexCount * layout.stride;
+        const VkDeviceSize indexBytes = (VkDeviceSize)indexCount * indexSize;
+
+        VkBuffer vertexBuffer = VK_NULL_HANDLE;
+        VkBuffer indexBuffer = VK_NULL_HANDLE;
+        std::vector<VkDeviceSize> streamOffsets;
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+
+            for (uint32_t i = 0; i < m_pages.size() && !result.IsValid(); ++i)
+            {
+                if (m_pages[i].layout == layout && m_pages[i].vertices.Allocate(vertexCount, result.firstVertex))
+                    result.page = i;
+            }
+
+            if (!result.IsValid())
+            {
+                // Oversized meshes get a page of their own
+                const uint32_t vertexCapacity = std::max<uint32_t>(vertexCount, (uint32_t)(kVertexPageSize / layout.stride));
+                result.page = CreatePage(layout, vertexCapacity);
+                m_pages[result.page].vertices.Allocate(vertexCount, result.firstVertex);
+            }
+            result.vertexCount = vertexCount;
+
+            if (indexCount > 0)
+            {
+                for (uint32_t i = 0; i < m_indexPages.size() && result.indexPage == GeometryAllocation::kInvalidPage; ++i)
+                {
+                    if (m_indexPages[i].type == indexType && m_indexPages[i].indices.Allocate(indexCount, result.firstIndex))
+                        result.indexPage = i;
+                }
+
+                if (result.indexPage == GeometryAllocation::kInvalidPage)
+                {
+                    const uint32_t indexCapacity = std::max<uint32_t>(indexCount, (uint32_t)(kIndexPageSize / indexSize));
+                    result.indexPage = CreateIndexPage(indexType, indexCapacity);
+                    m_indexPages[result.indexPage].indices.Allocate(indexCount, result.firstIndex);
+                }
+                result.indexCount = indexCount;
+                indexBuffer = m_indexPages[result.indexPage].buffer;
+            }
+
+            vertexBuffer = m_pages[result.page].vertexBuffer;
+            streamOffsets = m_pages[result.page].streamOffsets;
+        }
+
+        auto &vk = Engine::GetInstance().GetVulkanContext();
+        VkDevice device = vk.GetDevice();
+
+        VkBuffer stagingBuf{};
+        VkDeviceMemory stagingMem{};
+        vkutil::CreateBuffer(vk.GetGPU(), device, vertexBytes + indexBytes,
+                             VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                             stagingBuf, stagingMem);
+
+        void *mapped = nullptr;
+        vkMapMemory(device, stagingMem, 0, vertexBytes + indexBytes, 0, &mapped);
+        std::memcpy(mapped, vertices, (size_t)vertexBytes);
+        if (indexBytes > 0)
+            std::memcpy((char *)mapped + vertexBytes, indices, (size_t)indexBytes);
+        vkUnmapMemory(device, stagingMem);
+
+        VkCommandBuffer cmd = vkutil::BeginOneTime(device, vk.GetCommandPool());
+
+        std::vector<VkBufferCopy> vertexCopies(layout.GetStreamCount());
+        VkDeviceSize srcOffset = 0;
+        for (uint32_t s = 0; s < layout.GetStreamCount(); ++s)
+        {
+            const VkDeviceSize streamStride = layout.GetStreamStride(s);
+            vertexCopies[s].srcOffset = srcOffset;
+            vertexCopies[s].dstOffset = streamOffsets[s] + (VkDeviceSize)result.firstVertex * streamStride;
+            vertexCopies[s].size = (VkDeviceSize)vertexCount * streamStride;
+            srcOffset += vertexCopies[s].size;
+        }
+        vkCmdCopyBuffer(cmd, stagingBuf, vertexBuffer, (uint32_t)vertexCopies.size(), vertexCopies.data());
+
+        if (indexBytes > 0)
+        {
+            VkBufferCopy indexCopy{};
+            indexCopy.srcOffset = vertexBytes;
+            indexCopy.dstOffset = (VkDeviceSize)result.firstIndex * indexSize;
+            indexCopy.size = indexBytes;
+            vkCmdCopyBuffer(cmd, stagingBuf, indexBuffer, 1, &indexCopy);
+        }
+
+        vkutil::EndOneTime(device, vk.GetGraphicsQueue(), vk.GetCommandPool(), cmd);
+
+        vkDestroyBuffer(device, stagingBuf, nullptr);
+        vkFreeMemory(device, stagingMem, nullptr);
+
+        return result;
+    }
+
+    void GeometryPool::Free(const GeometryAllocation &allocation)
+    {
+        if (!allocation.IsValid())
+            return;
+
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (allocation.page >= m_pages.size())
+            return;
+
+        m_pendingFrees.push_back({allocation, kRetireFrames});
+    }
+
+    void GeometryPool::Release(const GeometryAllocation &allocation)
+    {
+        m_pages[allocation.page].vertices.Free(allocation.firstVertex, allocation.vertexCount);
+        if (allocation.indexPage != GeometryAllocation::kInvalidPage)
+            m_indexPages[allocation.indexPage].indices.Free(allocation.firstIndex, allocation.indexCount);
+    }
+
+    void GeometryPool::NextFrame()
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        for (size_t i = 0; i < m_pendingFrees.size();)
+        {
+            auto &pending = m_pendingFrees[i];
+            if (--pending.framesLeft == 0)
+            {
+                Release(pending.allocation);
+                pending = m_pendingFrees.back();
+                m_pendingFrees.pop_back();
+            }
+            else
+            {
+                ++i;
+            }
+        }
+    }
+
+    void GeometryPool::Destroy()
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        VkDevice device = Engine::GetInstance().GetVulkanContext().GetDevice();
+        for (auto &page : m_pages)
+        {
+            if (page.vertexBuffer)
+                vkDestroyBuffer(device, page.vertexBuffer, nullptr);
+            if (page.vertexMemory)
+                vkFreeMemory(device, page.vertexMemory, nullptr);
+        }
+        for (auto &page : m_indexPages)
+        {
+            if (page.buffer)
+                vkDestroyBuffer(device, page.buffer, nullptr);
+            if (page.memory)
+                vkFreeMemory(device, page.memory, nullptr);
+        }
+        m_pages.clear();
+        m_indexPages.clear();
+        m_pendingFrees.clear();
+    }
+
+    void GeometryPool::Bind(VkCommandBuffer cmd, uint32_t page) const
+    {
+        const Page &p = m_pages[page];
+
+        VkBuffer buffers[4];
+        const uint32_t streamCount = std::min<uint32_t>((uint32_t)p.streamOffsets.size(), 4);
+        for (uint32_t s = 0; s < streamCount; ++s)
+            buffers[s] = p.vertexBuffer;
+        vkCmdBindVertexBuffers(cmd, 0, streamCount, buffers, p.streamOffsets.data());
+    }
+
+    void GeometryPool::BindIndices(VkCommandBuffer cmd, uint32_t indexPage) const
+    {
+        const IndexPage &p = m_indexPages[indexPage];
+        vkCmdBindIndexBuffer(cmd, p.buffer, 0, p.type);
+    }
+
+    GpuVertexFormat GeometryPool::GetVertexFormat(uint32_t page) const
+    {
+        const Page &p = m_pages[page];
+
+        GpuVertexFormat format;
+        for (uint32_t s = 0; s < std::min<uint32_t>((uint32_t)p.streamOffsets.size(), 2); ++s)
+        {
+            format.streams[s] = p.address + p.streamOffsets[s];
+            format.strides[s] = p.layout.GetStreamStride(s);
+        }
+
+        for (const auto &e : p.layout.elements)
+        {
+            if (e.index >= GpuVertexFormat::kMaxLocations || e.binding >= 2)
+                continue;
+
+            format.attribs[e.index] = (uint32_t)e.type | (e.size << 4) | (e.binding << 8) |
+                                      GpuVertexFormat::kAttribPresent | (e.offset << 16);
+        }
+        return format;
+    }
+}
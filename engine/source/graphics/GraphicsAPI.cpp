@@ -13,38 +13,115 @@ namespace eng
     std::shared_ptr<ShaderProgram> GraphicsAPI::CreateShaderProgram(const std::string &vertSpv,
                                                                     const std::string &fragSpv,
                                                                     const VertexLayout &layout)
+    {
+        return CreateShaderProgram(vertSpv, fragSpv, layout, Engine::GetInstance().GetVulkanContext().GetTextureSetLayout());
+    }
+
+    std::shared_ptr<ShaderProgram> GraphicsAPI::CreateShaderProgram(const std::string &vertSpv,
+                                                                    const std::string &fragSpv,
+                                                                    const VertexLayout &layout,
+                                                                    VkDescriptorSetLayout textureSetLayout)
     {
         auto &vk = Engine::GetInstance().GetVulkanContext();
         auto sp = std::make_shared<ShaderProgram>();
-        sp->Create(vk.GetDevice(), vk.GetRenderPass(), vk.GetExtent(), layout, vertSpv, fragSpv, vk.GetCameraSetLayout(), vk.GetTextureSetLayout());
+        sp->Create(vk.GetDevice(), vk.GetRenderPass(), vk.GetExtent(), layout, vertSpv, fragSpv, vk.GetCameraSetLayout(), textureSetLayout, vk.GetLightSetLayout(), vk.GetObjectSetLayout());
 
         vk.RegisterShaderProgram(sp); // чтобы пересоздавать на resize (см. ниже)
         return sp;
     }
 
+    static VertexLayout DefaultVertexLayout()
+    {
+        eng::VertexLayout layout;
+        // Position
+        layout.elements.push_back({VertexElement::Position, 3, AttribType::Float32, 0});
+        // Color
+        layout.elements.push_back({VertexElement::Color, 3, AttribType::Float32, sizeof(float) * 3});
+        // UV
+        layout.elements.push_back({VertexElement::UV, 2, AttribType::Float32, sizeof(float) * 6});
+        // Normals
+        layout.elements.push_back({VertexElement::Normal, 3, AttribType::Float32, sizeof(float) * 8});
+
+        layout.stride = sizeof(float) * 11;
+        return layout;
+    }
+
     const std::shared_ptr<ShaderProgram> &GraphicsAPI::GetDefaultShaderProgram()
     {
         if (!m_defaultShaderProgram)
+        {
+            // Clustered forward lighting (set=2). Programs created from .mat files
+            // keep the single push-constant light.
+            m_defaultShaderProgram = CreateShaderProgram(
+                "shaders/clustered_vert.spv",
+                "shaders/clustered_frag.spv",
+                DefaultVertexLayout());
+        }
+
+        return m_defaultShaderProgram;
+    }
+
+    const std::shared_ptr<ShaderProgram> &GraphicsAPI::GetIndirectShaderProgram()
+    {
+        if (!m_indirectShaderProgram)
+        {
+            m_indirectShaderProgram = CreateShaderProgram(
+                "shaders/indirect_vert.spv",
+                "shaders/clustered_frag.spv",
+                DefaultVertexLayout());
+        }
+
+        return m_indirectShaderProgram;
+    }
+
+    const std::shared_ptr<ShaderProgram> &GraphicsAPI::GetDepthShaderProgram()
+    {
+        if (!m_depthShaderProgram)
         {
             eng::VertexLayout layout;
-            // Position
             layout.elements.push_back({VertexElement::Position, 3, AttribType::Float32, 0});
-            // Color
-            layout.elements.push_back({VertexElement::Color, 3, AttribType::Float32, sizeof(float) * 3});
-            // UV
-            layout.elements.push_back({VertexElement::UV, 2, AttribType::Float32, sizeof(float) * 6});
-            // Normals
-            layout.elements.push_back({VertexElement::Normal, 3, AttribType::Float32, sizeof(float) * 8});
+            layout.stride = sizeof(float) * 3;
 
-            layout.stride = sizeof(float) * 11;
+            m_depthShaderProgram = CreateShaderProgram("shaders/depth_vert.spv", "", layout);
+        }
 
-            m_defaultShaderProgram = CreateShaderProgram(
-                "shaders/vertex.spv",
-                "shaders/fragment.spv",
-                layout);
+        return m_depthShaderProgram;
+    }
+
+    const std::shared_ptr<ShaderProgram> &GraphicsAPI::GetPullShaderProgram()
+    {
+        if (!m_pullShaderProgram)
+        {
+            m_pullShaderProgram = CreateShaderProgram(
+                "shaders/indirect_pull_vert.spv",
+                "shaders/clustered_frag.spv",
+                VertexLayout{});
         }
 
-        return m_defaultShaderProgram;
+        return m_pullShaderProgram;
+    }
+
+    const std::shared_ptr<ShaderProgram> &GraphicsAPI::GetPullDepthShaderProgram()
+    {
+        if (!m_pullDepthShaderProgram)
+            m_pullDepthShaderProgram = CreateShaderProgram("shaders/depth_pull_vert.spv", "", VertexLayout{});
+
+        return m_pullDepthShaderProgram;
+    }
+
+    const std::shared_ptr<ShaderProgram> &GraphicsAPI::GetVirtualTextureShaderProgram()
+    {
+        auto &virtualTextures = Engine::GetInstance().GetVulkanContext().GetVirtualTextures();
+        if (!m_virtualTextureShaderProgram && virtualTextures.IsSupported())
+        {
+            m_virtualTextureShaderProgram = CreateShaderProgram(
+                "shaders/clustered_vert.spv",
+                "shaders/virtual_texture_frag.spv",
+                DefaultVertexLayout(),
+                virtualTextures.GetSetLayout());
+        }
+
+        return m_virtualTextureShaderProgram;
     }
 
     void GraphicsAPI::SetClearColor(float r, float g, float b, float a)
@@ -73,10 +150,43 @@ namespace eng
             mesh->Bind();
     }
 
-    void GraphicsAPI::DrawMesh(Mesh *mesh)
+    void GraphicsAPI::DrawMesh(Mesh *mesh, uint32_t lod)
+    {
+        if (mesh)
+            mesh->Draw(lod);
+    }
+
+    void GraphicsAPI::DrawMeshRange(Mesh *mesh, uint32_t firstIndex, uint32_t indexCount)
     {
         if (mesh)
-            mesh->Draw();
+            mesh->DrawRange(firstIndex, indexCount);
+    }
+
+    void GraphicsAPI::BindGeometryPage(uint32_t page)
+    {
+        if (m_currentProgram)
+            m_currentProgram->BindVertexLayout(m_geometryPool.GetLayout(page));
+
+        if (page == m_boundGeometryPage)
+            return;
+
+        m_geometryPool.Bind(m_cmd, page);
+        m_boundGeometryPage = page;
+    }
+
+    void GraphicsAPI::BindIndexPage(uint32_t indexPage)
+    {
+        if (indexPage == GeometryAllocation::kInvalidPage || indexPage == m_boundIndexPage)
+            return;
+
+        m_geometryPool.BindIndices(m_cmd, indexPage);
+        m_boundIndexPage = indexPage;
+    }
+
+    void GraphicsAPI::BindIndexBuffer(VkBuffer buffer, VkIndexType indexType)
+    {
+        vkCmdBindIndexBuffer(m_cmd, buffer, 0, indexType);
+        m_boundIndexPage = GeometryAllocation::kInvalidPage;
     }
 
     VkBuffer GraphicsAPI::CreateVertexBuffer(const std::vector<float> &vertices)
@@ -176,5 +286,7 @@ namespace eng
             r.memory = VK_NULL_HANDLE;
         }
         m_ownedBuffers.clear();
+
+        m_geometryPool.Destroy();
     }
 }
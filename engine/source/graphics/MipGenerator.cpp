@@ -0,0 +1,221 @@
+#include "graphics/MipGenerator.h"
+
+#include "jobs/JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+namespace eng
+{
+#if defined(__AVX2__)
+    const char *const kMipGeneratorSimdName = "AVX2";
+#elif defined(__SSE4_1__)
+    const char *const kMipGeneratorSimdName = "SSE4.1";
+#else
+    const char *const kMipGeneratorSimdName = "scalar";
+#endif
+
+    // Buckets of the float to byte lookup. Narrower than the smallest gap
+    // between two sRGB bytes in linear space (1 / (255 * 12.92)).
+    static constexpr uint32_t kEncodeSteps = 4096;
+    // Destination texels per job
+    static constexpr size_t kTexelsPerJob = 16384;
+
+    static double SrgbToLinear(double c)
+    {
+        return c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+    }
+
+    // Linear value in [0, 1] to the nearest byte of one encoding. The bucket
+    // gives the byte at its lower edge, at most one rounding threshold lies
+    // inside it.
+    struct ByteEncoder
+    {
+        uint8_t first[kEncodeSteps + 1];
+        // Halfway between byte i and i + 1, above 1 for 255
+        float threshold[256];
+
+        uint8_t Encode(float v) const
+        {
+            v = std::clamp(v, 0.f, 1.f);
+            const uint32_t b = first[(uint32_t)(v * (float)kEncodeSteps)];
+            return (uint8_t)(b + (v >= threshold[b] ? 1 : 0));
+        }
+    };
+
+    static ByteEncoder MakeEncoder(bool srgb)
+    {
+        ByteEncoder e{};
+        for (int i = 0; i < 256; ++i)
+        {
+            const double c = (i + 0.5) / 255.0;
+            e.threshold[i] = i == 255 ? 2.f : (float)(srgb ? SrgbToLinear(c) : c);
+        }
+
+        // Bucket edges are exact in float, so this matches Encode
+        uint32_t b = 0;
+        for (uint32_t i = 0; i <= kEncodeSteps; ++i)
+        {
+            const float v = (float)i / (float)kEncodeSteps;
+            while (e.threshold[b] <= v)
+                ++b;
+            e.first[i] = (uint8_t)b;
+        }
+        return e;
+    }
+
+    // Byte to linear float, indexed by channel * 256 + value
+    struct DecodeTable
+    {
+        alignas(32) float values[4 * 256];
+    };
+
+    static DecodeTable MakeDecodeTable(bool srgb)
+    {
+        DecodeTable t{};
+        for (int ch = 0; ch < 4; ++ch)
+            for (int i = 0; i < 256; ++i)
+                t.values[ch * 256 + i] = (float)(srgb && ch < 3 ? SrgbToLinear(i / 255.0) : i / 255.0);
+        return t;
+    }
+
+    static const DecodeTable &GetDecodeTable(bool srgb)
+    {
+        static const DecodeTable tables[2] = {MakeDecodeTable(false), MakeDecodeTable(true)};
+        return tables[srgb ? 1 : 0];
+    }
+
+    static const ByteEncoder &GetEncoder(bool srgb)
+    {
+        static const ByteEncoder encoders[2] = {MakeEncoder(false), MakeEncoder(true)};
+        return encoders[srgb ? 1 : 0];
+    }
+
+    // count bytes of RGBA8 to floats
+    static void DecodeRow(const uint8_t *src, size_t count, const float *table, float *out)
+    {
+        size_t i = 0;
+#if defined(__AVX2__)
+        // Two texels per gather, lanes keep their channel
+        const __m256i channel = _mm256_setr_epi32(0, 256, 512, 768, 0, 256, 512, 768);
+        for (; i + 8 <= count; i += 8)
+        {
+            const __m256i bytes = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + i)));
+            _mm256_storeu_ps(out + i, _mm256_i32gather_ps(table, _mm256_add_epi32(bytes, channel), 4));
+        }
+#endif
+        for (; i < count; ++i)
+            out[i] = table[(i & 3) * 256 + src[i]];
+    }
+
+    // Averages texels 2x and 2x + 1 of rows r0 and r1 into texel x of out.
+    // Every path adds in the same order, so the result does not depend on
+    // ENGINE_SIMD.
+    static void ReduceRows(const float *r0, const float *r1, uint32_t width, float *out)
+    {
+        uint32_t x = 0;
+#if defined(__AVX2__)
+        const __m256 quarter8 = _mm256_set1_ps(0.25f);
+        for (; x + 2 <= width; x += 2)
+        {
+            // Texel pairs (2x, 2x + 1) and (2x + 2, 2x + 3), summed over both rows
+            const __m256 a = _mm256_add_ps(_mm256_loadu_ps(r0 + x * 8), _mm256_loadu_ps(r1 + x * 8));
+            const __m256 b = _mm256_add_ps(_mm256_loadu_ps(r0 + x * 8 + 8), _mm256_loadu_ps(r1 + x * 8 + 8));
+            const __m256 even = _mm256_permute2f128_ps(a, b, 0x20);
+            const __m256 odd = _mm256_permute2f128_ps(a, b, 0x31);
+            _mm256_storeu_ps(out + x * 4, _mm256_mul_ps(_mm256_add_ps(even, odd), quarter8));
+        }
+#endif
+#if defined(__AVX2__) || defined(__SSE4_1__)
+        const __m128 quarter = _mm_set1_ps(0.25f);
+        for (; x < width; ++x)
+        {
+            const __m128 a = _mm_add_ps(_mm_loadu_ps(r0 + x * 8), _mm_loadu_ps(r1 + x * 8));
+            const __m128 b = _mm_add_ps(_mm_loadu_ps(r0 + x * 8 + 4), _mm_loadu_ps(r1 + x * 8 + 4));
+            _mm_storeu_ps(out + x * 4, _mm_mul_ps(_mm_add_ps(a, b), quarter));
+        }
+#else
+        for (; x < width; ++x)
+            for (int ch = 0; ch < 4; ++ch)
+                out[x * 4 + ch] = ((r0[x * 8 + ch] + r1[x * 8 + ch]) + (r0[x * 8 + 4 + ch] + r1[x * 8 + 4 + ch])) * 0.25f;
+#endif
+    }
+
+    bool GenerateMipChain(TextureImage &image, JobSystem *jobs)
+    {
+        if (image.format != VK_FORMAT_R8G8B8A8_UNORM && image.format != VK_FORMAT_R8G8B8A8_SRGB)
+            return false;
+
+        const bool srgb = IsSrgbFormat(image.format);
+        const float *decode = GetDecodeTable(srgb).values;
+        const ByteEncoder *encoders[4] = {&GetEncoder(srgb), &GetEncoder(srgb), &GetEncoder(srgb), &GetEncoder(false)};
+
+        // Lay out every level first, the data does not move while filtering
+        image.levels.resize(1);
+        size_t end = image.levels[0].offset + image.levels[0].size;
+        while (image.levels.back().width > 1 || image.levels.back().height > 1)
+        {
+            const auto &src = image.levels.back();
+            TextureImage::Level dst;
+            dst.width = std::max(src.width / 2, 1u);
+            dst.height = std::max(src.height / 2, 1u);
+            dst.size = (size_t)dst.width * dst.height * 4;
+            dst.offset = end;
+            end += dst.size;
+            image.levels.push_back(dst);
+        }
+        image.data.resize(end);
+
+        for (size_t level = 1; level < image.levels.size(); ++level)
+        {
+            const auto &src = image.levels[level - 1];
+            const auto &dst = image.levels[level];
+            const uint8_t *in = image.data.data() + src.offset;
+            uint8_t *out = image.data.data() + dst.offset;
+
+            // A source row of one texel is repeated to fill the pair
+            const uint32_t pairWidth = dst.width * 2;
+            const uint32_t readWidth = std::min(src.width, pairWidth);
+
+            auto filterRows = [&](size_t begin, size_t rowsEnd)
+            {
+                std::vector<float> rows(pairWidth * 8 + dst.width * 4);
+                float *r0 = rows.data();
+                float *r1 = r0 + pairWidth * 4;
+                float *filtered = r1 + pairWidth * 4;
+
+                for (size_t y = begin; y < rowsEnd; ++y)
+                {
+                    const uint32_t y0 = std::min((uint32_t)y * 2, src.height - 1);
+                    const uint32_t y1 = std::min((uint32_t)y * 2 + 1, src.height - 1);
+                    DecodeRow(in + (size_t)y0 * src.width * 4, (size_t)readWidth * 4, decode, r0);
+                    DecodeRow(in + (size_t)y1 * src.width * 4, (size_t)readWidth * 4, decode, r1);
+                    for (uint32_t x = readWidth; x < pairWidth; ++x)
+                    {
+                        std::memcpy(r0 + x * 4, r0 + (readWidth - 1) * 4, 4 * sizeof(float));
+                        std::memcpy(r1 + x * 4, r1 + (readWidth - 1) * 4, 4 * sizeof(float));
+                    }
+
+                    ReduceRows(r0, r1, dst.width, filtered);
+
+                    uint8_t *row = out + y * dst.width * 4;
+                    for (size_t i = 0; i < (size_t)dst.width * 4; ++i)
+                        row[i] = encoders[i & 3]->Encode(filtered[i]);
+                }
+            };
+
+            const size_t grain = std::max<size_t>(1, kTexelsPerJob / dst.width);
+            if (jobs)
+                jobs->ParallelFor(dst.height, grain, filterRows);
+            else
+                filterRows(0, dst.height);
+        }
+        return true;
+    }
+}
@@ -3,6 +3,7 @@
 #include "graphics/GraphicsAPI.h"
 #include "vk/VkHelpers.h"
 
+#include <algorithm>
 #include <fstream>
 #include <vector>
 #include <stdexcept>
@@ -34,7 +35,8 @@ namespace eng
     {
         if (m_layout)
             return;
-        if (m_cameraSetLayout == VK_NULL_HANDLE || m_textureSetLayout == VK_NULL_HANDLE)
+        if (m_cameraSetLayout == VK_NULL_HANDLE || m_textureSetLayout == VK_NULL_HANDLE ||
+            m_lightSetLayout == VK_NULL_HANDLE || m_objectSetLayout == VK_NULL_HANDLE)
             throw std::runtime_error("SetLayout is null");
 
         VkPushConstantRange range{};
@@ -42,10 +44,11 @@ namespace eng
         range.offset = 0;
         range.size = sizeof(PushData);
 
-        VkDescriptorSetLayout setLayouts[] = {m_cameraSetLayout, m_textureSetLayout};
+        // Every program shares the same layout; shaders that ignore sets 2/3 stay compatible.
+        VkDescriptorSetLayout setLayouts[] = {m_cameraSetLayout, m_textureSetLayout, m_lightSetLayout, m_objectSetLayout};
 
         VkPipelineLayoutCreateInfo li{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
-        li.setLayoutCount = 2;
+        li.setLayoutCount = 4;
         li.pSetLayouts = setLayouts;
         li.pushConstantRangeCount = 1;
         li.pPushConstantRanges = &range;
@@ -57,17 +60,23 @@ namespace eng
     void ShaderProgram::Create(VkDevice device, VkRenderPass renderPass, VkExtent2D extent,
                                const VertexLayout &layout,
                                const std::string &vertSpv, const std::string &fragSpv,
-                               VkDescriptorSetLayout cameraSetLayout, VkDescriptorSetLayout textureSetLayout)
+                               VkDescriptorSetLayout cameraSetLayout, VkDescriptorSetLayout textureSetLayout,
+                               VkDescriptorSetLayout lightSetLayout, VkDescriptorSetLayout objectSetLayout)
     {
         m_device = device;
         m_renderPass = renderPass;
         m_extent = extent;
-        m_vlayout = layout;
+        m_inputs = layout;
+        m_variants.clear();
+        m_variants.push_back({layout, VK_NULL_HANDLE});
+        m_lastVariant = 0;
         m_vertPath = vertSpv;
         m_fragPath = fragSpv;
 
         m_cameraSetLayout = cameraSetLayout;
         m_textureSetLayout = textureSetLayout;
+        m_lightSetLayout = lightSetLayout;
+        m_objectSetLayout = objectSetLayout;
 
         createPipelineLayoutIfNeeded();
         recreatePipelineInternal();
@@ -82,14 +91,18 @@ namespace eng
 
     void ShaderProgram::recreatePipelineInternal()
     {
-        if (m_pipeline)
+        for (auto &variant : m_variants)
         {
-            vkDestroyPipeline(m_device, m_pipeline, nullptr);
-            m_pipeline = VK_NULL_HANDLE;
+            if (variant.pipeline)
+                vkDestroyPipeline(m_device, variant.pipeline, nullptr);
+            variant.pipeline = createPipeline(variant.layout);
         }
+    }
 
+    VkPipeline ShaderProgram::createPipeline(const VertexLayout &layout)
+    {
         VkShaderModule vert = loadModule(m_vertPath);
-        VkShaderModule frag = loadModule(m_fragPath);
+        VkShaderModule frag = m_fragPath.empty() ? VK_NULL_HANDLE : loadModule(m_fragPath);
 
         VkPipelineShaderStageCreateInfo stages[2]{};
         stages[0] = {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
@@ -102,27 +115,42 @@ namespace eng
         stages[1].module = frag;
         stages[1].pName = "main";
 
-        // Vertex input from your VertexLayout
-        VkVertexInputBindingDescription binding{};
-        binding.binding = 0;
-        binding.stride = m_vlayout.stride;
-        binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
+        // Vertex input from the mesh layout, limited to the locations this program
+        // reads. Streams that only feed other locations are not declared at all.
+        std::vector<VkVertexInputBindingDescription> bindings;
         std::vector<VkVertexInputAttributeDescription> attrs;
-        attrs.reserve(m_vlayout.elements.size());
-        for (const auto &e : m_vlayout.elements)
+        attrs.reserve(layout.elements.size());
+        for (const auto &e : layout.elements)
         {
+            const bool read = std::any_of(m_inputs.elements.begin(), m_inputs.elements.end(),
+                                          [&e](const VertexElement &input)
+                                          { return input.index == e.index; });
+            if (!read)
+                continue;
+
             VkVertexInputAttributeDescription a{};
             a.location = e.index;
-            a.binding = 0;
+            a.binding = e.binding;
             a.offset = e.offset;
             a.format = ToVkFormat(e.type, e.size);
             attrs.push_back(a);
+
+            const bool declared = std::any_of(bindings.begin(), bindings.end(),
+                                              [&e](const VkVertexInputBindingDescription &b)
+                                              { return b.binding == e.binding; });
+            if (!declared)
+            {
+                VkVertexInputBindingDescription binding{};
+                binding.binding = e.binding;
+                binding.stride = layout.GetStreamStride(e.binding);
+                binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+                bindings.push_back(binding);
+            }
         }
 
         VkPipelineVertexInputStateCreateInfo vi{VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
-        vi.vertexBindingDescriptionCount = 1;
-        vi.pVertexBindingDescriptions = &binding;
+        vi.vertexBindingDescriptionCount = (uint32_t)bindings.size();
+        vi.pVertexBindingDescriptions = bindings.data();
         vi.vertexAttributeDescriptionCount = (uint32_t)attrs.size();
         vi.pVertexAttributeDescriptions = attrs.data();
 
@@ -132,7 +160,8 @@ namespace eng
         VkPipelineDepthStencilStateCreateInfo ds{VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO};
         ds.depthTestEnable = VK_TRUE;
         ds.depthWriteEnable = VK_TRUE;
-        ds.depthCompareOp = VK_COMPARE_OP_LESS;
+        // LESS_OR_EQUAL so color passes still draw over a depth prepass
+        ds.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
         ds.depthBoundsTestEnable = VK_FALSE;
         ds.stencilTestEnable = VK_FALSE;
 
@@ -169,14 +198,15 @@ namespace eng
         ms.minSampleShading = 0.25f;
 
         VkPipelineColorBlendAttachmentState cbAtt{};
-        cbAtt.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+        if (frag)
+            cbAtt.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
 
         VkPipelineColorBlendStateCreateInfo cb{VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO};
         cb.attachmentCount = 1;
         cb.pAttachments = &cbAtt;
 
         VkGraphicsPipelineCreateInfo gp{VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
-        gp.stageCount = 2;
+        gp.stageCount = frag ? 2 : 1;
         gp.pStages = stages;
         gp.pVertexInputState = &vi;
         gp.pInputAssemblyState = &ia;
@@ -189,23 +219,29 @@ namespace eng
         gp.pDepthStencilState = &ds;
         gp.subpass = 0;
 
-        vkutil::vkCheck(vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &gp, nullptr, &m_pipeline),
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        vkutil::vkCheck(vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &gp, nullptr, &pipeline),
                         "vkCreateGraphicsPipelines failed");
 
         vkDestroyShaderModule(m_device, vert, nullptr);
-        vkDestroyShaderModule(m_device, frag, nullptr);
+        if (frag)
+            vkDestroyShaderModule(m_device, frag, nullptr);
+        return pipeline;
     }
 
     void ShaderProgram::Destroy()
     {
         if (m_device)
         {
-            if (m_pipeline)
-                vkDestroyPipeline(m_device, m_pipeline, nullptr);
+            for (auto &variant : m_variants)
+            {
+                if (variant.pipeline)
+                    vkDestroyPipeline(m_device, variant.pipeline, nullptr);
+            }
             if (m_layout)
                 vkDestroyPipelineLayout(m_device, m_layout, nullptr);
         }
-        m_pipeline = VK_NULL_HANDLE;
+        m_variants.clear();
         m_layout = VK_NULL_HANDLE;
         m_device = VK_NULL_HANDLE;
     }
@@ -217,7 +253,10 @@ namespace eng
         if (cmd == VK_NULL_HANDLE)
             return; // Bind called outside recording
 
-        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
+        // Most draws in a row share a vertex layout, start with the last one used
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_variants[m_lastVariant].pipeline);
+        m_boundVariant = m_lastVariant;
+        api.SetCurrentShaderProgram(this);
         VkDescriptorSet sets[2] = {
             api.GetCurrentCameraSet(),
             api.GetCurrentTextureSet()
@@ -228,12 +267,40 @@ namespace eng
             vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
                                     m_layout, 0, 2, sets, 0, nullptr);
         }
+
+        VkDescriptorSet lightSet = api.GetCurrentLightSet();
+        if (lightSet != VK_NULL_HANDLE)
+        {
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                    m_layout, 2, 1, &lightSet, 0, nullptr);
+        }
         api.SetCurrentPipelineLayout(m_layout);
 
         // optional: push current constants immediately
         pushConstantsNow();
     }
 
+    void ShaderProgram::BindVertexLayout(const VertexLayout &layout)
+    {
+        if (m_boundVariant < m_variants.size() && m_variants[m_boundVariant].layout == layout)
+            return;
+
+        uint32_t variant = 0;
+        while (variant < m_variants.size() && !(m_variants[variant].layout == layout))
+            ++variant;
+
+        // Created on first use, outside of any render pass state
+        if (variant == m_variants.size())
+            m_variants.push_back({layout, createPipeline(layout)});
+
+        VkCommandBuffer cmd = Engine::GetInstance().GetGraphicsAPI().GetCmd();
+        if (cmd != VK_NULL_HANDLE)
+            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_variants[variant].pipeline);
+
+        m_boundVariant = variant;
+        m_lastVariant = variant;
+    }
+
     void ShaderProgram::pushConstantsNow()
     {
         auto &api = Engine::GetInstance().GetGraphicsAPI();
@@ -289,14 +356,6 @@ namespace eng
         {
             m_pc.u_color = glm::vec4(v, 1.0f);
         }
-        else if (name == "uLight.position")
-        {
-            m_pc.u_lightPos = glm::vec4(v, 1.0f);
-        }
-        else if (name == "uLight.color")
-        {
-            m_pc.u_lightColor = glm::vec4(v, 1.0f);
-        }
         else if (name == "u_cameraPos")
         {
             m_pc.u_cameraPos = glm::vec4(v, 1.0f);
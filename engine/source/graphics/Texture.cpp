@@ -1,10 +1,14 @@
 #include "graphics/Texture.h"
 
+#include "graphics/BlockCompression.h"
+#include "graphics/MipGenerator.h"
+#include "graphics/TextureContainer.h"
 #include "vk/VkHelpers.h"
 #include "Engine.h"
 
 #include <stdexcept>
 #include <cstring>
+#include <iterator>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -28,13 +32,6 @@ namespace eng
         return view;
     }
 
-    static bool FormatSupportsLinearBlit(VkPhysicalDevice gpu, VkFormat format)
-    {
-        VkFormatProperties props{};
-        vkGetPhysicalDeviceFormatProperties(gpu, format, &props);
-        return (props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) != 0;
-    }
-
     void Texture::createSampler()
     {
         VkPhysicalDeviceProperties props{};
@@ -56,12 +53,27 @@ namespace eng
 
         si.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
         si.minLod = 0.0f;
-        si.maxLod = (float)(m_mipLevels > 0 ? (m_mipLevels - 1) : 0);
+        // The view limits the levels, so streaming can keep the sampler
+        si.maxLod = VK_LOD_CLAMP_NONE;
         si.mipLodBias = 0.0f;
 
         vkutil::vkCheck(vkCreateSampler(m_device, &si, nullptr, &m_sampler), "vkCreateSampler failed");
     }
 
+    static bool FormatSupportsSampling(VkPhysicalDevice gpu, VkFormat format)
+    {
+        VkFormatProperties props{};
+        vkGetPhysicalDeviceFormatProperties(gpu, format, &props);
+        return (props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+    }
+
+    // Single level RGBA8, containers without mips included
+    static bool NeedsMipChain(const TextureImage &image)
+    {
+        return image.levels.size() == 1 && (image.width > 1 || image.height > 1) &&
+               (image.format == VK_FORMAT_R8G8B8A8_UNORM || image.format == VK_FORMAT_R8G8B8A8_SRGB);
+    }
+
     bool Texture::LoadFromFile(VkPhysicalDevice gpu,
                                VkDevice device,
                                VkQueue graphicsQueue,
@@ -69,27 +81,175 @@ namespace eng
                                const std::filesystem::path &path,
                                bool srgb)
     {
-        m_gpu = gpu;
-        m_device = device;
+        TextureImage image;
+        if (!ReadImage(path, srgb, image))
+            return false;
+        return LoadFromImage(gpu, device, graphicsQueue, cmdPool, image);
+    }
+
+    bool Texture::LoadFromImage(VkPhysicalDevice gpu,
+                                VkDevice device,
+                                VkQueue graphicsQueue,
+                                VkCommandPool cmdPool,
+                                const TextureImage &source)
+    {
+        TextureImage image;
+        const TextureImage *prepared = &source;
+        if (!FormatSupportsSampling(gpu, source.format) || NeedsMipChain(source))
+        {
+            image = source;
+            if (!PrepareForDevice(gpu, image))
+                return false;
+            prepared = &image;
+        }
+
+        createImage(gpu, device, *prepared, 0);
+        return upload(*prepared, graphicsQueue, cmdPool);
+    }
+
+    bool Texture::ReadImage(const std::filesystem::path &path, bool srgb, TextureImage &out, std::filesystem::path *container)
+    {
+        const auto ext = path.extension().string();
+        const bool isContainer = ext == ".ktx2" || ext == ".dds";
+
+        std::filesystem::path containerPath = path;
+        if (!isContainer)
+            containerPath.replace_extension(".ktx2");
+
+        if (std::filesystem::exists(containerPath) && ReadTextureContainer(containerPath, srgb, out))
+        {
+            if (container)
+                *container = containerPath;
+            return true;
+        }
+        if (isContainer)
+            return false;
 
         int w = 0, h = 0, comp = 0;
         stbi_uc *pixels = stbi_load(path.string().c_str(), &w, &h, &comp, STBI_rgb_alpha);
         if (!pixels)
             return false;
 
-        m_width = (uint32_t)w;
-        m_height = (uint32_t)h;
+        out.format = srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+        out.width = (uint32_t)w;
+        out.height = (uint32_t)h;
+        out.levels = {{0, (size_t)w * (size_t)h * 4, out.width, out.height}};
+        out.data.assign(pixels, pixels + out.levels[0].size);
+        stbi_image_free(pixels);
+        // Usually called from a decode job, the nested ParallelFor is helped by the waiting worker
+        GenerateMipChain(out, &Engine::GetInstance().GetJobSystem());
+        return true;
+    }
+
+    bool Texture::PrepareForDevice(VkPhysicalDevice gpu, TextureImage &image)
+    {
+        if (!FormatSupportsSampling(gpu, image.format))
+        {
+            TextureImage decoded;
+            if (!DecompressTexture(image, decoded))
+            {
+                SDL_Log("Texture: format %d cannot be sampled or decoded", (int)image.format);
+                return false;
+            }
+            SDL_Log("Texture: format %d cannot be sampled, decoded to RGBA8", (int)image.format);
+            image = std::move(decoded);
+        }
+
+        if (NeedsMipChain(image))
+            GenerateMipChain(image, &Engine::GetInstance().GetJobSystem());
+        return true;
+    }
+
+    // Staging offset of a level, covers the texel block size of every format TextureImage holds
+    static VkDeviceSize AlignLevel(VkDeviceSize offset)
+    {
+        constexpr VkDeviceSize kAlignment = 16;
+        return (offset + kAlignment - 1) & ~(kAlignment - 1);
+    }
+
+    VkDeviceSize Texture::PackLevels(const TextureImage &image, uint32_t baseMip, uint8_t *dst)
+    {
+        VkDeviceSize size = 0;
+        for (size_t i = baseMip; i < image.levels.size(); ++i)
+        {
+            const auto &level = image.levels[i];
+            if (dst)
+                std::memcpy(dst + size, image.data.data() + level.offset, level.size);
+            size = AlignLevel(size + level.size);
+        }
+        return size;
+    }
+
+    void Texture::createImage(VkPhysicalDevice gpu, VkDevice device, const TextureImage &image, uint32_t baseMip)
+    {
+        m_gpu = gpu;
+        m_device = device;
+        m_width = image.width;
+        m_height = image.height;
+        m_format = image.format;
+
+        // Every level comes from the CPU (container or GenerateMipChain), one copy uploads them
+        m_nextMipLevels = (uint32_t)image.levels.size() - baseMip;
+        m_nextBaseMip = baseMip;
+
+        const VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        const auto &base = image.levels[baseMip];
+        vkutil::CreateImage(m_gpu, m_device, base.width, base.height, m_nextMipLevels, m_format, usage, m_nextImage, m_nextMemory);
 
-        m_format = srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+        VkMemoryRequirements req{};
+        vkGetImageMemoryRequirements(m_device, m_nextImage, &req);
+        m_nextMemorySize = req.size;
+    }
 
-        uint32_t desiredMip = 1u + (uint32_t)std::floor(std::log2(std::max(m_width, m_height)));
-        if (!FormatSupportsLinearBlit(m_gpu, m_format))
-            desiredMip = 1;
-        m_mipLevels = desiredMip;
+    void Texture::recordUpload(VkCommandBuffer cmd, VkBuffer staging, VkDeviceSize stagingOffset, const TextureImage &image)
+    {
+        std::vector<VkBufferImageCopy> regions;
+        VkDeviceSize offset = stagingOffset;
+        for (size_t i = m_nextBaseMip; i < image.levels.size(); ++i)
+        {
+            const auto &level = image.levels[i];
+            VkBufferImageCopy region{};
+            region.bufferOffset = offset;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = (uint32_t)(i - m_nextBaseMip);
+            region.imageSubresource.layerCount = 1;
+            region.imageExtent = {level.width, level.height, 1};
+            regions.push_back(region);
+
+            offset = stagingOffset + AlignLevel(offset - stagingOffset + level.size);
+        }
 
-        const VkDeviceSize imageSize = (VkDeviceSize)m_width * (VkDeviceSize)m_height * 4;
+        vkutil::TransitionImageLayout(cmd, m_nextImage,
+                                      VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT,
+                                      0, m_nextMipLevels);
+        vkCmdCopyBufferToImage(cmd, staging, m_nextImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               (uint32_t)regions.size(), regions.data());
+        vkutil::TransitionImageLayout(cmd, m_nextImage,
+                                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                      VK_IMAGE_ASPECT_COLOR_BIT, 0, m_nextMipLevels);
+    }
+
+    void Texture::finishUpload()
+    {
+        m_image = m_nextImage;
+        m_memory = m_nextMemory;
+        m_memorySize = m_nextMemorySize;
+        m_mipLevels = m_nextMipLevels;
+        m_baseMip = m_nextBaseMip;
+        m_nextImage = VK_NULL_HANDLE;
+        m_nextMemory = VK_NULL_HANDLE;
+
+        m_view = CreateImageView(m_device, m_image, m_format);
+        if (!m_sampler)
+            createSampler();
+        m_textureSet = Engine::GetInstance().GetVulkanContext().CreateTextureSet(m_view, m_sampler);
+        m_fallback.reset();
+    }
+
+    bool Texture::upload(const TextureImage &image, VkQueue graphicsQueue, VkCommandPool cmdPool)
+    {
+        const VkDeviceSize imageSize = PackLevels(image, m_nextBaseMip);
 
-        // staging buffer
         VkBuffer stagingBuf{};
         VkDeviceMemory stagingMem{};
         vkutil::CreateBuffer(m_gpu, m_device, imageSize,
@@ -99,29 +259,17 @@ namespace eng
 
         void *mapped = nullptr;
         vkutil::vkCheck(vkMapMemory(m_device, stagingMem, 0, imageSize, 0, &mapped), "vkMapMemory failed");
-        std::memcpy(mapped, pixels, (size_t)imageSize);
+        PackLevels(image, m_nextBaseMip, (uint8_t *)mapped);
         vkUnmapMemory(m_device, stagingMem);
 
-        stbi_image_free(pixels);
-
-        // device image
-        vkutil::CreateImage(m_gpu, m_device, m_width, m_height, m_mipLevels, m_format,
-                            VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-                            m_image, m_memory);
-
         VkCommandBuffer cmd = vkutil::BeginOneTime(m_device, cmdPool);
-        vkutil::TransitionImageLayout(cmd, m_image,
-                                      VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT,
-                                      0, 1);
-        vkutil::CopyBufferToImage(cmd, stagingBuf, m_image, m_width, m_height);
-        vkutil::GenerateMipmaps(m_gpu, cmd, m_image, m_format, (int32_t)m_width, (int32_t)m_height, m_mipLevels);
+        recordUpload(cmd, stagingBuf, 0, image);
         vkutil::EndOneTime(m_device, graphicsQueue, cmdPool, cmd);
 
         vkDestroyBuffer(m_device, stagingBuf, nullptr);
         vkFreeMemory(m_device, stagingMem, nullptr);
 
-        m_view = CreateImageView(m_device, m_image, m_format);
-        createSampler();
+        finishUpload();
         return true;
     }
 
@@ -146,6 +294,11 @@ namespace eng
         if (!m_device)
             return;
 
+        if (m_textureSet)
+        {
+            Engine::GetInstance().GetVulkanContext().FreeTextureSet(m_textureSet);
+            m_textureSet = VK_NULL_HANDLE;
+        }
         if (m_sampler)
         {
             vkDestroySampler(m_device, m_sampler, nullptr);
@@ -166,7 +319,20 @@ namespace eng
             vkFreeMemory(m_device, m_memory, nullptr);
             m_memory = VK_NULL_HANDLE;
         }
+        if (m_nextImage)
+        {
+            vkDestroyImage(m_device, m_nextImage, nullptr);
+            m_nextImage = VK_NULL_HANDLE;
+        }
+        if (m_nextMemory)
+        {
+            vkFreeMemory(m_device, m_nextMemory, nullptr);
+            m_nextMemory = VK_NULL_HANDLE;
+        }
 
+        m_fallback.reset();
+        m_source.reset();
+        m_sourceFile.clear();
         m_device = VK_NULL_HANDLE;
         m_gpu = VK_NULL_HANDLE;
     }
@@ -194,4 +360,344 @@ namespace eng
         return tex;
     }
 
+
+    // Staging bytes one Update may submit. A larger texture goes alone.
+    static constexpr VkDeviceSize kUploadBudget = 64ull << 20;
+
+    std::shared_ptr<Texture> TextureManager::GetOrLoadTextureAsync(const std::string &path)
+    {
+        const std::string key = std::filesystem::path(path).lexically_normal().generic_string();
+
+        if (auto it = m_textures.find(key); it != m_textures.end())
+        {
+            if (auto sp = it->second.lock())
+                return sp;
+        }
+
+        if (!m_placeholder)
+            createPlaceholder();
+
+        auto tex = std::make_shared<Texture>();
+        tex->m_fallback = m_placeholder;
+        m_textures[key] = tex;
+        ++m_pending;
+
+        const auto fullPath = Engine::GetInstance().GetFileSystem().GetAssetsFolder() / key;
+        const VkPhysicalDevice gpu = Engine::GetInstance().GetVulkanContext().GetGPU();
+
+        // The job holds the texture, so a request that arrives while this one
+        // is in flight finds it in m_textures
+        auto decode = [this, tex, fullPath, gpu]()
+        {
+            DecodedTexture decoded;
+            decoded.texture = tex;
+            std::filesystem::path container;
+            decoded.ok = Texture::ReadImage(fullPath, true, decoded.image, &container) &&
+                         Texture::PrepareForDevice(gpu, decoded.image);
+            if (!decoded.ok)
+                SDL_Log("TextureManager: failed to load '%s'", fullPath.string().c_str());
+            // Decoded formats and generated levels are not in the file
+            else if (decoded.image.fileOffsets.size() == decoded.image.levels.size())
+                decoded.container = std::move(container);
+
+            std::lock_guard lock(m_decodedMutex);
+            m_decoded.push_back(std::move(decoded));
+        };
+        Engine::GetInstance().GetJobSystem().Run(decode, &m_decodeJobs);
+
+        return tex;
+    }
+
+    void TextureManager::Update()
+    {
+        auto &vk = Engine::GetInstance().GetVulkanContext();
+
+        // The queue completes batches in submission order
+        size_t finished = 0;
+        while (finished < m_batches.size() && vkGetFenceStatus(vk.GetDevice(), m_batches[finished].fence) == VK_SUCCESS)
+        {
+            for (auto &texture : m_batches[finished].textures)
+            {
+                if (texture->IsResident())
+                {
+                    // Frames still in flight sample the previous levels
+                    m_retired.push_back({texture->m_image, texture->m_memory, texture->m_view, texture->m_textureSet, kRetireFrames});
+                    texture->m_image = VK_NULL_HANDLE;
+                    texture->m_memory = VK_NULL_HANDLE;
+                    texture->m_view = VK_NULL_HANDLE;
+                    texture->m_textureSet = VK_NULL_HANDLE;
+                }
+                else
+                {
+                    --m_pending;
+                }
+                texture->finishUpload();
+            }
+            destroyBatch(m_batches[finished]);
+            ++finished;
+        }
+        m_batches.erase(m_batches.begin(), m_batches.begin() + finished);
+
+        std::vector<Upload> uploads;
+        VkDeviceSize bytes = 0;
+
+        std::vector<TextureStreamer::Transition> transitions;
+        m_streamer.Update(kUploadBudget, transitions);
+        for (auto &transition : transitions)
+        {
+            Texture &texture = *transition.texture;
+            if (texture.m_sourceFile.empty())
+            {
+                bytes += Texture::PackLevels(*texture.m_source, transition.baseMip);
+                auto image = texture.m_source;
+                uploads.push_back({std::move(transition.texture), std::move(image), transition.baseMip});
+                continue;
+            }
+
+            // The levels come from the file on a job, uploaded by a later Update
+            texture.m_reading = true;
+            texture.m_nextBaseMip = transition.baseMip;
+            auto read = [this, tex = std::move(transition.texture), file = texture.m_sourceFile,
+                         source = texture.m_source, baseMip = transition.baseMip]()
+            {
+                ReadLevels levels;
+                levels.texture = tex;
+                levels.baseMip = baseMip;
+                levels.ok = ReadTextureLevels(file, *source, baseMip, levels.image);
+                if (!levels.ok)
+                    SDL_Log("TextureManager: failed to read levels %u.. of '%s'", baseMip, file.string().c_str());
+
+                std::lock_guard lock(m_decodedMutex);
+                m_read.push_back(std::move(levels));
+            };
+            Engine::GetInstance().GetJobSystem().Run(read, &m_decodeJobs);
+        }
+
+        std::vector<ReadLevels> read;
+        std::vector<DecodedTexture> decoded;
+        {
+            std::lock_guard lock(m_decodedMutex);
+            // Already within the budget the streamer was given
+            read.swap(m_read);
+            for (const auto &levels : read)
+            {
+                if (levels.ok)
+                    bytes += Texture::PackLevels(levels.image, levels.baseMip);
+            }
+
+            size_t taken = 0;
+            for (; taken < m_decoded.size(); ++taken)
+            {
+                const auto &image = m_decoded[taken].image;
+                bytes += Texture::PackLevels(image, image.levels.size() > 1 ? TextureStreamer::GetTailMip(image) : 0);
+                if ((taken > 0 || !uploads.empty() || !read.empty()) && bytes > kUploadBudget)
+                    break;
+            }
+            decoded.assign(std::make_move_iterator(m_decoded.begin()), std::make_move_iterator(m_decoded.begin() + taken));
+            m_decoded.erase(m_decoded.begin(), m_decoded.begin() + taken);
+        }
+
+        // A file that cannot be read again keeps the levels it has and stops streaming
+        for (auto &levels : read)
+        {
+            levels.texture->m_reading = false;
+            if (!levels.ok)
+            {
+                levels.texture->m_source.reset();
+                levels.texture->m_sourceFile.clear();
+                continue;
+            }
+            if (levels.texture.use_count() == 1)
+                continue;
+            auto image = std::make_shared<const TextureImage>(std::move(levels.image));
+            uploads.push_back({std::move(levels.texture), std::move(image), levels.baseMip});
+        }
+
+        // Failed loads keep the placeholder, dropped ones are not worth the copy
+        for (auto &d : decoded)
+        {
+            if (!d.ok || d.texture.use_count() == 1)
+            {
+                --m_pending;
+                continue;
+            }
+
+            auto image = std::make_shared<const TextureImage>(std::move(d.image));
+            uint32_t baseMip = 0;
+            if (image->levels.size() > 1)
+            {
+                // Only the tail for now, the streamer asks for the rest
+                if (d.container.empty())
+                {
+                    d.texture->m_source = image;
+                }
+                else
+                {
+                    // The file holds the levels, keep their layout only
+                    auto layout = std::make_shared<TextureImage>();
+                    layout->format = image->format;
+                    layout->width = image->width;
+                    layout->height = image->height;
+                    layout->levels = image->levels;
+                    layout->fileOffsets = image->fileOffsets;
+                    d.texture->m_source = std::move(layout);
+                    d.texture->m_sourceFile = std::move(d.container);
+                }
+                baseMip = TextureStreamer::GetTailMip(*image);
+                m_streamer.Add(d.texture);
+            }
+            uploads.push_back({std::move(d.texture), std::move(image), baseMip});
+        }
+
+        if (!uploads.empty())
+            submitBatch(uploads);
+    }
+
+    void TextureManager::NextFrame()
+    {
+        for (size_t i = 0; i < m_retired.size();)
+        {
+            auto &retired = m_retired[i];
+            if (--retired.framesLeft == 0)
+            {
+                destroyRetired(retired);
+                retired = m_retired.back();
+                m_retired.pop_back();
+            }
+            else
+            {
+                ++i;
+            }
+        }
+    }
+
+    void TextureManager::submitBatch(std::vector<Upload> &uploads)
+    {
+        auto &vk = Engine::GetInstance().GetVulkanContext();
+        const VkDevice device = vk.GetDevice();
+
+        std::vector<VkDeviceSize> offsets(uploads.size());
+        VkDeviceSize size = 0;
+        for (size_t i = 0; i < uploads.size(); ++i)
+        {
+            offsets[i] = size;
+            size += Texture::PackLevels(*uploads[i].image, uploads[i].baseMip);
+        }
+
+        UploadBatch batch;
+        vkutil::CreateBuffer(vk.GetGPU(), device, size,
+                             VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                             batch.staging, batch.stagingMemory);
+
+        uint8_t *mapped = nullptr;
+        vkutil::vkCheck(vkMapMemory(device, batch.stagingMemory, 0, size, 0, (void **)&mapped), "vkMapMemory failed");
+        for (size_t i = 0; i < uploads.size(); ++i)
+            Texture::PackLevels(*uploads[i].image, uploads[i].baseMip, mapped + offsets[i]);
+        vkUnmapMemory(device, batch.stagingMemory);
+
+        if (!m_uploadPool)
+        {
+            // Own pool, the swapchain one is reset while batches may be pending
+            VkCommandPoolCreateInfo ci{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+            ci.queueFamilyIndex = vk.GetGraphicsQueueFamily();
+            ci.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            vkutil::vkCheck(vkCreateCommandPool(device, &ci, nullptr, &m_uploadPool), "vkCreateCommandPool (upload) failed");
+        }
+
+        VkCommandBufferAllocateInfo ai{VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+        ai.commandPool = m_uploadPool;
+        ai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        ai.commandBufferCount = 1;
+        vkutil::vkCheck(vkAllocateCommandBuffers(device, &ai, &batch.cmd), "vkAllocateCommandBuffers (upload) failed");
+
+        VkCommandBufferBeginInfo bi{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+        bi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkutil::vkCheck(vkBeginCommandBuffer(batch.cmd, &bi), "vkBeginCommandBuffer (upload) failed");
+
+        for (size_t i = 0; i < uploads.size(); ++i)
+        {
+            auto &texture = *uploads[i].texture;
+            texture.createImage(vk.GetGPU(), device, *uploads[i].image, uploads[i].baseMip);
+            texture.recordUpload(batch.cmd, batch.staging, offsets[i], *uploads[i].image);
+            batch.textures.push_back(std::move(uploads[i].texture));
+        }
+
+        vkutil::vkCheck(vkEndCommandBuffer(batch.cmd), "vkEndCommandBuffer (upload) failed");
+
+        VkFenceCreateInfo fi{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+        vkutil::vkCheck(vkCreateFence(device, &fi, nullptr, &batch.fence), "vkCreateFence (upload) failed");
+
+        VkSubmitInfo si{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+        si.commandBufferCount = 1;
+        si.pCommandBuffers = &batch.cmd;
+        vkutil::vkCheck(vkQueueSubmit(vk.GetGraphicsQueue(), 1, &si, batch.fence), "vkQueueSubmit (upload) failed");
+
+        m_batches.push_back(std::move(batch));
+    }
+
+    void TextureManager::destroyBatch(UploadBatch &batch)
+    {
+        const VkDevice device = Engine::GetInstance().GetVulkanContext().GetDevice();
+        vkDestroyFence(device, batch.fence, nullptr);
+        vkFreeCommandBuffers(device, m_uploadPool, 1, &batch.cmd);
+        vkDestroyBuffer(device, batch.staging, nullptr);
+        vkFreeMemory(device, batch.stagingMemory, nullptr);
+        batch = {};
+    }
+
+    void TextureManager::destroyRetired(RetiredImage &retired)
+    {
+        auto &vk = Engine::GetInstance().GetVulkanContext();
+        vk.FreeTextureSet(retired.set);
+        vkDestroyImageView(vk.GetDevice(), retired.view, nullptr);
+        vkDestroyImage(vk.GetDevice(), retired.image, nullptr);
+        vkFreeMemory(vk.GetDevice(), retired.memory, nullptr);
+    }
+
+    void TextureManager::createPlaceholder()
+    {
+        // Opaque white, materials multiply it away
+        TextureImage image;
+        image.format = VK_FORMAT_R8G8B8A8_UNORM;
+        image.width = 1;
+        image.height = 1;
+        image.levels = {{0, 4, 1, 1}};
+        image.data.assign(4, 255);
+
+        auto &vk = Engine::GetInstance().GetVulkanContext();
+        m_placeholder = std::make_shared<Texture>();
+        m_placeholder->LoadFromImage(vk.GetGPU(), vk.GetDevice(), vk.GetGraphicsQueue(), vk.GetCommandPool(), image);
+    }
+
+    void TextureManager::Destroy()
+    {
+        Engine::GetInstance().GetJobSystem().Wait(m_decodeJobs);
+        m_decoded.clear();
+        m_read.clear();
+
+        const VkDevice device = Engine::GetInstance().GetVulkanContext().GetDevice();
+        for (auto &batch : m_batches)
+        {
+            vkWaitForFences(device, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+            destroyBatch(batch);
+        }
+        m_batches.clear();
+
+        for (auto &retired : m_retired)
+            destroyRetired(retired);
+        m_retired.clear();
+        m_streamer.Clear();
+
+        if (m_uploadPool)
+        {
+            vkDestroyCommandPool(device, m_uploadPool, nullptr);
+            m_uploadPool = VK_NULL_HANDLE;
+        }
+
+        m_placeholder.reset();
+        m_textures.clear();
+        m_pending = 0;
+    }
+
 }
\ No newline at end of file
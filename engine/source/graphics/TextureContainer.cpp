@@ -0,0 +1,465 @@
+#include "graphics/TextureContainer.h"
+
+#include <SDL3/SDL.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace eng
+{
+    bool IsBlockCompressed(VkFormat format)
+    {
+        return format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK;
+    }
+
+    bool IsSrgbFormat(VkFormat format)
+    {
+        switch (format)
+        {
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        case VK_FORMAT_BC2_SRGB_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    uint32_t FormatBlockBytes(VkFormat format)
+    {
+        switch (format)
+        {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+            return 4;
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+        case VK_FORMAT_BC4_SNORM_BLOCK:
+            return 8;
+        case VK_FORMAT_BC2_UNORM_BLOCK:
+        case VK_FORMAT_BC2_SRGB_BLOCK:
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+        case VK_FORMAT_BC5_SNORM_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            return 16;
+        default:
+            return 0;
+        }
+    }
+
+    size_t TextureLevelSize(VkFormat format, uint32_t width, uint32_t height)
+    {
+        const size_t bytes = FormatBlockBytes(format);
+        if (!IsBlockCompressed(format))
+            return (size_t)width * height * bytes;
+        return (size_t)((width + 3) / 4) * ((height + 3) / 4) * bytes;
+    }
+
+    // Larger than any device's image limit, keeps level sizes far from overflowing size_t
+    static constexpr uint32_t kMaxDimension = 1u << 16;
+
+    // Down to 1x1: floor(log2(max(width, height))) + 1
+    static uint32_t MaxLevelCount(uint32_t width, uint32_t height)
+    {
+        uint32_t count = 1;
+        for (uint32_t side = std::max(width, height); side > 1; side >>= 1)
+            ++count;
+        return count;
+    }
+
+    // Headers are untrusted: the level count must fit the size before anything is allocated
+    static bool IsValidExtent(uint32_t width, uint32_t height, uint32_t levelCount)
+    {
+        return width > 0 && height > 0 && width <= kMaxDimension && height <= kMaxDimension &&
+               levelCount <= MaxLevelCount(width, height);
+    }
+
+    template <typename T>
+    static T ReadAt(const std::vector<char> &file, size_t offset)
+    {
+        T value{};
+        std::memcpy(&value, file.data() + offset, sizeof(T));
+        return value;
+    }
+
+    bool ReadKtx2(const std::vector<char> &file, TextureImage &out)
+    {
+        static constexpr uint8_t kIdentifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+        // Identifier, 9 header words, dfd/kvd offsets and sizes, sgd offset and size
+        static constexpr size_t kLevelIndexOffset = 12 + 9 * 4 + 4 * 4 + 2 * 8;
+
+        if (file.size() < kLevelIndexOffset || std::memcmp(file.data(), kIdentifier, sizeof(kIdentifier)) != 0)
+            return false;
+
+        const auto vkFormat = ReadAt<uint32_t>(file, 12);
+        const auto width = ReadAt<uint32_t>(file, 20);
+        const auto height = ReadAt<uint32_t>(file, 24);
+        const auto depth = ReadAt<uint32_t>(file, 28);
+        const auto layers = ReadAt<uint32_t>(file, 32);
+        const auto faces = ReadAt<uint32_t>(file, 36);
+        const auto levelCount = std::max(ReadAt<uint32_t>(file, 40), 1u);
+        const auto supercompression = ReadAt<uint32_t>(file, 44);
+
+        out.format = (VkFormat)vkFormat;
+        if (FormatBlockBytes(out.format) == 0 || depth > 1 || layers > 1 || faces != 1 || supercompression != 0)
+        {
+            SDL_Log("ReadKtx2: unsupported format %u or layout (supercompression %u)", vkFormat, supercompression);
+            return false;
+        }
+        if (!IsValidExtent(width, height, levelCount) || file.size() < kLevelIndexOffset + (size_t)levelCount * 24)
+            return false;
+
+        out.width = width;
+        out.height = height;
+        out.levels.resize(levelCount);
+
+        size_t total = 0;
+        for (uint32_t i = 0; i < levelCount; ++i)
+        {
+            auto &level = out.levels[i];
+            level.width = std::max(width >> i, 1u);
+            level.height = std::max(height >> i, 1u);
+            level.size = TextureLevelSize(out.format, level.width, level.height);
+            level.offset = total;
+            total += level.size;
+        }
+
+        // Levels are stored smallest first in the file, the index says where.
+        // Written so a crafted offset cannot wrap around.
+        for (uint32_t i = 0; i < levelCount; ++i)
+        {
+            const auto offset = ReadAt<uint64_t>(file, kLevelIndexOffset + i * 24);
+            const auto length = ReadAt<uint64_t>(file, kLevelIndexOffset + i * 24 + 8);
+            if (length != out.levels[i].size || offset > file.size() || length > file.size() - offset)
+                return false;
+        }
+
+        out.data.resize(total);
+        out.fileOffsets.resize(levelCount);
+        for (uint32_t i = 0; i < levelCount; ++i)
+        {
+            const auto offset = ReadAt<uint64_t>(file, kLevelIndexOffset + i * 24);
+            const auto &level = out.levels[i];
+            std::memcpy(out.data.data() + level.offset, file.data() + offset, level.size);
+            out.fileOffsets[i] = (size_t)offset;
+        }
+        return true;
+    }
+
+    static constexpr uint32_t FourCC(char a, char b, char c, char d)
+    {
+        return (uint32_t)(uint8_t)a | (uint32_t)(uint8_t)b << 8 | (uint32_t)(uint8_t)c << 16 | (uint32_t)(uint8_t)d << 24;
+    }
+
+    static VkFormat DxgiToVkFormat(uint32_t dxgi)
+    {
+        switch (dxgi)
+        {
+        case 28:
+            return VK_FORMAT_R8G8B8A8_UNORM;
+        case 29:
+            return VK_FORMAT_R8G8B8A8_SRGB;
+        case 71:
+            return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+        case 72:
+            return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+        case 74:
+            return VK_FORMAT_BC2_UNORM_BLOCK;
+        case 75:
+            return VK_FORMAT_BC2_SRGB_BLOCK;
+        case 77:
+            return VK_FORMAT_BC3_UNORM_BLOCK;
+        case 78:
+            return VK_FORMAT_BC3_SRGB_BLOCK;
+        case 80:
+            return VK_FORMAT_BC4_UNORM_BLOCK;
+        case 81:
+            return VK_FORMAT_BC4_SNORM_BLOCK;
+        case 83:
+            return VK_FORMAT_BC5_UNORM_BLOCK;
+        case 84:
+            return VK_FORMAT_BC5_SNORM_BLOCK;
+        case 98:
+            return VK_FORMAT_BC7_UNORM_BLOCK;
+        case 99:
+            return VK_FORMAT_BC7_SRGB_BLOCK;
+        default:
+            return VK_FORMAT_UNDEFINED;
+        }
+    }
+
+    bool ReadDds(const std::vector<char> &file, bool srgb, TextureImage &out)
+    {
+        // Magic, DDS_HEADER, optional DDS_HEADER_DXT10
+        static constexpr size_t kHeaderSize = 4 + 124;
+        static constexpr uint32_t kPixelFormatFourCC = 0x4;
+
+        if (file.size() < kHeaderSize || ReadAt<uint32_t>(file, 0) != FourCC('D', 'D', 'S', ' '))
+            return false;
+
+        const auto height = ReadAt<uint32_t>(file, 12);
+        const auto width = ReadAt<uint32_t>(file, 16);
+        const auto mipCount = std::max(ReadAt<uint32_t>(file, 28), 1u);
+        const auto pfFlags = ReadAt<uint32_t>(file, 80);
+        const auto fourCC = ReadAt<uint32_t>(file, 84);
+
+        size_t dataOffset = kHeaderSize;
+        out.format = VK_FORMAT_UNDEFINED;
+
+        if (pfFlags & kPixelFormatFourCC)
+        {
+            if (fourCC == FourCC('D', 'X', '1', '0'))
+            {
+                if (file.size() < kHeaderSize + 20)
+                    return false;
+                const auto dimension = ReadAt<uint32_t>(file, kHeaderSize + 4);
+                const auto arraySize = ReadAt<uint32_t>(file, kHeaderSize + 12);
+                // D3D10_RESOURCE_DIMENSION_TEXTURE2D
+                if (dimension != 3 || arraySize > 1)
+                    return false;
+                out.format = DxgiToVkFormat(ReadAt<uint32_t>(file, kHeaderSize));
+                dataOffset += 20;
+            }
+            else if (fourCC == FourCC('D', 'X', 'T', '1'))
+                out.format = srgb ? VK_FORMAT_BC1_RGBA_SRGB_BLOCK : VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+            else if (fourCC == FourCC('D', 'X', 'T', '5'))
+                out.format = srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+            else if (fourCC == FourCC('A', 'T', 'I', '1') || fourCC == FourCC('B', 'C', '4', 'U'))
+                out.format = VK_FORMAT_BC4_UNORM_BLOCK;
+            else if (fourCC == FourCC('A', 'T', 'I', '2') || fourCC == FourCC('B', 'C', '5', 'U'))
+                out.format = VK_FORMAT_BC5_UNORM_BLOCK;
+        }
+
+        if (out.format == VK_FORMAT_UNDEFINED)
+        {
+            SDL_Log("ReadDds: unsupported pixel format");
+            return false;
+        }
+        if (!IsValidExtent(width, height, mipCount))
+            return false;
+
+        out.width = width;
+        out.height = height;
+        out.levels.resize(mipCount);
+
+        // Levels follow each other largest first, same order as TextureImage
+        size_t total = 0;
+        for (uint32_t i = 0; i < mipCount; ++i)
+        {
+            auto &level = out.levels[i];
+            level.width = std::max(width >> i, 1u);
+            level.height = std::max(height >> i, 1u);
+            level.size = TextureLevelSize(out.format, level.width, level.height);
+            level.offset = total;
+            total += level.size;
+        }
+
+        if (dataOffset > file.size() || total > file.size() - dataOffset)
+            return false;
+
+        out.data.assign(file.begin() + dataOffset, file.begin() + dataOffset + total);
+        out.fileOffsets.resize(mipCount);
+        for (uint32_t i = 0; i < mipCount; ++i)
+            out.fileOffsets[i] = dataOffset + out.levels[i].offset;
+        return true;
+    }
+
+    // Basic data format descriptor sample: bit range, channel id and
+    // qualifiers in the top nibble
+    struct DfdSample
+    {
+        uint32_t offset;
+        uint32_t length;
+        uint32_t channel;
+        uint32_t qualifiers;
+    };
+
+    static std::vector<uint32_t> BuildDfd(VkFormat format)
+    {
+        // khr_df_model_e, channel ids and qualifier bits from the Khronos Data Format spec
+        static constexpr uint32_t kModelRgbsda = 1, kModelBc1a = 128, kModelBc2 = 129, kModelBc3 = 130, kModelBc4 = 131, kModelBc5 = 132, kModelBc7 = 134;
+        static constexpr uint32_t kChannelAlpha = 15;
+        static constexpr uint32_t kLinear = 0x1;
+
+        const bool srgb = IsSrgbFormat(format);
+        // Alpha is never sRGB encoded
+        const uint32_t alphaQualifiers = srgb ? kLinear : 0;
+
+        uint32_t model = 0;
+        std::vector<DfdSample> samples;
+        switch (format)
+        {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+            model = kModelRgbsda;
+            samples = {{0, 8, 0, 0}, {8, 8, 1, 0}, {16, 8, 2, 0}, {24, 8, kChannelAlpha, alphaQualifiers}};
+            break;
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            model = kModelBc1a;
+            samples = {{0, 64, 0, 0}};
+            break;
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+            // Channel 1 marks the punch through alpha as used
+            model = kModelBc1a;
+            samples = {{0, 64, 1, 0}};
+            break;
+        case VK_FORMAT_BC2_UNORM_BLOCK:
+        case VK_FORMAT_BC2_SRGB_BLOCK:
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+            model = format == VK_FORMAT_BC2_UNORM_BLOCK || format == VK_FORMAT_BC2_SRGB_BLOCK ? kModelBc2 : kModelBc3;
+            samples = {{0, 64, kChannelAlpha, alphaQualifiers}, {64, 64, 0, 0}};
+            break;
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+            model = kModelBc4;
+            samples = {{0, 64, 0, 0}};
+            break;
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+            model = kModelBc5;
+            samples = {{0, 64, 0, 0}, {64, 64, 1, 0}};
+            break;
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            model = kModelBc7;
+            samples = {{0, 128, 0, 0}};
+            break;
+        default:
+            return {};
+        }
+
+        const bool block = IsBlockCompressed(format);
+        const uint32_t blockSize = 24 + 16 * (uint32_t)samples.size();
+        std::vector<uint32_t> dfd;
+        dfd.push_back(4 + blockSize);
+        // Khronos vendor, basic descriptor type, version 1.3
+        dfd.push_back(0);
+        dfd.push_back(2 | blockSize << 16);
+        // BT.709 primaries, linear (1) or sRGB (2) transfer, straight alpha
+        dfd.push_back(model | 1u << 8 | (srgb ? 2u : 1u) << 16);
+        // Block dimensions minus one
+        dfd.push_back(block ? 3 | 3 << 8 : 0);
+        dfd.push_back(FormatBlockBytes(format));
+        dfd.push_back(0);
+        for (const auto &sample : samples)
+        {
+            dfd.push_back(sample.offset | (sample.length - 1) << 16 | sample.channel << 24 | sample.qualifiers << 28);
+            dfd.push_back(0);
+            dfd.push_back(0);
+            dfd.push_back(block ? 0xFFFFFFFFu : 255u);
+        }
+        return dfd;
+    }
+
+    bool WriteKtx2(const std::filesystem::path &path, const TextureImage &image)
+    {
+        static constexpr uint8_t kIdentifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+        static constexpr size_t kLevelIndexOffset = 12 + 9 * 4 + 4 * 4 + 2 * 8;
+
+        const auto dfd = BuildDfd(image.format);
+        if (dfd.empty() || image.levels.empty())
+        {
+            SDL_Log("WriteKtx2: unsupported format %d", (int)image.format);
+            return false;
+        }
+
+        const uint32_t levelCount = (uint32_t)image.levels.size();
+        const size_t dfdOffset = kLevelIndexOffset + levelCount * 24;
+        const size_t dfdSize = dfd.size() * 4;
+        // Levels start on a multiple of the block size, smallest level first
+        const size_t alignment = FormatBlockBytes(image.format);
+
+        std::vector<char> file(dfdOffset + dfdSize);
+        auto writeAt = [&](size_t offset, auto value)
+        { std::memcpy(file.data() + offset, &value, sizeof(value)); };
+
+        std::memcpy(file.data(), kIdentifier, sizeof(kIdentifier));
+        writeAt(12, (uint32_t)image.format);
+        // typeSize, width, height, depth, layers, faces, levels, supercompression
+        const uint32_t header[8] = {1, image.width, image.height, 0, 0, 1, levelCount, 0};
+        std::memcpy(file.data() + 16, header, sizeof(header));
+        writeAt(48, (uint32_t)dfdOffset);
+        writeAt(52, (uint32_t)dfdSize);
+        std::memcpy(file.data() + dfdOffset, dfd.data(), dfdSize);
+
+        for (uint32_t i = levelCount; i-- > 0;)
+        {
+            const auto &level = image.levels[i];
+            file.resize((file.size() + alignment - 1) / alignment * alignment);
+            writeAt(kLevelIndexOffset + i * 24, (uint64_t)file.size());
+            writeAt(kLevelIndexOffset + i * 24 + 8, (uint64_t)level.size);
+            writeAt(kLevelIndexOffset + i * 24 + 16, (uint64_t)level.size);
+            file.insert(file.end(), image.data.begin() + level.offset, image.data.begin() + level.offset + level.size);
+        }
+
+        std::ofstream stream(path, std::ios::binary);
+        if (!stream || !stream.write(file.data(), (std::streamsize)file.size()))
+        {
+            SDL_Log("WriteKtx2: failed to write %s", path.string().c_str());
+            return false;
+        }
+        return true;
+    }
+
+    bool ReadTextureContainer(const std::filesystem::path &path, bool srgb, TextureImage &out)
+    {
+        std::ifstream stream(path, std::ios::binary | std::ios::ate);
+        if (!stream)
+            return false;
+
+        std::vector<char> file((size_t)stream.tellg());
+        stream.seekg(0);
+        if (!stream.read(file.data(), (std::streamsize)file.size()))
+            return false;
+
+        const auto ext = path.extension().string();
+        if (ext == ".ktx2")
+            return ReadKtx2(file, out);
+        if (ext == ".dds")
+            return ReadDds(file, srgb, out);
+        return false;
+    }
+
+    bool ReadTextureLevels(const std::filesystem::path &path, const TextureImage &image, uint32_t firstLevel, TextureImage &out)
+    {
+        if (firstLevel >= image.levels.size() || image.fileOffsets.size() != image.levels.size())
+            return false;
+
+        out.format = image.format;
+        out.width = image.width;
+        out.height = image.height;
+        out.levels = image.levels;
+        out.fileOffsets = image.fileOffsets;
+
+        size_t total = 0;
+        for (size_t i = firstLevel; i < out.levels.size(); ++i)
+        {
+            out.levels[i].offset = total;
+            total += out.levels[i].size;
+        }
+        out.data.resize(total);
+
+        std::ifstream stream(path, std::ios::binary);
+        if (!stream)
+            return false;
+        for (size_t i = firstLevel; i < out.levels.size(); ++i)
+        {
+            const auto &level = out.levels[i];
+            stream.seekg((std::streamoff)out.fileOffsets[i]);
+            if (!stream.read((char *)out.data.data() + level.offset, (std::streamsize)level.size))
+                return false;
+        }
+        return true;
+    }
+}
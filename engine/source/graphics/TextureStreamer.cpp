@@ -0,0 +1,188 @@
+#include "graphics/TextureStreamer.h"
+
+#include "graphics/Texture.h"
+#include "render/Frustum.h"
+#include "render/Material.h"
+#include "render/Mesh.h"
+#include "render/RenderScene.h"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace eng
+{
+    uint32_t TextureStreamer::GetTailMip(const TextureImage &image)
+    {
+        for (uint32_t i = 0; i < (uint32_t)image.levels.size(); ++i)
+        {
+            if (std::max(image.levels[i].width, image.levels[i].height) <= kTailSize)
+                return i;
+        }
+        return image.levels.empty() ? 0 : (uint32_t)image.levels.size() - 1;
+    }
+
+    void TextureStreamer::Add(const std::shared_ptr<Texture> &texture)
+    {
+        m_textures.push_back(texture);
+    }
+
+    void TextureStreamer::RequestMips(const RenderScene &renderScene, const CameraData &camera, float viewportHeight)
+    {
+        const Frustum frustum = Frustum::FromMatrix(camera.projectionMatrix * camera.viewMatrix);
+        // Screen pixels per world unit at distance 1
+        const float pixelsPerUnit = viewportHeight * 0.5f * std::abs(camera.projectionMatrix[1][1]);
+
+        for (const auto &proxy : renderScene.GetProxies())
+        {
+            if (!proxy.mesh || !proxy.material || proxy.imposter)
+                continue;
+
+            Texture *texture = proxy.material->GetTexture().get();
+            const float uvDensity = proxy.mesh->GetUvDensity();
+            if (!texture || !texture->m_source || uvDensity <= 0.f || !frustum.Intersects(proxy.worldBounds))
+                continue;
+
+            // The least scaled axis has the most texels per world unit
+            const glm::mat4 &m = proxy.transform;
+            const float scale = std::min(glm::length(glm::vec3(m[0])),
+                                         std::min(glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2]))));
+
+            // Nearest point of the bounding sphere, the finest level any triangle needs
+            const glm::vec3 center = (proxy.worldBounds.min + proxy.worldBounds.max) * 0.5f;
+            const float radius = glm::length(proxy.worldBounds.max - proxy.worldBounds.min) * 0.5f;
+            const float distance = std::max(glm::length(center - camera.position) - radius, camera.nearPlane);
+
+            const float texelsPerUnit = uvDensity / std::max(scale, 1e-6f) * (float)std::max(texture->m_width, texture->m_height);
+            const float mip = std::log2(texelsPerUnit * distance / pixelsPerUnit);
+            const uint32_t level = mip > 0.f ? (uint32_t)mip : 0u;
+
+            if (texture->m_requestFrame != m_frame)
+            {
+                texture->m_requestFrame = m_frame;
+                texture->m_requestedMip = level;
+            }
+            else
+            {
+                texture->m_requestedMip = std::min(texture->m_requestedMip, level);
+            }
+        }
+    }
+
+    void TextureStreamer::Update(VkDeviceSize uploadBudget, std::vector<Transition> &out)
+    {
+        ++m_frame;
+        m_stats = Stats{};
+
+        struct Candidate
+        {
+            std::shared_ptr<Texture> texture;
+            // Level the requests need, the tail for unused textures
+            uint32_t need = 0;
+            uint32_t tail = 0;
+            uint32_t wanted = 0;
+            uint64_t lastRequest = 0;
+        };
+
+        std::vector<Candidate> candidates;
+        VkDeviceSize total = 0;
+
+        for (size_t i = 0; i < m_textures.size();)
+        {
+            // Also dropped when its file could not be read again
+            auto texture = m_textures[i].lock();
+            if (!texture || !texture->m_source)
+            {
+                m_textures[i] = m_textures.back();
+                m_textures.pop_back();
+                continue;
+            }
+            ++i;
+
+            const TextureImage &source = *texture->m_source;
+            const uint32_t tail = GetTailMip(source);
+            const bool used = texture->m_requestFrame != 0 && texture->m_requestFrame + kRequestFrames >= m_frame;
+            const uint32_t need = used ? std::min(texture->m_requestedMip, tail) : tail;
+
+            ++m_stats.textures;
+            m_stats.residentBytes += texture->GetMemorySize();
+            m_stats.requestedBytes += Texture::PackLevels(source, need);
+
+            // One change at a time, the first upload and file reads included
+            if (texture->m_nextImage || texture->m_reading)
+            {
+                const uint32_t held = texture->IsResident() ? std::min(texture->m_baseMip, texture->m_nextBaseMip)
+                                                            : texture->m_nextBaseMip;
+                total += Texture::PackLevels(source, held);
+                continue;
+            }
+
+            // Finer levels come in when needed, coarser ones only under pressure
+            Candidate candidate{std::move(texture), need, tail, 0, 0};
+            candidate.wanted = std::min(need, candidate.texture->m_baseMip);
+            candidate.lastRequest = candidate.texture->m_requestFrame;
+            total += Texture::PackLevels(source, candidate.wanted);
+            candidates.push_back(std::move(candidate));
+        }
+
+        auto levelBytes = [](const Candidate &c)
+        {
+            const TextureImage &source = *c.texture->m_source;
+            return Texture::PackLevels(source, c.wanted) - Texture::PackLevels(source, c.wanted + 1);
+        };
+
+        // Over budget: levels finer than needed go first, least recently used textures first
+        std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b)
+                  { return a.lastRequest < b.lastRequest; });
+        for (auto &c : candidates)
+        {
+            while (total > m_budget && c.wanted < c.need)
+            {
+                total -= levelBytes(c);
+                ++c.wanted;
+            }
+        }
+
+        // Then needed levels, the largest one each time
+        while (total > m_budget)
+        {
+            Candidate *largest = nullptr;
+            for (auto &c : candidates)
+            {
+                if (c.wanted < c.tail && (!largest || levelBytes(c) > levelBytes(*largest)))
+                    largest = &c;
+            }
+            if (!largest)
+                break;
+            total -= levelBytes(*largest);
+            ++largest->wanted;
+        }
+
+        // Dropping levels frees memory and needs little staging, do it first
+        VkDeviceSize staging = 0;
+        for (auto &c : candidates)
+        {
+            if (c.wanted <= c.texture->m_baseMip)
+                continue;
+            staging += Texture::PackLevels(*c.texture->m_source, c.wanted);
+            out.push_back({c.texture, c.wanted});
+            ++m_stats.streamedOut;
+        }
+
+        // The rest of the staging budget goes to the most recently requested textures
+        std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b)
+                  { return a.lastRequest > b.lastRequest; });
+        for (auto &c : candidates)
+        {
+            if (c.wanted >= c.texture->m_baseMip)
+                continue;
+            const VkDeviceSize bytes = Texture::PackLevels(*c.texture->m_source, c.wanted);
+            if (staging > 0 && staging + bytes > uploadBudget)
+                continue;
+            staging += bytes;
+            out.push_back({c.texture, c.wanted});
+            ++m_stats.streamedIn;
+        }
+    }
+}
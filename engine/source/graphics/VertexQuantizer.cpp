@@ -0,0 +1,200 @@
+#include "graphics/VertexQuantizer.h"
+
+#include <glm/gtc/packing.hpp>
+#include <glm/vec4.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace eng
+{
+    static const VertexElement *FindElement(const VertexLayout &layout, uint32_t index)
+    {
+        for (auto &e : layout.elements)
+        {
+            if (e.index == index)
+                return &e;
+        }
+        return nullptr;
+    }
+
+    // Component c of every vertex, for range checks
+    template <typename F>
+    static void ForEachComponent(const VertexLayout &layout, const std::vector<float> &vertices, const VertexElement &e, F &&f)
+    {
+        const size_t floatsPerVertex = layout.stride / sizeof(float);
+        const size_t offset = e.offset / sizeof(float);
+        const size_t count = floatsPerVertex > 0 ? vertices.size() / floatsPerVertex : 0;
+        for (size_t v = 0; v < count; ++v)
+        {
+            for (uint32_t c = 0; c < e.size; ++c)
+                f(vertices[v * floatsPerVertex + offset + c]);
+        }
+    }
+
+    static bool InUnitRange(const VertexLayout &layout, const std::vector<float> &vertices, const VertexElement &e)
+    {
+        bool inside = true;
+        ForEachComponent(layout, vertices, e, [&](float x)
+                         { inside = inside && x >= 0.f && x <= 1.f; });
+        return inside;
+    }
+
+    static bool HalfPrecisionEnough(const VertexLayout &layout, const std::vector<float> &vertices, const VertexElement &e)
+    {
+        float minX = std::numeric_limits<float>::max();
+        float maxX = -std::numeric_limits<float>::max();
+        float maxError = 0.f;
+        ForEachComponent(layout, vertices, e, [&](float x)
+                         {
+                             minX = std::min(minX, x);
+                             maxX = std::max(maxX, x);
+                             const float back = glm::unpackHalf1x16(glm::packHalf1x16(x));
+                             maxError = std::isfinite(back) ? std::max(maxError, std::fabs(back - x)) : std::numeric_limits<float>::max(); });
+
+        if (minX > maxX)
+            return false;
+        return maxError <= std::min(kQuantizeMaxError, (maxX - minX) * kQuantizeRelativeError);
+    }
+
+    VertexLayout QuantizeLayout(const VertexLayout &layout, const std::vector<float> &vertices, bool packedNormals)
+    {
+        for (auto &e : layout.elements)
+        {
+            if (e.type != AttribType::Float32)
+                return layout;
+        }
+
+        VertexLayout result;
+        for (auto e : layout.elements)
+        {
+            switch (e.index)
+            {
+            case VertexElement::Position:
+                if (e.size >= 3 && HalfPrecisionEnough(layout, vertices, e))
+                {
+                    e.type = AttribType::Float16;
+                    e.size = 4;
+                }
+                break;
+            case VertexElement::Color:
+                e.type = InUnitRange(layout, vertices, e) ? AttribType::UNorm8 : AttribType::Float16;
+                e.size = e.size == 3 ? 4 : e.size;
+                break;
+            case VertexElement::UV:
+                if (InUnitRange(layout, vertices, e))
+                    e.type = AttribType::UNorm16;
+                break;
+            case VertexElement::Normal:
+                if (e.size == 3)
+                {
+                    e.type = packedNormals ? AttribType::SNorm10_10_10_2 : AttribType::SNorm8;
+                    e.size = 4;
+                }
+                break;
+            default:
+                break;
+            }
+
+            result.elements.push_back(e);
+        }
+
+        // Positions get a stream of their own so depth only passes fetch nothing else
+        const bool hasPosition = FindElement(result, VertexElement::Position) != nullptr;
+        const bool split = hasPosition && result.elements.size() > 1;
+        if (split)
+            result.streams.assign(2, 0);
+
+        for (auto &e : result.elements)
+        {
+            e.binding = split && e.index != VertexElement::Position ? 1 : 0;
+
+            uint32_t &stride = split ? result.streams[e.binding] : result.stride;
+            e.offset = stride;
+            stride += (AttribSize(e.type, e.size) + 3u) & ~3u;
+        }
+
+        if (split)
+            result.stride = result.streams[0] + result.streams[1];
+
+        return result;
+    }
+
+    std::vector<uint8_t> QuantizeVertices(const VertexLayout &layout, const std::vector<float> &vertices,
+                                          const VertexLayout &quantized)
+    {
+        const size_t floatsPerVertex = layout.stride / sizeof(float);
+        const size_t count = floatsPerVertex > 0 ? vertices.size() / floatsPerVertex : 0;
+
+        std::vector<uint8_t> result(count * quantized.stride, 0);
+
+        // Streams are stored one after the other
+        std::vector<size_t> streamBase(quantized.GetStreamCount(), 0);
+        for (uint32_t b = 1; b < quantized.GetStreamCount(); ++b)
+            streamBase[b] = streamBase[b - 1] + count * quantized.GetStreamStride(b - 1);
+
+        for (const auto &dst : quantized.elements)
+        {
+            const VertexElement *src = FindElement(layout, dst.index);
+            if (!src)
+                continue;
+
+            const uint32_t srcComps = std::min<uint32_t>(src->size, 4);
+            for (size_t v = 0; v < count; ++v)
+            {
+                const float *in = vertices.data() + v * floatsPerVertex + src->offset / sizeof(float);
+                glm::vec4 value(0.f, 0.f, 0.f, 1.f);
+                for (uint32_t c = 0; c < srcComps; ++c)
+                    value[c] = in[c];
+
+                uint8_t *out = result.data() + streamBase[dst.binding] + v * quantized.GetStreamStride(dst.binding) + dst.offset;
+                switch (dst.type)
+                {
+                case AttribType::Float32:
+                    std::memcpy(out, &value[0], sizeof(float) * dst.size);
+                    break;
+                case AttribType::Float16:
+                    for (uint32_t c = 0; c < dst.size; ++c)
+                    {
+                        const uint16_t h = glm::packHalf1x16(value[c]);
+                        std::memcpy(out + c * 2, &h, 2);
+                    }
+                    break;
+                case AttribType::SNorm16:
+                    for (uint32_t c = 0; c < dst.size; ++c)
+                    {
+                        const uint16_t s = glm::packSnorm1x16(value[c]);
+                        std::memcpy(out + c * 2, &s, 2);
+                    }
+                    break;
+                case AttribType::UNorm16:
+                    for (uint32_t c = 0; c < dst.size; ++c)
+                    {
+                        const uint16_t u = glm::packUnorm1x16(value[c]);
+                        std::memcpy(out + c * 2, &u, 2);
+                    }
+                    break;
+                case AttribType::SNorm8:
+                    for (uint32_t c = 0; c < dst.size; ++c)
+                        out[c] = glm::packSnorm1x8(value[c]);
+                    break;
+                case AttribType::UNorm8:
+                    for (uint32_t c = 0; c < dst.size; ++c)
+                        out[c] = glm::packUnorm1x8(value[c]);
+                    break;
+                case AttribType::SNorm10_10_10_2:
+                {
+                    // Normals: w carries no meaning, keep it 0
+                    const uint32_t p = glm::packSnorm3x10_1x2(glm::vec4(glm::vec3(value), 0.f));
+                    std::memcpy(out, &p, 4);
+                    break;
+                }
+                }
+            }
+        }
+
+        return result;
+    }
+}
@@ -0,0 +1,234 @@
+#include "graphics/VirtualTextureFile.h"
+
+#include "graphics/BlockCompression.h"
+#include "jobs/JobSystem.h"
+
+#include <SDL3/SDL.h>
+
+#include <atomic>
+#include <cstring>
+
+namespace eng
+{
+    static constexpr char kMagic[4] = {'V', 'T', 'E', 'X'};
+    static constexpr uint32_t kVersion = 1;
+    // Magic, version, format, width, height, levels, tile size, border
+    static constexpr size_t kHeaderSize = 8 * 4;
+    // Offset (u64), size, reserved per tile
+    static constexpr size_t kTileEntrySize = 16;
+
+    static bool IsPowerOfTwo(uint32_t v)
+    {
+        return v != 0 && (v & (v - 1)) == 0;
+    }
+
+    uint32_t VirtualTextureFile::LevelCount(uint32_t width, uint32_t height)
+    {
+        uint32_t levels = 1;
+        while (TileCount(width, levels - 1) > 1 || TileCount(height, levels - 1) > 1)
+            ++levels;
+        return levels;
+    }
+
+    bool VirtualTextureFile::Open(const std::filesystem::path &path)
+    {
+        m_stream.open(path, std::ios::binary);
+        if (!m_stream)
+            return false;
+
+        char header[kHeaderSize];
+        if (!m_stream.read(header, sizeof(header)) || std::memcmp(header, kMagic, sizeof(kMagic)) != 0)
+        {
+            SDL_Log("VirtualTextureFile: %s is not a .vtex", path.string().c_str());
+            return false;
+        }
+
+        uint32_t words[7];
+        std::memcpy(words, header + 4, sizeof(words));
+        m_format = (VkFormat)words[1];
+        m_width = words[2];
+        m_height = words[3];
+        m_levelCount = words[4];
+        if (words[0] != kVersion || words[5] != kTileSize || words[6] != kTileBorder || FormatBlockBytes(m_format) == 0 ||
+            !IsPowerOfTwo(m_width) || !IsPowerOfTwo(m_height) || m_width < kTileSize || m_height < kTileSize ||
+            m_levelCount != LevelCount(m_width, m_height))
+        {
+            SDL_Log("VirtualTextureFile: unsupported layout in %s", path.string().c_str());
+            return false;
+        }
+
+        uint32_t tileCount = 0;
+        m_firstTile.resize(m_levelCount);
+        for (uint32_t level = 0; level < m_levelCount; ++level)
+        {
+            m_firstTile[level] = tileCount;
+            tileCount += GetTilesX(level) * GetTilesY(level);
+        }
+
+        std::vector<char> table((size_t)tileCount * kTileEntrySize);
+        if (!m_stream.read(table.data(), (std::streamsize)table.size()))
+        {
+            SDL_Log("VirtualTextureFile: truncated tile table in %s", path.string().c_str());
+            return false;
+        }
+
+        m_tiles.resize(tileCount);
+        for (uint32_t i = 0; i < tileCount; ++i)
+        {
+            std::memcpy(&m_tiles[i].offset, table.data() + i * kTileEntrySize, 8);
+            std::memcpy(&m_tiles[i].size, table.data() + i * kTileEntrySize + 8, 4);
+        }
+        return true;
+    }
+
+    bool VirtualTextureFile::ReadTile(uint32_t level, uint32_t x, uint32_t y, std::vector<uint8_t> &rgba) const
+    {
+        if (level >= m_levelCount || x >= GetTilesX(level) || y >= GetTilesY(level))
+            return false;
+
+        const Tile &tile = m_tiles[m_firstTile[level] + y * GetTilesX(level) + x];
+        const size_t size = TextureLevelSize(m_format, kPageSize, kPageSize);
+        if (tile.size != size)
+            return false;
+
+        std::vector<uint8_t> payload(size);
+        {
+            std::lock_guard lock(m_mutex);
+            m_stream.clear();
+            m_stream.seekg((std::streamoff)tile.offset);
+            if (!m_stream.read((char *)payload.data(), (std::streamsize)size))
+                return false;
+        }
+
+        if (!IsBlockCompressed(m_format))
+        {
+            rgba = std::move(payload);
+            return true;
+        }
+
+        TextureImage compressed;
+        compressed.format = m_format;
+        compressed.width = compressed.height = kPageSize;
+        compressed.levels = {{0, size, kPageSize, kPageSize}};
+        compressed.data = std::move(payload);
+
+        TextureImage decoded;
+        if (!DecompressTexture(compressed, decoded))
+            return false;
+        rgba = std::move(decoded.data);
+        return true;
+    }
+
+    bool WriteVirtualTexture(const std::filesystem::path &path, const TextureImage &image, VkFormat tileFormat, JobSystem *jobs)
+    {
+        using File = VirtualTextureFile;
+        constexpr uint32_t kPage = File::kPageSize;
+
+        if (image.format != VK_FORMAT_R8G8B8A8_UNORM && image.format != VK_FORMAT_R8G8B8A8_SRGB)
+        {
+            SDL_Log("WriteVirtualTexture: source must be RGBA8");
+            return false;
+        }
+        if (!IsPowerOfTwo(image.width) || !IsPowerOfTwo(image.height) || image.width < File::kTileSize || image.height < File::kTileSize)
+        {
+            SDL_Log("WriteVirtualTexture: %ux%u is not a power of two of at least %u", image.width, image.height, File::kTileSize);
+            return false;
+        }
+
+        const uint32_t levelCount = File::LevelCount(image.width, image.height);
+        if (image.levels.size() < levelCount)
+        {
+            SDL_Log("WriteVirtualTexture: needs %u mip levels, got %zu", levelCount, image.levels.size());
+            return false;
+        }
+
+        struct TileSource
+        {
+            uint32_t level, x, y;
+        };
+        std::vector<TileSource> sources;
+        for (uint32_t level = 0; level < levelCount; ++level)
+            for (uint32_t y = 0; y < File::TileCount(image.height, level); ++y)
+                for (uint32_t x = 0; x < File::TileCount(image.width, level); ++x)
+                    sources.push_back({level, x, y});
+
+        const bool compress = IsBlockCompressed(tileFormat);
+        std::vector<std::vector<uint8_t>> payloads(sources.size());
+        std::atomic<bool> failed{false};
+
+        // Border texels come from the neighbouring tiles, clamped at the edges
+        auto buildTiles = [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                const auto &source = sources[i];
+                const auto &level = image.levels[source.level];
+                const uint8_t *texels = image.data.data() + level.offset;
+
+                TextureImage page;
+                page.format = image.format;
+                page.width = page.height = kPage;
+                page.levels = {{0, (size_t)kPage * kPage * 4, kPage, kPage}};
+                page.data.resize(page.levels[0].size);
+                for (uint32_t py = 0; py < kPage; ++py)
+                {
+                    const int64_t sy = std::clamp<int64_t>((int64_t)source.y * File::kTileSize + py - File::kTileBorder, 0, level.height - 1);
+                    for (uint32_t px = 0; px < kPage; ++px)
+                    {
+                        const int64_t sx = std::clamp<int64_t>((int64_t)source.x * File::kTileSize + px - File::kTileBorder, 0, level.width - 1);
+                        std::memcpy(&page.data[((size_t)py * kPage + px) * 4], texels + ((size_t)sy * level.width + sx) * 4, 4);
+                    }
+                }
+
+                if (!compress)
+                {
+                    payloads[i] = std::move(page.data);
+                    continue;
+                }
+
+                TextureImage compressed;
+                if (!CompressTexture(page, tileFormat, compressed))
+                {
+                    failed = true;
+                    continue;
+                }
+                payloads[i] = std::move(compressed.data);
+            }
+        };
+
+        if (jobs)
+            jobs->ParallelFor(sources.size(), 4, buildTiles);
+        else
+            buildTiles(0, sources.size());
+
+        if (failed)
+        {
+            SDL_Log("WriteVirtualTexture: cannot encode tiles as format %d", (int)tileFormat);
+            return false;
+        }
+
+        std::vector<char> file(kHeaderSize + sources.size() * kTileEntrySize);
+        auto writeAt = [&](size_t offset, auto value)
+        { std::memcpy(file.data() + offset, &value, sizeof(value)); };
+
+        std::memcpy(file.data(), kMagic, sizeof(kMagic));
+        const uint32_t header[7] = {kVersion, (uint32_t)(compress ? tileFormat : image.format), image.width, image.height,
+                                    levelCount, File::kTileSize, File::kTileBorder};
+        std::memcpy(file.data() + 4, header, sizeof(header));
+
+        for (size_t i = 0; i < payloads.size(); ++i)
+        {
+            writeAt(kHeaderSize + i * kTileEntrySize, (uint64_t)file.size());
+            writeAt(kHeaderSize + i * kTileEntrySize + 8, (uint32_t)payloads[i].size());
+            file.insert(file.end(), payloads[i].begin(), payloads[i].end());
+        }
+
+        std::ofstream stream(path, std::ios::binary);
+        if (!stream || !stream.write(file.data(), (std::streamsize)file.size()))
+        {
+            SDL_Log("WriteVirtualTexture: failed to write %s", path.string().c_str());
+            return false;
+        }
+        return true;
+    }
+}
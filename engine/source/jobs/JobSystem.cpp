@@ -0,0 +1,373 @@
+#include "jobs/JobSystem.h"
+
+#include <SDL3/SDL.h>
+
+#include <array>
+#include <chrono>
+
+namespace eng
+{
+    struct Job
+    {
+        JobSystem::JobFunction fn;
+        JobCounter *counter = nullptr;
+    };
+
+    // Chase-Lev work-stealing deque with a fixed capacity.
+    // The owner pushes and pops at the bottom, thieves take from the top.
+    class WorkStealingQueue
+    {
+    public:
+        static constexpr int64_t kCapacity = 4096;
+        static constexpr int64_t kMask = kCapacity - 1;
+
+        bool Push(Job *job)
+        {
+            const int64_t b = m_bottom.load(std::memory_order_relaxed);
+            const int64_t t = m_top.load(std::memory_order_acquire);
+            if (b - t >= kCapacity)
+                return false;
+
+            m_items[b & kMask].store(job, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+            return true;
+        }
+
+        Job *Pop()
+        {
+            const int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+            m_bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t = m_top.load(std::memory_order_relaxed);
+
+            if (t > b)
+            {
+                // empty
+                m_bottom.store(b + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+
+            Job *job = m_items[b & kMask].load(std::memory_order_relaxed);
+            if (t == b)
+            {
+                // last item: race against thieves
+                if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    job = nullptr;
+                m_bottom.store(b + 1, std::memory_order_relaxed);
+            }
+            return job;
+        }
+
+        Job *Steal()
+        {
+            int64_t t = m_top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const int64_t b = m_bottom.load(std::memory_order_acquire);
+
+            if (t >= b)
+                return nullptr;
+
+            Job *job = m_items[t & kMask].load(std::memory_order_relaxed);
+            if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                return nullptr;
+            return job;
+        }
+
+    private:
+        alignas(64) std::atomic<int64_t> m_top{0};
+        alignas(64) std::atomic<int64_t> m_bottom{0};
+        std::array<std::atomic<Job *>, kCapacity> m_items{};
+    };
+
+    struct JobSystem::Worker
+    {
+        WorkStealingQueue queue;
+    };
+
+    static thread_local uint32_t t_threadIndex = JobSystem::kMainThreadIndex;
+    static thread_local bool t_isOwned = false;
+    static thread_local uint32_t t_rng = 0x9E3779B9u;
+
+    static uint32_t NextRandom()
+    {
+        uint32_t x = t_rng;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        t_rng = x;
+        return x;
+    }
+
+    JobSystem::JobSystem() = default;
+
+    JobSystem::~JobSystem()
+    {
+        Shutdown();
+    }
+
+    bool JobSystem::Init(uint32_t workerCount)
+    {
+        if (m_running)
+            return true;
+
+        if (workerCount == 0)
+        {
+            const uint32_t hw = std::thread::hardware_concurrency();
+            workerCount = hw > 1 ? hw - 1 : 1;
+        }
+
+        m_mainThreadId = std::this_thread::get_id();
+        t_threadIndex = kMainThreadIndex;
+        t_isOwned = true;
+
+        m_workers.clear();
+        for (uint32_t i = 0; i < workerCount + 1; ++i)
+            m_workers.push_back(std::make_unique<Worker>());
+
+        m_running = true;
+
+        m_threads.reserve(workerCount);
+        for (uint32_t i = 1; i <= workerCount; ++i)
+            m_threads.emplace_back(&JobSystem::workerLoop, this, i);
+
+        SDL_Log("JobSystem: %u worker threads", workerCount);
+        return true;
+    }
+
+    void JobSystem::Shutdown()
+    {
+        if (!m_running)
+            return;
+
+        m_running = false;
+        m_wake.notify_all();
+
+        for (auto &t : m_threads)
+            if (t.joinable())
+                t.join();
+        m_threads.clear();
+
+        // Drain whatever is left so counters still reach zero.
+        while (Job *job = findJob(kMainThreadIndex))
+            execute(job);
+
+        m_workers.clear();
+    }
+
+    uint32_t JobSystem::GetThreadIndex()
+    {
+        return t_threadIndex;
+    }
+
+    bool JobSystem::IsMainThread() const
+    {
+        return std::this_thread::get_id() == m_mainThreadId;
+    }
+
+    void JobSystem::workerLoop(uint32_t index)
+    {
+        t_threadIndex = index;
+        t_isOwned = true;
+        t_rng = 0x9E3779B9u * (index + 1);
+
+        while (m_running.load(std::memory_order_relaxed))
+        {
+            if (Job *job = findJob(index))
+            {
+                execute(job);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_sleepLock);
+            m_wake.wait_for(lock, std::chrono::milliseconds(1), [this]()
+                            { return !m_running.load(std::memory_order_relaxed) ||
+                                     m_queuedJobs.load(std::memory_order_relaxed) > 0; });
+        }
+    }
+
+    void JobSystem::schedule(Job *job)
+    {
+        if (!m_running)
+        {
+            execute(job);
+            return;
+        }
+
+        if (t_isOwned)
+        {
+            if (!m_workers[t_threadIndex]->queue.Push(job))
+            {
+                // deque is full: run it right here
+                execute(job);
+                return;
+            }
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lock(m_injectLock);
+            m_injected.push_back(job);
+        }
+
+        m_queuedJobs.fetch_add(1, std::memory_order_relaxed);
+        m_wake.notify_one();
+    }
+
+    Job *JobSystem::findJob(uint32_t index)
+    {
+        if (m_workers.empty())
+            return nullptr;
+
+        Job *job = m_workers[index]->queue.Pop();
+
+        if (!job)
+        {
+            std::lock_guard<std::mutex> lock(m_injectLock);
+            if (!m_injected.empty())
+            {
+                job = m_injected.back();
+                m_injected.pop_back();
+            }
+        }
+
+        if (!job)
+        {
+            const uint32_t count = (uint32_t)m_workers.size();
+            const uint32_t start = NextRandom() % count;
+            for (uint32_t i = 0; i < count && !job; ++i)
+            {
+                const uint32_t victim = (start + i) % count;
+                if (victim != index)
+                    job = m_workers[victim]->queue.Steal();
+            }
+        }
+
+        if (job)
+            m_queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+
+        return job;
+    }
+
+    void JobSystem::execute(Job *job)
+    {
+        job->fn();
+        finish(job->counter);
+        delete job;
+    }
+
+    void JobSystem::finish(JobCounter *counter)
+    {
+        if (!counter)
+            return;
+
+        // Not the last job: the counter stays above zero, so no Wait can
+        // return and let the owner destroy it while we are in here
+        int value = counter->m_value.load(std::memory_order_relaxed);
+        while (value > 1)
+        {
+            if (counter->m_value.compare_exchange_weak(value, value - 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+                return;
+        }
+
+        // Zero is published under the lock, Wait takes it before returning
+        std::vector<Job *> ready;
+        {
+            std::lock_guard<std::mutex> lock(counter->m_lock);
+            if (counter->m_value.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                return;
+            ready.swap(counter->m_continuations);
+        }
+
+        for (Job *job : ready)
+            schedule(job);
+    }
+
+    void JobSystem::Run(JobFunction fn, JobCounter *counter, JobCounter *dependency)
+    {
+        if (counter)
+            counter->m_value.fetch_add(1, std::memory_order_acq_rel);
+
+        Job *job = new Job{std::move(fn), counter};
+
+        if (dependency)
+        {
+            std::lock_guard<std::mutex> lock(dependency->m_lock);
+            if (dependency->m_value.load(std::memory_order_acquire) > 0)
+            {
+                dependency->m_continuations.push_back(job);
+                return;
+            }
+        }
+
+        schedule(job);
+    }
+
+    void JobSystem::Wait(JobCounter &counter)
+    {
+        while (counter.Get() > 0)
+        {
+            Job *job = (t_isOwned && m_running) ? findJob(t_threadIndex) : nullptr;
+            if (job)
+                execute(job);
+            else
+                std::this_thread::yield();
+        }
+
+        // The job that brought the counter to zero may still hold its lock
+        std::lock_guard<std::mutex> lock(counter.m_lock);
+    }
+
+    void JobSystem::ParallelFor(size_t count, size_t grain, const RangeFunction &fn)
+    {
+        if (count == 0)
+            return;
+
+        if (grain == 0)
+            grain = 1;
+
+        const size_t chunks = (count + grain - 1) / grain;
+        if (chunks == 1 || !m_running)
+        {
+            fn(0, count);
+            return;
+        }
+
+        JobCounter counter;
+        for (size_t c = 1; c < chunks; ++c)
+        {
+            const size_t begin = c * grain;
+            const size_t end = std::min(count, begin + grain);
+            Run([&fn, begin, end]()
+                { fn(begin, end); },
+                &counter);
+        }
+
+        fn(0, std::min(count, grain));
+        Wait(counter);
+    }
+
+    void JobSystem::RunOnMainThread(JobFunction fn)
+    {
+        if (IsMainThread())
+        {
+            fn();
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mainThreadLock);
+        m_mainThreadJobs.push_back(std::move(fn));
+    }
+
+    void JobSystem::ProcessMainThreadJobs()
+    {
+        std::vector<JobFunction> jobs;
+        {
+            std::lock_guard<std::mutex> lock(m_mainThreadLock);
+            jobs.swap(m_mainThreadJobs);
+        }
+
+        for (auto &fn : jobs)
+            fn();
+    }
+
+}
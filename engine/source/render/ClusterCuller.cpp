@@ -0,0 +1,343 @@
+#include "render/ClusterCuller.h"
+
+#include "render/Material.h"
+#include "render/Mesh.h"
+#include "graphics/GraphicsAPI.h"
+#include "graphics/ShaderProgram.h"
+#include "vk/VkHelpers.h"
+#include "Engine.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+namespace eng
+{
+    void ClusterCuller::Init(VkDevice device, VkPhysicalDevice gpu, uint32_t framesInFlight)
+    {
+        m_device = device;
+        m_gpu = gpu;
+
+        // 0 objects, 1 clusters, 2 cluster indices, 3 instances, 4 commands, 5 output indices
+        VkDescriptorSetLayoutBinding bindings[6]{};
+        for (uint32_t i = 0; i < 6; ++i)
+        {
+            bindings[i].binding = i;
+            bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+
+        VkDescriptorSetLayoutCreateInfo li{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+        li.bindingCount = 6;
+        li.pBindings = bindings;
+        vkutil::vkCheck(vkCreateDescriptorSetLayout(m_device, &li, nullptr, &m_setLayout),
+                        "vkCreateDescriptorSetLayout (clusters) failed");
+
+        VkDescriptorPoolSize ps{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, framesInFlight * 6};
+        VkDescriptorPoolCreateInfo pi{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+        pi.maxSets = framesInFlight;
+        pi.poolSizeCount = 1;
+        pi.pPoolSizes = &ps;
+        vkutil::vkCheck(vkCreateDescriptorPool(m_device, &pi, nullptr, &m_descriptorPool),
+                        "vkCreateDescriptorPool (clusters) failed");
+
+        m_frames.resize(framesInFlight);
+        for (auto &frame : m_frames)
+        {
+            VkDescriptorSetAllocateInfo ai{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+            ai.descriptorPool = m_descriptorPool;
+            ai.descriptorSetCount = 1;
+            ai.pSetLayouts = &m_setLayout;
+            vkutil::vkCheck(vkAllocateDescriptorSets(m_device, &ai, &frame.set),
+                            "vkAllocateDescriptorSets (clusters) failed");
+        }
+
+        auto code = Engine::GetInstance().GetFileSystem().LoadAssetSpirv("shaders/cluster_cull_comp.spv");
+
+        VkShaderModuleCreateInfo mi{VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
+        mi.codeSize = code.size() * sizeof(uint32_t);
+        mi.pCode = code.data();
+
+        VkShaderModule module{};
+        vkutil::vkCheck(vkCreateShaderModule(m_device, &mi, nullptr, &module), "vkCreateShaderModule (clusters) failed");
+
+        VkPushConstantRange range{};
+        range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        range.size = sizeof(Push);
+
+        VkPipelineLayoutCreateInfo pli{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+        pli.setLayoutCount = 1;
+        pli.pSetLayouts = &m_setLayout;
+        pli.pushConstantRangeCount = 1;
+        pli.pPushConstantRanges = &range;
+        vkutil::vkCheck(vkCreatePipelineLayout(m_device, &pli, nullptr, &m_layout),
+                        "vkCreatePipelineLayout (clusters) failed");
+
+        VkComputePipelineCreateInfo ci{VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+        ci.stage = {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+        ci.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        ci.stage.module = module;
+        ci.stage.pName = "main";
+        ci.layout = m_layout;
+        vkutil::vkCheck(vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &ci, nullptr, &m_pipeline),
+                        "vkCreateComputePipelines (clusters) failed");
+
+        vkDestroyShaderModule(m_device, module, nullptr);
+    }
+
+    void ClusterCuller::Destroy()
+    {
+        if (!m_device)
+            return;
+
+        DestroyFrameBuffers();
+        m_frames.clear();
+
+        if (m_pipeline)
+            vkDestroyPipeline(m_device, m_pipeline, nullptr);
+        if (m_layout)
+            vkDestroyPipelineLayout(m_device, m_layout, nullptr);
+        if (m_descriptorPool)
+            vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
+        if (m_setLayout)
+            vkDestroyDescriptorSetLayout(m_device, m_setLayout, nullptr);
+
+        m_pipeline = VK_NULL_HANDLE;
+        m_layout = VK_NULL_HANDLE;
+        m_descriptorPool = VK_NULL_HANDLE;
+        m_setLayout = VK_NULL_HANDLE;
+        m_device = VK_NULL_HANDLE;
+    }
+
+    void ClusterCuller::CreateBuffer(Buffer &buffer, VkDeviceSize size, VkBufferUsageFlags usage, bool hostVisible)
+    {
+        // Empty builds still need valid descriptors
+        buffer.size = std::max<VkDeviceSize>(size, 16);
+
+        vkutil::CreateBuffer(m_gpu, m_device, buffer.size, usage,
+                             hostVisible ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+                                         : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                             buffer.buffer, buffer.memory);
+
+        if (hostVisible)
+        {
+            vkutil::vkCheck(vkMapMemory(m_device, buffer.memory, 0, buffer.size, 0, &buffer.mapped),
+                            "vkMapMemory (clusters) failed");
+        }
+    }
+
+    void ClusterCuller::DestroyBuffer(Buffer &buffer)
+    {
+        if (buffer.mapped)
+            vkUnmapMemory(m_device, buffer.memory);
+        if (buffer.buffer)
+            vkDestroyBuffer(m_device, buffer.buffer, nullptr);
+        if (buffer.memory)
+            vkFreeMemory(m_device, buffer.memory, nullptr);
+        buffer = Buffer{};
+    }
+
+    void ClusterCuller::CreateFrameBuffers()
+    {
+        for (auto &frame : m_frames)
+        {
+            CreateBuffer(frame.clusters, sizeof(GpuCluster) * m_clusters.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, true);
+            CreateBuffer(frame.indices, sizeof(uint32_t) * m_indices.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, true);
+            CreateBuffer(frame.instances, sizeof(GpuInstance) * m_instances.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, true);
+            CreateBuffer(frame.templates, sizeof(VkDrawIndexedIndirectCommand) * m_templates.size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, true);
+            CreateBuffer(frame.commands, sizeof(VkDrawIndexedIndirectCommand) * m_templates.size(),
+                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, false);
+            CreateBuffer(frame.output, sizeof(uint32_t) * m_outputCapacity,
+                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, false);
+
+            const Buffer *buffers[5] = {&frame.clusters, &frame.indices, &frame.instances, &frame.commands, &frame.output};
+            VkDescriptorBufferInfo infos[5]{};
+            VkWriteDescriptorSet writes[5]{};
+            for (uint32_t i = 0; i < 5; ++i)
+            {
+                infos[i] = {buffers[i]->buffer, 0, buffers[i]->size};
+                writes[i] = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+                writes[i].dstSet = frame.set;
+                writes[i].dstBinding = i + 1;
+                writes[i].descriptorCount = 1;
+                writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                writes[i].pBufferInfo = &infos[i];
+            }
+            vkUpdateDescriptorSets(m_device, 5, writes, 0, nullptr);
+
+            frame.uploadedVersion = UINT64_MAX;
+        }
+    }
+
+    void ClusterCuller::DestroyFrameBuffers()
+    {
+        for (auto &frame : m_frames)
+        {
+            for (Buffer *buffer : {&frame.clusters, &frame.indices, &frame.instances, &frame.templates, &frame.commands, &frame.output})
+                DestroyBuffer(*buffer);
+            frame.uploadedVersion = UINT64_MAX;
+        }
+    }
+
+    void ClusterCuller::Build(const std::vector<Instance> &instances)
+    {
+        m_clusters.clear();
+        m_indices.clear();
+        m_instances.clear();
+        m_templates.clear();
+        m_groups.clear();
+
+        // Instances of the same mesh share its cluster indices
+        std::unordered_map<const Mesh *, uint32_t> meshIndexBase;
+        uint32_t outputOffset = 0;
+
+        for (uint32_t i = 0; i < (uint32_t)instances.size(); ++i)
+        {
+            const auto &instance = instances[i];
+            const Mesh *mesh = instance.mesh;
+
+            auto [it, inserted] = meshIndexBase.try_emplace(mesh, (uint32_t)m_indices.size());
+            if (inserted)
+                m_indices.insert(m_indices.end(), mesh->GetIndices().begin(), mesh->GetIndices().end());
+
+            for (const auto &meshlet : mesh->GetMeshlets())
+            {
+                GpuCluster cluster;
+                cluster.sphere = glm::vec4(meshlet.center, meshlet.radius);
+                cluster.cone = glm::vec4(meshlet.coneAxis, meshlet.coneCutoff);
+                cluster.firstIndex = it->second + meshlet.firstIndex;
+                cluster.indexCount = meshlet.indexCount;
+                cluster.instance = i;
+                m_clusters.push_back(cluster);
+            }
+
+            m_instances.push_back({instance.object, outputOffset});
+
+            VkDrawIndexedIndirectCommand command{};
+            command.indexCount = 0;
+            command.instanceCount = 1;
+            command.firstIndex = outputOffset;
+            command.vertexOffset = (int32_t)instance.firstVertex;
+            command.firstInstance = instance.object;
+            m_templates.push_back(command);
+
+            outputOffset += (uint32_t)mesh->GetIndices().size();
+
+            if (m_groups.empty() || m_groups.back().material != instance.material || m_groups.back().page != instance.page)
+                m_groups.push_back({instance.material, instance.page, i, 0});
+            ++m_groups.back().instanceCount;
+        }
+
+        m_instanceCount = (uint32_t)instances.size();
+        ++m_version;
+
+        // Other frames may still read the old buffers
+        if (!m_frames.empty() &&
+            (m_frames[0].clusters.size < sizeof(GpuCluster) * m_clusters.size() ||
+             m_frames[0].indices.size < sizeof(uint32_t) * m_indices.size() ||
+             m_frames[0].instances.size < sizeof(GpuInstance) * m_instances.size() ||
+             m_outputCapacity < outputOffset))
+        {
+            vkDeviceWaitIdle(m_device);
+            DestroyFrameBuffers();
+            m_outputCapacity = outputOffset;
+            CreateFrameBuffers();
+        }
+    }
+
+    void ClusterCuller::Cull(VkCommandBuffer cmd, uint32_t frameIndex, VkBuffer objects, const glm::mat4 &viewProj, const glm::vec3 &eye)
+    {
+        if (m_instanceCount == 0 || m_clusters.empty())
+            return;
+
+        auto &frame = m_frames[frameIndex];
+        if (frame.uploadedVersion != m_version)
+        {
+            std::memcpy(frame.clusters.mapped, m_clusters.data(), sizeof(GpuCluster) * m_clusters.size());
+            std::memcpy(frame.indices.mapped, m_indices.data(), sizeof(uint32_t) * m_indices.size());
+            std::memcpy(frame.instances.mapped, m_instances.data(), sizeof(GpuInstance) * m_instances.size());
+            std::memcpy(frame.templates.mapped, m_templates.data(), sizeof(VkDrawIndexedIndirectCommand) * m_templates.size());
+            frame.uploadedVersion = m_version;
+        }
+
+        if (frame.boundObjects != objects)
+        {
+            VkDescriptorBufferInfo info{objects, 0, VK_WHOLE_SIZE};
+            VkWriteDescriptorSet write{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+            write.dstSet = frame.set;
+            write.dstBinding = 0;
+            write.descriptorCount = 1;
+            write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            write.pBufferInfo = &info;
+            vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+            frame.boundObjects = objects;
+        }
+
+        // Every instance starts with an empty index range
+        VkBufferCopy copy{0, 0, sizeof(VkDrawIndexedIndirectCommand) * m_templates.size()};
+        vkCmdCopyBuffer(cmd, frame.templates.buffer, frame.commands.buffer, 1, &copy);
+
+        VkMemoryBarrier reset{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+        reset.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        reset.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0, 1, &reset, 0, nullptr, 0, nullptr);
+
+        Push push;
+        push.viewProj = viewProj;
+        push.eye = glm::vec4(eye, 1.f);
+        push.clusterCount = (uint32_t)m_clusters.size();
+
+        // One workgroup per cluster, folded into y past the guaranteed dispatch limit
+        const uint32_t groupsX = std::min<uint32_t>(push.clusterCount, 65535);
+        const uint32_t groupsY = (push.clusterCount + groupsX - 1) / groupsX;
+
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_layout, 0, 1, &frame.set, 0, nullptr);
+        vkCmdPushConstants(cmd, m_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Push), &push);
+        vkCmdDispatch(cmd, groupsX, groupsY, 1);
+
+        VkMemoryBarrier written{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+        written.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        written.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                             0, 1, &written, 0, nullptr, 0, nullptr);
+    }
+
+    void ClusterCuller::Draw(GraphicsAPI &graphicsAPI, uint32_t frameIndex, ShaderProgram &program, VkDescriptorSet objectSet,
+                             bool pullVertices, bool depthOnly)
+    {
+        if (m_instanceCount == 0 || m_clusters.empty())
+            return;
+
+        const auto &frame = m_frames[frameIndex];
+        VkCommandBuffer cmd = graphicsAPI.GetCmd();
+
+        for (uint32_t g = 0; g < (uint32_t)m_groups.size(); ++g)
+        {
+            const auto &group = m_groups[g];
+
+            if (!depthOnly || g == 0)
+            {
+                graphicsAPI.SetCurrentTextureSet(group.material->GetTextureSet());
+                program.Bind();
+            }
+
+            if (g == 0)
+            {
+                vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, program.GetLayout(),
+                                        3, 1, &objectSet, 0, nullptr);
+            }
+
+            if (!pullVertices)
+                graphicsAPI.BindGeometryPage(group.page);
+            graphicsAPI.BindIndexBuffer(frame.output.buffer, VK_INDEX_TYPE_UINT32);
+
+            vkCmdDrawIndexedIndirect(cmd, frame.commands.buffer,
+                                     sizeof(VkDrawIndexedIndirectCommand) * group.firstInstance,
+                                     group.instanceCount, sizeof(VkDrawIndexedIndirectCommand));
+        }
+    }
+}
@@ -0,0 +1,206 @@
+#include "render/ClusteredLighting.h"
+
+#include "Engine.h"
+
+#include <SDL3/SDL.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace eng
+{
+    static constexpr size_t kLightGrain = 128;
+
+    void ClusteredLighting::Build(std::span<const LightData> lights, const CameraData &camera, uint32_t width, uint32_t height)
+    {
+        const size_t lightCount = std::min<size_t>(lights.size(), kMaxLights);
+        if (lights.size() > kMaxLights && !m_warnedOverflow)
+        {
+            SDL_Log("ClusteredLighting: %zu lights, only the first %u are used", lights.size(), kMaxLights);
+            m_warnedOverflow = true;
+        }
+
+        const float nearPlane = camera.nearPlane;
+        const float farPlane = camera.farPlane;
+        const float logRatio = std::log(farPlane / nearPlane);
+
+        m_params.gridSize = glm::uvec4(kGridX, kGridY, kGridZ, (uint32_t)lightCount);
+        m_params.zParams = glm::vec4(kGridZ / logRatio, -(float)kGridZ * std::log(nearPlane) / logRatio, nearPlane, farPlane);
+        m_params.screen = glm::vec4((float)width, (float)height,
+                                    width > 0 ? 1.f / width : 0.f, height > 0 ? 1.f / height : 0.f);
+
+        m_lights.resize(lightCount);
+        m_bounds.resize(lightCount);
+        for (size_t i = 0; i < lightCount; ++i)
+        {
+            const auto &light = lights[i];
+            m_lights[i].positionRadius = glm::vec4(light.position, light.radius);
+            m_lights[i].colorIntensity = glm::vec4(light.color, light.intensity);
+        }
+
+        if (m_slices.size() != kGridZ)
+        {
+            m_slices.resize(kGridZ);
+            for (auto &slice : m_slices)
+            {
+                slice.counts.resize(kGridX * kGridY);
+                slice.cursor.resize(kGridX * kGridY);
+            }
+        }
+
+        auto &jobs = Engine::GetInstance().GetJobSystem();
+        jobs.ParallelFor(lightCount, kLightGrain, [this, &camera](size_t begin, size_t end)
+                         { ComputeBounds(begin, end, camera); });
+
+        jobs.ParallelFor(kGridZ, 1, [this](size_t begin, size_t end)
+                         {
+                             for (size_t z = begin; z < end; ++z)
+                                 BinSlice((uint32_t)z); });
+
+        // Concatenate the per-slice lists into one index buffer
+        m_clusters.resize(kClusterCount);
+        m_lightIndices.clear();
+
+        constexpr uint32_t tilesPerSlice = kGridX * kGridY;
+        for (uint32_t z = 0; z < kGridZ; ++z)
+        {
+            const auto &slice = m_slices[z];
+            const uint32_t base = (uint32_t)m_lightIndices.size();
+            const uint32_t room = kMaxLightIndices - base;
+            const uint32_t taken = std::min<uint32_t>((uint32_t)slice.indices.size(), room);
+
+            uint32_t offset = 0;
+            for (uint32_t t = 0; t < tilesPerSlice; ++t)
+            {
+                auto &cluster = m_clusters[z * tilesPerSlice + t];
+                const uint32_t count = slice.counts[t];
+                cluster.offset = base + std::min(offset, taken);
+                cluster.count = offset >= taken ? 0 : std::min(count, taken - offset);
+                offset += count;
+            }
+
+            m_lightIndices.insert(m_lightIndices.end(), slice.indices.begin(), slice.indices.begin() + taken);
+
+            if (taken < slice.indices.size() && !m_warnedOverflow)
+            {
+                SDL_Log("ClusteredLighting: light index list full (%u), clusters are truncated", kMaxLightIndices);
+                m_warnedOverflow = true;
+            }
+        }
+    }
+
+    void ClusteredLighting::ComputeBounds(size_t begin, size_t end, const CameraData &camera)
+    {
+        const float nearPlane = m_params.zParams.z;
+        const float farPlane = m_params.zParams.w;
+        const float sliceScale = m_params.zParams.x;
+        const float sliceBias = m_params.zParams.y;
+
+        const float p00 = camera.projectionMatrix[0][0];
+        const float p11 = camera.projectionMatrix[1][1];
+
+        for (size_t i = begin; i < end; ++i)
+        {
+            auto &bounds = m_bounds[i];
+            bounds.visible = false;
+
+            const glm::vec4 &pr = m_lights[i].positionRadius;
+            const float radius = pr.w;
+            if (radius <= 0.f)
+                continue;
+
+            const glm::vec3 c = glm::vec3(camera.viewMatrix * glm::vec4(glm::vec3(pr), 1.f));
+            const float depth = -c.z;
+
+            if (depth + radius < nearPlane || depth - radius > farPlane)
+                continue;
+
+            // Depth slices
+            const float zNear = std::max(nearPlane, depth - radius);
+            const float zFar = std::min(farPlane, depth + radius);
+            const int sliceMin = (int)std::floor(std::log(zNear) * sliceScale + sliceBias);
+            const int sliceMax = (int)std::floor(std::log(zFar) * sliceScale + sliceBias);
+
+            // Screen rect of the view space box. The projection is monotonic in
+            // x and 1/depth, so the extremes are at the corners. Corners in front
+            // of the near plane are clamped to it, which only grows the rect.
+            float ndcMinX = 1.f, ndcMaxX = -1.f;
+            float ndcMinY = 1.f, ndcMaxY = -1.f;
+            const float depths[2] = {zNear, zFar};
+            for (float d : depths)
+            {
+                for (int sx = -1; sx <= 1; sx += 2)
+                {
+                    const float x = (c.x + sx * radius) * p00 / d;
+                    ndcMinX = std::min(ndcMinX, x);
+                    ndcMaxX = std::max(ndcMaxX, x);
+                }
+                for (int sy = -1; sy <= 1; sy += 2)
+                {
+                    const float y = (c.y + sy * radius) * p11 / d;
+                    ndcMinY = std::min(ndcMinY, y);
+                    ndcMaxY = std::max(ndcMaxY, y);
+                }
+            }
+
+            if (ndcMaxX < -1.f || ndcMinX > 1.f || ndcMaxY < -1.f || ndcMinY > 1.f)
+                continue;
+
+            // Tiles use a top-left origin like gl_FragCoord in Vulkan
+            auto toTile = [](float v, uint32_t count)
+            {
+                const int t = (int)std::floor(v * (float)count);
+                return (uint16_t)std::clamp(t, 0, (int)count - 1);
+            };
+
+            bounds.minX = toTile(ndcMinX * 0.5f + 0.5f, kGridX);
+            bounds.maxX = toTile(ndcMaxX * 0.5f + 0.5f, kGridX);
+            bounds.minY = toTile(0.5f - ndcMaxY * 0.5f, kGridY);
+            bounds.maxY = toTile(0.5f - ndcMinY * 0.5f, kGridY);
+            bounds.minZ = (uint16_t)std::clamp(sliceMin, 0, (int)kGridZ - 1);
+            bounds.maxZ = (uint16_t)std::clamp(sliceMax, 0, (int)kGridZ - 1);
+            bounds.visible = true;
+        }
+    }
+
+    void ClusteredLighting::BinSlice(uint32_t z)
+    {
+        auto &slice = m_slices[z];
+        std::fill(slice.counts.begin(), slice.counts.end(), 0u);
+
+        // Pass 1: count lights per tile
+        uint32_t total = 0;
+        for (const auto &b : m_bounds)
+        {
+            if (!b.visible || z < b.minZ || z > b.maxZ)
+                continue;
+
+            for (uint32_t y = b.minY; y <= b.maxY; ++y)
+                for (uint32_t x = b.minX; x <= b.maxX; ++x)
+                    ++slice.counts[y * kGridX + x];
+
+            total += (uint32_t)(b.maxY - b.minY + 1) * (b.maxX - b.minX + 1);
+        }
+
+        // Pass 2: exclusive prefix sum, then scatter light indices
+        auto &cursor = slice.cursor;
+        uint32_t running = 0;
+        for (size_t t = 0; t < slice.counts.size(); ++t)
+        {
+            cursor[t] = running;
+            running += slice.counts[t];
+        }
+
+        slice.indices.resize(total);
+        for (uint32_t i = 0; i < (uint32_t)m_bounds.size(); ++i)
+        {
+            const auto &b = m_bounds[i];
+            if (!b.visible || z < b.minZ || z > b.maxZ)
+                continue;
+
+            for (uint32_t y = b.minY; y <= b.maxY; ++y)
+                for (uint32_t x = b.minX; x <= b.maxX; ++x)
+                    slice.indices[cursor[y * kGridX + x]++] = i;
+        }
+    }
+}
@@ -0,0 +1,321 @@
+#include "render/HiZPyramid.h"
+
+#include "vk/VkHelpers.h"
+#include "vk/VulkanContext.h"
+#include "Engine.h"
+
+#include <SDL3/SDL.h>
+
+#include <algorithm>
+
+namespace eng
+{
+    struct HiZPush
+    {
+        uint32_t srcWidth = 0;
+        uint32_t srcHeight = 0;
+        uint32_t dstWidth = 0;
+        uint32_t dstHeight = 0;
+    };
+
+    static uint32_t PrevPow2(uint32_t v)
+    {
+        uint32_t p = 1;
+        while (p * 2 <= v)
+            p *= 2;
+        return p;
+    }
+
+    void HiZPyramid::Init(VulkanContext &vk)
+    {
+        m_device = vk.GetDevice();
+        m_gpu = vk.GetGPU();
+        m_vk = &vk;
+
+        VkDescriptorSetLayoutBinding bindings[2]{};
+        bindings[0].binding = 0;
+        bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        bindings[0].descriptorCount = 1;
+        bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        bindings[1].binding = 1;
+        bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        bindings[1].descriptorCount = 1;
+        bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+        VkDescriptorSetLayoutCreateInfo li{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+        li.bindingCount = 2;
+        li.pBindings = bindings;
+        vkutil::vkCheck(vkCreateDescriptorSetLayout(m_device, &li, nullptr, &m_setLayout),
+                        "vkCreateDescriptorSetLayout (hiz) failed");
+
+        VkPushConstantRange range{};
+        range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        range.size = sizeof(HiZPush);
+
+        VkPipelineLayoutCreateInfo pli{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+        pli.setLayoutCount = 1;
+        pli.pSetLayouts = &m_setLayout;
+        pli.pushConstantRangeCount = 1;
+        pli.pPushConstantRanges = &range;
+        vkutil::vkCheck(vkCreatePipelineLayout(m_device, &pli, nullptr, &m_layout),
+                        "vkCreatePipelineLayout (hiz) failed");
+
+        m_initPipeline = CreatePipeline("shaders/hiz_init_comp.spv");
+        m_initMsPipeline = CreatePipeline("shaders/hiz_init_ms_comp.spv");
+        m_reducePipeline = CreatePipeline("shaders/hiz_reduce_comp.spv");
+
+        // Nearest only: a filtered depth would no longer be a conservative max
+        VkSamplerCreateInfo si{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+        si.magFilter = VK_FILTER_NEAREST;
+        si.minFilter = VK_FILTER_NEAREST;
+        si.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        si.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        si.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        si.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        si.maxLod = VK_LOD_CLAMP_NONE;
+        vkutil::vkCheck(vkCreateSampler(m_device, &si, nullptr, &m_sampler), "vkCreateSampler (hiz) failed");
+    }
+
+    VkPipeline HiZPyramid::CreatePipeline(const char *path)
+    {
+        auto code = Engine::GetInstance().GetFileSystem().LoadAssetSpirv(path);
+
+        VkShaderModuleCreateInfo mi{VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
+        mi.codeSize = code.size() * sizeof(uint32_t);
+        mi.pCode = code.data();
+
+        VkShaderModule module{};
+        vkutil::vkCheck(vkCreateShaderModule(m_device, &mi, nullptr, &module), "vkCreateShaderModule (hiz) failed");
+
+        VkComputePipelineCreateInfo ci{VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+        ci.stage = {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+        ci.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        ci.stage.module = module;
+        ci.stage.pName = "main";
+        ci.layout = m_layout;
+
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        vkutil::vkCheck(vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &ci, nullptr, &pipeline),
+                        "vkCreateComputePipelines (hiz) failed");
+
+        vkDestroyShaderModule(m_device, module, nullptr);
+        return pipeline;
+    }
+
+    void HiZPyramid::Resize(const Swapchain &swapchain)
+    {
+        DestroyImage();
+
+        if (!m_device)
+            return;
+
+        // Without a sampleable depth the pyramid is a 1x1 placeholder, so the
+        // culling descriptors stay valid, and Build() does nothing
+        m_buildable = swapchain.depthSampleable();
+        if (!m_buildable)
+            SDL_Log("HiZPyramid: depth format cannot be sampled, occlusion culling disabled");
+
+        const VkExtent2D extent = swapchain.extent();
+        m_width = m_buildable ? PrevPow2(extent.width) : 1;
+        m_height = m_buildable ? PrevPow2(extent.height) : 1;
+        m_mipCount = 1;
+        while ((m_width >> m_mipCount) > 0 || (m_height >> m_mipCount) > 0)
+            ++m_mipCount;
+
+        m_depthImage = swapchain.depthImage();
+        m_depthMultisampled = swapchain.msaaSamples() != VK_SAMPLE_COUNT_1_BIT;
+        m_depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+        if (swapchain.depthFormat() == VK_FORMAT_D32_SFLOAT_S8_UINT || swapchain.depthFormat() == VK_FORMAT_D24_UNORM_S8_UINT)
+            m_depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+
+        vkutil::CreateImage(m_gpu, m_device, m_width, m_height, m_mipCount, VK_FORMAT_R32_SFLOAT,
+                            VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT,
+                            m_image, m_memory);
+        m_view = vkutil::CreateImageView(m_device, m_image, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, 0, m_mipCount);
+
+        VkCommandBuffer cmd = vkutil::BeginOneTime(m_device, m_vk->GetCommandPool());
+        vkutil::TransitionImageLayout(cmd, m_image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+                                      VK_IMAGE_ASPECT_COLOR_BIT, 0, m_mipCount);
+        vkutil::EndOneTime(m_device, m_vk->GetGraphicsQueue(), m_vk->GetCommandPool(), cmd);
+
+        if (!m_buildable)
+            return;
+
+        m_mipViews.resize(m_mipCount);
+        for (uint32_t i = 0; i < m_mipCount; ++i)
+            m_mipViews[i] = vkutil::CreateImageView(m_device, m_image, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, i, 1);
+
+        // One set per mip: set 0 reads depth, set i reads mip i-1
+        VkDescriptorPoolSize sizes[2]{};
+        sizes[0] = {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_mipCount};
+        sizes[1] = {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, m_mipCount};
+
+        VkDescriptorPoolCreateInfo pi{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+        pi.maxSets = m_mipCount;
+        pi.poolSizeCount = 2;
+        pi.pPoolSizes = sizes;
+        vkutil::vkCheck(vkCreateDescriptorPool(m_device, &pi, nullptr, &m_descriptorPool),
+                        "vkCreateDescriptorPool (hiz) failed");
+
+        std::vector<VkDescriptorSetLayout> layouts(m_mipCount, m_setLayout);
+        m_sets.resize(m_mipCount);
+
+        VkDescriptorSetAllocateInfo ai{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+        ai.descriptorPool = m_descriptorPool;
+        ai.descriptorSetCount = m_mipCount;
+        ai.pSetLayouts = layouts.data();
+        vkutil::vkCheck(vkAllocateDescriptorSets(m_device, &ai, m_sets.data()), "vkAllocateDescriptorSets (hiz) failed");
+
+        for (uint32_t i = 0; i < m_mipCount; ++i)
+        {
+            VkDescriptorImageInfo src{};
+            src.sampler = m_sampler;
+            src.imageView = i == 0 ? swapchain.depthView() : m_mipViews[i - 1];
+            src.imageLayout = i == 0 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+            VkDescriptorImageInfo dst{};
+            dst.imageView = m_mipViews[i];
+            dst.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+            VkWriteDescriptorSet writes[2]{};
+            writes[0] = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+            writes[0].dstSet = m_sets[i];
+            writes[0].dstBinding = 0;
+            writes[0].descriptorCount = 1;
+            writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            writes[0].pImageInfo = &src;
+            writes[1] = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+            writes[1].dstSet = m_sets[i];
+            writes[1].dstBinding = 1;
+            writes[1].descriptorCount = 1;
+            writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            writes[1].pImageInfo = &dst;
+            vkUpdateDescriptorSets(m_device, 2, writes, 0, nullptr);
+        }
+    }
+
+    void HiZPyramid::Build(VkCommandBuffer cmd)
+    {
+        if (!m_buildable)
+            return;
+
+        VkImageMemoryBarrier toRead{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+        toRead.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        toRead.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        toRead.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        toRead.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+        toRead.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toRead.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toRead.image = m_depthImage;
+        toRead.subresourceRange = {m_depthAspect, 0, 1, 0, 1};
+
+        // The previous contents may still be read by this frame's early culling
+        VkMemoryBarrier pyramidWar{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+        pyramidWar.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        pyramidWar.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+
+        vkCmdPipelineBarrier(cmd,
+                             VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0, 1, &pyramidWar, 0, nullptr, 1, &toRead);
+
+        VkMemoryBarrier mipWritten{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+        mipWritten.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        mipWritten.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        for (uint32_t i = 0; i < m_mipCount; ++i)
+        {
+            HiZPush push{};
+            push.dstWidth = std::max(1u, m_width >> i);
+            push.dstHeight = std::max(1u, m_height >> i);
+
+            if (i == 0)
+            {
+                const VkExtent2D extent = m_vk->GetExtent();
+                push.srcWidth = extent.width;
+                push.srcHeight = extent.height;
+                vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_depthMultisampled ? m_initMsPipeline : m_initPipeline);
+            }
+            else
+            {
+                push.srcWidth = std::max(1u, m_width >> (i - 1));
+                push.srcHeight = std::max(1u, m_height >> (i - 1));
+                if (i == 1)
+                    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_reducePipeline);
+
+                vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                     0, 1, &mipWritten, 0, nullptr, 0, nullptr);
+            }
+
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_layout, 0, 1, &m_sets[i], 0, nullptr);
+            vkCmdPushConstants(cmd, m_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(HiZPush), &push);
+            vkCmdDispatch(cmd, (push.dstWidth + kGroupSize - 1) / kGroupSize, (push.dstHeight + kGroupSize - 1) / kGroupSize, 1);
+        }
+
+        VkImageMemoryBarrier toAttachment = toRead;
+        toAttachment.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        toAttachment.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        toAttachment.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+        toAttachment.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                             0, 1, &mipWritten, 0, nullptr, 1, &toAttachment);
+    }
+
+    void HiZPyramid::DestroyImage()
+    {
+        if (!m_device)
+            return;
+
+        if (m_descriptorPool)
+            vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
+        m_descriptorPool = VK_NULL_HANDLE;
+        m_sets.clear();
+
+        for (VkImageView view : m_mipViews)
+            vkDestroyImageView(m_device, view, nullptr);
+        m_mipViews.clear();
+
+        if (m_view)
+            vkDestroyImageView(m_device, m_view, nullptr);
+        if (m_image)
+            vkDestroyImage(m_device, m_image, nullptr);
+        if (m_memory)
+            vkFreeMemory(m_device, m_memory, nullptr);
+
+        m_view = VK_NULL_HANDLE;
+        m_image = VK_NULL_HANDLE;
+        m_memory = VK_NULL_HANDLE;
+        m_depthImage = VK_NULL_HANDLE;
+        m_width = m_height = m_mipCount = 0;
+        m_buildable = false;
+    }
+
+    void HiZPyramid::Destroy()
+    {
+        if (!m_device)
+            return;
+
+        DestroyImage();
+
+        VkPipeline pipelines[3] = {m_initPipeline, m_initMsPipeline, m_reducePipeline};
+        for (VkPipeline pipeline : pipelines)
+            if (pipeline)
+                vkDestroyPipeline(m_device, pipeline, nullptr);
+
+        if (m_sampler)
+            vkDestroySampler(m_device, m_sampler, nullptr);
+        if (m_layout)
+            vkDestroyPipelineLayout(m_device, m_layout, nullptr);
+        if (m_setLayout)
+            vkDestroyDescriptorSetLayout(m_device, m_setLayout, nullptr);
+
+        m_initPipeline = m_initMsPipeline = m_reducePipeline = VK_NULL_HANDLE;
+        m_sampler = VK_NULL_HANDLE;
+        m_layout = VK_NULL_HANDLE;
+        m_setLayout = VK_NULL_HANDLE;
+        m_device = VK_NULL_HANDLE;
+        m_vk = nullptr;
+    }
+}
@@ -0,0 +1,405 @@
+#include "render/ImposterBaker.h"
+
+#include "render/Material.h"
+#include "render/Mesh.h"
+#include "vk/VkHelpers.h"
+#include "vk/VulkanContext.h"
+#include "Engine.h"
+
+#include <SDL3/SDL.h>
+
+#include <glm/geometric.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace eng
+{
+    struct ImposterBakePush
+    {
+        glm::mat4 viewProj;
+    };
+
+    static glm::vec2 SignNotZero(const glm::vec2 &v)
+    {
+        return {v.x >= 0.f ? 1.f : -1.f, v.y >= 0.f ? 1.f : -1.f};
+    }
+
+    // Full sphere octahedral mapping, e in [-1, 1]. Same as imposter_vert.glsl.
+    static glm::vec3 OctahedralDecode(const glm::vec2 &e)
+    {
+        glm::vec3 n(e.x, e.y, 1.f - std::abs(e.x) - std::abs(e.y));
+        if (n.z < 0.f)
+        {
+            const glm::vec2 folded = (1.f - glm::abs(glm::vec2(n.y, n.x))) * SignNotZero(glm::vec2(n));
+            n.x = folded.x;
+            n.y = folded.y;
+        }
+        return glm::normalize(n);
+    }
+
+    void ImposterBaker::Init(VulkanContext &vk)
+    {
+        m_vk = &vk;
+        m_device = vk.GetDevice();
+        m_gpu = vk.GetGPU();
+
+        VkAttachmentDescription attachments[2]{};
+        attachments[0].format = kColorFormat;
+        attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+        attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        // Ready for vkutil::GenerateMipmaps
+        attachments[0].finalLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+
+        attachments[1].format = kDepthFormat;
+        attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+        attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentReference colorRef{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+        VkAttachmentReference depthRef{1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+        VkSubpassDescription subpass{};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 1;
+        subpass.pColorAttachments = &colorRef;
+        subpass.pDepthStencilAttachment = &depthRef;
+
+        // The mip blits read what the subpass wrote
+        VkSubpassDependency dependency{};
+        dependency.srcSubpass = 0;
+        dependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependency.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependency.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+        VkRenderPassCreateInfo rpi{VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO};
+        rpi.attachmentCount = 2;
+        rpi.pAttachments = attachments;
+        rpi.subpassCount = 1;
+        rpi.pSubpasses = &subpass;
+        rpi.dependencyCount = 1;
+        rpi.pDependencies = &dependency;
+        vkutil::vkCheck(vkCreateRenderPass(m_device, &rpi, nullptr, &m_renderPass),
+                        "vkCreateRenderPass (imposter bake) failed");
+
+        // set 0: the material texture
+        VkDescriptorSetLayout textureLayout = vk.GetTextureSetLayout();
+
+        VkPushConstantRange range{};
+        range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        range.size = sizeof(ImposterBakePush);
+
+        VkPipelineLayoutCreateInfo pli{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+        pli.setLayoutCount = 1;
+        pli.pSetLayouts = &textureLayout;
+        pli.pushConstantRangeCount = 1;
+        pli.pPushConstantRanges = &range;
+        vkutil::vkCheck(vkCreatePipelineLayout(m_device, &pli, nullptr, &m_layout),
+                        "vkCreatePipelineLayout (imposter bake) failed");
+
+        // Clamped so frames do not bleed into their neighbours at the atlas edge
+        VkSamplerCreateInfo si{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+        si.magFilter = VK_FILTER_LINEAR;
+        si.minFilter = VK_FILTER_LINEAR;
+        si.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+        si.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        si.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        si.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        si.maxLod = VK_LOD_CLAMP_NONE;
+        vkutil::vkCheck(vkCreateSampler(m_device, &si, nullptr, &m_sampler), "vkCreateSampler (imposter) failed");
+    }
+
+    void ImposterBaker::Destroy()
+    {
+        if (!m_device)
+            return;
+
+        for (auto &variant : m_variants)
+            vkDestroyPipeline(m_device, variant.pipeline, nullptr);
+        m_variants.clear();
+
+        if (m_sampler)
+            vkDestroySampler(m_device, m_sampler, nullptr);
+        if (m_layout)
+            vkDestroyPipelineLayout(m_device, m_layout, nullptr);
+        if (m_renderPass)
+            vkDestroyRenderPass(m_device, m_renderPass, nullptr);
+
+        m_sampler = VK_NULL_HANDLE;
+        m_layout = VK_NULL_HANDLE;
+        m_renderPass = VK_NULL_HANDLE;
+        m_device = VK_NULL_HANDLE;
+    }
+
+    VkPipeline ImposterBaker::GetPipeline(const VertexLayout &layout)
+    {
+        for (const auto &variant : m_variants)
+            if (variant.layout == layout)
+                return variant.pipeline;
+
+        auto &fs = Engine::GetInstance().GetFileSystem();
+        VkShaderModule modules[2]{};
+        const char *paths[2] = {"shaders/imposter_bake_vert.spv", "shaders/imposter_bake_frag.spv"};
+        for (int i = 0; i < 2; ++i)
+        {
+            auto code = fs.LoadAssetSpirv(paths[i]);
+            VkShaderModuleCreateInfo mi{VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
+            mi.codeSize = code.size() * sizeof(uint32_t);
+            mi.pCode = code.data();
+            vkutil::vkCheck(vkCreateShaderModule(m_device, &mi, nullptr, &modules[i]),
+                            "vkCreateShaderModule (imposter bake) failed");
+        }
+
+        VkPipelineShaderStageCreateInfo stages[2]{};
+        stages[0] = {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+        stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+        stages[0].module = modules[0];
+        stages[0].pName = "main";
+        stages[1] = {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+        stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        stages[1].module = modules[1];
+        stages[1].pName = "main";
+
+        // Position, color, UV and normal of the interleaved float layout
+        VkVertexInputBindingDescription binding{0, layout.stride, VK_VERTEX_INPUT_RATE_VERTEX};
+        std::vector<VkVertexInputAttributeDescription> attrs;
+        for (const auto &e : layout.elements)
+        {
+            if (e.index <= VertexElement::Normal)
+                attrs.push_back({e.index, 0, ToVkFormat(e.type, e.size), e.offset});
+        }
+
+        VkPipelineVertexInputStateCreateInfo vi{VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
+        vi.vertexBindingDescriptionCount = 1;
+        vi.pVertexBindingDescriptions = &binding;
+        vi.vertexAttributeDescriptionCount = (uint32_t)attrs.size();
+        vi.pVertexAttributeDescriptions = attrs.data();
+
+        VkPipelineInputAssemblyStateCreateInfo ia{VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO};
+        ia.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+        VkPipelineViewportStateCreateInfo vpState{VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO};
+        vpState.viewportCount = 1;
+        vpState.scissorCount = 1;
+
+        VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+        VkPipelineDynamicStateCreateInfo dyn{VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO};
+        dyn.dynamicStateCount = 2;
+        dyn.pDynamicStates = dynamicStates;
+
+        // Frames look at the mesh from every side, open geometry included
+        VkPipelineRasterizationStateCreateInfo rs{VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO};
+        rs.polygonMode = VK_POLYGON_MODE_FILL;
+        rs.cullMode = VK_CULL_MODE_NONE;
+        rs.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+        rs.lineWidth = 1.f;
+
+        VkPipelineMultisampleStateCreateInfo ms{VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO};
+        ms.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+        VkPipelineDepthStencilStateCreateInfo ds{VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO};
+        ds.depthTestEnable = VK_TRUE;
+        ds.depthWriteEnable = VK_TRUE;
+        ds.depthCompareOp = VK_COMPARE_OP_LESS;
+
+        VkPipelineColorBlendAttachmentState cbAtt{};
+        cbAtt.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+        VkPipelineColorBlendStateCreateInfo cb{VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO};
+        cb.attachmentCount = 1;
+        cb.pAttachments = &cbAtt;
+
+        VkGraphicsPipelineCreateInfo gp{VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
+        gp.stageCount = 2;
+        gp.pStages = stages;
+        gp.pVertexInputState = &vi;
+        gp.pInputAssemblyState = &ia;
+        gp.pViewportState = &vpState;
+        gp.pRasterizationState = &rs;
+        gp.pMultisampleState = &ms;
+        gp.pDepthStencilState = &ds;
+        gp.pColorBlendState = &cb;
+        gp.pDynamicState = &dyn;
+        gp.layout = m_layout;
+        gp.renderPass = m_renderPass;
+        gp.subpass = 0;
+
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        vkutil::vkCheck(vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &gp, nullptr, &pipeline),
+                        "vkCreateGraphicsPipelines (imposter bake) failed");
+
+        vkDestroyShaderModule(m_device, modules[0], nullptr);
+        vkDestroyShaderModule(m_device, modules[1], nullptr);
+
+        m_variants.push_back({layout, pipeline});
+        return pipeline;
+    }
+
+    bool ImposterBaker::Bake(const Mesh &mesh, const Material &material, Imposter &out)
+    {
+        const auto &vertices = mesh.GetVertices();
+        const auto &indices = mesh.GetIndices();
+        const VertexLayout &layout = mesh.GetVertexLayout();
+
+        if (vertices.empty() || material.GetTextureSet() == VK_NULL_HANDLE)
+        {
+            SDL_Log("ImposterBaker: mesh has no CPU copy or material has no texture, not baked");
+            return false;
+        }
+
+        const AABB &bounds = mesh.GetBounds();
+        out.center = (bounds.min + bounds.max) * 0.5f;
+        out.radius = std::max(glm::length(bounds.max - bounds.min) * 0.5f, 1e-4f);
+
+        // Temporary copies of the float vertices, the pool only has the quantized ones
+        const VkDeviceSize vertexBytes = vertices.size() * sizeof(float);
+        const VkDeviceSize indexBytes = std::max<VkDeviceSize>(indices.size() * sizeof(uint32_t), 4);
+        VkBuffer vertexBuffer{}, indexBuffer{};
+        VkDeviceMemory vertexMemory{}, indexMemory{};
+        vkutil::CreateBuffer(m_gpu, m_device, vertexBytes, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                             vertexBuffer, vertexMemory);
+        vkutil::CreateBuffer(m_gpu, m_device, indexBytes, VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                             indexBuffer, indexMemory);
+
+        void *mapped = nullptr;
+        vkutil::vkCheck(vkMapMemory(m_device, vertexMemory, 0, vertexBytes, 0, &mapped), "vkMapMemory failed");
+        std::memcpy(mapped, vertices.data(), (size_t)vertexBytes);
+        vkUnmapMemory(m_device, vertexMemory);
+        if (!indices.empty())
+        {
+            vkutil::vkCheck(vkMapMemory(m_device, indexMemory, 0, indexBytes, 0, &mapped), "vkMapMemory failed");
+            std::memcpy(mapped, indices.data(), indices.size() * sizeof(uint32_t));
+            vkUnmapMemory(m_device, indexMemory);
+        }
+
+        const uint32_t mipLevels = vkutil::FormatSupportsLinearBlit(m_gpu, kColorFormat) ? kMipLevels : 1;
+
+        vkutil::CreateImage(m_gpu, m_device, kAtlasSize, kAtlasSize, mipLevels, kColorFormat,
+                            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                                VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                            out.image, out.memory);
+        out.view = vkutil::CreateImageView(m_device, out.image, kColorFormat, VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels);
+        VkImageView targetView = vkutil::CreateImageView(m_device, out.image, kColorFormat, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1);
+
+        VkImage depthImage{};
+        VkDeviceMemory depthMemory{};
+        vkutil::CreateImage(m_gpu, m_device, kAtlasSize, kAtlasSize, 1, kDepthFormat,
+                            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, depthImage, depthMemory);
+        VkImageView depthView = vkutil::CreateImageView(m_device, depthImage, kDepthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1);
+
+        VkImageView views[2] = {targetView, depthView};
+        VkFramebufferCreateInfo fbi{VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
+        fbi.renderPass = m_renderPass;
+        fbi.attachmentCount = 2;
+        fbi.pAttachments = views;
+        fbi.width = kAtlasSize;
+        fbi.height = kAtlasSize;
+        fbi.layers = 1;
+        VkFramebuffer framebuffer{};
+        vkutil::vkCheck(vkCreateFramebuffer(m_device, &fbi, nullptr, &framebuffer),
+                        "vkCreateFramebuffer (imposter bake) failed");
+
+        VkClearValue clears[2]{};
+        clears[1].depthStencil.depth = 1.f;
+
+        VkRenderPassBeginInfo rbi{VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
+        rbi.renderPass = m_renderPass;
+        rbi.framebuffer = framebuffer;
+        rbi.renderArea.extent = {kAtlasSize, kAtlasSize};
+        rbi.clearValueCount = 2;
+        rbi.pClearValues = clears;
+
+        VkPipeline pipeline = GetPipeline(layout);
+        VkDescriptorSet textureSet = material.GetTextureSet();
+
+        VkCommandBuffer cmd = vkutil::BeginOneTime(m_device, m_vk->GetCommandPool());
+        vkCmdBeginRenderPass(cmd, &rbi, VK_SUBPASS_CONTENTS_INLINE);
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_layout, 0, 1, &textureSet, 0, nullptr);
+
+        VkDeviceSize offset = 0;
+        vkCmdBindVertexBuffers(cmd, 0, 1, &vertexBuffer, &offset);
+        if (!indices.empty())
+            vkCmdBindIndexBuffer(cmd, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+        const float r = out.radius;
+        for (uint32_t y = 0; y < kFrames; ++y)
+        {
+            for (uint32_t x = 0; x < kFrames; ++x)
+            {
+                const glm::vec2 cell((x + 0.5f) / kFrames * 2.f - 1.f, (y + 0.5f) / kFrames * 2.f - 1.f);
+                const glm::vec3 dir = OctahedralDecode(cell);
+                const glm::vec3 up = std::abs(dir.y) > 0.999f ? glm::vec3(0.f, 0.f, 1.f) : glm::vec3(0.f, 1.f, 0.f);
+
+                const glm::mat4 view = glm::lookAt(out.center + dir * (2.f * r), out.center, up);
+                glm::mat4 proj = glm::orthoRH_ZO(-r, r, -r, r, 0.5f * r, 3.5f * r);
+                // Same flip as the camera UBO: +up is the top row of the frame
+                proj[1][1] *= -1.f;
+
+                ImposterBakePush push{proj * view};
+                vkCmdPushConstants(cmd, m_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push), &push);
+
+                VkViewport vp{};
+                vp.x = (float)(x * kFrameSize);
+                vp.y = (float)(y * kFrameSize);
+                vp.width = (float)kFrameSize;
+                vp.height = (float)kFrameSize;
+                vp.maxDepth = 1.f;
+                VkRect2D sc{{(int32_t)(x * kFrameSize), (int32_t)(y * kFrameSize)}, {kFrameSize, kFrameSize}};
+                vkCmdSetViewport(cmd, 0, 1, &vp);
+                vkCmdSetScissor(cmd, 0, 1, &sc);
+
+                if (indices.empty())
+                    vkCmdDraw(cmd, (uint32_t)mesh.GetVertexCount(), 1, 0, 0);
+                else
+                    vkCmdDrawIndexed(cmd, (uint32_t)indices.size(), 1, 0, 0, 0);
+            }
+        }
+
+        vkCmdEndRenderPass(cmd);
+        vkutil::GenerateMipmaps(m_gpu, cmd, out.image, kColorFormat, (int32_t)kAtlasSize, (int32_t)kAtlasSize, mipLevels);
+        vkutil::EndOneTime(m_device, m_vk->GetGraphicsQueue(), m_vk->GetCommandPool(), cmd);
+
+        vkDestroyFramebuffer(m_device, framebuffer, nullptr);
+        vkDestroyImageView(m_device, targetView, nullptr);
+        vkDestroyImageView(m_device, depthView, nullptr);
+        vkDestroyImage(m_device, depthImage, nullptr);
+        vkFreeMemory(m_device, depthMemory, nullptr);
+        vkDestroyBuffer(m_device, vertexBuffer, nullptr);
+        vkFreeMemory(m_device, vertexMemory, nullptr);
+        vkDestroyBuffer(m_device, indexBuffer, nullptr);
+        vkFreeMemory(m_device, indexMemory, nullptr);
+
+        out.textureSet = m_vk->CreateTextureSet(out.view, m_sampler);
+        return true;
+    }
+
+    void ImposterBaker::DestroyImposter(Imposter &imposter)
+    {
+        if (!m_device)
+            return;
+
+        m_vk->FreeTextureSet(imposter.textureSet);
+        if (imposter.view)
+            vkDestroyImageView(m_device, imposter.view, nullptr);
+        if (imposter.image)
+            vkDestroyImage(m_device, imposter.image, nullptr);
+        if (imposter.memory)
+            vkFreeMemory(m_device, imposter.memory, nullptr);
+        imposter = {};
+    }
+}
@@ -0,0 +1,373 @@
+#include "render/ImposterRenderer.h"
+
+#include "render/Frustum.h"
+#include "render/Material.h"
+#include "render/RenderScene.h"
+#include "vk/VkHelpers.h"
+#include "vk/VulkanContext.h"
+#include "Common.h"
+#include "Engine.h"
+
+#include <SDL3/SDL.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace eng
+{
+    void ImposterRenderer::Init(VulkanContext &vk, uint32_t framesInFlight)
+    {
+        m_vk = &vk;
+        m_device = vk.GetDevice();
+        m_gpu = vk.GetGPU();
+        m_renderPass = vk.GetRenderPass();
+
+        m_baker.Init(vk);
+
+        VkDescriptorSetLayout setLayouts[] = {vk.GetCameraSetLayout(), vk.GetTextureSetLayout()};
+
+        VkPushConstantRange range{};
+        range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        range.size = sizeof(Push);
+
+        VkPipelineLayoutCreateInfo pli{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+        pli.setLayoutCount = 2;
+        pli.pSetLayouts = setLayouts;
+        pli.pushConstantRangeCount = 1;
+        pli.pPushConstantRanges = &range;
+        vkutil::vkCheck(vkCreatePipelineLayout(m_device, &pli, nullptr, &m_layout),
+                        "vkCreatePipelineLayout (imposter) failed");
+
+        CreatePipeline();
+        m_frames.resize(framesInFlight);
+    }
+
+    void ImposterRenderer::Destroy()
+    {
+        if (!m_device)
+            return;
+
+        for (auto &[key, entry] : m_cache)
+            m_baker.DestroyImposter(entry->imposter);
+        m_cache.clear();
+        m_pending.clear();
+        m_baker.Destroy();
+
+        for (auto &frame : m_frames)
+        {
+            if (frame.buffer)
+            {
+                vkDestroyBuffer(m_device, frame.buffer, nullptr);
+                vkFreeMemory(m_device, frame.memory, nullptr);
+            }
+        }
+        m_frames.clear();
+
+        if (m_pipeline)
+            vkDestroyPipeline(m_device, m_pipeline, nullptr);
+        if (m_layout)
+            vkDestroyPipelineLayout(m_device, m_layout, nullptr);
+
+        m_pipeline = VK_NULL_HANDLE;
+        m_layout = VK_NULL_HANDLE;
+        m_device = VK_NULL_HANDLE;
+    }
+
+    void ImposterRenderer::Recreate(VkRenderPass renderPass)
+    {
+        if (!m_device)
+            return;
+
+        m_renderPass = renderPass;
+        if (m_pipeline)
+            vkDestroyPipeline(m_device, m_pipeline, nullptr);
+        CreatePipeline();
+    }
+
+    void ImposterRenderer::CreatePipeline()
+    {
+        auto &fs = Engine::GetInstance().GetFileSystem();
+        VkShaderModule modules[2]{};
+        const char *paths[2] = {"shaders/imposter_vert.spv", "shaders/imposter_frag.spv"};
+        for (int i = 0; i < 2; ++i)
+        {
+            auto code = fs.LoadAssetSpirv(paths[i]);
+            VkShaderModuleCreateInfo mi{VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
+            mi.codeSize = code.size() * sizeof(uint32_t);
+            mi.pCode = code.data();
+            vkutil::vkCheck(vkCreateShaderModule(m_device, &mi, nullptr, &modules[i]),
+                            "vkCreateShaderModule (imposter) failed");
+        }
+
+        VkPipelineShaderStageCreateInfo stages[2]{};
+        stages[0] = {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+        stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+        stages[0].module = modules[0];
+        stages[0].pName = "main";
+        stages[1] = {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+        stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        stages[1].module = modules[1];
+        stages[1].pName = "main";
+
+        // Per instance model matrix, the quad corners come from gl_VertexIndex
+        VkVertexInputBindingDescription binding{0, sizeof(glm::mat4), VK_VERTEX_INPUT_RATE_INSTANCE};
+        VkVertexInputAttributeDescription attrs[4]{};
+        for (uint32_t i = 0; i < 4; ++i)
+            attrs[i] = {i, 0, VK_FORMAT_R32G32B32A32_SFLOAT, i * (uint32_t)sizeof(glm::vec4)};
+
+        VkPipelineVertexInputStateCreateInfo vi{VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
+        vi.vertexBindingDescriptionCount = 1;
+        vi.pVertexBindingDescriptions = &binding;
+        vi.vertexAttributeDescriptionCount = 4;
+        vi.pVertexAttributeDescriptions = attrs;
+
+        VkPipelineInputAssemblyStateCreateInfo ia{VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO};
+        ia.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+        VkPipelineViewportStateCreateInfo vpState{VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO};
+        vpState.viewportCount = 1;
+        vpState.scissorCount = 1;
+
+        VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+        VkPipelineDynamicStateCreateInfo dyn{VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO};
+        dyn.dynamicStateCount = 2;
+        dyn.pDynamicStates = dynamicStates;
+
+        // The quad faces the frame direction, which may be behind it for a mirrored model matrix
+        VkPipelineRasterizationStateCreateInfo rs{VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO};
+        rs.polygonMode = VK_POLYGON_MODE_FILL;
+        rs.cullMode = VK_CULL_MODE_NONE;
+        rs.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+        rs.lineWidth = 1.f;
+
+        VkPipelineMultisampleStateCreateInfo ms{VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO};
+        ms.rasterizationSamples = m_vk->GetMsaaSamples();
+
+        VkPipelineDepthStencilStateCreateInfo ds{VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO};
+        ds.depthTestEnable = VK_TRUE;
+        ds.depthWriteEnable = VK_TRUE;
+        ds.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+        VkPipelineColorBlendAttachmentState cbAtt{};
+        cbAtt.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+        VkPipelineColorBlendStateCreateInfo cb{VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO};
+        cb.attachmentCount = 1;
+        cb.pAttachments = &cbAtt;
+
+        VkGraphicsPipelineCreateInfo gp{VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
+        gp.stageCount = 2;
+        gp.pStages = stages;
+        gp.pVertexInputState = &vi;
+        gp.pInputAssemblyState = &ia;
+        gp.pViewportState = &vpState;
+        gp.pRasterizationState = &rs;
+        gp.pMultisampleState = &ms;
+        gp.pDepthStencilState = &ds;
+        gp.pColorBlendState = &cb;
+        gp.pDynamicState = &dyn;
+        gp.layout = m_layout;
+        gp.renderPass = m_renderPass;
+        gp.subpass = 0;
+
+        vkutil::vkCheck(vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &gp, nullptr, &m_pipeline),
+                        "vkCreateGraphicsPipelines (imposter) failed");
+
+        vkDestroyShaderModule(m_device, modules[0], nullptr);
+        vkDestroyShaderModule(m_device, modules[1], nullptr);
+    }
+
+    const Imposter *ImposterRenderer::GetOrBake(const std::shared_ptr<Mesh> &mesh, const std::shared_ptr<Material> &material)
+    {
+        // The baker samples plain texture sets
+        if (!m_device || !mesh || !material || material->GetVirtualTexture())
+            return nullptr;
+
+        Entry &entry = GetEntry(mesh, material);
+        if (!entry.tried)
+            TryBake(entry, *mesh, *material);
+        return entry.baked ? &entry.imposter : nullptr;
+    }
+
+    const Imposter *ImposterRenderer::Get(const std::shared_ptr<Mesh> &mesh, const std::shared_ptr<Material> &material)
+    {
+        if (!m_device || !mesh || !material || material->GetVirtualTexture())
+            return nullptr;
+
+        Entry &entry = GetEntry(mesh, material);
+        if (!entry.tried && !entry.queued)
+        {
+            entry.queued = true;
+            m_pending.push_back({mesh, material});
+        }
+        return entry.baked ? &entry.imposter : nullptr;
+    }
+
+    ImposterRenderer::Entry &ImposterRenderer::GetEntry(const std::shared_ptr<Mesh> &mesh,
+                                                        const std::shared_ptr<Material> &material)
+    {
+        auto &entry = m_cache[{mesh.get(), material.get()}];
+        if (entry && (entry->mesh.expired() || entry->material.expired()))
+        {
+            // The pointers were reused before the dead entry was pruned, its atlas may still be in flight
+            vkDeviceWaitIdle(m_device);
+            m_baker.DestroyImposter(entry->imposter);
+            entry.reset();
+        }
+
+        if (!entry)
+        {
+            entry = std::make_unique<Entry>();
+            entry->mesh = mesh;
+            entry->material = material;
+        }
+        return *entry;
+    }
+
+    bool ImposterRenderer::TryBake(Entry &entry, const Mesh &mesh, const Material &material)
+    {
+        // Baking the placeholder would stick, ask again once the texture arrived
+        if (!material.IsTextureResident())
+            return false;
+
+        entry.tried = true;
+        entry.queued = false;
+        entry.baked = m_baker.Bake(mesh, material, entry.imposter);
+        return true;
+    }
+
+    void ImposterRenderer::NextFrame()
+    {
+        if (!m_device)
+            return;
+        ++m_frameCount;
+
+        // One bake per frame at most; pairs waiting for their texture stay queued
+        for (size_t i = 0; i < m_pending.size();)
+        {
+            auto mesh = m_pending[i].first.lock();
+            auto material = m_pending[i].second.lock();
+            auto it = mesh && material ? m_cache.find({mesh.get(), material.get()}) : m_cache.end();
+            if (it == m_cache.end() || it->second->tried)
+            {
+                m_pending.erase(m_pending.begin() + i);
+                continue;
+            }
+
+            if (TryBake(*it->second, *mesh, *material))
+            {
+                m_pending.erase(m_pending.begin() + i);
+                break;
+            }
+            ++i;
+        }
+
+        for (auto it = m_cache.begin(); it != m_cache.end();)
+        {
+            Entry &entry = *it->second;
+            if (!entry.mesh.expired() && !entry.material.expired())
+            {
+                ++it;
+                continue;
+            }
+
+            if (entry.retireFrame == 0)
+                entry.retireFrame = m_frameCount + m_frames.size();
+            if (m_frameCount < entry.retireFrame)
+            {
+                ++it;
+                continue;
+            }
+
+            m_baker.DestroyImposter(entry.imposter);
+            it = m_cache.erase(it);
+        }
+    }
+
+    void ImposterRenderer::EnsureCapacity(FrameResources &frame, uint32_t count)
+    {
+        if (frame.capacity >= count)
+            return;
+
+        // This frame's fence was waited on, its old buffer is no longer read
+        if (frame.buffer)
+        {
+            vkDestroyBuffer(m_device, frame.buffer, nullptr);
+            vkFreeMemory(m_device, frame.memory, nullptr);
+        }
+
+        frame.capacity = std::max(count, std::max(frame.capacity * 2, 256u));
+        vkutil::CreateBuffer(m_gpu, m_device, (VkDeviceSize)frame.capacity * sizeof(glm::mat4),
+                             VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                             frame.buffer, frame.memory);
+        vkutil::vkCheck(vkMapMemory(m_device, frame.memory, 0, VK_WHOLE_SIZE, 0, &frame.mapped),
+                        "vkMapMemory (imposter) failed");
+    }
+
+    void ImposterRenderer::Draw(VkCommandBuffer cmd, uint32_t frameIndex, VkDescriptorSet cameraSet,
+                                const RenderScene &renderScene, const CameraData &cameraData)
+    {
+        m_drawnCount = 0;
+        if (!m_device)
+            return;
+
+        const auto &proxies = renderScene.GetProxies();
+        const Frustum frustum = Frustum::FromMatrix(cameraData.projectionMatrix * cameraData.viewMatrix);
+
+        m_order.clear();
+        for (uint32_t i = 0; i < (uint32_t)proxies.size(); ++i)
+        {
+            if (proxies[i].imposter && frustum.Intersects(proxies[i].worldBounds))
+                m_order.push_back(i);
+        }
+        if (m_order.empty())
+            return;
+
+        std::sort(m_order.begin(), m_order.end(), [&proxies](uint32_t a, uint32_t b)
+                  { return proxies[a].imposter < proxies[b].imposter; });
+
+        auto &frame = m_frames[frameIndex];
+        EnsureCapacity(frame, (uint32_t)m_order.size());
+
+        auto *instances = static_cast<glm::mat4 *>(frame.mapped);
+        m_batches.clear();
+        for (uint32_t i = 0; i < (uint32_t)m_order.size(); ++i)
+        {
+            const auto &proxy = proxies[m_order[i]];
+            instances[i] = proxy.transform;
+
+            if (m_batches.empty() || m_batches.back().imposter != proxy.imposter)
+                m_batches.push_back({proxy.imposter, i, 0});
+            ++m_batches.back().instanceCount;
+        }
+
+        const VkExtent2D extent = m_vk->GetExtent();
+        VkViewport vp{};
+        vp.width = (float)extent.width;
+        vp.height = (float)extent.height;
+        vp.maxDepth = 1.f;
+        VkRect2D sc{{0, 0}, extent};
+
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
+        vkCmdSetViewport(cmd, 0, 1, &vp);
+        vkCmdSetScissor(cmd, 0, 1, &sc);
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_layout, 0, 1, &cameraSet, 0, nullptr);
+
+        VkDeviceSize offset = 0;
+        vkCmdBindVertexBuffers(cmd, 0, 1, &frame.buffer, &offset);
+
+        for (const auto &batch : m_batches)
+        {
+            const Imposter &imposter = *batch.imposter;
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_layout, 1, 1, &imposter.textureSet, 0, nullptr);
+
+            Push push{glm::vec4(imposter.center, imposter.radius)};
+            vkCmdPushConstants(cmd, m_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push), &push);
+
+            vkCmdDraw(cmd, 6, batch.instanceCount, 0, batch.firstInstance);
+        }
+
+        m_drawnCount = (uint32_t)m_order.size();
+    }
+}
@@ -0,0 +1,743 @@
+#include "render/IndirectRenderer.h"
+
+#include "render/HiZPyramid.h"
+#include "render/Material.h"
+#include "render/Mesh.h"
+#include "render/RenderScene.h"
+#include "graphics/GraphicsAPI.h"
+#include "graphics/ShaderProgram.h"
+#include "vk/VkHelpers.h"
+#include "vk/VulkanContext.h"
+#include "Engine.h"
+
+#include <SDL3/SDL.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace eng
+{
+    static_assert(sizeof(IndirectRenderer::GpuObject) == 128, "GpuObject must match the std430 layout");
+    static_assert(sizeof(IndirectRenderer::OcclusionStats) == 16, "OcclusionStats must match cull_comp.glsl");
+    static_assert(sizeof(GpuVertexFormat) == 48, "GpuVertexFormat must match the std430 layout");
+
+    void IndirectRenderer::Init(VulkanContext &vk, bool supported, uint32_t framesInFlight)
+    {
+        m_device = vk.GetDevice();
+        m_gpu = vk.GetGPU();
+
+        // Set 3 of every graphics pipeline layout, created even when the path is off.
+        // 0 objects, 1 vertex formats
+        VkDescriptorSetLayoutBinding objectBindings[2]{};
+        for (uint32_t i = 0; i < 2; ++i)
+        {
+            objectBindings[i].binding = i;
+            objectBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            objectBindings[i].descriptorCount = 1;
+            objectBindings[i].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        }
+
+        VkDescriptorSetLayoutCreateInfo oli{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+        oli.bindingCount = 2;
+        oli.pBindings = objectBindings;
+        vkutil::vkCheck(vkCreateDescriptorSetLayout(m_device, &oli, nullptr, &m_objectSetLayout),
+                        "vkCreateDescriptorSetLayout (objects) failed");
+
+        if (!supported)
+        {
+            SDL_Log("IndirectRenderer: drawIndirectCount not supported, using CPU draws");
+            return;
+        }
+
+        // 0 objects, 1 commands, 2 counts, 3 drawnEarly, 4 Hi-Z pyramid, 5 stats, 6 params
+        VkDescriptorSetLayoutBinding cullBindings[kCullBindingCount]{};
+        for (uint32_t i = 0; i < kCullBindingCount; ++i)
+        {
+            cullBindings[i].binding = i;
+            cullBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            cullBindings[i].descriptorCount = 1;
+            cullBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+        cullBindings[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        cullBindings[6].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+
+        VkDescriptorSetLayoutCreateInfo cli{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+        cli.bindingCount = kCullBindingCount;
+        cli.pBindings = cullBindings;
+        vkutil::vkCheck(vkCreateDescriptorSetLayout(m_device, &cli, nullptr, &m_cullSetLayout),
+                        "vkCreateDescriptorSetLayout (cull) failed");
+
+        VkDescriptorPoolSize ps[3]{};
+        ps[0] = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, framesInFlight * 7};
+        ps[1] = {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, framesInFlight};
+        ps[2] = {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, framesInFlight};
+
+        VkDescriptorPoolCreateInfo pi{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+        pi.maxSets = framesInFlight * 2;
+        pi.poolSizeCount = 3;
+        pi.pPoolSizes = ps;
+        vkutil::vkCheck(vkCreateDescriptorPool(m_device, &pi, nullptr, &m_descriptorPool),
+                        "vkCreateDescriptorPool (indirect) failed");
+
+        m_frames.resize(framesInFlight);
+        for (auto &frame : m_frames)
+        {
+            VkDescriptorSetLayout layouts[2] = {m_cullSetLayout, m_objectSetLayout};
+            VkDescriptorSet sets[2]{};
+
+            VkDescriptorSetAllocateInfo ai{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+            ai.descriptorPool = m_descriptorPool;
+            ai.descriptorSetCount = 2;
+            ai.pSetLayouts = layouts;
+            vkutil::vkCheck(vkAllocateDescriptorSets(m_device, &ai, sets),
+                            "vkAllocateDescriptorSets (indirect) failed");
+
+            frame.cullSet = sets[0];
+            frame.objectSet = sets[1];
+
+            // Small, fixed size and host visible: survive CreateFrameBuffers
+            vkutil::CreateBuffer(m_gpu, m_device, sizeof(OcclusionStats),
+                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                 frame.stats, frame.statsMemory);
+            vkutil::vkCheck(vkMapMemory(m_device, frame.statsMemory, 0, sizeof(OcclusionStats), 0, &frame.statsMapped),
+                            "vkMapMemory (cull stats) failed");
+            std::memset(frame.statsMapped, 0, sizeof(OcclusionStats));
+
+            vkutil::CreateBuffer(m_gpu, m_device, sizeof(CullParams) * 2,
+                                 VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                 frame.params, frame.paramsMemory);
+            vkutil::vkCheck(vkMapMemory(m_device, frame.paramsMemory, 0, sizeof(CullParams) * 2, 0, &frame.paramsMapped),
+                            "vkMapMemory (cull params) failed");
+
+            VkDescriptorBufferInfo statsInfo{frame.stats, 0, sizeof(OcclusionStats)};
+            vkutil::CreateBuffer(m_gpu, m_device, sizeof(GpuVertexFormat) * kMaxVertexPages,
+                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                 frame.formats, frame.formatsMemory);
+            vkutil::vkCheck(vkMapMemory(m_device, frame.formatsMemory, 0, sizeof(GpuVertexFormat) * kMaxVertexPages, 0, &frame.formatsMapped),
+                            "vkMapMemory (vertex formats) failed");
+
+            VkDescriptorBufferInfo paramsInfo{frame.params, 0, sizeof(CullParams) * 2};
+            VkDescriptorBufferInfo formatsInfo{frame.formats, 0, sizeof(GpuVertexFormat) * kMaxVertexPages};
+
+            VkWriteDescriptorSet writes[3]{};
+            writes[0] = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+            writes[0].dstSet = frame.cullSet;
+            writes[0].dstBinding = 5;
+            writes[0].descriptorCount = 1;
+            writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[0].pBufferInfo = &statsInfo;
+            writes[1] = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+            writes[1].dstSet = frame.cullSet;
+            writes[1].dstBinding = 6;
+            writes[1].descriptorCount = 1;
+            writes[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            writes[1].pBufferInfo = &paramsInfo;
+            writes[2] = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+            writes[2].dstSet = frame.objectSet;
+            writes[2].dstBinding = 1;
+            writes[2].descriptorCount = 1;
+            writes[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[2].pBufferInfo = &formatsInfo;
+            vkUpdateDescriptorSets(m_device, 3, writes, 0, nullptr);
+        }
+
+        m_pullingSupported = vk.IsVertexPullingSupported();
+
+        CreatePipelines();
+        m_clusters.Init(m_device, m_gpu, framesInFlight);
+        CreateFrameBuffers(kInitialCapacity, 64);
+
+        m_enabled = true;
+    }
+
+    void IndirectRenderer::CreatePipelines()
+    {
+        auto code = Engine::GetInstance().GetFileSystem().LoadAssetSpirv("shaders/cull_comp.spv");
+
+        VkShaderModuleCreateInfo mi{VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
+        mi.codeSize = code.size() * sizeof(uint32_t);
+        mi.pCode = code.data();
+
+        VkShaderModule module{};
+        vkutil::vkCheck(vkCreateShaderModule(m_device, &mi, nullptr, &module), "vkCreateShaderModule (cull) failed");
+
+        VkPushConstantRange range{};
+        range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        range.size = sizeof(uint32_t);
+
+        VkPipelineLayoutCreateInfo li{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+        li.setLayoutCount = 1;
+        li.pSetLayouts = &m_cullSetLayout;
+        li.pushConstantRangeCount = 1;
+        li.pPushConstantRanges = &range;
+        vkutil::vkCheck(vkCreatePipelineLayout(m_device, &li, nullptr, &m_cullLayout),
+                        "vkCreatePipelineLayout (cull) failed");
+
+        VkComputePipelineCreateInfo ci{VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+        ci.stage = {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+        ci.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        ci.stage.module = module;
+        ci.stage.pName = "main";
+        ci.layout = m_cullLayout;
+        vkutil::vkCheck(vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &ci, nullptr, &m_cullPipeline),
+                        "vkCreateComputePipelines (cull) failed");
+
+        vkDestroyShaderModule(m_device, module, nullptr);
+    }
+
+    void IndirectRenderer::CreateFrameBuffers(uint32_t capacity, uint32_t bucketCapacity)
+    {
+        m_capacity = capacity;
+        m_bucketCapacity = bucketCapacity;
+
+        // Commands and counts hold an early and a late region
+        const VkDeviceSize objectsSize = sizeof(GpuObject) * capacity;
+        const VkDeviceSize commandsSize = sizeof(VkDrawIndexedIndirectCommand) * capacity * 2;
+        const VkDeviceSize countsSize = sizeof(uint32_t) * bucketCapacity * 2;
+        const VkDeviceSize drawnEarlySize = sizeof(uint32_t) * capacity;
+
+        for (auto &frame : m_frames)
+        {
+            vkutil::CreateBuffer(m_gpu, m_device, objectsSize,
+                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                 frame.objects, frame.objectsMemory);
+            vkutil::vkCheck(vkMapMemory(m_device, frame.objectsMemory, 0, objectsSize, 0, &frame.objectsMapped),
+                            "vkMapMemory (objects) failed");
+
+            vkutil::CreateBuffer(m_gpu, m_device, commandsSize,
+                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                 frame.commands, frame.commandsMemory);
+
+            vkutil::CreateBuffer(m_gpu, m_device, countsSize,
+                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                 frame.counts, frame.countsMemory);
+
+            vkutil::CreateBuffer(m_gpu, m_device, drawnEarlySize,
+                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                 frame.drawnEarly, frame.drawnEarlyMemory);
+
+            VkDescriptorBufferInfo infos[5]{};
+            infos[0] = {frame.objects, 0, objectsSize};
+            infos[1] = {frame.commands, 0, commandsSize};
+            infos[2] = {frame.counts, 0, countsSize};
+            infos[3] = {frame.drawnEarly, 0, drawnEarlySize};
+            infos[4] = {frame.objects, 0, objectsSize};
+
+            VkWriteDescriptorSet writes[5]{};
+            for (uint32_t i = 0; i < 5; ++i)
+            {
+                writes[i] = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+                writes[i].dstSet = i < 4 ? frame.cullSet : frame.objectSet;
+                writes[i].dstBinding = i < 4 ? i : 0;
+                writes[i].descriptorCount = 1;
+                writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                writes[i].pBufferInfo = &infos[i];
+            }
+            vkUpdateDescriptorSets(m_device, 5, writes, 0, nullptr);
+
+            frame.fullUpload = true;
+            frame.dirty.clear();
+        }
+    }
+
+    void IndirectRenderer::DestroyFrameBuffers()
+    {
+        for (auto &frame : m_frames)
+        {
+            if (frame.objectsMapped)
+                vkUnmapMemory(m_device, frame.objectsMemory);
+            frame.objectsMapped = nullptr;
+
+            VkBuffer buffers[4] = {frame.objects, frame.commands, frame.counts, frame.drawnEarly};
+            VkDeviceMemory memories[4] = {frame.objectsMemory, frame.commandsMemory, frame.countsMemory, frame.drawnEarlyMemory};
+            for (int i = 0; i < 4; ++i)
+            {
+                if (buffers[i])
+                    vkDestroyBuffer(m_device, buffers[i], nullptr);
+                if (memories[i])
+                    vkFreeMemory(m_device, memories[i], nullptr);
+            }
+
+            frame.objects = frame.commands = frame.counts = frame.drawnEarly = VK_NULL_HANDLE;
+            frame.objectsMemory = frame.commandsMemory = frame.countsMemory = frame.drawnEarlyMemory = VK_NULL_HANDLE;
+        }
+    }
+
+    void IndirectRenderer::Destroy()
+    {
+        if (!m_device)
+            return;
+
+        DestroyFrameBuffers();
+        m_clusters.Destroy();
+        for (auto &frame : m_frames)
+        {
+            VkBuffer buffers[3] = {frame.stats, frame.params, frame.formats};
+            VkDeviceMemory memories[3] = {frame.statsMemory, frame.paramsMemory, frame.formatsMemory};
+            for (int i = 0; i < 3; ++i)
+            {
+                if (memories[i])
+                    vkUnmapMemory(m_device, memories[i]);
+                if (buffers[i])
+                    vkDestroyBuffer(m_device, buffers[i], nullptr);
+                if (memories[i])
+                    vkFreeMemory(m_device, memories[i], nullptr);
+            }
+        }
+        m_frames.clear();
+        m_pyramid = nullptr;
+
+        if (m_cullPipeline)
+            vkDestroyPipeline(m_device, m_cullPipeline, nullptr);
+        if (m_cullLayout)
+            vkDestroyPipelineLayout(m_device, m_cullLayout, nullptr);
+        if (m_descriptorPool)
+            vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
+        if (m_cullSetLayout)
+            vkDestroyDescriptorSetLayout(m_device, m_cullSetLayout, nullptr);
+        if (m_objectSetLayout)
+            vkDestroyDescriptorSetLayout(m_device, m_objectSetLayout, nullptr);
+
+        m_cullPipeline = VK_NULL_HANDLE;
+        m_cullLayout = VK_NULL_HANDLE;
+        m_descriptorPool = VK_NULL_HANDLE;
+        m_cullSetLayout = VK_NULL_HANDLE;
+        m_objectSetLayout = VK_NULL_HANDLE;
+        m_enabled = false;
+        m_pullingSupported = false;
+        m_device = VK_NULL_HANDLE;
+    }
+
+    void IndirectRenderer::SetClusterCulling(bool enabled)
+    {
+        if (enabled == m_clusterCulling)
+            return;
+
+        m_clusterCulling = enabled;
+        m_builtStructure = UINT64_MAX;
+    }
+
+    void IndirectRenderer::SetVertexPulling(bool enabled)
+    {
+        enabled = enabled && m_pullingSupported;
+        if (enabled == m_vertexPulling)
+            return;
+
+        m_vertexPulling = enabled;
+        m_builtStructure = UINT64_MAX;
+    }
+
+    bool IndirectRenderer::IsEligible(const RenderProxy &proxy)
+    {
+        if (!proxy.mesh || !proxy.material)
+            return false;
+
+        // The indirect program replaces the default one, custom programs stay on the CPU path
+        auto &api = Engine::GetInstance().GetGraphicsAPI();
+        return proxy.mesh->GetGeometry().IsValid() &&
+               proxy.mesh->GetIndexCount() > 0 &&
+               proxy.material->GetTextureSet() != VK_NULL_HANDLE &&
+               proxy.material->GetShaderProgram() == api.GetDefaultShaderProgram().get();
+    }
+
+    void IndirectRenderer::RebuildObjects(const RenderScene &renderScene)
+    {
+        const auto &proxies = renderScene.GetProxies();
+
+        if (m_vertexPulling && Engine::GetInstance().GetGraphicsAPI().GetGeometryPool().GetPageCount() > kMaxVertexPages)
+        {
+            SDL_Log("IndirectRenderer: more than %u geometry pages, vertex pulling disabled", kMaxVertexPages);
+            m_vertexPulling = false;
+        }
+
+        // Pulled vertices do not need the vertex page bound, so it does not split buckets
+        const bool pulling = m_vertexPulling;
+        auto bucketPage = [pulling](const GeometryAllocation &geometry)
+        {
+            return pulling ? 0u : geometry.page;
+        };
+
+        std::vector<uint32_t> order;
+        order.reserve(proxies.size());
+        for (uint32_t i = 0; i < (uint32_t)proxies.size(); ++i)
+        {
+            if (IsEligible(proxies[i]))
+                order.push_back(i);
+        }
+
+        std::sort(order.begin(), order.end(), [&proxies, &bucketPage](uint32_t a, uint32_t b)
+                  {
+                      const auto &pa = proxies[a];
+                      const auto &pb = proxies[b];
+                      if (pa.material != pb.material)
+                          return pa.material < pb.material;
+                      const auto &ga = pa.mesh->GetGeometry();
+                      const auto &gb = pb.mesh->GetGeometry();
+                      if (bucketPage(ga) != bucketPage(gb))
+                          return bucketPage(ga) < bucketPage(gb);
+                      return ga.indexPage < gb.indexPage; });
+
+        m_objects.clear();
+        m_objects.reserve(order.size());
+        m_buckets.clear();
+        m_proxyObjects.assign(m_proxyObjects.size(), ProxyObjects{});
+
+        for (uint32_t proxyIndex : order)
+        {
+            const auto &proxy = proxies[proxyIndex];
+            const auto &geometry = proxy.mesh->GetGeometry();
+            const uint32_t first = (uint32_t)m_objects.size();
+
+            if (m_buckets.empty() || m_buckets.back().material != proxy.material ||
+                m_buckets.back().page != bucketPage(geometry) || m_buckets.back().indexPage != geometry.indexPage)
+                m_buckets.push_back({proxy.material, bucketPage(geometry), geometry.indexPage, first, 0});
+
+            auto &bucket = m_buckets.back();
+
+            GpuObject object;
+            object.vertexOffset = (int32_t)geometry.firstVertex;
+            object.vertexPage = geometry.page;
+            object.bucket = (uint32_t)m_buckets.size() - 1;
+            object.commandBase = bucket.commandBase;
+
+            const RenderScene::ProxyHandle handle = renderScene.GetHandle(proxyIndex);
+            if (handle >= m_proxyObjects.size())
+                m_proxyObjects.resize(handle + 1);
+
+            // Merged meshes: one object per source range, culled on its own
+            auto &slots = m_proxyObjects[handle];
+            slots.first = first;
+            slots.count = std::max<uint32_t>(1, (uint32_t)proxy.ranges.size());
+            m_objects.insert(m_objects.end(), slots.count, object);
+            bucket.maxCount += slots.count;
+        }
+        m_drawObjectCount = (uint32_t)m_objects.size();
+
+        std::vector<ClusterCuller::Instance> instances;
+        for (uint32_t proxyIndex : order)
+        {
+            const auto &proxy = proxies[proxyIndex];
+            if (!m_clusterCulling || proxy.mesh->GetMeshlets().empty() || !proxy.ranges.empty())
+                continue;
+
+            const auto &geometry = proxy.mesh->GetGeometry();
+            auto &slots = m_proxyObjects[renderScene.GetHandle(proxyIndex)];
+            slots.cluster = (uint32_t)m_objects.size();
+            instances.push_back({slots.cluster, proxy.mesh, proxy.material, geometry.page, geometry.firstVertex});
+
+            GpuObject object;
+            object.vertexOffset = (int32_t)geometry.firstVertex;
+            object.vertexPage = geometry.page;
+            m_objects.push_back(object);
+        }
+
+        for (uint32_t proxyIndex : order)
+            WriteObjects(proxies[proxyIndex], m_proxyObjects[renderScene.GetHandle(proxyIndex)]);
+
+        m_clusters.Build(instances);
+        m_builtStructure = renderScene.GetStructureVersion();
+        m_builtVersion = renderScene.GetVersion();
+
+        for (auto &frame : m_frames)
+        {
+            frame.fullUpload = true;
+            frame.dirty.clear();
+        }
+    }
+
+    bool IndirectRenderer::UpdateObjects(const RenderScene &renderScene)
+    {
+        m_changed.clear();
+        if (!renderScene.GetChangedSince(m_builtVersion, m_changed))
+            return false;
+
+        for (auto handle : m_changed)
+        {
+            // Not drawn here
+            if (handle >= m_proxyObjects.size() || m_proxyObjects[handle].count == 0)
+                continue;
+
+            const auto &slots = m_proxyObjects[handle];
+            WriteObjects(renderScene.GetProxy(handle), slots);
+            for (uint32_t i = 0; i < slots.count; ++i)
+                MarkDirty(slots.first + i);
+            if (slots.cluster != kNoObject)
+                MarkDirty(slots.cluster);
+        }
+
+        m_builtVersion = renderScene.GetVersion();
+        return true;
+    }
+
+    void IndirectRenderer::WriteObjects(const RenderProxy &proxy, const ProxyObjects &slots)
+    {
+        const bool hidden = proxy.imposter != nullptr;
+        // Level 0 of a clustered mesh is drawn by ClusterCuller
+        const bool clusterDraws = slots.cluster != kNoObject && proxy.lod == 0 && !hidden;
+        const auto &lod0 = proxy.mesh->GetLod(0);
+
+        for (uint32_t i = 0; i < slots.count; ++i)
+        {
+            auto &object = m_objects[slots.first + i];
+            object.model = proxy.transform;
+
+            if (proxy.ranges.empty())
+            {
+                const auto &lod = proxy.mesh->GetLod(proxy.lod);
+                object.boundsMin = glm::vec4(proxy.worldBounds.min, 0.f);
+                object.boundsMax = glm::vec4(proxy.worldBounds.max, 0.f);
+                object.indexCount = hidden || clusterDraws ? 0 : lod.indexCount;
+                object.firstIndex = lod.firstIndex;
+            }
+            else
+            {
+                const auto &range = proxy.ranges[i];
+                object.boundsMin = glm::vec4(range.worldBounds.min, 0.f);
+                object.boundsMax = glm::vec4(range.worldBounds.max, 0.f);
+                object.indexCount = hidden ? 0 : range.indexCount;
+                object.firstIndex = lod0.firstIndex + range.firstIndex;
+            }
+        }
+
+        if (slots.cluster != kNoObject)
+        {
+            auto &object = m_objects[slots.cluster];
+            object.model = proxy.transform;
+            object.boundsMin = glm::vec4(proxy.worldBounds.min, 0.f);
+            object.boundsMax = glm::vec4(proxy.worldBounds.max, 0.f);
+            object.indexCount = clusterDraws ? lod0.indexCount : 0;
+            object.firstIndex = lod0.firstIndex;
+        }
+    }
+
+    void IndirectRenderer::MarkDirty(uint32_t slot)
+    {
+        for (auto &frame : m_frames)
+        {
+            if (frame.fullUpload)
+                continue;
+
+            // A frame that fell this far behind copies everything
+            if (frame.dirty.size() >= m_objects.size())
+            {
+                frame.fullUpload = true;
+                frame.dirty.clear();
+                continue;
+            }
+            frame.dirty.push_back(slot);
+        }
+    }
+
+    void IndirectRenderer::Cull(VkCommandBuffer cmd, uint32_t frameIndex, const RenderScene &renderScene, const glm::mat4 &viewProj,
+                                const glm::vec3 &eye)
+    {
+        if (!m_enabled)
+            return;
+
+        const bool structureChanged = m_builtStructure != renderScene.GetStructureVersion();
+        if (structureChanged || (m_builtVersion != renderScene.GetVersion() && !UpdateObjects(renderScene)))
+        {
+            RebuildObjects(renderScene);
+
+            if (m_objects.size() > m_capacity || m_buckets.size() > m_bucketCapacity)
+            {
+                uint32_t capacity = m_capacity;
+                while (capacity < m_objects.size())
+                    capacity *= 2;
+                uint32_t bucketCapacity = m_bucketCapacity;
+                while (bucketCapacity < m_buckets.size())
+                    bucketCapacity *= 2;
+
+                // Rare: other frames may still read the old buffers
+                vkDeviceWaitIdle(m_device);
+                DestroyFrameBuffers();
+                CreateFrameBuffers(capacity, bucketCapacity);
+            }
+        }
+
+        auto &frame = m_frames[frameIndex];
+        auto *objects = static_cast<GpuObject *>(frame.objectsMapped);
+        if (frame.fullUpload)
+        {
+            std::memcpy(objects, m_objects.data(), m_objects.size() * sizeof(GpuObject));
+
+            // New pages only come with new meshes, which always change the scene structure
+            if (m_vertexPulling)
+            {
+                const auto &pool = Engine::GetInstance().GetGraphicsAPI().GetGeometryPool();
+                auto *formats = static_cast<GpuVertexFormat *>(frame.formatsMapped);
+                for (uint32_t page = 0; page < pool.GetPageCount(); ++page)
+                    formats[page] = pool.GetVertexFormat(page);
+            }
+            frame.fullUpload = false;
+        }
+        else
+        {
+            for (uint32_t slot : frame.dirty)
+                objects[slot] = m_objects[slot];
+        }
+        frame.dirty.clear();
+
+        // The fence of this slot was waited on, its last counts are final
+        std::memcpy(&m_stats, frame.statsMapped, sizeof(OcclusionStats));
+
+        const bool occlusion = m_occlusionCulling && m_pyramid && m_pyramid->CanBuild();
+        m_latePass = occlusion && m_drawObjectCount > 0;
+        if (!m_latePass)
+            m_hasHistory = false;
+
+        const glm::vec4 pyramidSize = m_pyramid ? glm::vec4((float)m_pyramid->GetWidth(), (float)m_pyramid->GetHeight(), 0.f, 0.f)
+                                                : glm::vec4(0.f);
+
+        CullParams params[2]{};
+        params[kPhaseEarly].viewProj = viewProj;
+        params[kPhaseEarly].occlusionViewProj = m_prevViewProj;
+        params[kPhaseEarly].objectCount = m_drawObjectCount;
+        params[kPhaseEarly].mipCount = m_latePass && m_hasHistory ? m_pyramid->GetMipCount() : 0;
+        params[kPhaseEarly].pyramidSize = pyramidSize;
+
+        params[kPhaseLate] = params[kPhaseEarly];
+        params[kPhaseLate].occlusionViewProj = viewProj;
+        params[kPhaseLate].mipCount = m_latePass ? m_pyramid->GetMipCount() : 0;
+        params[kPhaseLate].commandOffset = m_capacity;
+        params[kPhaseLate].countOffset = m_bucketCapacity;
+
+        std::memcpy(frame.paramsMapped, params, sizeof(params));
+        m_prevViewProj = viewProj;
+
+        if (m_objects.empty())
+            return;
+
+        vkCmdFillBuffer(cmd, frame.counts, 0, VK_WHOLE_SIZE, 0);
+        vkCmdFillBuffer(cmd, frame.stats, 0, VK_WHOLE_SIZE, 0);
+
+        VkMemoryBarrier clear{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+        clear.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        clear.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0, 1, &clear, 0, nullptr, 0, nullptr);
+
+        Dispatch(cmd, frame, kPhaseEarly);
+        m_clusters.Cull(cmd, frameIndex, frame.objects, viewProj, eye);
+    }
+
+    void IndirectRenderer::CullLate(VkCommandBuffer cmd, uint32_t frameIndex)
+    {
+        if (!m_enabled || !m_latePass)
+            return;
+
+        // HiZPyramid::Build made the new pyramid visible to compute
+        Dispatch(cmd, m_frames[frameIndex], kPhaseLate);
+        m_hasHistory = true;
+    }
+
+    void IndirectRenderer::Dispatch(VkCommandBuffer cmd, const FrameResources &frame, CullPhase phase)
+    {
+        const uint32_t phaseIndex = phase;
+
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullPipeline);
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullLayout, 0, 1, &frame.cullSet, 0, nullptr);
+        vkCmdPushConstants(cmd, m_cullLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &phaseIndex);
+        vkCmdDispatch(cmd, (m_drawObjectCount + kCullGroupSize - 1) / kCullGroupSize, 1, 1);
+
+        // Indirect args for the draws, drawnEarly for the late phase, stats for the host
+        VkMemoryBarrier written{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+        written.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        written.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+                             0, 1, &written, 0, nullptr, 0, nullptr);
+    }
+
+    void IndirectRenderer::SetPyramid(const HiZPyramid &pyramid)
+    {
+        m_pyramid = &pyramid;
+        m_hasHistory = false;
+
+        if (!m_enabled)
+            return;
+
+        VkDescriptorImageInfo info{};
+        info.sampler = pyramid.GetSampler();
+        info.imageView = pyramid.GetView();
+        info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        for (auto &frame : m_frames)
+        {
+            VkWriteDescriptorSet write{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+            write.dstSet = frame.cullSet;
+            write.dstBinding = 4;
+            write.descriptorCount = 1;
+            write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            write.pImageInfo = &info;
+            vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+        }
+    }
+
+    void IndirectRenderer::Draw(GraphicsAPI &graphicsAPI, uint32_t frameIndex, const CameraData &cameraData, bool late)
+    {
+        if (!m_enabled || (m_buckets.empty() && m_clusters.IsEmpty()) || (late && !m_latePass))
+            return;
+
+        if (m_depthPrepass)
+        {
+            auto &depthProgram = m_vertexPulling ? graphicsAPI.GetPullDepthShaderProgram() : graphicsAPI.GetDepthShaderProgram();
+            DrawBuckets(graphicsAPI, frameIndex, *depthProgram, late, true);
+        }
+
+        auto &program = m_vertexPulling ? graphicsAPI.GetPullShaderProgram() : graphicsAPI.GetIndirectShaderProgram();
+        program->SetUniform("u_model", glm::mat4(1.f));
+        program->SetUniform("u_cameraPos", cameraData.position);
+
+        DrawBuckets(graphicsAPI, frameIndex, *program, late, false);
+    }
+
+    void IndirectRenderer::DrawBuckets(GraphicsAPI &graphicsAPI, uint32_t frameIndex, ShaderProgram &program,
+                                       bool late, bool depthOnly)
+    {
+        const auto &frame = m_frames[frameIndex];
+
+        // Clusters are culled once, with the early phase
+        if (!late)
+            m_clusters.Draw(graphicsAPI, frameIndex, program, frame.objectSet, m_vertexPulling, depthOnly);
+
+        const uint32_t commandOffset = late ? m_capacity : 0;
+        const uint32_t countOffset = late ? m_bucketCapacity : 0;
+
+        VkCommandBuffer cmd = graphicsAPI.GetCmd();
+
+        for (uint32_t b = 0; b < (uint32_t)m_buckets.size(); ++b)
+        {
+            const auto &bucket = m_buckets[b];
+
+            // The depth program has no use for textures, its pipeline only changes per page
+            if (!depthOnly || b == 0)
+            {
+                graphicsAPI.SetCurrentTextureSet(bucket.material->GetTextureSet());
+                program.Bind();
+            }
+
+            if (b == 0)
+            {
+                vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, program.GetLayout(),
+                                        3, 1, &frame.objectSet, 0, nullptr);
+            }
+
+            if (!m_vertexPulling)
+                graphicsAPI.BindGeometryPage(bucket.page);
+            graphicsAPI.BindIndexPage(bucket.indexPage);
+
+            vkCmdDrawIndexedIndirectCount(cmd,
+                                          frame.commands, sizeof(VkDrawIndexedIndirectCommand) * (commandOffset + bucket.commandBase),
+                                          frame.counts, sizeof(uint32_t) * (countOffset + b),
+                                          bucket.maxCount, sizeof(VkDrawIndexedIndirectCommand));
+        }
+    }
+}
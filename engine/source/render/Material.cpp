@@ -3,6 +3,8 @@
 #include "graphics/ShaderProgram.h"
 #include "Engine.h"
 #include "graphics/Texture.h"
+#include "render/VirtualTexturing.h"
+#include "vk/VulkanContext.h"
 
 #include <nlohmann/json.hpp>
 
@@ -26,13 +28,25 @@ namespace eng
     void Material::SetTexture(const std::string &name, const std::shared_ptr<Texture> &texture)
     {
         m_texture = texture;
-        m_textureSet = VK_NULL_HANDLE;
+    }
 
-        if (!m_texture)
-            return;
+    void Material::SetVirtualTexture(const std::shared_ptr<VirtualTexture> &texture)
+    {
+        m_virtualTexture = texture;
+    }
 
-        auto &vk = Engine::GetInstance().GetVulkanContext();
-        m_textureSet = vk.CreateTextureSet(m_texture->View(), m_texture->Sampler());
+    VkDescriptorSet Material::GetTextureSet() const
+    {
+        if (m_virtualTexture)
+            return m_virtualTexture->GetTextureSet();
+        return m_texture ? m_texture->GetTextureSet() : VK_NULL_HANDLE;
+    }
+
+    bool Material::IsTextureResident() const
+    {
+        if (m_virtualTexture)
+            return m_virtualTexture->IsReady();
+        return !m_texture || m_texture->IsResident();
     }
 
     void Material::Bind()
@@ -41,7 +55,7 @@ namespace eng
             return;
 
         auto &api = Engine::GetInstance().GetGraphicsAPI();
-        api.SetCurrentTextureSet(m_textureSet);
+        api.SetCurrentTextureSet(GetTextureSet());
 
         m_shaderProgram->Bind();
 
@@ -96,6 +110,22 @@ namespace eng
             result->SetShaderProgram(shaderProgram);
         }
 
+        // {"virtualTexture": "textures/terrain.vtex"} replaces the shader with
+        // the virtual texture program, the vertex layout stays the default one
+        if (json.contains("virtualTexture"))
+        {
+            auto &vk = Engine::GetInstance().GetVulkanContext();
+            auto texture = vk.GetVirtualTextures().Load(json["virtualTexture"].get<std::string>());
+            auto shaderProgram = Engine::GetInstance().GetGraphicsAPI().GetVirtualTextureShaderProgram();
+            if (texture && shaderProgram)
+            {
+                if (!result)
+                    result = std::make_shared<Material>();
+                result->SetShaderProgram(shaderProgram);
+                result->SetVirtualTexture(texture);
+            }
+        }
+
         if (json.contains("params"))
         {
             auto paramsObj = json["params"];
@@ -130,8 +160,7 @@ namespace eng
                 {
                     std::string name = p.value("name", "");
                     std::string texPath = p.value("path", "");
-                    auto &vk = Engine::GetInstance().GetVulkanContext();
-                    auto texture = Engine::GetInstance().GetTextureManager().GetOrLoadTexture(texPath);
+                    auto texture = Engine::GetInstance().GetTextureManager().GetOrLoadTextureAsync(texPath);
 
                     result->SetTexture(name, texture);
                 }
@@ -1,61 +1,232 @@
 #include "render/Mesh.h"
 
 #include "graphics/GraphicsAPI.h"
+#include "graphics/VertexQuantizer.h"
+#include "vk/VulkanContext.h"
 #include "Engine.h"
 
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 // #include <cgltf.h>
 
 namespace eng
 {
+    static AABB ComputeBounds(const VertexLayout &layout, const std::vector<float> &vertices)
+    {
+        AABB bounds;
+
+        auto it = std::find_if(layout.elements.begin(), layout.elements.end(),
+                               [](const VertexElement &e)
+                               { return e.index == VertexElement::Position; });
+
+        const size_t floatsPerVertex = layout.stride / sizeof(float);
+        if (it == layout.elements.end() || it->size < 3 || floatsPerVertex == 0)
+            return bounds;
+
+        const size_t offset = it->offset / sizeof(float);
+        const size_t count = vertices.size() / floatsPerVertex;
+        if (count == 0)
+            return bounds;
+
+        bounds.min = glm::vec3(std::numeric_limits<float>::max());
+        bounds.max = glm::vec3(-std::numeric_limits<float>::max());
+        for (size_t i = 0; i < count; ++i)
+        {
+            const float *p = &vertices[i * floatsPerVertex + offset];
+            const glm::vec3 pos(p[0], p[1], p[2]);
+            bounds.min = glm::min(bounds.min, pos);
+            bounds.max = glm::max(bounds.max, pos);
+        }
+
+        return bounds;
+    }
+
+    // Square root of the UV area over the surface area. Without indices the
+    // vertices are a triangle list.
+    static float ComputeUvDensity(const VertexLayout &layout, const std::vector<float> &vertices,
+                                  std::span<const uint32_t> indices)
+    {
+        const VertexElement *position = nullptr;
+        const VertexElement *uv = nullptr;
+        for (auto &e : layout.elements)
+        {
+            if (e.index == VertexElement::Position && e.size >= 3)
+                position = &e;
+            else if (e.index == VertexElement::UV && e.size >= 2)
+                uv = &e;
+        }
+
+        const size_t floatsPerVertex = layout.stride / sizeof(float);
+        if (!position || !uv || floatsPerVertex == 0)
+            return 0.f;
+
+        const size_t vertexCount = vertices.size() / floatsPerVertex;
+        const size_t count = indices.empty() ? vertexCount : indices.size();
+        const size_t positionOffset = position->offset / sizeof(float);
+        const size_t uvOffset = uv->offset / sizeof(float);
+
+        double surface = 0.0;
+        double uvArea = 0.0;
+        for (size_t t = 0; t + 2 < count; t += 3)
+        {
+            glm::vec3 p[3];
+            glm::vec2 q[3];
+            for (size_t k = 0; k < 3; ++k)
+            {
+                const size_t v = indices.empty() ? t + k : std::min<size_t>(indices[t + k], vertexCount - 1);
+                const float *f = &vertices[v * floatsPerVertex];
+                p[k] = glm::vec3(f[positionOffset], f[positionOffset + 1], f[positionOffset + 2]);
+                q[k] = glm::vec2(f[uvOffset], f[uvOffset + 1]);
+            }
+
+            surface += 0.5 * glm::length(glm::cross(p[1] - p[0], p[2] - p[0]));
+            const glm::vec2 a = q[1] - q[0];
+            const glm::vec2 b = q[2] - q[0];
+            uvArea += 0.5 * std::abs(a.x * b.y - a.y * b.x);
+        }
+
+        return surface > 0.0 ? (float)std::sqrt(uvArea / surface) : 0.f;
+    }
+
+    static bool SupportsVertexFormat(VkFormat format)
+    {
+        VkFormatProperties props{};
+        vkGetPhysicalDeviceFormatProperties(Engine::GetInstance().GetVulkanContext().GetGPU(), format, &props);
+        return (props.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT) != 0;
+    }
+
+    // Quantized vertices and, while the vertex count allows, 16 bit indices
+    static GeometryAllocation AllocateGeometry(const VertexLayout &layout, const std::vector<float> &vertices,
+                                               const std::vector<uint32_t> &indices, VertexLayout &outGpuLayout)
+    {
+        static const bool packedNormals = SupportsVertexFormat(VK_FORMAT_A2B10G10R10_SNORM_PACK32);
+
+        outGpuLayout = QuantizeLayout(layout, vertices, packedNormals);
+        const std::vector<uint8_t> gpuVertices = QuantizeVertices(layout, vertices, outGpuLayout);
+        const uint32_t vertexCount = (uint32_t)(gpuVertices.size() / outGpuLayout.stride);
+
+        auto &pool = Engine::GetInstance().GetGraphicsAPI().GetGeometryPool();
+        if (vertexCount <= 0x10000)
+        {
+            std::vector<uint16_t> indices16(indices.begin(), indices.end());
+            return pool.Allocate(outGpuLayout, gpuVertices.data(), vertexCount,
+                                 indices16.data(), (uint32_t)indices16.size(), VK_INDEX_TYPE_UINT16);
+        }
+
+        return pool.Allocate(outGpuLayout, gpuVertices.data(), vertexCount,
+                             indices.data(), (uint32_t)indices.size(), VK_INDEX_TYPE_UINT32);
+    }
+
     Mesh::Mesh(const VertexLayout &layout,
                const std::vector<float> &vertices,
                const std::vector<uint32_t> &indices)
+        : Mesh(layout, vertices, indices, {MeshLod{0, (uint32_t)indices.size(), 0.f}})
+    {
+    }
+
+    Mesh::Mesh(const VertexLayout &layout,
+               const std::vector<float> &vertices,
+               const std::vector<uint32_t> &indices,
+               const std::vector<MeshLod> &lods,
+               const std::vector<Meshlet> &meshlets)
     {
         m_vertexLayout = layout;
+        m_geometry = AllocateGeometry(layout, vertices, indices, m_gpuLayout);
 
-        auto &api = Engine::GetInstance().GetGraphicsAPI();
+        m_lods = lods;
+        if (m_lods.empty())
+            m_lods.push_back({0, (uint32_t)indices.size(), 0.f});
+        for (auto &lod : m_lods)
+            lod.firstIndex += m_geometry.firstIndex;
 
-        m_VBO = api.CreateVertexBuffer(vertices);
-        m_EBO = api.CreateIndexBuffer(indices);
+        const MeshLod &base = lods.empty() ? m_lods[0] : lods[0];
 
         m_vertexCount = (vertices.size() * sizeof(float)) / m_vertexLayout.stride;
-        m_indexCount = indices.size();
+        m_indexCount = base.indexCount;
+        m_bounds = ComputeBounds(layout, vertices);
+        m_meshlets = meshlets;
+
+        m_vertices = vertices;
+        m_indices = indices;
+        m_uvDensity = ComputeUvDensity(layout, m_vertices, GetIndices());
     }
 
     Mesh::Mesh(const VertexLayout &layout,
                const std::vector<float> &vertices)
     {
         m_vertexLayout = layout;
-
-        auto &api = Engine::GetInstance().GetGraphicsAPI();
-
-        m_VBO = api.CreateVertexBuffer(vertices);
+        m_geometry = AllocateGeometry(layout, vertices, {}, m_gpuLayout);
 
         m_vertexCount = (vertices.size() * sizeof(float)) / m_vertexLayout.stride;
         m_indexCount = 0;
+        m_bounds = ComputeBounds(layout, vertices);
+        m_lods.push_back({0, 0, 0.f});
+
+        m_vertices = vertices;
+        m_uvDensity = ComputeUvDensity(layout, m_vertices, {});
     }
 
-    void Mesh::Bind()
+    Mesh::~Mesh()
     {
-        auto &api = Engine::GetInstance().GetGraphicsAPI();
-        VkCommandBuffer cmd = api.GetCmd();
+        Engine::GetInstance().GetGraphicsAPI().GetGeometryPool().Free(m_geometry);
+    }
 
-        VkDeviceSize off = 0;
-        vkCmdBindVertexBuffers(cmd, 0, 1, &m_VBO, &off);
+    std::span<const uint32_t> Mesh::GetLodIndices(uint32_t lod) const
+    {
+        if (m_indices.empty())
+            return {};
 
-        if (m_indexCount > 0)
-            vkCmdBindIndexBuffer(cmd, m_EBO, 0, VK_INDEX_TYPE_UINT32);
+        const MeshLod &range = GetLod(lod);
+        return std::span<const uint32_t>(m_indices).subspan(range.firstIndex - m_geometry.firstIndex, range.indexCount);
     }
 
-    void Mesh::Draw()
+    void Mesh::ReleaseCpuData()
+    {
+        std::vector<float>().swap(m_vertices);
+        if (m_meshlets.empty())
+            std::vector<uint32_t>().swap(m_indices);
+    }
+
+    void Mesh::Bind()
     {
+        if (!m_geometry.IsValid())
+            return;
+
+        // No-op while consecutive meshes share a pool page
+        auto &api = Engine::GetInstance().GetGraphicsAPI();
+        api.BindGeometryPage(m_geometry.page);
+        api.BindIndexPage(m_geometry.indexPage);
+    }
+
+    void Mesh::Draw(uint32_t lod)
+    {
+        if (!m_geometry.IsValid())
+            return;
+
         auto &api = Engine::GetInstance().GetGraphicsAPI();
         VkCommandBuffer cmd = api.GetCmd();
 
         if (m_indexCount > 0)
-            vkCmdDrawIndexed(cmd, m_indexCount, 1, 0, 0, 0);
+        {
+            const MeshLod &range = GetLod(lod);
+            vkCmdDrawIndexed(cmd, range.indexCount, 1, range.firstIndex, (int32_t)m_geometry.firstVertex, 0);
+        }
         else
-            vkCmdDraw(cmd, m_vertexCount, 1, 0, 0);
+            vkCmdDraw(cmd, m_geometry.vertexCount, 1, m_geometry.firstVertex, 0);
+    }
+
+    void Mesh::DrawRange(uint32_t firstIndex, uint32_t indexCount)
+    {
+        if (!m_geometry.IsValid() || m_indexCount == 0 || indexCount == 0)
+            return;
+
+        VkCommandBuffer cmd = Engine::GetInstance().GetGraphicsAPI().GetCmd();
+        vkCmdDrawIndexed(cmd, indexCount, 1, GetLod(0).firstIndex + firstIndex, (int32_t)m_geometry.firstVertex, 0);
     }
 
     std::shared_ptr<Mesh> Mesh::CreateCube()
@@ -0,0 +1,642 @@
+#include "render/MeshOptimizer.h"
+
+#include "render/Mesh.h"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/vec3.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+namespace eng
+{
+    namespace
+    {
+        // FIFO cache model: a vertex stays cached for kVertexCacheSize misses after it was loaded
+        struct CacheSimulator
+        {
+            std::vector<uint32_t> loadedAt;
+            uint32_t misses = 0;
+
+            explicit CacheSimulator(size_t vertexCount) : loadedAt(vertexCount, 0) {}
+
+            bool Access(uint32_t v)
+            {
+                if (loadedAt[v] != 0 && misses - loadedAt[v] < kVertexCacheSize)
+                    return false;
+
+                loadedAt[v] = ++misses;
+                return true;
+            }
+
+            // Empties the cache without touching every vertex
+            void Flush() { misses += kVertexCacheSize; }
+        };
+
+        // Triangles around each vertex, CSR style
+        struct TriangleAdjacency
+        {
+            std::vector<uint32_t> offsets;
+            std::vector<uint32_t> triangles;
+
+            TriangleAdjacency(const std::vector<uint32_t> &indices, size_t vertexCount)
+                : offsets(vertexCount + 1, 0), triangles(indices.size())
+            {
+                for (uint32_t index : indices)
+                    ++offsets[index + 1];
+                for (size_t v = 0; v < vertexCount; ++v)
+                    offsets[v + 1] += offsets[v];
+
+                std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+                for (size_t i = 0; i < indices.size(); ++i)
+                    triangles[fill[indices[i]]++] = (uint32_t)(i / 3);
+            }
+        };
+
+        uint32_t HashVertex(const float *v, size_t floatsPerVertex)
+        {
+            // FNV-1a over the raw bits, so -0.f and 0.f stay distinct like memcmp sees them
+            uint32_t h = 2166136261u;
+            for (size_t i = 0; i < floatsPerVertex; ++i)
+            {
+                uint32_t bits;
+                std::memcpy(&bits, v + i, sizeof(bits));
+                h = (h ^ bits) * 16777619u;
+            }
+            return h ^ (h >> 15);
+        }
+    }
+
+    VertexCacheStats AnalyzeVertexCache(const std::vector<uint32_t> &indices, size_t vertexCount)
+    {
+        VertexCacheStats stats;
+        if (indices.size() < 3 || vertexCount == 0)
+            return stats;
+
+        CacheSimulator cache(vertexCount);
+        std::vector<uint8_t> referenced(vertexCount, 0);
+        size_t unique = 0;
+
+        for (uint32_t index : indices)
+        {
+            if (index >= vertexCount)
+                continue;
+
+            cache.Access(index);
+            if (!referenced[index])
+            {
+                referenced[index] = 1;
+                ++unique;
+            }
+        }
+
+        stats.acmr = (float)cache.misses / (float)(indices.size() / 3);
+        stats.atvr = unique > 0 ? (float)cache.misses / (float)unique : 0.f;
+        return stats;
+    }
+
+    size_t RemoveInvalidTriangles(std::vector<uint32_t> &indices, size_t vertexCount)
+    {
+        const size_t triangleCount = indices.size() / 3;
+        const size_t partial = indices.size() % 3 != 0 ? 1 : 0;
+        size_t kept = 0;
+
+        for (size_t t = 0; t < triangleCount; ++t)
+        {
+            const uint32_t *tri = &indices[t * 3];
+            if (tri[0] >= vertexCount || tri[1] >= vertexCount || tri[2] >= vertexCount)
+                continue;
+
+            indices[kept * 3 + 0] = tri[0];
+            indices[kept * 3 + 1] = tri[1];
+            indices[kept * 3 + 2] = tri[2];
+            ++kept;
+        }
+
+        indices.resize(kept * 3);
+        return triangleCount - kept + partial;
+    }
+
+    size_t WeldVertices(std::vector<float> &vertices, size_t floatsPerVertex, std::vector<uint32_t> &indices)
+    {
+        if (floatsPerVertex == 0)
+            return 0;
+
+        const size_t vertexCount = vertices.size() / floatsPerVertex;
+        const size_t vertexBytes = floatsPerVertex * sizeof(float);
+
+        size_t tableSize = 1;
+        while (tableSize < vertexCount * 2)
+            tableSize <<= 1;
+
+        // Open addressing, slots hold the welded vertex index
+        std::vector<uint32_t> table(tableSize, UINT32_MAX);
+        std::vector<uint32_t> remap(vertexCount);
+        size_t welded = 0;
+
+        for (size_t v = 0; v < vertexCount; ++v)
+        {
+            const float *src = vertices.data() + v * floatsPerVertex;
+            size_t slot = HashVertex(src, floatsPerVertex) & (tableSize - 1);
+
+            while (table[slot] != UINT32_MAX &&
+                   std::memcmp(vertices.data() + (size_t)table[slot] * floatsPerVertex, src, vertexBytes) != 0)
+                slot = (slot + 1) & (tableSize - 1);
+
+            if (table[slot] == UINT32_MAX)
+            {
+                // Compacts in place, the destination is never ahead of the source
+                if (welded != v)
+                    std::memmove(vertices.data() + welded * floatsPerVertex, src, vertexBytes);
+                table[slot] = (uint32_t)welded++;
+            }
+            remap[v] = table[slot];
+        }
+
+        vertices.resize(welded * floatsPerVertex);
+        for (auto &index : indices)
+        {
+            if (index < vertexCount)
+                index = remap[index];
+        }
+
+        return welded;
+    }
+
+    void OptimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount, std::vector<uint32_t> *outClusters)
+    {
+        if (outClusters)
+            outClusters->clear();
+
+        const size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0 || vertexCount == 0)
+            return;
+
+        const TriangleAdjacency adjacency(indices, vertexCount);
+
+        std::vector<uint32_t> live(vertexCount);
+        for (size_t v = 0; v < vertexCount; ++v)
+            live[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+
+        const uint32_t k = kVertexCacheSize;
+        std::vector<uint32_t> cacheTime(vertexCount, 0);
+        std::vector<uint8_t> emitted(triangleCount, 0);
+        std::vector<uint32_t> deadEnd;
+        std::vector<uint32_t> candidates;
+        std::vector<uint32_t> result;
+        result.reserve(triangleCount * 3);
+
+        uint32_t time = k + 1;
+        size_t cursor = 0;
+
+        // Most recently referenced vertex that still has triangles, else the next one in input order
+        auto skipDeadEnd = [&]() -> int64_t
+        {
+            while (!deadEnd.empty())
+            {
+                const uint32_t v = deadEnd.back();
+                deadEnd.pop_back();
+                if (live[v] > 0)
+                    return v;
+            }
+            for (; cursor < vertexCount; ++cursor)
+            {
+                if (live[cursor] > 0)
+                    return (int64_t)cursor;
+            }
+            return -1;
+        };
+
+        int64_t fan = skipDeadEnd();
+        if (outClusters && fan >= 0)
+            outClusters->push_back(0);
+
+        while (fan >= 0)
+        {
+            candidates.clear();
+            for (uint32_t a = adjacency.offsets[fan]; a < adjacency.offsets[fan + 1]; ++a)
+            {
+                const uint32_t t = adjacency.triangles[a];
+                if (emitted[t])
+                    continue;
+
+                for (int c = 0; c < 3; ++c)
+                {
+                    const uint32_t v = indices[(size_t)t * 3 + c];
+                    result.push_back(v);
+                    deadEnd.push_back(v);
+                    candidates.push_back(v);
+                    --live[v];
+                    if (time - cacheTime[v] > k)
+                        cacheTime[v] = time++;
+                }
+                emitted[t] = 1;
+            }
+
+            // Prefer the oldest cached vertex that will still be cached after its remaining triangles
+            int64_t next = -1;
+            int64_t bestPriority = -1;
+            for (uint32_t v : candidates)
+            {
+                if (live[v] == 0)
+                    continue;
+
+                int64_t priority = 0;
+                if (time - cacheTime[v] + 2 * live[v] <= k)
+                    priority = time - cacheTime[v];
+                if (priority > bestPriority)
+                {
+                    bestPriority = priority;
+                    next = v;
+                }
+            }
+
+            if (next < 0)
+            {
+                next = skipDeadEnd();
+                if (outClusters && next >= 0)
+                    outClusters->push_back((uint32_t)(result.size() / 3));
+            }
+            fan = next;
+        }
+
+        indices.swap(result);
+    }
+
+    void OptimizeOverdraw(std::vector<uint32_t> &indices, const float *positions, size_t stride, size_t vertexCount,
+                          const std::vector<uint32_t> &clusters, float threshold)
+    {
+        const size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0 || !positions || vertexCount == 0)
+            return;
+
+        auto position = [&](uint32_t v)
+        {
+            const float *p = positions + (size_t)v * stride;
+            return glm::vec3(p[0], p[1], p[2]);
+        };
+
+        // Soft boundaries: end a cluster as soon as its ACMR is close to the whole mesh,
+        // so drawing clusters in any order costs little extra vertex work
+        const float limit = AnalyzeVertexCache(indices, vertexCount).acmr * threshold;
+        std::vector<uint32_t> starts;
+        {
+            CacheSimulator cache(vertexCount);
+            size_t hard = 0;
+            uint32_t clusterStart = 0;
+            uint32_t clusterMisses = 0;
+
+            for (uint32_t t = 0; t < (uint32_t)triangleCount; ++t)
+            {
+                if (t == 0 || (hard < clusters.size() && clusters[hard] == t))
+                {
+                    while (hard < clusters.size() && clusters[hard] <= t)
+                        ++hard;
+                    if (starts.empty() || starts.back() != t)
+                        starts.push_back(t);
+                    cache.Flush();
+                    clusterStart = t;
+                    clusterMisses = 0;
+                }
+
+                for (int c = 0; c < 3; ++c)
+                    clusterMisses += cache.Access(indices[(size_t)t * 3 + c]) ? 1 : 0;
+
+                const uint32_t clusterSize = t + 1 - clusterStart;
+                const bool nextIsHard = hard < clusters.size() && clusters[hard] == t + 1;
+                if (t + 1 < triangleCount && !nextIsHard && (float)clusterMisses <= limit * (float)clusterSize)
+                {
+                    starts.push_back(t + 1);
+                    cache.Flush();
+                    clusterStart = t + 1;
+                    clusterMisses = 0;
+                }
+            }
+        }
+
+        if (starts.size() < 2)
+            return;
+
+        struct Cluster
+        {
+            uint32_t begin = 0;
+            uint32_t end = 0;
+            float sortKey = 0.f;
+        };
+
+        std::vector<Cluster> sorted(starts.size());
+        std::vector<glm::vec3> centroids(starts.size());
+        std::vector<glm::vec3> normals(starts.size());
+        glm::vec3 meshCentroid(0.f);
+        float meshArea = 0.f;
+
+        for (size_t c = 0; c < starts.size(); ++c)
+        {
+            sorted[c].begin = starts[c];
+            sorted[c].end = c + 1 < starts.size() ? starts[c + 1] : (uint32_t)triangleCount;
+
+            glm::vec3 centroid(0.f);
+            glm::vec3 normal(0.f);
+            float area = 0.f;
+            for (uint32_t t = sorted[c].begin; t < sorted[c].end; ++t)
+            {
+                const glm::vec3 p0 = position(indices[(size_t)t * 3]);
+                const glm::vec3 p1 = position(indices[(size_t)t * 3 + 1]);
+                const glm::vec3 p2 = position(indices[(size_t)t * 3 + 2]);
+                const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+                const float a = glm::length(n);
+
+                centroid += (p0 + p1 + p2) * (a / 3.f);
+                normal += n;
+                area += a;
+            }
+
+            centroids[c] = area > 0.f ? centroid / area : centroid;
+            normals[c] = normal;
+            meshCentroid += centroid;
+            meshArea += area;
+        }
+
+        if (meshArea > 0.f)
+            meshCentroid /= meshArea;
+
+        // Clusters facing away from the center are more likely to occlude the rest
+        for (size_t c = 0; c < sorted.size(); ++c)
+        {
+            const float length = glm::length(normals[c]);
+            sorted[c].sortKey = length > 0.f ? glm::dot(centroids[c] - meshCentroid, normals[c] / length) : 0.f;
+        }
+
+        std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster &a, const Cluster &b)
+                         { return a.sortKey > b.sortKey; });
+
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+        for (const auto &cluster : sorted)
+            result.insert(result.end(), indices.begin() + (size_t)cluster.begin * 3, indices.begin() + (size_t)cluster.end * 3);
+
+        indices.swap(result);
+    }
+
+    void OptimizeVertexFetch(std::vector<float> &vertices, size_t floatsPerVertex, std::vector<uint32_t> &indices)
+    {
+        if (floatsPerVertex == 0)
+            return;
+
+        const size_t vertexCount = vertices.size() / floatsPerVertex;
+        std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+        std::vector<float> result;
+        result.reserve(vertices.size());
+
+        for (auto &index : indices)
+        {
+            if (index >= vertexCount)
+                continue;
+
+            if (remap[index] == UINT32_MAX)
+            {
+                remap[index] = (uint32_t)(result.size() / floatsPerVertex);
+                result.insert(result.end(), vertices.begin() + (size_t)index * floatsPerVertex,
+                              vertices.begin() + (size_t)(index + 1) * floatsPerVertex);
+            }
+            index = remap[index];
+        }
+
+        // Unreferenced vertices are dropped
+        vertices.swap(result);
+    }
+
+    static void ComputeMeshletBounds(Meshlet &meshlet, const uint32_t *indices, const float *positions, size_t stride)
+    {
+        auto position = [positions, stride](uint32_t v)
+        {
+            const float *p = positions + (size_t)v * stride;
+            return glm::vec3(p[0], p[1], p[2]);
+        };
+
+        glm::vec3 lo(std::numeric_limits<float>::max());
+        glm::vec3 hi(-std::numeric_limits<float>::max());
+        for (uint32_t i = 0; i < meshlet.indexCount; ++i)
+        {
+            const glm::vec3 p = position(indices[i]);
+            lo = glm::min(lo, p);
+            hi = glm::max(hi, p);
+        }
+
+        meshlet.center = (lo + hi) * 0.5f;
+        meshlet.radius = 0.f;
+        for (uint32_t i = 0; i < meshlet.indexCount; ++i)
+            meshlet.radius = std::max(meshlet.radius, glm::distance(meshlet.center, position(indices[i])));
+
+        // Area weighted average normal, then the widest deviation from it
+        std::vector<glm::vec3> normals;
+        normals.reserve(meshlet.indexCount / 3);
+        glm::vec3 axis(0.f);
+        for (uint32_t i = 0; i + 2 < meshlet.indexCount; i += 3)
+        {
+            const glm::vec3 p0 = position(indices[i]);
+            const glm::vec3 n = glm::cross(position(indices[i + 1]) - p0, position(indices[i + 2]) - p0);
+            const float area = glm::length(n);
+            if (area <= 0.f)
+                continue;
+
+            axis += n;
+            normals.push_back(n / area);
+        }
+
+        meshlet.coneAxis = glm::vec3(0.f, 0.f, 1.f);
+        meshlet.coneCutoff = 1.f;
+
+        const float axisLength = glm::length(axis);
+        if (normals.empty() || axisLength <= 0.f)
+            return;
+
+        meshlet.coneAxis = axis / axisLength;
+
+        float minDot = 1.f;
+        for (const auto &n : normals)
+            minDot = std::min(minDot, glm::dot(n, meshlet.coneAxis));
+
+        // Spread over ~84 degrees: the cone would almost never cull, keep it disabled
+        if (minDot > 0.1f)
+            meshlet.coneCutoff = std::sqrt(1.f - minDot * minDot);
+    }
+
+    void BuildMeshlets(std::vector<uint32_t> &indices, const float *positions, size_t stride, size_t vertexCount,
+                       std::vector<Meshlet> &outMeshlets, uint32_t maxVertices, uint32_t maxTriangles)
+    {
+        outMeshlets.clear();
+
+        const size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0 || vertexCount == 0 || maxVertices < 3 || maxTriangles == 0)
+            return;
+
+        const TriangleAdjacency adjacency(indices, vertexCount);
+
+        std::vector<uint8_t> emitted(triangleCount, 0);
+        // Meshlet the vertex was last added to, plus one
+        std::vector<uint32_t> vertexMeshlet(vertexCount, 0);
+
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+
+        // Unemitted triangles touching the current meshlet
+        std::vector<uint32_t> candidates;
+        size_t seed = 0;
+
+        Meshlet meshlet;
+        uint32_t meshletVertices = 0;
+
+        auto newVertices = [&](uint32_t t)
+        {
+            const uint32_t id = (uint32_t)outMeshlets.size() + 1;
+            return (uint32_t)(vertexMeshlet[indices[t * 3 + 0]] != id) +
+                   (uint32_t)(vertexMeshlet[indices[t * 3 + 1]] != id) +
+                   (uint32_t)(vertexMeshlet[indices[t * 3 + 2]] != id);
+        };
+
+        auto flush = [&]()
+        {
+            if (meshlet.indexCount == 0)
+                return;
+
+            ComputeMeshletBounds(meshlet, result.data() + meshlet.firstIndex, positions, stride);
+            outMeshlets.push_back(meshlet);
+
+            meshlet = Meshlet{};
+            meshlet.firstIndex = (uint32_t)result.size();
+            meshletVertices = 0;
+            candidates.clear();
+        };
+
+        for (size_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount)
+        {
+            // Prefer the neighbour that adds the fewest vertices, first come on ties
+            uint32_t best = UINT32_MAX;
+            uint32_t bestCost = 4;
+            size_t kept = 0;
+            for (size_t i = 0; i < candidates.size(); ++i)
+            {
+                const uint32_t t = candidates[i];
+                if (emitted[t])
+                    continue;
+
+                candidates[kept++] = t;
+                const uint32_t cost = newVertices(t);
+                if (cost < bestCost)
+                {
+                    best = t;
+                    bestCost = cost;
+                }
+            }
+            candidates.resize(kept);
+
+            // Full: the neighbour starts the next meshlet
+            if (best != UINT32_MAX && meshletVertices + bestCost > maxVertices)
+                flush();
+
+            if (best == UINT32_MAX)
+            {
+                // Restart from the next triangle in the input order
+                while (emitted[seed])
+                    ++seed;
+                best = (uint32_t)seed;
+
+                if (meshletVertices + newVertices(best) > maxVertices)
+                    flush();
+            }
+
+            const uint32_t id = (uint32_t)outMeshlets.size() + 1;
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                const uint32_t v = indices[best * 3 + k];
+                result.push_back(v);
+                if (vertexMeshlet[v] == id)
+                    continue;
+
+                vertexMeshlet[v] = id;
+                ++meshletVertices;
+                for (uint32_t a = adjacency.offsets[v]; a < adjacency.offsets[v + 1]; ++a)
+                {
+                    if (!emitted[adjacency.triangles[a]])
+                        candidates.push_back(adjacency.triangles[a]);
+                }
+            }
+
+            emitted[best] = 1;
+            meshlet.indexCount += 3;
+
+            if (meshlet.indexCount / 3 >= maxTriangles)
+                flush();
+        }
+        flush();
+
+        // Restore cache locality inside every meshlet, on local vertex ids
+        std::vector<uint32_t> local;
+        std::vector<uint32_t> globalIds;
+        std::fill(vertexMeshlet.begin(), vertexMeshlet.end(), UINT32_MAX);
+        for (const auto &m : outMeshlets)
+        {
+            local.assign(result.begin() + m.firstIndex, result.begin() + m.firstIndex + m.indexCount);
+            globalIds.clear();
+            for (auto &index : local)
+            {
+                if (vertexMeshlet[index] == UINT32_MAX)
+                {
+                    vertexMeshlet[index] = (uint32_t)globalIds.size();
+                    globalIds.push_back(index);
+                }
+                index = vertexMeshlet[index];
+            }
+
+            OptimizeVertexCache(local, globalIds.size());
+            for (uint32_t i = 0; i < m.indexCount; ++i)
+                result[m.firstIndex + i] = globalIds[local[i]];
+            for (uint32_t v : globalIds)
+                vertexMeshlet[v] = UINT32_MAX;
+        }
+
+        indices.swap(result);
+    }
+
+    MeshOptimizeReport OptimizeMesh(const VertexLayout &layout, std::vector<float> &vertices, std::vector<uint32_t> &indices)
+    {
+        MeshOptimizeReport report;
+
+        const size_t floatsPerVertex = layout.stride / sizeof(float);
+        if (floatsPerVertex == 0)
+            return report;
+
+        report.vertexCountBefore = vertices.size() / floatsPerVertex;
+        report.before = AnalyzeVertexCache(indices, report.vertexCountBefore);
+        report.vertexCountAfter = report.vertexCountBefore;
+        report.after = report.before;
+
+        if (indices.size() < 3)
+            return report;
+
+        const size_t vertexCount = WeldVertices(vertices, floatsPerVertex, indices);
+
+        std::vector<uint32_t> clusters;
+        OptimizeVertexCache(indices, vertexCount, &clusters);
+
+        const VertexElement *position = nullptr;
+        for (auto &e : layout.elements)
+        {
+            if (e.index == VertexElement::Position)
+                position = &e;
+        }
+        if (position && position->size >= 3 && position->type == AttribType::Float32)
+            OptimizeOverdraw(indices, vertices.data() + position->offset / sizeof(float), floatsPerVertex, vertexCount, clusters);
+
+        OptimizeVertexFetch(vertices, floatsPerVertex, indices);
+
+        report.vertexCountAfter = vertices.size() / floatsPerVertex;
+        report.after = AnalyzeVertexCache(indices, report.vertexCountAfter);
+        return report;
+    }
+}
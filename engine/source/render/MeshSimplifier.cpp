@@ -0,0 +1,475 @@
+#include "render/MeshSimplifier.h"
+
+#include "render/Mesh.h"
+#include "render/MeshOptimizer.h"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/vec3.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace eng
+{
+    namespace
+    {
+        // E(p) = p'Ap + 2b'p + c with A symmetric, summed over weighted planes
+        struct Quadric
+        {
+            float a00 = 0.f, a11 = 0.f, a22 = 0.f;
+            float a01 = 0.f, a02 = 0.f, a12 = 0.f;
+            float b0 = 0.f, b1 = 0.f, b2 = 0.f;
+            float c = 0.f;
+            float w = 0.f;
+
+            void Add(const Quadric &q)
+            {
+                a00 += q.a00;
+                a11 += q.a11;
+                a22 += q.a22;
+                a01 += q.a01;
+                a02 += q.a02;
+                a12 += q.a12;
+                b0 += q.b0;
+                b1 += q.b1;
+                b2 += q.b2;
+                c += q.c;
+                w += q.w;
+            }
+
+            // Weighted mean squared distance to the planes
+            float Error(const glm::vec3 &p) const
+            {
+                const float rx = a00 * p.x + a01 * p.y + a02 * p.z + b0;
+                const float ry = a01 * p.x + a11 * p.y + a12 * p.z + b1;
+                const float rz = a02 * p.x + a12 * p.y + a22 * p.z + b2;
+                const float e = rx * p.x + ry * p.y + rz * p.z + b0 * p.x + b1 * p.y + b2 * p.z + c;
+                return w > 0.f ? std::fabs(e) / w : 0.f;
+            }
+        };
+
+        Quadric PlaneQuadric(const glm::vec3 &n, float d, float weight)
+        {
+            Quadric q;
+            q.a00 = n.x * n.x * weight;
+            q.a11 = n.y * n.y * weight;
+            q.a22 = n.z * n.z * weight;
+            q.a01 = n.x * n.y * weight;
+            q.a02 = n.x * n.z * weight;
+            q.a12 = n.y * n.z * weight;
+            q.b0 = n.x * d * weight;
+            q.b1 = n.y * d * weight;
+            q.b2 = n.z * d * weight;
+            q.c = d * d * weight;
+            q.w = weight;
+            return q;
+        }
+
+        // Border edges get a plane perpendicular to their face, weighted up so
+        // that open silhouettes hold their shape.
+        constexpr float kBorderWeight = 10.f;
+
+        enum class VertexKind : uint8_t
+        {
+            Manifold,
+            Border,
+            Locked
+        };
+
+        struct Collapse
+        {
+            uint32_t from = 0; // canonical vertex that disappears
+            uint32_t to = 0;   // vertex (not canonical) it is merged into
+            float error = 0.f;
+        };
+
+        struct PositionKey
+        {
+            uint32_t bits[3];
+
+            bool operator==(const PositionKey &o) const
+            {
+                return bits[0] == o.bits[0] && bits[1] == o.bits[1] && bits[2] == o.bits[2];
+            }
+        };
+
+        struct PositionKeyHash
+        {
+            size_t operator()(const PositionKey &k) const
+            {
+                size_t h = k.bits[0];
+                h = h * 0x9E3779B1u ^ k.bits[1];
+                h = h * 0x9E3779B1u ^ k.bits[2];
+                return h;
+            }
+        };
+
+        uint64_t EdgeKey(uint32_t a, uint32_t b)
+        {
+            return ((uint64_t)a << 32) | b;
+        }
+    }
+
+    std::vector<uint32_t> SimplifyMesh(const float *positions, size_t vertexCount, size_t stride,
+                                       const std::vector<uint32_t> &indices,
+                                       size_t targetIndexCount, float targetError, float *outError)
+    {
+        if (outError)
+            *outError = 0.f;
+
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            if (indices[i] < vertexCount && indices[i + 1] < vertexCount && indices[i + 2] < vertexCount)
+                result.insert(result.end(), indices.begin() + i, indices.begin() + i + 3);
+        }
+
+        if (!positions || vertexCount == 0 || result.size() <= targetIndexCount)
+            return result;
+
+        // Positions scaled into the unit cube so errors do not depend on mesh size
+        glm::vec3 minP(std::numeric_limits<float>::max());
+        glm::vec3 maxP(-std::numeric_limits<float>::max());
+        for (uint32_t index : result)
+        {
+            const float *p = positions + (size_t)index * stride;
+            minP = glm::min(minP, glm::vec3(p[0], p[1], p[2]));
+            maxP = glm::max(maxP, glm::vec3(p[0], p[1], p[2]));
+        }
+        const glm::vec3 size = maxP - minP;
+        const float extent = std::max(size.x, std::max(size.y, size.z));
+        const float invExtent = extent > 0.f ? 1.f / extent : 0.f;
+
+        std::vector<glm::vec3> pos(vertexCount);
+        for (size_t i = 0; i < vertexCount; ++i)
+        {
+            const float *p = positions + i * stride;
+            pos[i] = (glm::vec3(p[0], p[1], p[2]) - minP) * invExtent;
+        }
+
+        // Vertices sharing a position are wedges of one canonical vertex
+        std::vector<uint32_t> canonical(vertexCount);
+        std::vector<uint32_t> wedges(vertexCount, 0);
+        {
+            std::vector<uint8_t> referenced(vertexCount, 0);
+            for (uint32_t index : result)
+                referenced[index] = 1;
+
+            std::unordered_map<PositionKey, uint32_t, PositionKeyHash> lookup;
+            lookup.reserve(vertexCount);
+            for (uint32_t i = 0; i < (uint32_t)vertexCount; ++i)
+            {
+                PositionKey key;
+                std::memcpy(key.bits, positions + (size_t)i * stride, sizeof(key.bits));
+                canonical[i] = lookup.emplace(key, i).first->second;
+                if (referenced[i])
+                    ++wedges[canonical[i]];
+            }
+        }
+
+        // Directed canonical edges, an edge without its twin is on an open border
+        std::unordered_set<uint64_t> edges;
+        edges.reserve(result.size());
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            for (int e = 0; e < 3; ++e)
+                edges.insert(EdgeKey(canonical[result[i + e]], canonical[result[i + (e + 1) % 3]]));
+        }
+
+        auto isBorderEdge = [&edges](uint32_t a, uint32_t b)
+        {
+            return edges.find(EdgeKey(b, a)) == edges.end();
+        };
+
+        std::vector<uint8_t> borderOut(vertexCount, 0);
+        std::vector<uint8_t> borderIn(vertexCount, 0);
+        std::vector<Quadric> quadrics(vertexCount);
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            const uint32_t c[3] = {canonical[result[i]], canonical[result[i + 1]], canonical[result[i + 2]]};
+            const glm::vec3 &p0 = pos[c[0]];
+            const glm::vec3 &p1 = pos[c[1]];
+            const glm::vec3 &p2 = pos[c[2]];
+
+            glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+            const float area2 = glm::length(n);
+            if (area2 <= 0.f)
+                continue;
+            n /= area2;
+
+            const Quadric face = PlaneQuadric(n, -glm::dot(n, p0), area2 * 0.5f);
+            for (uint32_t v : c)
+                quadrics[v].Add(face);
+
+            for (int e = 0; e < 3; ++e)
+            {
+                const uint32_t a = c[e];
+                const uint32_t b = c[(e + 1) % 3];
+                if (a == b || !isBorderEdge(a, b))
+                    continue;
+
+                borderOut[a] = (uint8_t)std::min(borderOut[a] + 1, 2);
+                borderIn[b] = (uint8_t)std::min(borderIn[b] + 1, 2);
+
+                const glm::vec3 edge = pos[b] - pos[a];
+                const float length = glm::length(edge);
+                if (length <= 0.f)
+                    continue;
+
+                const glm::vec3 side = glm::normalize(glm::cross(edge, n));
+                const Quadric border = PlaneQuadric(side, -glm::dot(side, pos[a]), length * length * kBorderWeight);
+                quadrics[a].Add(border);
+                quadrics[b].Add(border);
+            }
+        }
+
+        std::vector<VertexKind> kinds(vertexCount, VertexKind::Manifold);
+        for (uint32_t v = 0; v < (uint32_t)vertexCount; ++v)
+        {
+            if (canonical[v] != v)
+                continue;
+
+            if (wedges[v] > 1 || borderOut[v] > 1 || borderIn[v] > 1 || borderOut[v] != borderIn[v])
+                kinds[v] = VertexKind::Locked;
+            else if (borderOut[v] == 1)
+                kinds[v] = VertexKind::Border;
+        }
+
+        const float errorLimit = targetError * targetError;
+        float maxError = 0.f;
+
+        // Cheapest collapse per vertex, keeps the sort at one entry per vertex
+        std::vector<Collapse> best(vertexCount);
+        std::vector<Collapse> collapses;
+        std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+        std::vector<uint32_t> adjacency;
+        std::vector<uint32_t> collapseTarget(vertexCount);
+        std::vector<uint8_t> touched(vertexCount);
+
+        auto flips = [&](uint32_t from, const glm::vec3 &to, uint32_t toCanonical)
+        {
+            for (uint32_t a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1]; ++a)
+            {
+                const size_t tri = (size_t)adjacency[a] * 3;
+                uint32_t c[3] = {canonical[result[tri]], canonical[result[tri + 1]], canonical[result[tri + 2]]};
+                if (c[0] == toCanonical || c[1] == toCanonical || c[2] == toCanonical)
+                    continue;
+
+                const glm::vec3 before = glm::cross(pos[c[1]] - pos[c[0]], pos[c[2]] - pos[c[0]]);
+                glm::vec3 p[3] = {pos[c[0]], pos[c[1]], pos[c[2]]};
+                for (int k = 0; k < 3; ++k)
+                {
+                    if (c[k] == from)
+                        p[k] = to;
+                }
+                const glm::vec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+
+                if (glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after))
+                    return true;
+            }
+            return false;
+        };
+
+        while (result.size() > targetIndexCount)
+        {
+            const uint32_t triangleCount = (uint32_t)(result.size() / 3);
+
+            // Triangles around every canonical vertex
+            std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+            for (uint32_t index : result)
+                ++adjacencyOffsets[canonical[index] + 1];
+            for (size_t v = 0; v < vertexCount; ++v)
+                adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+            adjacency.resize(result.size());
+            {
+                std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+                for (size_t i = 0; i < result.size(); ++i)
+                    adjacency[fill[canonical[result[i]]]++] = (uint32_t)(i / 3);
+            }
+
+            for (auto &collapse : best)
+                collapse.error = std::numeric_limits<float>::max();
+
+            for (size_t i = 0; i < result.size(); i += 3)
+            {
+                for (int e = 0; e < 3; ++e)
+                {
+                    const uint32_t va = result[i + e];
+                    const uint32_t vb = result[i + (e + 1) % 3];
+                    const uint32_t a = canonical[va];
+                    const uint32_t b = canonical[vb];
+                    if (a == b)
+                        continue;
+
+                    auto consider = [&](uint32_t from, uint32_t toVertex, uint32_t to)
+                    {
+                        const VertexKind kind = kinds[from];
+                        if (kind == VertexKind::Locked)
+                            return;
+                        if (kind == VertexKind::Border && !isBorderEdge(a, b) && !isBorderEdge(b, a))
+                            return;
+
+                        Quadric q = quadrics[from];
+                        q.Add(quadrics[to]);
+                        const float error = q.Error(pos[to]);
+                        if (error < best[from].error)
+                            best[from] = {from, toVertex, error};
+                    };
+
+                    consider(a, vb, b);
+                    consider(b, va, a);
+                }
+            }
+
+            collapses.clear();
+            for (const auto &collapse : best)
+            {
+                if (collapse.error <= errorLimit)
+                    collapses.push_back(collapse);
+            }
+
+            if (collapses.empty())
+                break;
+
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse &x, const Collapse &y)
+                      { return x.error < y.error; });
+
+            // Each interior collapse removes two triangles, a border one removes one
+            const uint32_t goal = (triangleCount - (uint32_t)(targetIndexCount / 3) + 1) / 2 + 1;
+            uint32_t removed = 0;
+            uint32_t applied = 0;
+
+            for (uint32_t v = 0; v < (uint32_t)vertexCount; ++v)
+                collapseTarget[v] = v;
+            std::fill(touched.begin(), touched.end(), 0);
+
+            for (const auto &collapse : collapses)
+            {
+                if (collapse.error > errorLimit)
+                    break;
+
+                const uint32_t to = canonical[collapse.to];
+                if (touched[collapse.from] || touched[to])
+                    continue;
+
+                if (flips(collapse.from, pos[to], to))
+                    continue;
+
+                collapseTarget[collapse.from] = collapse.to;
+                quadrics[to].Add(quadrics[collapse.from]);
+                touched[collapse.from] = 1;
+                touched[to] = 1;
+
+                maxError = std::max(maxError, collapse.error);
+                removed += kinds[collapse.from] == VertexKind::Border ? 1 : 2;
+                ++applied;
+
+                if (removed >= goal)
+                    break;
+            }
+
+            if (applied == 0)
+                break;
+
+            // Collapsed vertices are not seams, so their canonical vertex stands for their only wedge
+            size_t write = 0;
+            for (size_t i = 0; i < result.size(); i += 3)
+            {
+                uint32_t tri[3];
+                for (int k = 0; k < 3; ++k)
+                {
+                    const uint32_t c = canonical[result[i + k]];
+                    tri[k] = collapseTarget[c] != c ? collapseTarget[c] : result[i + k];
+                }
+
+                const uint32_t c0 = canonical[tri[0]], c1 = canonical[tri[1]], c2 = canonical[tri[2]];
+                if (c0 == c1 || c1 == c2 || c0 == c2)
+                    continue;
+
+                result[write++] = tri[0];
+                result[write++] = tri[1];
+                result[write++] = tri[2];
+            }
+            result.resize(write);
+        }
+
+        if (outError)
+            *outError = std::sqrt(maxError);
+
+        return result;
+    }
+
+    void BuildLodChain(const VertexLayout &layout, const std::vector<float> &vertices,
+                       const std::vector<uint32_t> &indices,
+                       std::vector<uint32_t> &outIndices, std::vector<MeshLod> &outLods)
+    {
+        // Below this there is not enough vertex work left to be worth a level
+        constexpr size_t kMinTriangles = 64;
+        // Levels that would deviate more than this (of the extent) are useless at any distance
+        constexpr float kMaxError = 0.1f;
+        // A level has to drop at least this share of the previous one
+        constexpr float kMinReduction = 0.15f;
+
+        outIndices = indices;
+        outLods.assign(1, MeshLod{0, (uint32_t)indices.size(), 0.f});
+
+        const VertexElement *position = nullptr;
+        for (auto &e : layout.elements)
+        {
+            if (e.index == VertexElement::Position)
+                position = &e;
+        }
+
+        const size_t stride = layout.stride / sizeof(float);
+        if (!position || position->size < 3 || position->type != AttribType::Float32 || stride == 0 ||
+            indices.size() / 3 < kMinTriangles * 2)
+            return;
+
+        const size_t vertexCount = vertices.size() / stride;
+        const float *positions = vertices.data() + position->offset / sizeof(float);
+
+        glm::vec3 minP(std::numeric_limits<float>::max());
+        glm::vec3 maxP(-std::numeric_limits<float>::max());
+        for (size_t i = 0; i < vertexCount; ++i)
+        {
+            const float *p = positions + i * stride;
+            minP = glm::min(minP, glm::vec3(p[0], p[1], p[2]));
+            maxP = glm::max(maxP, glm::vec3(p[0], p[1], p[2]));
+        }
+        const glm::vec3 size = maxP - minP;
+        const float extent = std::max(size.x, std::max(size.y, size.z));
+        const float radius = glm::length(size) * 0.5f;
+        if (radius <= 0.f)
+            return;
+
+        size_t previousCount = indices.size();
+        float previousError = 0.f;
+
+        for (uint32_t level = 1; level < Mesh::kMaxLods; ++level)
+        {
+            // Every level starts from the source so errors are measured against it
+            const size_t target = (size_t)(indices.size() >> level) / 3 * 3;
+            float error = 0.f;
+            std::vector<uint32_t> lod = SimplifyMesh(positions, vertexCount, stride, indices, target, kMaxError, &error);
+
+            if (lod.empty() || (float)lod.size() > (float)previousCount * (1.f - kMinReduction))
+                break;
+
+            OptimizeVertexCache(lod, vertexCount);
+
+            previousError = std::max(previousError, error * extent / radius);
+            outLods.push_back({(uint32_t)outIndices.size(), (uint32_t)lod.size(), previousError});
+            outIndices.insert(outIndices.end(), lod.begin(), lod.end());
+            previousCount = lod.size();
+
+            if (lod.size() / 3 < kMinTriangles)
+                break;
+        }
+    }
+}
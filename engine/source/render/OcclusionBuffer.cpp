@@ -0,0 +1,490 @@
+#include "render/OcclusionBuffer.h"
+
+#include "render/Mesh.h"
+#include "jobs/JobSystem.h"
+
+#include <glm/common.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+namespace eng
+{
+    // Thin wrappers so the rasterizer is written once, as a template over the
+    // lane type. Masks are all-ones or zero per lane. Scalar is always built so
+    // SetScalar can check the ENGINE_SIMD path against it.
+    namespace simd
+    {
+        struct Scalar
+        {
+            static constexpr uint32_t kLanes = 1;
+            static constexpr const char *kName = "scalar";
+            using VecF = float;
+            using VecI = int32_t;
+
+            static VecI SetI(int32_t v) { return v; }
+            static VecI LaneIndex() { return 0; }
+            static VecI AddI(VecI a, VecI b) { return a + b; }
+            static VecI MulI(VecI a, VecI b) { return a * b; }
+            static VecI OrI(VecI a, VecI b) { return a | b; }
+            static VecI AndI(VecI a, VecI b) { return a & b; }
+            static VecI GreaterI(VecI a, VecI b) { return a > b ? -1 : 0; }
+            static bool Any(VecI mask) { return mask != 0; }
+
+            static VecF SetF(float v) { return v; }
+            static VecF ToFloat(VecI v) { return (float)v; }
+            static VecF LoadF(const float *p) { return *p; }
+            static void StoreF(float *p, VecF v) { *p = v; }
+            static VecF AddF(VecF a, VecF b) { return a + b; }
+            static VecF MulF(VecF a, VecF b) { return a * b; }
+            // Same operand order as minps: the second operand wins unless a < b
+            static VecF MinF(VecF a, VecF b) { return a < b ? a : b; }
+            static VecI GreaterEqualF(VecF a, VecF b) { return a >= b ? -1 : 0; }
+            static VecF Select(VecF a, VecF b, VecI mask) { return mask ? b : a; }
+        };
+
+#if defined(__AVX2__)
+        struct Native
+        {
+            static constexpr uint32_t kLanes = 8;
+            static constexpr const char *kName = "AVX2";
+            using VecF = __m256;
+            using VecI = __m256i;
+
+            static VecI SetI(int32_t v) { return _mm256_set1_epi32(v); }
+            static VecI LaneIndex() { return _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7); }
+            static VecI AddI(VecI a, VecI b) { return _mm256_add_epi32(a, b); }
+            static VecI MulI(VecI a, VecI b) { return _mm256_mullo_epi32(a, b); }
+            static VecI OrI(VecI a, VecI b) { return _mm256_or_si256(a, b); }
+            static VecI AndI(VecI a, VecI b) { return _mm256_and_si256(a, b); }
+            static VecI GreaterI(VecI a, VecI b) { return _mm256_cmpgt_epi32(a, b); }
+            static bool Any(VecI mask) { return _mm256_movemask_ps(_mm256_castsi256_ps(mask)) != 0; }
+
+            static VecF SetF(float v) { return _mm256_set1_ps(v); }
+            static VecF ToFloat(VecI v) { return _mm256_cvtepi32_ps(v); }
+            static VecF LoadF(const float *p) { return _mm256_loadu_ps(p); }
+            static void StoreF(float *p, VecF v) { _mm256_storeu_ps(p, v); }
+            static VecF AddF(VecF a, VecF b) { return _mm256_add_ps(a, b); }
+            static VecF MulF(VecF a, VecF b) { return _mm256_mul_ps(a, b); }
+            static VecF MinF(VecF a, VecF b) { return _mm256_min_ps(a, b); }
+            static VecI GreaterEqualF(VecF a, VecF b) { return _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_GE_OQ)); }
+            static VecF Select(VecF a, VecF b, VecI mask) { return _mm256_blendv_ps(a, b, _mm256_castsi256_ps(mask)); }
+        };
+#elif defined(__SSE4_1__)
+        struct Native
+        {
+            static constexpr uint32_t kLanes = 4;
+            static constexpr const char *kName = "SSE4.1";
+            using VecF = __m128;
+            using VecI = __m128i;
+
+            static VecI SetI(int32_t v) { return _mm_set1_epi32(v); }
+            static VecI LaneIndex() { return _mm_setr_epi32(0, 1, 2, 3); }
+            static VecI AddI(VecI a, VecI b) { return _mm_add_epi32(a, b); }
+            static VecI MulI(VecI a, VecI b) { return _mm_mullo_epi32(a, b); }
+            static VecI OrI(VecI a, VecI b) { return _mm_or_si128(a, b); }
+            static VecI AndI(VecI a, VecI b) { return _mm_and_si128(a, b); }
+            static VecI GreaterI(VecI a, VecI b) { return _mm_cmpgt_epi32(a, b); }
+            static bool Any(VecI mask) { return _mm_movemask_ps(_mm_castsi128_ps(mask)) != 0; }
+
+            static VecF SetF(float v) { return _mm_set1_ps(v); }
+            static VecF ToFloat(VecI v) { return _mm_cvtepi32_ps(v); }
+            static VecF LoadF(const float *p) { return _mm_loadu_ps(p); }
+            static void StoreF(float *p, VecF v) { _mm_storeu_ps(p, v); }
+            static VecF AddF(VecF a, VecF b) { return _mm_add_ps(a, b); }
+            static VecF MulF(VecF a, VecF b) { return _mm_mul_ps(a, b); }
+            static VecF MinF(VecF a, VecF b) { return _mm_min_ps(a, b); }
+            static VecI GreaterEqualF(VecF a, VecF b) { return _mm_castps_si128(_mm_cmpge_ps(a, b)); }
+            static VecF Select(VecF a, VecF b, VecI mask) { return _mm_blendv_ps(a, b, _mm_castsi128_ps(mask)); }
+        };
+#else
+        using Native = Scalar;
+#endif
+    }
+
+    const uint32_t OcclusionBuffer::kSimdLanes = simd::Native::kLanes;
+    const char *const OcclusionBuffer::kSimdName = simd::Native::kName;
+
+    // 1/8 pixel fixed point. With kMaxSize and the guard band every edge
+    // function value stays well inside int32.
+    static constexpr int32_t kSubpixelBits = 3;
+    static constexpr int32_t kSubpixel = 1 << kSubpixelBits;
+    static constexpr float kGuardBand = 256.f;
+
+    void OcclusionBuffer::Init(uint32_t width, uint32_t height)
+    {
+        auto fit = [](uint32_t v)
+        { return std::min(kMaxSize, std::max(kTileSize, (v + kTileSize - 1) / kTileSize * kTileSize)); };
+
+        m_width = fit(width);
+        m_height = fit(height);
+        m_tilesX = m_width / kTileSize;
+        m_tilesY = m_height / kTileSize;
+
+        m_depth.assign((size_t)m_width * m_height, 1.f);
+        m_tileMax.assign((size_t)m_tilesX * m_tilesY, 1.f);
+        m_triangles.clear();
+    }
+
+    void OcclusionBuffer::Render(std::span<const Occluder> occluders, const glm::mat4 &viewProj, JobSystem &jobSystem)
+    {
+        if (m_depth.empty())
+            Init();
+
+        m_viewProj = viewProj;
+
+        m_threadTriangles.resize(std::max(1u, jobSystem.GetThreadCount()));
+        for (auto &bucket : m_threadTriangles)
+            bucket.clear();
+
+        jobSystem.ParallelFor(occluders.size(), 4, [this, occluders](size_t begin, size_t end)
+                              {
+                                  auto &out = m_threadTriangles[JobSystem::GetThreadIndex()];
+                                  for (size_t i = begin; i < end; ++i)
+                                      SetupOccluder(occluders[i], out); });
+
+        // Depth only ever decreases, so triangle order does not change the result
+        m_triangles.clear();
+        for (auto &bucket : m_threadTriangles)
+            m_triangles.insert(m_triangles.end(), bucket.begin(), bucket.end());
+
+        jobSystem.ParallelFor(m_tilesY, 1, [this](size_t begin, size_t end)
+                              {
+                                  for (size_t band = begin; band < end; ++band)
+                                  {
+                                      if (m_scalar)
+                                          RasterizeBand<simd::Scalar>((uint32_t)band);
+                                      else
+                                          RasterizeBand<simd::Native>((uint32_t)band);
+                                  } });
+    }
+
+    void OcclusionBuffer::SetupOccluder(const Occluder &occluder, std::vector<Triangle> &out) const
+    {
+        const float *positions = occluder.positions.data();
+        size_t stride = 3;
+        size_t vertexCount = occluder.positions.size() / 3;
+        std::span<const uint32_t> indices = occluder.indices;
+
+        if (const Mesh *mesh = occluder.mesh)
+        {
+            const VertexLayout &layout = mesh->GetVertexLayout();
+            const VertexElement *position = nullptr;
+            for (auto &e : layout.elements)
+            {
+                if (e.index == VertexElement::Position)
+                    position = &e;
+            }
+            if (!position || position->size < 3 || position->type != AttribType::Float32 || layout.stride == 0)
+                return;
+
+            const auto &vertices = mesh->GetVertices();
+            stride = layout.stride / sizeof(float);
+            positions = vertices.data() + position->offset / sizeof(float);
+            vertexCount = vertices.size() / stride;
+            indices = mesh->GetIndices();
+        }
+
+        const glm::mat4 mvp = m_viewProj * occluder.transform;
+
+        std::vector<glm::vec4> clip(vertexCount);
+        for (size_t i = 0; i < vertexCount; ++i)
+        {
+            const float *p = positions + i * stride;
+            clip[i] = mvp * glm::vec4(p[0], p[1], p[2], 1.f);
+        }
+
+        if (indices.empty())
+        {
+            for (size_t i = 0; i + 2 < vertexCount; i += 3)
+                SetupTriangle(clip[i], clip[i + 1], clip[i + 2], out);
+            return;
+        }
+
+        auto setupIndexed = [&](std::span<const uint32_t> list)
+        {
+            for (size_t i = 0; i + 2 < list.size(); i += 3)
+            {
+                const uint32_t i0 = list[i], i1 = list[i + 1], i2 = list[i + 2];
+                if (i0 < vertexCount && i1 < vertexCount && i2 < vertexCount)
+                    SetupTriangle(clip[i0], clip[i1], clip[i2], out);
+            }
+        };
+
+        if (!occluder.mesh || occluder.ranges.empty())
+        {
+            setupIndexed(indices);
+            return;
+        }
+
+        // Removed sources have an empty level 0
+        for (const auto &range : occluder.ranges)
+        {
+            const auto &level = range.levels[0];
+            if (level.indexCount > 0 && (size_t)level.firstIndex + level.indexCount <= indices.size())
+                setupIndexed(indices.subspan(level.firstIndex, level.indexCount));
+        }
+    }
+
+    void OcclusionBuffer::SetupTriangle(const glm::vec4 &v0, const glm::vec4 &v1, const glm::vec4 &v2, std::vector<Triangle> &out) const
+    {
+        // Trivially outside one of the side or far planes
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            if (v0[axis] > v0.w && v1[axis] > v1.w && v2[axis] > v2.w)
+                return;
+            if (axis < 2 && v0[axis] < -v0.w && v1[axis] < -v1.w && v2[axis] < -v2.w)
+                return;
+        }
+
+        // Clip against the near plane (z = -w, GL style), up to 4 vertices
+        const glm::vec4 in[3] = {v0, v1, v2};
+        glm::vec4 poly[4];
+        int count = 0;
+        for (int i = 0; i < 3; ++i)
+        {
+            const glm::vec4 &a = in[i];
+            const glm::vec4 &b = in[(i + 1) % 3];
+            const float da = a.z + a.w;
+            const float db = b.z + b.w;
+
+            if (da >= 0.f)
+                poly[count++] = a;
+            if ((da >= 0.f) != (db >= 0.f))
+                poly[count++] = a + (b - a) * (da / (da - db));
+        }
+        if (count < 3)
+            return;
+
+        struct Screen
+        {
+            int32_t x, y;
+            float z;
+        };
+
+        const float width = (float)m_width;
+        const float height = (float)m_height;
+
+        Screen s[4];
+        for (int i = 0; i < count; ++i)
+        {
+            const float invW = 1.f / poly[i].w;
+            const float sx = (poly[i].x * invW * 0.5f + 0.5f) * width;
+            const float sy = (0.5f - poly[i].y * invW * 0.5f) * height;
+
+            // Dropping an occluder is always safe, overflowing the fixed point is not
+            if (!(sx >= -kGuardBand && sx <= width + kGuardBand && sy >= -kGuardBand && sy <= height + kGuardBand))
+                return;
+
+            s[i].x = (int32_t)std::lround(sx * kSubpixel);
+            s[i].y = (int32_t)std::lround(sy * kSubpixel);
+            s[i].z = poly[i].z * invW;
+        }
+
+        for (int t = 1; t + 1 < count; ++t)
+        {
+            Screen p0 = s[0], p1 = s[t], p2 = s[t + 1];
+
+            int64_t area = (int64_t)(p1.x - p0.x) * (p2.y - p0.y) - (int64_t)(p2.x - p0.x) * (p1.y - p0.y);
+            if (area == 0)
+                continue;
+            // Occluders are two sided; orient so the inside is positive
+            if (area < 0)
+                std::swap(p1, p2);
+
+            Triangle tri;
+            // Pixel centers (x + 0.5) inside the bounds, clamped to the buffer
+            const int32_t minFx = std::min({p0.x, p1.x, p2.x});
+            const int32_t maxFx = std::max({p0.x, p1.x, p2.x});
+            const int32_t minFy = std::min({p0.y, p1.y, p2.y});
+            const int32_t maxFy = std::max({p0.y, p1.y, p2.y});
+            tri.minX = std::max(0, (minFx - kSubpixel / 2 + kSubpixel - 1) >> kSubpixelBits);
+            tri.maxX = std::min((int32_t)m_width - 1, (maxFx - kSubpixel / 2) >> kSubpixelBits);
+            tri.minY = std::max(0, (minFy - kSubpixel / 2 + kSubpixel - 1) >> kSubpixelBits);
+            tri.maxY = std::min((int32_t)m_height - 1, (maxFy - kSubpixel / 2) >> kSubpixelBits);
+            if (tri.minX > tri.maxX || tri.minY > tri.maxY)
+                continue;
+
+            const Screen v[3] = {p0, p1, p2};
+            for (int e = 0; e < 3; ++e)
+            {
+                const Screen &a = v[e];
+                const Screen &b = v[(e + 1) % 3];
+                tri.a[e] = a.y - b.y;
+                tri.b[e] = b.x - a.x;
+                tri.c[e] = a.x * b.y - a.y * b.x;
+            }
+
+            // Depth plane in pixel units
+            const float x0 = (float)p0.x / kSubpixel, y0 = (float)p0.y / kSubpixel;
+            const float d1x = (float)(p1.x - p0.x) / kSubpixel, d1y = (float)(p1.y - p0.y) / kSubpixel;
+            const float d2x = (float)(p2.x - p0.x) / kSubpixel, d2y = (float)(p2.y - p0.y) / kSubpixel;
+            const float d1z = p1.z - p0.z, d2z = p2.z - p0.z;
+            const float invDet = 1.f / (d1x * d2y - d2x * d1y);
+            tri.za = (d1z * d2y - d2z * d1y) * invDet;
+            tri.zb = (d2z * d1x - d1z * d2x) * invDet;
+            tri.zc = p0.z - tri.za * x0 - tri.zb * y0;
+
+            out.push_back(tri);
+        }
+    }
+
+    template <typename Ops>
+    void OcclusionBuffer::RasterizeBand(uint32_t band)
+    {
+        using VecI = typename Ops::VecI;
+        using VecF = typename Ops::VecF;
+        constexpr uint32_t kLanes = Ops::kLanes;
+
+        const int32_t bandY0 = (int32_t)(band * kTileSize);
+        const int32_t bandY1 = bandY0 + (int32_t)kTileSize - 1;
+        float *depth = m_depth.data();
+
+        std::fill(depth + (size_t)bandY0 * m_width, depth + (size_t)(bandY1 + 1) * m_width, 1.f);
+
+        const VecI lane = Ops::LaneIndex();
+        const VecI laneSample = Ops::MulI(lane, Ops::SetI(kSubpixel));
+        const VecI minusOne = Ops::SetI(-1);
+        const VecF half = Ops::SetF(0.5f);
+
+        for (const Triangle &tri : m_triangles)
+        {
+            if (tri.maxY < bandY0 || tri.minY > bandY1)
+                continue;
+
+            const int32_t y0 = std::max(tri.minY, bandY0);
+            const int32_t y1 = std::min(tri.maxY, bandY1);
+            const int32_t x0 = tri.minX & ~(int32_t)(kLanes - 1);
+
+            const VecI a0 = Ops::SetI(tri.a[0]), a1 = Ops::SetI(tri.a[1]), a2 = Ops::SetI(tri.a[2]);
+            const VecF za = Ops::SetF(tri.za);
+
+            for (int32_t y = y0; y <= y1; ++y)
+            {
+                const int32_t sampleY = y * kSubpixel + kSubpixel / 2;
+                const VecI row0 = Ops::SetI(tri.b[0] * sampleY + tri.c[0]);
+                const VecI row1 = Ops::SetI(tri.b[1] * sampleY + tri.c[1]);
+                const VecI row2 = Ops::SetI(tri.b[2] * sampleY + tri.c[2]);
+                const VecF zRow = Ops::SetF(tri.zc + tri.zb * ((float)y + 0.5f));
+                float *rowDepth = depth + (size_t)y * m_width;
+
+                for (int32_t x = x0; x <= tri.maxX; x += (int32_t)kLanes)
+                {
+                    const VecI sampleX = Ops::AddI(Ops::SetI(x * kSubpixel + kSubpixel / 2), laneSample);
+                    const VecI e0 = Ops::AddI(Ops::MulI(a0, sampleX), row0);
+                    const VecI e1 = Ops::AddI(Ops::MulI(a1, sampleX), row1);
+                    const VecI e2 = Ops::AddI(Ops::MulI(a2, sampleX), row2);
+
+                    // All three edge functions >= 0
+                    const VecI inside = Ops::GreaterI(Ops::OrI(Ops::OrI(e0, e1), e2), minusOne);
+                    if (!Ops::Any(inside))
+                        continue;
+
+                    const VecF px = Ops::AddF(Ops::ToFloat(Ops::AddI(Ops::SetI(x), lane)), half);
+                    const VecF z = Ops::AddF(zRow, Ops::MulF(za, px));
+                    const VecF current = Ops::LoadF(rowDepth + x);
+                    Ops::StoreF(rowDepth + x, Ops::Select(current, Ops::MinF(current, z), inside));
+                }
+            }
+        }
+
+        for (uint32_t tx = 0; tx < m_tilesX; ++tx)
+        {
+            float farthest = 0.f;
+            for (int32_t y = bandY0; y <= bandY1; ++y)
+            {
+                const float *p = depth + (size_t)y * m_width + tx * kTileSize;
+                for (uint32_t x = 0; x < kTileSize; ++x)
+                    farthest = std::max(farthest, p[x]);
+            }
+            m_tileMax[band * m_tilesX + tx] = farthest;
+        }
+    }
+
+    bool OcclusionBuffer::IsVisible(const AABB &bounds) const
+    {
+        return m_scalar ? IsVisibleWith<simd::Scalar>(bounds) : IsVisibleWith<simd::Native>(bounds);
+    }
+
+    template <typename Ops>
+    bool OcclusionBuffer::IsVisibleWith(const AABB &bounds) const
+    {
+        using VecI = typename Ops::VecI;
+        using VecF = typename Ops::VecF;
+        constexpr uint32_t kLanes = Ops::kLanes;
+
+        if (m_depth.empty())
+            return true;
+
+        const float width = (float)m_width;
+        const float height = (float)m_height;
+
+        float minX = width, maxX = 0.f, minY = height, maxY = 0.f;
+        float zMin = 1.f;
+        for (int i = 0; i < 8; ++i)
+        {
+            const glm::vec3 corner((i & 1) ? bounds.max.x : bounds.min.x,
+                                   (i & 2) ? bounds.max.y : bounds.min.y,
+                                   (i & 4) ? bounds.max.z : bounds.min.z);
+            const glm::vec4 clip = m_viewProj * glm::vec4(corner, 1.f);
+            if (clip.w <= 1e-5f)
+                return true; // crosses the near plane
+
+            const float invW = 1.f / clip.w;
+            const float sx = (clip.x * invW * 0.5f + 0.5f) * width;
+            const float sy = (0.5f - clip.y * invW * 0.5f) * height;
+            minX = std::min(minX, sx);
+            maxX = std::max(maxX, sx);
+            minY = std::min(minY, sy);
+            maxY = std::max(maxY, sy);
+            zMin = std::min(zMin, clip.z * invW);
+        }
+
+        // Fully in front of the camera but off screen
+        if (maxX < 0.f || maxY < 0.f || minX > width || minY > height)
+            return false;
+
+        const int32_t px0 = std::max(0, (int32_t)std::floor(minX));
+        const int32_t py0 = std::max(0, (int32_t)std::floor(minY));
+        const int32_t px1 = std::min((int32_t)m_width - 1, std::max(px0, (int32_t)std::ceil(maxX) - 1));
+        const int32_t py1 = std::min((int32_t)m_height - 1, std::max(py0, (int32_t)std::ceil(maxY) - 1));
+
+        const VecI lane = Ops::LaneIndex();
+        const VecF nearest = Ops::SetF(zMin);
+
+        for (int32_t ty = py0 / (int32_t)kTileSize; ty <= py1 / (int32_t)kTileSize; ++ty)
+        {
+            for (int32_t tx = px0 / (int32_t)kTileSize; tx <= px1 / (int32_t)kTileSize; ++tx)
+            {
+                // Everything in this tile is nearer than the box
+                if (zMin > m_tileMax[ty * m_tilesX + tx])
+                    continue;
+
+                const int32_t cx0 = std::max(px0, tx * (int32_t)kTileSize);
+                const int32_t cx1 = std::min(px1, tx * (int32_t)kTileSize + (int32_t)kTileSize - 1);
+                const int32_t cy0 = std::max(py0, ty * (int32_t)kTileSize);
+                const int32_t cy1 = std::min(py1, ty * (int32_t)kTileSize + (int32_t)kTileSize - 1);
+                const VecI first = Ops::SetI(cx0 - 1);
+                const VecI last = Ops::SetI(cx1 + 1);
+
+                for (int32_t y = cy0; y <= cy1; ++y)
+                {
+                    const float *row = m_depth.data() + (size_t)y * m_width;
+                    for (int32_t x = cx0 & ~(int32_t)(kLanes - 1); x <= cx1; x += (int32_t)kLanes)
+                    {
+                        const VecI px = Ops::AddI(Ops::SetI(x), lane);
+                        const VecI inRange = Ops::AndI(Ops::GreaterI(px, first), Ops::GreaterI(last, px));
+                        if (Ops::Any(Ops::AndI(inRange, Ops::GreaterEqualF(Ops::LoadF(row + x), nearest))))
+                            return true;
+                    }
+                }
+            }
+        }
+
+        return false;
+    }
+}
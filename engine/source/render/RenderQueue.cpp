@@ -2,33 +2,194 @@
 
 #include "render/Mesh.h"
 #include "render/Material.h"
+#include "render/RenderScene.h"
+#include "render/IndirectRenderer.h"
 #include "graphics/GraphicsAPI.h"
 #include "graphics/ShaderProgram.h"
+#include "jobs/JobSystem.h"
+#include "Engine.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
 
 namespace eng
 {
+    void RenderQueue::Init(uint32_t threadCount)
+    {
+        m_buckets.clear();
+        m_buckets.resize(threadCount > 0 ? threadCount : 1);
+        m_occlusion.Init();
+    }
+
     void RenderQueue::Submit(const RenderCommand &command)
     {
-        m_commands.push_back(command);
+        const uint32_t thread = JobSystem::GetThreadIndex();
+        assert(thread < m_buckets.size() && "RenderQueue::Init was not called");
+        m_buckets[thread].push_back(command);
     }
 
-    void RenderQueue::Draw(GraphicsAPI &graphicsAPI, const CameraData &cameraData, const std::vector<LightData> &lights)
+    void RenderQueue::MergeBuckets()
     {
-        for (auto &command : m_commands)
+        size_t total = m_commands.size();
+        for (auto &bucket : m_buckets)
+            total += bucket.size();
+        m_commands.reserve(total);
+
+        // Bucket order is not deterministic across frames, the draw order inside a bucket is.
+        for (auto &bucket : m_buckets)
         {
-            graphicsAPI.BindMaterial(command.material);
-            auto shaderProgram = command.material->GetShaderProgram();
-            shaderProgram->SetUniform("u_model", command.modelMatrix);
-            shaderProgram->SetUniform("u_camera_Pos", cameraData.position);
-            if (!lights.empty())
+            m_commands.insert(m_commands.end(), bucket.begin(), bucket.end());
+            bucket.clear();
+        }
+    }
+
+    void RenderQueue::BindItem(GraphicsAPI &graphicsAPI, Mesh *mesh, Material *material, const glm::mat4 &modelMatrix,
+                               const CameraData &cameraData)
+    {
+        graphicsAPI.BindMaterial(material);
+        auto shaderProgram = material->GetShaderProgram();
+        shaderProgram->SetUniform("u_model", modelMatrix);
+        // Lights come from the clustered lighting set, not per draw
+        shaderProgram->SetUniform("u_cameraPos", cameraData.position);
+
+        graphicsAPI.BindMesh(mesh);
+    }
+
+    void RenderQueue::DrawItem(GraphicsAPI &graphicsAPI, Mesh *mesh, Material *material, const glm::mat4 &modelMatrix,
+                               const CameraData &cameraData, uint32_t lod)
+    {
+        BindItem(graphicsAPI, mesh, material, modelMatrix, cameraData);
+        graphicsAPI.DrawMesh(mesh, lod);
+    }
+
+    void RenderQueue::DrawRanges(GraphicsAPI &graphicsAPI, const RenderProxy &proxy, const uint8_t *visible,
+                                 const CameraData &cameraData)
+    {
+        BindItem(graphicsAPI, proxy.mesh, proxy.material, proxy.transform, cameraData);
+
+        const auto &ranges = proxy.ranges;
+        for (size_t r = 0; r < ranges.size();)
+        {
+            if (!visible[r] || ranges[r].indexCount == 0)
             {
-                auto &light = lights[0];
-                shaderProgram->SetUniform("uLight.color", light.color);
-                shaderProgram->SetUniform("uLight.position", light.position);
+                ++r;
+                continue;
             }
+            // Sources were appended one after the other, so visible neighbours are contiguous indices
+            const uint32_t first = ranges[r].firstIndex;
+            uint32_t count = ranges[r].indexCount;
+            for (++r; r < ranges.size() && visible[r] && ranges[r].firstIndex == first + count; ++r)
+                count += ranges[r].indexCount;
+            graphicsAPI.DrawMeshRange(proxy.mesh, first, count);
+        }
+    }
+
+    bool RenderQueue::RenderOccluders(const RenderScene &renderScene, const CameraData &cameraData)
+    {
+        m_occluders.clear();
+        for (auto &proxy : renderScene.GetProxies())
+        {
+            if (proxy.occluder)
+                m_occluders.push_back({proxy.mesh, proxy.transform, {}, {}, proxy.ranges});
+        }
+
+        m_occlusionStats.occluders = (uint32_t)m_occluders.size();
+        if (m_occluders.empty())
+            return false;
+
+        const auto start = std::chrono::steady_clock::now();
+        m_occlusion.Render(m_occluders, cameraData.projectionMatrix * cameraData.viewMatrix,
+                           Engine::GetInstance().GetJobSystem());
+        m_occlusionStats.rasterMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        m_occlusionStats.triangles = m_occlusion.GetTriangleCount();
+        return true;
+    }
+
+    void RenderQueue::Draw(GraphicsAPI &graphicsAPI, const RenderScene &renderScene, const CameraData &cameraData,
+                           bool skipIndirect)
+    {
+        const auto &proxies = renderScene.GetProxies();
+        MergeBuckets();
+
+        // The GPU driven path has its own Hi-Z culling
+        m_occlusionStats = OcclusionStats{};
+        const bool occlusion = m_occlusionCulling && !skipIndirect && RenderOccluders(renderScene, cameraData);
+
+        m_visible.assign(proxies.size() + m_commands.size(), 1);
+
+        // Merged proxies are always drawn range by range, ranges of removed sources are empty
+        const size_t proxyCount = proxies.size();
+        m_rangeFirst.resize(proxyCount);
+        uint32_t rangeCount = 0;
+        for (size_t i = 0; i < proxyCount; ++i)
+        {
+            m_rangeFirst[i] = rangeCount;
+            rangeCount += (uint32_t)proxies[i].ranges.size();
+        }
+        m_rangeVisible.assign(rangeCount, 1);
+
+        if (occlusion)
+        {
+            const auto start = std::chrono::steady_clock::now();
+
+            Engine::GetInstance().GetJobSystem().ParallelFor(m_visible.size(), 256, [&](size_t begin, size_t end)
+                                                             {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    if (i < proxyCount)
+                    {
+                        const auto &proxy = proxies[i];
+                        if (proxy.occluder)
+                            continue;
+                        if (proxy.ranges.empty())
+                        {
+                            m_visible[i] = m_occlusion.IsVisible(proxy.worldBounds);
+                            continue;
+                        }
+
+                        // A merged proxy is visible when one of its sources is
+                        uint8_t any = 0;
+                        uint8_t *rangeVisible = m_rangeVisible.data() + m_rangeFirst[i];
+                        for (size_t r = 0; r < proxy.ranges.size(); ++r)
+                        {
+                            rangeVisible[r] = proxy.ranges[r].indexCount > 0 && m_occlusion.IsVisible(proxy.ranges[r].worldBounds);
+                            any |= rangeVisible[r];
+                        }
+                        m_visible[i] = any;
+                    }
+                    else
+                    {
+                        const auto &command = m_commands[i - proxyCount];
+                        m_visible[i] = m_occlusion.IsVisible(TransformBounds(command.mesh->GetBounds(), command.modelMatrix));
+                    }
+                } });
+
+            m_occlusionStats.testMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+            m_occlusionStats.tested = (uint32_t)m_visible.size();
+            m_occlusionStats.culled = (uint32_t)std::count(m_visible.begin(), m_visible.end(), 0);
+        }
+
+        for (size_t i = 0; i < proxies.size(); ++i)
+        {
+            const auto &proxy = proxies[i];
+            // Imposters are drawn by ImposterRenderer
+            if (!m_visible[i] || proxy.imposter || (skipIndirect && IndirectRenderer::IsEligible(proxy)))
+                continue;
+
+            if (!proxy.ranges.empty())
+                DrawRanges(graphicsAPI, proxy, m_rangeVisible.data() + m_rangeFirst[i], cameraData);
+            else
+                DrawItem(graphicsAPI, proxy.mesh, proxy.material, proxy.transform, cameraData, proxy.lod);
+        }
+
+        for (size_t i = 0; i < m_commands.size(); ++i)
+        {
+            if (!m_visible[proxies.size() + i])
+                continue;
 
-            graphicsAPI.BindMesh(command.mesh);
-            graphicsAPI.DrawMesh(command.mesh);
+            const auto &command = m_commands[i];
+            DrawItem(graphicsAPI, command.mesh, command.material, command.modelMatrix, cameraData);
         }
 
         m_commands.clear();
@@ -0,0 +1,114 @@
+#include "render/RenderScene.h"
+
+#include "render/Mesh.h"
+
+#include <glm/common.hpp>
+
+#include <algorithm>
+
+namespace eng
+{
+    AABB TransformBounds(const AABB &local, const glm::mat4 &m)
+    {
+        // Arvo: project the box extents onto each world axis
+        const glm::vec3 center = (local.min + local.max) * 0.5f;
+        const glm::vec3 extent = (local.max - local.min) * 0.5f;
+
+        const glm::vec3 worldCenter = glm::vec3(m * glm::vec4(center, 1.f));
+        glm::vec3 worldExtent(0.f);
+        for (int i = 0; i < 3; ++i)
+        {
+            worldExtent += glm::abs(glm::vec3(m[i])) * extent[i];
+        }
+
+        AABB result;
+        result.min = worldCenter - worldExtent;
+        result.max = worldCenter + worldExtent;
+        return result;
+    }
+
+    RenderScene::ProxyHandle RenderScene::AddProxy(Mesh *mesh, Material *material, const glm::mat4 &transform)
+    {
+        RenderProxy proxy;
+        proxy.mesh = mesh;
+        proxy.material = material;
+        proxy.transform = transform;
+        proxy.worldBounds = TransformBounds(mesh->GetBounds(), transform);
+
+        MarkStructureChanged();
+        return m_proxies.Add(proxy);
+    }
+
+    void RenderScene::UpdateTransform(ProxyHandle handle, const glm::mat4 &transform)
+    {
+        auto &proxy = m_proxies.Get(handle);
+        proxy.transform = transform;
+        proxy.worldBounds = TransformBounds(proxy.mesh->GetBounds(), transform);
+        MarkChanged(handle);
+    }
+
+    void RenderScene::SetOccluder(ProxyHandle handle, bool occluder)
+    {
+        m_proxies.Get(handle).occluder = occluder;
+        MarkChanged(handle);
+    }
+
+    void RenderScene::SetLod(ProxyHandle handle, uint32_t lod)
+    {
+        m_proxies.Get(handle).lod = lod;
+        MarkChanged(handle);
+    }
+
+    void RenderScene::SetImposter(ProxyHandle handle, const Imposter *imposter)
+    {
+        m_proxies.Get(handle).imposter = imposter;
+        MarkChanged(handle);
+    }
+
+    void RenderScene::SetRanges(ProxyHandle handle, std::span<const DrawRange> ranges)
+    {
+        m_proxies.Get(handle).ranges = ranges;
+        MarkStructureChanged();
+    }
+
+    void RenderScene::UpdateRanges(ProxyHandle handle)
+    {
+        MarkChanged(handle);
+    }
+
+    void RenderScene::RemoveProxy(ProxyHandle handle)
+    {
+        m_proxies.Remove(handle);
+        MarkStructureChanged();
+    }
+
+    bool RenderScene::GetChangedSince(uint64_t version, std::vector<ProxyHandle> &changed) const
+    {
+        if (version < m_logStart || version < m_structureVersion)
+            return false;
+
+        for (auto it = m_changes.rbegin(); it != m_changes.rend() && it->version > version; ++it)
+            changed.push_back(it->handle);
+        return true;
+    }
+
+    void RenderScene::MarkChanged(ProxyHandle handle)
+    {
+        ++m_version;
+        if (m_changes.size() >= std::max(kMinChangeLog, m_proxies.Size()))
+        {
+            m_logStart = m_changes.back().version;
+            m_changes.clear();
+        }
+        m_changes.push_back({m_version, handle});
+    }
+
+    void RenderScene::MarkStructureChanged()
+    {
+        // Readers behind this rebuild anyway, older entries may name removed handles
+        ++m_version;
+        m_structureVersion = m_version;
+        m_logStart = m_version;
+        m_changes.clear();
+    }
+}
@@ -0,0 +1,372 @@
+#include "render/StaticBatcher.h"
+
+#include "render/Material.h"
+#include "render/Mesh.h"
+#include "scene/GameObject.h"
+#include "scene/components/CameraComponent.h"
+#include "scene/components/MeshComponent.h"
+#include "Engine.h"
+
+#include <SDL3/SDL.h>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+#include <glm/trigonometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace eng
+{
+    static_assert(DrawRange::kMaxLevels == Mesh::kMaxLods, "a range holds every level of a mesh");
+
+    static const VertexElement *FindElement(const VertexLayout &layout, uint32_t index)
+    {
+        for (auto &e : layout.elements)
+        {
+            if (e.index == index)
+                return &e;
+        }
+        return nullptr;
+    }
+
+    struct BatchSource
+    {
+        MeshComponent *component = nullptr;
+        glm::mat4 world = glm::mat4(1.f);
+    };
+
+    struct BatchBuilder
+    {
+        std::shared_ptr<Material> material;
+        VertexLayout layout;
+        std::vector<float> vertices;
+        // One block per level of detail, level 0 first once concatenated
+        std::vector<uint32_t> levels[DrawRange::kMaxLevels];
+        bool occluder = false;
+        std::vector<DrawRange> ranges;
+        std::vector<MeshComponent *> components;
+    };
+
+    static void AppendMesh(BatchBuilder &batch, const Mesh &mesh, const glm::mat4 &world)
+    {
+        const auto &layout = mesh.GetVertexLayout();
+        const size_t floatsPerVertex = layout.stride / sizeof(float);
+        const auto *position = FindElement(layout, VertexElement::Position);
+        const auto *normal = FindElement(layout, VertexElement::Normal);
+
+        const auto &src = mesh.GetVertices();
+        const uint32_t baseVertex = (uint32_t)(batch.vertices.size() / floatsPerVertex);
+        const size_t vertexCount = src.size() / floatsPerVertex;
+
+        batch.vertices.insert(batch.vertices.end(), src.begin(), src.begin() + vertexCount * floatsPerVertex);
+
+        const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(world)));
+
+        DrawRange range;
+        range.worldBounds.min = glm::vec3(std::numeric_limits<float>::max());
+        range.worldBounds.max = glm::vec3(-std::numeric_limits<float>::max());
+
+        for (size_t v = 0; v < vertexCount; ++v)
+        {
+            float *dst = &batch.vertices[(baseVertex + v) * floatsPerVertex];
+
+            float *p = dst + position->offset / sizeof(float);
+            const glm::vec3 wp = glm::vec3(world * glm::vec4(p[0], p[1], p[2], 1.f));
+            p[0] = wp.x;
+            p[1] = wp.y;
+            p[2] = wp.z;
+
+            range.worldBounds.min = glm::min(range.worldBounds.min, wp);
+            range.worldBounds.max = glm::max(range.worldBounds.max, wp);
+
+            if (normal && normal->size >= 3)
+            {
+                float *n = dst + normal->offset / sizeof(float);
+                glm::vec3 wn = normalMatrix * glm::vec3(n[0], n[1], n[2]);
+                const float len = glm::length(wn);
+                if (len > 0.f)
+                    wn /= len;
+                n[0] = wn.x;
+                n[1] = wn.y;
+                n[2] = wn.z;
+            }
+        }
+
+        const float scale = std::max(glm::length(glm::vec3(world[0])),
+                                     std::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+        range.radius = glm::length(mesh.GetBounds().max - mesh.GetBounds().min) * 0.5f * scale;
+
+        // Offsets within the level blocks for now, made relative to level 0 when the batch is finished
+        range.levelCount = std::min(mesh.GetLodCount(), DrawRange::kMaxLevels);
+        for (uint32_t lod = 0; lod < range.levelCount; ++lod)
+        {
+            auto &block = batch.levels[lod];
+            auto &level = range.levels[lod];
+            level.firstIndex = (uint32_t)block.size();
+            level.error = mesh.GetLod(lod).error;
+
+            const auto srcIndices = mesh.GetLodIndices(lod);
+            if (!srcIndices.empty())
+            {
+                for (uint32_t index : srcIndices)
+                    block.push_back(baseVertex + index);
+            }
+            else if (lod == 0)
+            {
+                for (uint32_t i = 0; i < (uint32_t)vertexCount; ++i)
+                    block.push_back(baseVertex + i);
+            }
+
+            level.indexCount = (uint32_t)block.size() - level.firstIndex;
+        }
+
+        batch.ranges.push_back(range);
+    }
+
+    StaticBatcher::~StaticBatcher()
+    {
+        Clear();
+    }
+
+    void StaticBatcher::Build(std::span<MeshComponent *const> components)
+    {
+        std::vector<BatchSource> sources;
+        sources.reserve(components.size());
+        size_t skipped = 0;
+
+        for (auto *component : components)
+        {
+            if (!component || component->IsBatched())
+                continue;
+
+            const auto &mesh = component->GetMesh();
+            if (!mesh || !component->GetMaterial() || mesh->GetVertices().empty())
+                continue;
+
+            const auto *position = FindElement(mesh->GetVertexLayout(), VertexElement::Position);
+            if (!position || position->size < 3 || position->type != AttribType::Float32)
+                continue;
+
+            // Keep their own proxy to switch to the imposter
+            if (component->GetImposterDistance() > 0.f)
+            {
+                ++skipped;
+                continue;
+            }
+
+            sources.push_back({component, component->GetOwner()->GetWorldTransform()});
+        }
+
+        // Same material next to each other so every group turns into one or a few batches
+        std::stable_sort(sources.begin(), sources.end(), [](const BatchSource &a, const BatchSource &b)
+                         { return a.component->GetMaterial().get() < b.component->GetMaterial().get(); });
+
+        std::vector<BatchBuilder> open;
+        std::vector<BatchBuilder> done;
+
+        auto flush = [&done](BatchBuilder &batch)
+        {
+            if (!batch.levels[0].empty())
+                done.push_back(std::move(batch));
+            batch = BatchBuilder{};
+        };
+
+        Material *currentMaterial = nullptr;
+        for (const auto &source : sources)
+        {
+            const Mesh &mesh = *source.component->GetMesh();
+            const auto &material = source.component->GetMaterial();
+
+            if (material.get() != currentMaterial)
+            {
+                for (auto &batch : open)
+                    flush(batch);
+                open.clear();
+                currentMaterial = material.get();
+            }
+
+            // Occluders batch among themselves, so a batch is rasterized only when all of it was meant to be
+            const bool occluder = source.component->IsOccluder();
+            auto it = std::find_if(open.begin(), open.end(), [&mesh, occluder](const BatchBuilder &b)
+                                   { return b.layout == mesh.GetVertexLayout() && b.occluder == occluder; });
+            if (it == open.end())
+            {
+                open.emplace_back();
+                it = open.end() - 1;
+                it->material = material;
+                it->layout = mesh.GetVertexLayout();
+                it->occluder = occluder;
+            }
+
+            const size_t floatsPerVertex = it->layout.stride / sizeof(float);
+            if (it->vertices.size() / floatsPerVertex + mesh.GetVertexCount() > kMaxBatchVertices)
+            {
+                flush(*it);
+                it->material = material;
+                it->layout = mesh.GetVertexLayout();
+                it->occluder = occluder;
+            }
+
+            AppendMesh(*it, mesh, source.world);
+            it->components.push_back(source.component);
+        }
+
+        for (auto &batch : open)
+            flush(batch);
+
+        auto &renderScene = Engine::GetInstance().GetRenderScene();
+        for (auto &builder : done)
+        {
+            StaticBatch batch;
+            batch.material = builder.material;
+
+            // Level blocks back to back, the ranges move from block to mesh relative offsets
+            std::vector<uint32_t> indices;
+            std::vector<MeshLod> lods;
+            uint32_t levelCount = 0;
+            for (uint32_t lod = 0; lod < DrawRange::kMaxLevels; ++lod)
+            {
+                if (!builder.levels[lod].empty())
+                    levelCount = lod + 1;
+            }
+            for (uint32_t lod = 0; lod < levelCount; ++lod)
+            {
+                lods.push_back({(uint32_t)indices.size(), (uint32_t)builder.levels[lod].size(), 0.f});
+                indices.insert(indices.end(), builder.levels[lod].begin(), builder.levels[lod].end());
+            }
+            for (auto &range : builder.ranges)
+            {
+                for (uint32_t lod = 0; lod < range.levelCount; ++lod)
+                    range.levels[lod].firstIndex += lods[lod].firstIndex;
+                range.firstIndex = range.levels[0].firstIndex;
+                range.indexCount = range.levels[0].indexCount;
+            }
+
+            batch.mesh = std::make_shared<Mesh>(builder.layout, builder.vertices, indices, lods);
+            // Only the occlusion rasterizer reads merged meshes back
+            if (!builder.occluder)
+                batch.mesh->ReleaseCpuData();
+            batch.ranges = std::move(builder.ranges);
+            batch.components = std::move(builder.components);
+            batch.proxy = renderScene.AddProxy(batch.mesh.get(), batch.material.get(), glm::mat4(1.f));
+            // The vector is not touched again, its storage outlives moves of the batch
+            renderScene.SetRanges(batch.proxy, batch.ranges);
+            if (builder.occluder)
+                renderScene.SetOccluder(batch.proxy, true);
+
+            for (uint32_t r = 0; r < (uint32_t)batch.components.size(); ++r)
+            {
+                batch.components[r]->SetBatched(this);
+                m_sources[batch.components[r]] = {(uint32_t)m_batches.size(), r};
+            }
+
+            m_batches.push_back(std::move(batch));
+        }
+
+        SDL_Log("StaticBatcher: %zu meshes merged into %zu batches, %zu with imposters left alone",
+                sources.size(), done.size(), skipped);
+    }
+
+    void StaticBatcher::UpdateLods(float deltaTime, GameObject *cameraObject)
+    {
+        // Same rate, threshold and hysteresis as MeshComponent::Update
+        m_lodAccumulator += deltaTime;
+        if (m_batches.empty() || m_lodAccumulator < 1.f / MeshComponent::kLodTickRate)
+            return;
+        m_lodAccumulator = 0.f;
+
+        auto *camera = cameraObject ? cameraObject->GetComponent<CameraComponent>() : nullptr;
+        if (!camera)
+            return;
+
+        const glm::vec3 eye = cameraObject->GetWordPosition();
+        const float tanHalfFov = std::tan(glm::radians(camera->GetFov()) * 0.5f);
+
+        auto &renderScene = Engine::GetInstance().GetRenderScene();
+        for (auto &batch : m_batches)
+        {
+            bool changed = false;
+            for (auto &range : batch.ranges)
+            {
+                if (range.levelCount < 2 || range.indexCount == 0)
+                    continue;
+
+                const glm::vec3 center = (range.worldBounds.min + range.worldBounds.max) * 0.5f;
+                const float distance = glm::length(center - eye);
+                const float screenSize = distance > range.radius ? range.radius / (distance * tanHalfFov)
+                                                                 : std::numeric_limits<float>::max();
+
+                uint32_t lod = 0;
+                for (uint32_t level = range.levelCount - 1; level > 0; --level)
+                {
+                    const float threshold = level > range.lod ? MeshComponent::kLodErrorThreshold * MeshComponent::kLodHysteresis
+                                                              : MeshComponent::kLodErrorThreshold;
+                    if (range.levels[level].error * screenSize < threshold)
+                    {
+                        lod = level;
+                        break;
+                    }
+                }
+
+                if (lod == range.lod)
+                    continue;
+
+                range.lod = lod;
+                range.firstIndex = range.levels[lod].firstIndex;
+                range.indexCount = range.levels[lod].indexCount;
+                changed = true;
+            }
+
+            if (changed && batch.proxy != RenderScene::kInvalidProxy)
+                renderScene.UpdateRanges(batch.proxy);
+        }
+    }
+
+    void StaticBatcher::Remove(MeshComponent *component)
+    {
+        auto it = m_sources.find(component);
+        if (it == m_sources.end())
+            return;
+
+        auto &batch = m_batches[it->second.batch];
+        auto &range = batch.ranges[it->second.range];
+        batch.components[it->second.range] = nullptr;
+        m_sources.erase(it);
+
+        // Nothing is drawn or rasterized for it anymore, the merged buffers stay as they are
+        range.levels[0] = {};
+        range.levelCount = 1;
+        range.lod = 0;
+        range.firstIndex = 0;
+        range.indexCount = 0;
+
+        if (batch.proxy != RenderScene::kInvalidProxy)
+            Engine::GetInstance().GetRenderScene().UpdateRanges(batch.proxy);
+    }
+
+    void StaticBatcher::Clear()
+    {
+        if (m_batches.empty())
+            return;
+
+        auto batches = std::move(m_batches);
+        m_batches.clear();
+        m_sources.clear();
+
+        auto &renderScene = Engine::GetInstance().GetRenderScene();
+        for (auto &batch : batches)
+        {
+            if (batch.proxy != RenderScene::kInvalidProxy)
+                renderScene.RemoveProxy(batch.proxy);
+
+            for (auto *component : batch.components)
+            {
+                if (component)
+                    component->SetBatched(nullptr);
+            }
+        }
+    }
+}
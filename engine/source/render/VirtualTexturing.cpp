@@ -0,0 +1,761 @@
+#include "render/VirtualTexturing.h"
+
+#include "vk/VkHelpers.h"
+#include "vk/VulkanContext.h"
+#include "Engine.h"
+
+#include <SDL3/SDL.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace eng
+{
+    // Must match the VirtualTextureParams block of virtual_texture_frag.glsl
+    struct VirtualTextureParams
+    {
+        uint32_t info[4];     // id, level count, width, height
+        uint32_t feedback[4]; // width, height in slots, jitter x, y
+        float cache[4];       // page size, border, 1 / cache size, tile size
+    };
+
+    // Per frame slice of a texture's parameter buffer, a multiple of minUniformBufferOffsetAlignment
+    static constexpr VkDeviceSize kParamsStride = 256;
+    static constexpr VkDeviceSize kPageBytes = (VkDeviceSize)VirtualTextureFile::kPageSize * VirtualTextureFile::kPageSize * 4;
+    static constexpr uint32_t kCacheSize = VirtualTextureSystem::kCachePages * VirtualTextureFile::kPageSize;
+    // Page ids have 4 bits for the level and 10 for each tile coordinate
+    static constexpr uint32_t kMaxLevels = 16;
+    static constexpr uint32_t kMaxTiles = 1024;
+
+    static void ImageBarrier(VkCommandBuffer cmd, VkImage image, uint32_t levels,
+                             VkImageLayout oldLayout, VkImageLayout newLayout,
+                             VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+                             VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+    {
+        VkImageMemoryBarrier barrier{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = newLayout;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levels, 0, 1};
+        vkCmdPipelineBarrier(cmd, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+
+    // ---------------- VirtualTexture ----------------
+
+    VirtualTexture::~VirtualTexture()
+    {
+        if (m_system)
+            m_system->release(*this);
+    }
+
+    VkDescriptorSet VirtualTexture::GetTextureSet() const
+    {
+        return m_system && !m_sets.empty() ? m_sets[m_system->GetFrame()] : VK_NULL_HANDLE;
+    }
+
+    // ---------------- VirtualTextureSystem ----------------
+
+    void VirtualTextureSystem::Init(VulkanContext &vk, bool supported, uint32_t framesInFlight)
+    {
+        m_vk = &vk;
+        m_device = vk.GetDevice();
+        m_gpu = vk.GetGPU();
+        m_supported = supported;
+        m_frames.resize(framesInFlight);
+
+        if (!m_supported)
+        {
+            SDL_Log("VirtualTextureSystem: no fragmentStoresAndAtomics, virtual textures are disabled");
+            return;
+        }
+
+        VkDescriptorSetLayoutBinding bindings[4]{};
+        bindings[0] = {0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr};
+        bindings[1] = {1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr};
+        bindings[2] = {2, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr};
+        bindings[3] = {3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr};
+
+        VkDescriptorSetLayoutCreateInfo li{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+        li.bindingCount = 4;
+        li.pBindings = bindings;
+        vkutil::vkCheck(vkCreateDescriptorSetLayout(m_device, &li, nullptr, &m_setLayout),
+                        "vkCreateDescriptorSetLayout (virtual texture) failed");
+
+        const uint32_t maxSets = kMaxTextures * framesInFlight;
+        VkDescriptorPoolSize sizes[3] = {
+            {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxSets * 2},
+            {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, maxSets},
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxSets}};
+
+        VkDescriptorPoolCreateInfo pi{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+        pi.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+        pi.maxSets = maxSets;
+        pi.poolSizeCount = 3;
+        pi.pPoolSizes = sizes;
+        vkutil::vkCheck(vkCreateDescriptorPool(m_device, &pi, nullptr, &m_descriptorPool),
+                        "vkCreateDescriptorPool (virtual texture) failed");
+
+        // Pages carry their own border, so bilinear never reaches a neighbour
+        VkSamplerCreateInfo si{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+        si.magFilter = VK_FILTER_LINEAR;
+        si.minFilter = VK_FILTER_LINEAR;
+        si.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        si.addressModeU = si.addressModeV = si.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        vkutil::vkCheck(vkCreateSampler(m_device, &si, nullptr, &m_cacheSampler), "vkCreateSampler (page cache) failed");
+
+        si.magFilter = VK_FILTER_NEAREST;
+        si.minFilter = VK_FILTER_NEAREST;
+        si.maxLod = VK_LOD_CLAMP_NONE;
+        vkutil::vkCheck(vkCreateSampler(m_device, &si, nullptr, &m_pageTableSampler), "vkCreateSampler (page table) failed");
+
+        createCache();
+        m_slots.assign(kCachePages * kCachePages, Slot{});
+    }
+
+    void VirtualTextureSystem::Destroy()
+    {
+        if (!m_device)
+            return;
+
+        Engine::GetInstance().GetJobSystem().Wait(m_loadJobs);
+        m_loaded.clear();
+        m_loading.clear();
+        m_requests.clear();
+
+        // Textures still held by materials keep working as empty handles
+        for (auto &weak : m_textures)
+        {
+            if (auto texture = weak.lock())
+            {
+                release(*texture);
+                texture->m_system = nullptr;
+                texture->m_sets.clear();
+            }
+        }
+        m_textures.clear();
+        m_byPath.clear();
+
+        for (auto &retired : m_retired)
+            destroyRetired(retired);
+        m_retired.clear();
+
+        destroyFeedback();
+        for (auto &frame : m_frames)
+        {
+            if (frame.staging)
+            {
+                vkDestroyBuffer(m_device, frame.staging, nullptr);
+                vkFreeMemory(m_device, frame.stagingMemory, nullptr);
+            }
+        }
+        m_frames.clear();
+
+        if (m_cacheViewSrgb)
+            vkDestroyImageView(m_device, m_cacheViewSrgb, nullptr);
+        if (m_cacheViewUnorm)
+            vkDestroyImageView(m_device, m_cacheViewUnorm, nullptr);
+        if (m_cache)
+        {
+            vkDestroyImage(m_device, m_cache, nullptr);
+            vkFreeMemory(m_device, m_cacheMemory, nullptr);
+        }
+        if (m_cacheSampler)
+            vkDestroySampler(m_device, m_cacheSampler, nullptr);
+        if (m_pageTableSampler)
+            vkDestroySampler(m_device, m_pageTableSampler, nullptr);
+        if (m_descriptorPool)
+            vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
+        if (m_setLayout)
+            vkDestroyDescriptorSetLayout(m_device, m_setLayout, nullptr);
+
+        m_cacheViewSrgb = m_cacheViewUnorm = VK_NULL_HANDLE;
+        m_cache = VK_NULL_HANDLE;
+        m_cacheSampler = m_pageTableSampler = VK_NULL_HANDLE;
+        m_descriptorPool = VK_NULL_HANDLE;
+        m_setLayout = VK_NULL_HANDLE;
+        m_slots.clear();
+        m_pageSlots.clear();
+        m_device = VK_NULL_HANDLE;
+    }
+
+    void VirtualTextureSystem::createCache()
+    {
+        VkImageCreateInfo ci{VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+        ci.flags = VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT;
+        ci.imageType = VK_IMAGE_TYPE_2D;
+        ci.format = VK_FORMAT_R8G8B8A8_UNORM;
+        ci.extent = {kCacheSize, kCacheSize, 1};
+        ci.mipLevels = 1;
+        ci.arrayLayers = 1;
+        ci.samples = VK_SAMPLE_COUNT_1_BIT;
+        ci.tiling = VK_IMAGE_TILING_OPTIMAL;
+        ci.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        ci.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        vkutil::vkCheck(vkCreateImage(m_device, &ci, nullptr, &m_cache), "vkCreateImage (page cache) failed");
+
+        VkMemoryRequirements req{};
+        vkGetImageMemoryRequirements(m_device, m_cache, &req);
+        VkMemoryAllocateInfo ai{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+        ai.allocationSize = req.size;
+        ai.memoryTypeIndex = vkutil::FindMemoryType(m_gpu, req.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        vkutil::vkCheck(vkAllocateMemory(m_device, &ai, nullptr, &m_cacheMemory), "vkAllocateMemory (page cache) failed");
+        vkutil::vkCheck(vkBindImageMemory(m_device, m_cache, m_cacheMemory, 0), "vkBindImageMemory (page cache) failed");
+
+        m_cacheViewSrgb = vkutil::CreateImageView(m_device, m_cache, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1);
+        m_cacheViewUnorm = vkutil::CreateImageView(m_device, m_cache, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1);
+        m_cacheInitialized = false;
+    }
+
+    void VirtualTextureSystem::Resize(VkExtent2D extent)
+    {
+        if (!m_supported || !m_device)
+            return;
+
+        destroyFeedback();
+        m_feedbackExtent = {(extent.width + kFeedbackScale - 1) / kFeedbackScale,
+                            (extent.height + kFeedbackScale - 1) / kFeedbackScale};
+        createFeedback();
+
+        for (auto &weak : m_textures)
+            if (auto texture = weak.lock())
+                writeSets(*texture);
+    }
+
+    void VirtualTextureSystem::createFeedback()
+    {
+        const VkDeviceSize size = (VkDeviceSize)std::max(m_feedbackExtent.width * m_feedbackExtent.height, 1u) * sizeof(uint32_t);
+        for (auto &frame : m_frames)
+        {
+            vkutil::CreateBuffer(m_gpu, m_device, size,
+                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                 frame.feedback, frame.feedbackMemory);
+            void *mapped = nullptr;
+            vkutil::vkCheck(vkMapMemory(m_device, frame.feedbackMemory, 0, size, 0, &mapped), "vkMapMemory (feedback) failed");
+            frame.feedbackMapped = (const uint32_t *)mapped;
+            frame.feedbackWritten = false;
+        }
+    }
+
+    void VirtualTextureSystem::destroyFeedback()
+    {
+        for (auto &frame : m_frames)
+        {
+            if (frame.feedback)
+            {
+                vkDestroyBuffer(m_device, frame.feedback, nullptr);
+                vkFreeMemory(m_device, frame.feedbackMemory, nullptr);
+            }
+            frame.feedback = VK_NULL_HANDLE;
+            frame.feedbackMemory = VK_NULL_HANDLE;
+            frame.feedbackMapped = nullptr;
+            frame.feedbackWritten = false;
+        }
+    }
+
+    void VirtualTextureSystem::writeSets(VirtualTexture &texture)
+    {
+        for (uint32_t f = 0; f < (uint32_t)texture.m_sets.size(); ++f)
+        {
+            if (!m_frames[f].feedback)
+                continue;
+
+            VkDescriptorImageInfo images[2]{};
+            images[0] = {m_cacheSampler, texture.m_file->IsSrgb() ? m_cacheViewSrgb : m_cacheViewUnorm,
+                         VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+            images[1] = {m_pageTableSampler, texture.m_pageTableView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+            VkDescriptorBufferInfo params{texture.m_params, f * kParamsStride, sizeof(VirtualTextureParams)};
+            VkDescriptorBufferInfo feedback{m_frames[f].feedback, 0, VK_WHOLE_SIZE};
+
+            VkWriteDescriptorSet writes[4]{};
+            for (uint32_t i = 0; i < 4; ++i)
+            {
+                writes[i] = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+                writes[i].dstSet = texture.m_sets[f];
+                writes[i].dstBinding = i;
+                writes[i].descriptorCount = 1;
+            }
+            writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            writes[0].pImageInfo = &images[0];
+            writes[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            writes[1].pImageInfo = &images[1];
+            writes[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            writes[2].pBufferInfo = &params;
+            writes[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[3].pBufferInfo = &feedback;
+            vkUpdateDescriptorSets(m_device, 4, writes, 0, nullptr);
+        }
+    }
+
+    std::shared_ptr<VirtualTexture> VirtualTextureSystem::Load(const std::string &path)
+    {
+        if (!m_supported || !m_device)
+            return nullptr;
+
+        if (auto it = m_byPath.find(path); it != m_byPath.end())
+            if (auto texture = it->second.lock())
+                return texture;
+
+        uint32_t id = 0;
+        while (id < m_textures.size() && !m_textures[id].expired())
+            ++id;
+        if (id >= kMaxTextures)
+        {
+            SDL_Log("VirtualTextureSystem: more than %u virtual textures, %s not loaded", kMaxTextures, path.c_str());
+            return nullptr;
+        }
+
+        auto file = std::make_shared<VirtualTextureFile>();
+        const auto fullPath = Engine::GetInstance().GetFileSystem().GetAssetsFolder() / path;
+        if (!file->Open(fullPath))
+        {
+            SDL_Log("VirtualTextureSystem: cannot open %s", fullPath.string().c_str());
+            return nullptr;
+        }
+        if (file->GetLevelCount() > kMaxLevels || file->GetTilesX(0) > kMaxTiles || file->GetTilesY(0) > kMaxTiles)
+        {
+            SDL_Log("VirtualTextureSystem: %s is too large for page ids", path.c_str());
+            return nullptr;
+        }
+
+        auto texture = std::make_shared<VirtualTexture>();
+        texture->m_file = file;
+        texture->m_id = id;
+
+        const uint32_t levels = file->GetLevelCount();
+        uint32_t entries = 0;
+        for (uint32_t level = 0; level < levels; ++level)
+        {
+            texture->m_levelOffsets.push_back(entries);
+            entries += file->GetTilesX(level) * file->GetTilesY(level);
+        }
+        texture->m_entries.assign(entries, 0);
+
+        vkutil::CreateImage(m_gpu, m_device, file->GetTilesX(0), file->GetTilesY(0), levels, VK_FORMAT_R8G8B8A8_UINT,
+                            VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                            texture->m_pageTable, texture->m_pageTableMemory);
+        texture->m_pageTableView = vkutil::CreateImageView(m_device, texture->m_pageTable, VK_FORMAT_R8G8B8A8_UINT,
+                                                           VK_IMAGE_ASPECT_COLOR_BIT, 0, levels);
+
+        vkutil::CreateBuffer(m_gpu, m_device, kParamsStride * m_frames.size(), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                             texture->m_params, texture->m_paramsMemory);
+        vkutil::vkCheck(vkMapMemory(m_device, texture->m_paramsMemory, 0, VK_WHOLE_SIZE, 0, (void **)&texture->m_paramsMapped),
+                        "vkMapMemory (virtual texture) failed");
+
+        std::vector<VkDescriptorSetLayout> layouts(m_frames.size(), m_setLayout);
+        texture->m_sets.resize(m_frames.size());
+        VkDescriptorSetAllocateInfo ai{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+        ai.descriptorPool = m_descriptorPool;
+        ai.descriptorSetCount = (uint32_t)layouts.size();
+        ai.pSetLayouts = layouts.data();
+        vkutil::vkCheck(vkAllocateDescriptorSets(m_device, &ai, texture->m_sets.data()),
+                        "vkAllocateDescriptorSets (virtual texture) failed");
+
+        texture->m_system = this;
+        writeSets(*texture);
+
+        if (id == m_textures.size())
+            m_textures.emplace_back();
+        m_textures[id] = texture;
+        m_byPath[path] = texture;
+        return texture;
+    }
+
+    void VirtualTextureSystem::release(VirtualTexture &texture)
+    {
+        // Its cache pages are free at once, the copy barrier keeps reuse behind frames still sampling them
+        for (auto &slot : m_slots)
+        {
+            if (slot.page != UINT32_MAX && slot.page >> 24 == texture.m_id)
+            {
+                m_pageSlots.erase(slot.page);
+                slot = Slot{};
+            }
+        }
+        if (texture.m_id < m_textures.size())
+            m_textures[texture.m_id].reset();
+
+        Retired retired;
+        retired.image = texture.m_pageTable;
+        retired.imageMemory = texture.m_pageTableMemory;
+        retired.view = texture.m_pageTableView;
+        retired.params = texture.m_params;
+        retired.paramsMemory = texture.m_paramsMemory;
+        retired.sets = std::move(texture.m_sets);
+        retired.framesLeft = (uint32_t)m_frames.size() + 1;
+        m_retired.push_back(std::move(retired));
+
+        texture.m_pageTable = VK_NULL_HANDLE;
+        texture.m_pageTableMemory = VK_NULL_HANDLE;
+        texture.m_pageTableView = VK_NULL_HANDLE;
+        texture.m_params = VK_NULL_HANDLE;
+        texture.m_paramsMemory = VK_NULL_HANDLE;
+        texture.m_paramsMapped = nullptr;
+    }
+
+    void VirtualTextureSystem::destroyRetired(Retired &retired)
+    {
+        if (retired.view)
+            vkDestroyImageView(m_device, retired.view, nullptr);
+        if (retired.image)
+        {
+            vkDestroyImage(m_device, retired.image, nullptr);
+            vkFreeMemory(m_device, retired.imageMemory, nullptr);
+        }
+        if (retired.params)
+        {
+            vkDestroyBuffer(m_device, retired.params, nullptr);
+            vkFreeMemory(m_device, retired.paramsMemory, nullptr);
+        }
+        if (!retired.sets.empty())
+            vkFreeDescriptorSets(m_device, m_descriptorPool, (uint32_t)retired.sets.size(), retired.sets.data());
+    }
+
+    void VirtualTextureSystem::ensureStaging(FrameResources &frame, VkDeviceSize size)
+    {
+        if (frame.stagingSize >= size)
+            return;
+
+        if (frame.staging)
+        {
+            vkDestroyBuffer(m_device, frame.staging, nullptr);
+            vkFreeMemory(m_device, frame.stagingMemory, nullptr);
+        }
+
+        // Room for the page uploads of a frame plus the page tables
+        frame.stagingSize = std::max(size, kPageBytes * kMaxUploadsPerFrame + 64 * 1024);
+        vkutil::CreateBuffer(m_gpu, m_device, frame.stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                             frame.staging, frame.stagingMemory);
+        vkutil::vkCheck(vkMapMemory(m_device, frame.stagingMemory, 0, frame.stagingSize, 0, (void **)&frame.stagingMapped),
+                        "vkMapMemory (virtual texture staging) failed");
+    }
+
+    void VirtualTextureSystem::request(VirtualTexture &texture, uint32_t level, uint32_t x, uint32_t y)
+    {
+        const auto &file = *texture.m_file;
+        if (level >= file.GetLevelCount() || x >= file.GetTilesX(level) || y >= file.GetTilesY(level))
+            return;
+
+        // The coarser pages covering it are the fallback while it loads, keep them too
+        for (; level < file.GetLevelCount(); ++level, x >>= 1, y >>= 1)
+        {
+            const uint32_t page = PageId(texture.m_id, level, x, y);
+            if (auto it = m_pageSlots.find(page); it != m_pageSlots.end())
+                m_slots[it->second].lastUsed = m_frameCounter;
+            else if (!m_loading.count(page))
+                m_requests.push_back(page);
+        }
+    }
+
+    void VirtualTextureSystem::readFeedback(FrameResources &frame)
+    {
+        const size_t count = (size_t)m_feedbackExtent.width * m_feedbackExtent.height;
+        std::vector<uint32_t> pages(frame.feedbackMapped, frame.feedbackMapped + count);
+        std::sort(pages.begin(), pages.end());
+        pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+
+        m_requests.clear();
+        for (uint32_t page : pages)
+        {
+            const uint32_t id = page >> 24;
+            if (page == UINT32_MAX || id >= m_textures.size())
+                continue;
+            // Slots of a texture that was destroyed since are empty
+            if (auto texture = m_textures[id].lock())
+                request(*texture, page >> 20 & 0xF, page & 0x3FF, page >> 10 & 0x3FF);
+        }
+    }
+
+    void VirtualTextureSystem::startLoads()
+    {
+        auto levelOf = [](uint32_t page)
+        { return page >> 20 & 0xF; };
+        auto coarserFirst = [&](uint32_t a, uint32_t b)
+        { return levelOf(a) != levelOf(b) ? levelOf(a) > levelOf(b) : a < b; };
+        std::sort(m_requests.begin(), m_requests.end(), coarserFirst);
+        m_requests.erase(std::unique(m_requests.begin(), m_requests.end()), m_requests.end());
+
+        auto &jobs = Engine::GetInstance().GetJobSystem();
+        size_t next = 0;
+        while (next < m_requests.size() && m_loading.size() < kMaxLoadsInFlight)
+        {
+            const uint32_t page = m_requests[next++];
+            if (m_loading.count(page) || m_pageSlots.count(page))
+                continue;
+            auto texture = m_textures[page >> 24].lock();
+            if (!texture)
+                continue;
+
+            m_loading.insert(page);
+            std::weak_ptr<VirtualTexture> weak = texture;
+            auto load = [this, weak, file = texture->m_file, page]()
+            {
+                LoadedPage loaded;
+                loaded.texture = weak;
+                loaded.page = page;
+                loaded.ok = file->ReadTile(page >> 20 & 0xF, page & 0x3FF, page >> 10 & 0x3FF, loaded.rgba);
+
+                std::lock_guard lock(m_loadedMutex);
+                m_loaded.push_back(std::move(loaded));
+            };
+            jobs.Run(load, &m_loadJobs);
+        }
+        m_requests.erase(m_requests.begin(), m_requests.begin() + (std::ptrdiff_t)next);
+    }
+
+    uint32_t VirtualTextureSystem::allocateSlot()
+    {
+        uint32_t best = UINT32_MAX;
+        for (uint32_t i = 0; i < (uint32_t)m_slots.size(); ++i)
+        {
+            const auto &slot = m_slots[i];
+            if (slot.page == UINT32_MAX)
+                return i;
+            // Pages seen by the latest feedback stay
+            if (slot.pinned || slot.lastUsed >= m_frameCounter)
+                continue;
+            if (best == UINT32_MAX || slot.lastUsed < m_slots[best].lastUsed)
+                best = i;
+        }
+
+        if (best != UINT32_MAX)
+        {
+            const uint32_t page = m_slots[best].page;
+            if (auto texture = m_textures[page >> 24].lock())
+                texture->m_dirty = true;
+            m_pageSlots.erase(page);
+            m_slots[best] = Slot{};
+        }
+        return best;
+    }
+
+    // Every entry points at the page itself when it is resident, otherwise
+    // at what its parent entry points at
+    void VirtualTextureSystem::updatePageTable(VirtualTexture &texture)
+    {
+        const auto &file = *texture.m_file;
+        const uint32_t levels = file.GetLevelCount();
+        bool ready = true;
+
+        for (uint32_t level = levels; level-- > 0;)
+        {
+            const uint32_t tilesX = file.GetTilesX(level);
+            for (uint32_t y = 0; y < file.GetTilesY(level); ++y)
+            {
+                for (uint32_t x = 0; x < tilesX; ++x)
+                {
+                    uint32_t entry = 0;
+                    if (auto it = m_pageSlots.find(PageId(texture.m_id, level, x, y)); it != m_pageSlots.end())
+                        entry = it->second % kCachePages | (it->second / kCachePages) << 8 | level << 16 | 1u << 24;
+                    else if (level + 1 < levels)
+                        entry = texture.m_entries[texture.m_levelOffsets[level + 1] + (y >> 1) * file.GetTilesX(level + 1) + (x >> 1)];
+                    else
+                        ready = false;
+                    texture.m_entries[texture.m_levelOffsets[level] + y * tilesX + x] = entry;
+                }
+            }
+        }
+        texture.m_ready = ready;
+    }
+
+    void VirtualTextureSystem::BeginFrame(VkCommandBuffer cmd, uint32_t frame)
+    {
+        if (!m_supported || !m_device)
+            return;
+
+        m_frame = frame;
+        ++m_frameCounter;
+        auto &resources = m_frames[frame];
+
+        for (size_t i = 0; i < m_retired.size();)
+        {
+            if (--m_retired[i].framesLeft == 0)
+            {
+                destroyRetired(m_retired[i]);
+                m_retired[i] = std::move(m_retired.back());
+                m_retired.pop_back();
+            }
+            else
+                ++i;
+        }
+
+        // Held for the whole call so no texture is released halfway through
+        std::vector<std::shared_ptr<VirtualTexture>> live;
+        for (auto &weak : m_textures)
+            if (auto texture = weak.lock())
+                live.push_back(std::move(texture));
+
+        // Written MAX_FRAMES ago, the fence of this slot has signalled since
+        if (resources.feedbackWritten)
+            readFeedback(resources);
+
+        // The coarsest level is the last fallback and always resident
+        for (auto &texture : live)
+        {
+            const uint32_t top = texture->m_file->GetLevelCount() - 1;
+            for (uint32_t y = 0; y < texture->m_file->GetTilesY(top); ++y)
+                for (uint32_t x = 0; x < texture->m_file->GetTilesX(top); ++x)
+                    request(*texture, top, x, y);
+        }
+        startLoads();
+
+        std::vector<LoadedPage> loaded;
+        {
+            std::lock_guard lock(m_loadedMutex);
+            const size_t count = std::min<size_t>(m_loaded.size(), kMaxUploadsPerFrame);
+            loaded.assign(std::make_move_iterator(m_loaded.begin()), std::make_move_iterator(m_loaded.begin() + (std::ptrdiff_t)count));
+            m_loaded.erase(m_loaded.begin(), m_loaded.begin() + (std::ptrdiff_t)count);
+        }
+
+        struct PageUpload
+        {
+            const LoadedPage *page;
+            uint32_t slot;
+        };
+        std::vector<PageUpload> pageUploads;
+        for (const auto &page : loaded)
+        {
+            m_loading.erase(page.page);
+            auto texture = page.texture.lock();
+            if (!texture || !page.ok || m_pageSlots.count(page.page))
+                continue;
+
+            const uint32_t slot = allocateSlot();
+            if (slot == UINT32_MAX)
+                continue;
+
+            const uint32_t level = page.page >> 20 & 0xF;
+            m_slots[slot] = {page.page, m_frameCounter, level + 1 == texture->m_file->GetLevelCount()};
+            m_pageSlots[page.page] = slot;
+            texture->m_dirty = true;
+            pageUploads.push_back({&page, slot});
+        }
+
+        VkDeviceSize stagingSize = pageUploads.size() * kPageBytes;
+        for (auto &texture : live)
+        {
+            if (!texture->m_dirty)
+                continue;
+            updatePageTable(*texture);
+            stagingSize += texture->m_entries.size() * sizeof(uint32_t);
+        }
+        ensureStaging(resources, stagingSize);
+
+        if (!m_cacheInitialized)
+        {
+            ImageBarrier(cmd, m_cache, 1, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                         VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0);
+            m_cacheInitialized = true;
+        }
+
+        VkDeviceSize offset = 0;
+        if (!pageUploads.empty())
+        {
+            std::vector<VkBufferImageCopy> regions;
+            for (const auto &upload : pageUploads)
+            {
+                std::memcpy(resources.stagingMapped + offset, upload.page->rgba.data(), kPageBytes);
+
+                VkBufferImageCopy region{};
+                region.bufferOffset = offset;
+                region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+                region.imageOffset = {(int32_t)(upload.slot % kCachePages * VirtualTextureFile::kPageSize),
+                                      (int32_t)(upload.slot / kCachePages * VirtualTextureFile::kPageSize), 0};
+                region.imageExtent = {VirtualTextureFile::kPageSize, VirtualTextureFile::kPageSize, 1};
+                regions.push_back(region);
+                offset += kPageBytes;
+            }
+
+            // Earlier frames may still sample the pages being replaced
+            ImageBarrier(cmd, m_cache, 1, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+            vkCmdCopyBufferToImage(cmd, resources.staging, m_cache, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                   (uint32_t)regions.size(), regions.data());
+            ImageBarrier(cmd, m_cache, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+        }
+
+        const uint32_t jitter = (uint32_t)(m_frameCounter * 37 % (kFeedbackScale * kFeedbackScale));
+        for (auto &texture : live)
+        {
+            const auto &file = *texture->m_file;
+            const uint32_t levels = file.GetLevelCount();
+
+            if (texture->m_dirty)
+            {
+                std::memcpy(resources.stagingMapped + offset, texture->m_entries.data(), texture->m_entries.size() * sizeof(uint32_t));
+
+                std::vector<VkBufferImageCopy> regions(levels);
+                for (uint32_t level = 0; level < levels; ++level)
+                {
+                    regions[level] = {};
+                    regions[level].bufferOffset = offset + texture->m_levelOffsets[level] * sizeof(uint32_t);
+                    regions[level].imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+                    regions[level].imageExtent = {file.GetTilesX(level), file.GetTilesY(level), 1};
+                }
+                offset += texture->m_entries.size() * sizeof(uint32_t);
+
+                // The whole table is rewritten, the old contents can go
+                ImageBarrier(cmd, texture->m_pageTable, levels, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                             VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+                vkCmdCopyBufferToImage(cmd, resources.staging, texture->m_pageTable, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                       levels, regions.data());
+                ImageBarrier(cmd, texture->m_pageTable, levels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                             VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+                texture->m_dirty = false;
+            }
+
+            VirtualTextureParams params{};
+            params.info[0] = texture->m_id;
+            params.info[1] = levels;
+            params.info[2] = file.GetWidth();
+            params.info[3] = file.GetHeight();
+            params.feedback[0] = m_feedbackExtent.width;
+            params.feedback[1] = m_feedbackExtent.height;
+            params.feedback[2] = jitter % kFeedbackScale;
+            params.feedback[3] = jitter / kFeedbackScale;
+            params.cache[0] = (float)VirtualTextureFile::kPageSize;
+            params.cache[1] = (float)VirtualTextureFile::kTileBorder;
+            params.cache[2] = 1.f / (float)kCacheSize;
+            params.cache[3] = (float)VirtualTextureFile::kTileSize;
+            std::memcpy(texture->m_paramsMapped + frame * kParamsStride, &params, sizeof(params));
+        }
+
+        vkCmdFillBuffer(cmd, resources.feedback, 0, VK_WHOLE_SIZE, UINT32_MAX);
+
+        VkBufferMemoryBarrier cleared{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+        cleared.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        cleared.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        cleared.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        cleared.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        cleared.buffer = resources.feedback;
+        cleared.size = VK_WHOLE_SIZE;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                             0, 0, nullptr, 1, &cleared, 0, nullptr);
+        resources.feedbackWritten = true;
+    }
+
+    void VirtualTextureSystem::EndFrame(VkCommandBuffer cmd)
+    {
+        if (!m_supported || !m_device)
+            return;
+
+        VkBufferMemoryBarrier written{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+        written.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        written.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        written.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        written.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        written.buffer = m_frames[m_frame].feedback;
+        written.size = VK_WHOLE_SIZE;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                             0, 0, nullptr, 1, &written, 0, nullptr);
+    }
+}
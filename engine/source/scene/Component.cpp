@@ -1,5 +1,8 @@
 #include "scene/Component.h"
 
+#include "scene/GameObject.h"
+#include "scene/Scene.h"
+
 namespace eng
 {
     size_t Component::nextId = 1;
@@ -9,4 +12,65 @@ namespace eng
         return m_owner;
     }
 
-}
\ No newline at end of file
+    void Component::SetTickEnabled(bool enabled)
+    {
+        if (m_tickEnabled == enabled)
+            return;
+
+        m_tickEnabled = enabled;
+        RefreshTick();
+    }
+
+    bool Component::IsTickEnabled() const
+    {
+        return m_tickEnabled;
+    }
+
+    void Component::SetTickInterval(uint32_t frames)
+    {
+        m_tickIntervalFrames = frames > 0 ? frames : 1;
+    }
+
+    void Component::SetTickRate(float hz)
+    {
+        m_tickIntervalSeconds = hz > 0.f ? 1.f / hz : 0.f;
+    }
+
+    void Component::Sleep()
+    {
+        if (m_sleeping)
+            return;
+
+        m_sleeping = true;
+        RefreshTick();
+    }
+
+    void Component::Wake()
+    {
+        if (!m_sleeping)
+            return;
+
+        m_sleeping = false;
+        RefreshTick();
+    }
+
+    bool Component::IsSleeping() const
+    {
+        return m_sleeping;
+    }
+
+    bool Component::WantsTick() const
+    {
+        return m_tickEnabled && !m_sleeping;
+    }
+
+    void Component::RefreshTick()
+    {
+        // Not attached yet: GameObject::AddComponent registers it
+        if (!m_owner || !m_owner->GetScene())
+            return;
+
+        m_owner->GetScene()->RefreshTick(this);
+    }
+
+}
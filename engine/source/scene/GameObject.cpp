@@ -12,32 +12,46 @@
 #include "graphics/VertexLayout.h"
 #include "render/Material.h"
 #include "render/Mesh.h"
+#include "render/MeshOptimizer.h"
+#include "render/MeshSimplifier.h"
 #include "scene/components/MeshComponent.h"
 
 namespace eng
 {
 
+    GameObject::~GameObject()
+    {
+        if (m_scene)
+        {
+            m_scene->UnregisterTicks(this);
+        }
+    }
+
     void GameObject::Update(float DeltaTime)
     {
-        for (auto &component : m_components)
+        // Called by Scene once per frame before the TickPhase::Update
+        // components. Children and components are ticked by the Scene itself.
+    }
+
+    void GameObject::SetTickEnabled(bool enabled)
+    {
+        if (m_tickEnabled == enabled)
         {
-            component->Update(DeltaTime);
+            return;
         }
 
-        for (auto it = m_children.begin(); it != m_children.end();)
+        m_tickEnabled = enabled;
+        if (m_scene)
         {
-            if ((*it)->IsAlive())
-            {
-                (*it)->Update(DeltaTime);
-                ++it;
-            }
-            else
-            {
-                it = m_children.erase(it);
-            }
+            m_scene->RefreshTick(this);
         }
     }
 
+    bool GameObject::IsTickEnabled() const
+    {
+        return m_tickEnabled;
+    }
+
     const std::string &GameObject::GetName() const
     {
         return m_name;
@@ -75,6 +89,12 @@ namespace eng
 
     void GameObject::MarkForDestroy()
     {
+        if (m_scene)
+        {
+            m_scene->DestroyObject(this);
+            return;
+        }
+
         m_isAlive = false;
     }
 
@@ -82,6 +102,14 @@ namespace eng
     {
         m_components.emplace_back(component);
         component->m_owner = this;
+
+        // New components get their initial OnTransformChanged at the next resolve
+        MarkTransformDirty();
+
+        if (m_scene)
+        {
+            m_scene->RefreshTick(component);
+        }
     }
 
     const glm::vec3 &GameObject::GetPosition() const
@@ -98,6 +126,7 @@ namespace eng
     void GameObject::SetPosition(const glm::vec3 &pos)
     {
         m_position = pos;
+        MarkTransformDirty();
     }
 
     const glm::quat &GameObject::GetRotation() const
@@ -108,6 +137,7 @@ namespace eng
     void GameObject::SetRotation(const glm::quat &rot)
     {
         m_rotation = rot;
+        MarkTransformDirty();
     }
 
     const glm::vec3 &GameObject::GetScale() const
@@ -118,6 +148,7 @@ namespace eng
     void GameObject::SetScale(const glm::vec3 &scale)
     {
         m_scale = scale;
+        MarkTransformDirty();
     }
 
     glm::mat4 GameObject::GetLocalTransform() const
@@ -138,6 +169,11 @@ namespace eng
 
     glm::mat4 GameObject::GetWorldTransform() const
     {
+        if (!IsTransformDirty())
+        {
+            return m_worldTransform;
+        }
+
         if (m_parent)
         {
             return m_parent->GetWorldTransform() * GetLocalTransform();
@@ -148,6 +184,46 @@ namespace eng
         }
     }
 
+    void GameObject::SetStatic(bool isStatic)
+    {
+        m_static = isStatic;
+    }
+
+    bool GameObject::IsStatic() const
+    {
+        for (auto obj = this; obj; obj = obj->m_parent)
+        {
+            if (obj->m_static)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool GameObject::IsTransformDirty() const
+    {
+        for (auto obj = this; obj; obj = obj->m_parent)
+        {
+            if (obj->m_transformDirty.load(std::memory_order_relaxed))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void GameObject::MarkTransformDirty()
+    {
+        // Children are not flagged: IsTransformDirty walks up, and Scene
+        // resolves the whole subtree of every queued object.
+        if (!m_transformDirty.exchange(true, std::memory_order_relaxed) && m_scene)
+        {
+            m_scene->QueueTransformUpdate(this);
+        }
+    }
+
     // ---- helpers ----
 
     static VertexLayout MakeDefaultLayout_PosColUvNrm()
@@ -218,7 +294,7 @@ namespace eng
         if (auto it = cache.find(key); it != cache.end())
             return it->second;
 
-        auto tex = Engine::GetInstance().GetTextureManager().GetOrLoadTexture(key);
+        auto tex = Engine::GetInstance().GetTextureManager().GetOrLoadTextureAsync(key);
 
         cache[key] = tex;
         return tex;
@@ -348,7 +424,33 @@ namespace eng
                 indices[i] = (uint32_t)i;
         }
 
-        return std::make_shared<Mesh>(layout, vertices, indices);
+        // The optimizer, meshlet and LOD passes index per-vertex tables without checks
+        const size_t dropped = RemoveInvalidTriangles(indices, (size_t)vcount);
+        if (dropped > 0)
+            SDL_Log("glTF mesh: dropped %zu malformed triangles", dropped);
+        if (indices.empty())
+            return nullptr;
+
+        const MeshOptimizeReport report = OptimizeMesh(layout, vertices, indices);
+        SDL_Log("glTF mesh: %zu -> %zu vertices, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f",
+                report.vertexCountBefore, report.vertexCountAfter,
+                report.before.acmr, report.after.acmr, report.before.atvr, report.after.atvr);
+
+        // Large meshes are drawn per cluster so only their visible parts rasterize
+        std::vector<Meshlet> meshlets;
+        if (indices.size() / 3 >= 4 * Mesh::kMeshletMaxTriangles)
+        {
+            BuildMeshlets(indices, vertices.data(), floatsPerVertex, vertices.size() / floatsPerVertex,
+                          meshlets, Mesh::kMeshletMaxVertices, Mesh::kMeshletMaxTriangles);
+            SDL_Log("glTF mesh: %zu meshlets", meshlets.size());
+        }
+
+        // Distant copies draw coarser index ranges over the same vertices
+        std::vector<uint32_t> lodIndices;
+        std::vector<MeshLod> lods;
+        BuildLodChain(layout, vertices, indices, lodIndices, lods);
+
+        return std::make_shared<Mesh>(layout, vertices, lodIndices, lods, meshlets);
     }
 
     static void ParseGLTFNode(
@@ -1,31 +1,262 @@
 #include "scene/Scene.h"
 
-#include "scene/components/LightComponent.h"
+#include "Engine.h"
+#include "render/Mesh.h"
+#include "scene/components/MeshComponent.h"
 
 #include <algorithm>
 
 namespace eng
 {
+    // Components per ParallelFor chunk
+    static constexpr size_t kComponentGrain = 64;
+
+    void Scene::TickComponent(Component *component, float DeltaTime)
+    {
+        component->m_tickAccumulator += DeltaTime;
+
+        if (component->m_tickCountdown > 1)
+        {
+            --component->m_tickCountdown;
+            return;
+        }
+
+        if (component->m_tickAccumulator < component->m_tickIntervalSeconds)
+            return;
+
+        const float elapsed = component->m_tickAccumulator;
+        component->m_tickAccumulator = 0.f;
+        component->m_tickCountdown = component->m_tickIntervalFrames;
+        component->Update(elapsed);
+    }
+
+    Scene::Scene()
+    {
+        const uint32_t threadCount = std::max(1u, Engine::GetInstance().GetJobSystem().GetThreadCount());
+        m_commandBuckets.resize(threadCount);
+        m_transformBuckets.resize(threadCount);
+    }
+
+    Scene::~Scene()
+    {
+        Clear();
+    }
 
     void Scene::Update(float DeltaTime)
     {
-        for (auto it = m_objects.begin(); it != m_objects.end();)
+        // Changes made between frames (e.g. Application::Init)
+        FlushChanges();
+
+        m_updating = true;
+
+        for (size_t i = 0; i < kPhaseCount; ++i)
         {
-            if ((*it)->IsAlive())
+            const auto phase = static_cast<TickPhase>(i);
+
+            if (phase == TickPhase::Update)
             {
-                (*it)->Update(DeltaTime);
-                ++it;
+                for (auto obj : m_tickObjects)
+                    obj->Update(DeltaTime);
             }
-            else
+            else if (phase == TickPhase::RenderExtract)
             {
-                it = m_objects.erase(it);
+                UpdateTransforms();
             }
+
+            RunPhase(phase, DeltaTime);
+
+            // Batched objects have no component ticking for them
+            if (phase == TickPhase::RenderExtract)
+                m_staticBatcher.UpdateLods(DeltaTime, GetMainCamera());
+        }
+
+        m_updating = false;
+
+        ApplyCommands();
+        FlushChanges();
+    }
+
+    void Scene::FlushChanges()
+    {
+        // Resolve before sweeping, the queues may point at destroyed objects
+        UpdateTransforms();
+
+        if (m_needsSweep)
+        {
+            SweepDestroyed(m_objects);
+            m_needsSweep = false;
+        }
+    }
+
+    void Scene::QueueTransformUpdate(GameObject *obj)
+    {
+        m_transformBuckets[JobSystem::GetThreadIndex()].push_back(obj);
+    }
+
+    void Scene::ForceTransformUpdate(GameObject *obj)
+    {
+        obj->m_transformDirty.store(true, std::memory_order_relaxed);
+        QueueTransformUpdate(obj);
+    }
+
+    void Scene::UpdateTransforms()
+    {
+        for (auto &bucket : m_transformBuckets)
+        {
+            for (auto obj : bucket)
+            {
+                // Already resolved through an ancestor
+                if (!obj->m_transformDirty.load(std::memory_order_relaxed))
+                    continue;
+
+                // A dirty ancestor is queued as well and will resolve this subtree
+                if (obj->m_parent && obj->m_parent->IsTransformDirty())
+                    continue;
+
+                const glm::mat4 parentWorld = obj->m_parent ? obj->m_parent->m_worldTransform : glm::mat4(1.f);
+                UpdateTransformRecursive(obj, parentWorld);
+            }
+
+            bucket.clear();
+        }
+    }
+
+    void Scene::UpdateTransformRecursive(GameObject *obj, const glm::mat4 &parentWorld)
+    {
+        obj->m_worldTransform = parentWorld * obj->GetLocalTransform();
+        obj->m_transformDirty.store(false, std::memory_order_relaxed);
+
+        for (auto &component : obj->m_components)
+            component->OnTransformChanged();
+
+        for (auto &child : obj->m_children)
+            UpdateTransformRecursive(child.get(), obj->m_worldTransform);
+    }
+
+    void Scene::RunPhase(TickPhase phase, float DeltaTime)
+    {
+        const size_t index = static_cast<size_t>(phase);
+
+        for (auto component : m_serialComponents[index])
+            TickComponent(component, DeltaTime);
+
+        auto &parallel = m_parallelComponents[index];
+        if (parallel.empty())
+            return;
+
+        auto &jobs = Engine::GetInstance().GetJobSystem();
+        jobs.ParallelFor(parallel.size(), kComponentGrain, [&parallel, DeltaTime](size_t begin, size_t end)
+                         {
+                             for (size_t i = begin; i < end; ++i)
+                                 TickComponent(parallel[i], DeltaTime); });
+    }
+
+    std::vector<Component *> &Scene::GetTickList(Component *component)
+    {
+        const size_t phase = static_cast<size_t>(component->GetTickPhase());
+        return component->IsParallelSafe() ? m_parallelComponents[phase] : m_serialComponents[phase];
+    }
+
+    void Scene::RefreshTick(Component *component)
+    {
+        if (m_updating)
+        {
+            RecordCommand(CommandType::RefreshTick, nullptr, nullptr, component);
+            return;
+        }
+
+        ApplyTick(component);
+    }
+
+    void Scene::RefreshTick(GameObject *obj)
+    {
+        if (m_updating)
+        {
+            RecordCommand(CommandType::RefreshTick, obj, nullptr);
+            return;
+        }
+
+        ApplyTick(obj);
+    }
+
+    void Scene::RefreshTicks(GameObject *obj)
+    {
+        RefreshTick(obj);
+        for (auto &component : obj->m_components)
+            RefreshTick(component.get());
+    }
+
+    void Scene::ApplyTick(Component *component)
+    {
+        const bool wanted = component->WantsTick() && component->m_owner && component->m_owner->IsAlive();
+        const bool registered = component->m_tickIndex >= 0;
+
+        if (wanted == registered)
+            return;
+
+        auto &list = GetTickList(component);
+        if (wanted)
+        {
+            component->m_tickIndex = (int32_t)list.size();
+            // Spread components with the same interval over different frames
+            component->m_tickCountdown = 1 + (uint32_t)list.size() % component->m_tickIntervalFrames;
+            component->m_tickAccumulator = 0.f;
+            list.push_back(component);
+        }
+        else
+        {
+            const size_t index = (size_t)component->m_tickIndex;
+            list[index] = list.back();
+            list[index]->m_tickIndex = (int32_t)index;
+            list.pop_back();
+            component->m_tickIndex = -1;
+        }
+    }
+
+    void Scene::ApplyTick(GameObject *obj)
+    {
+        const bool wanted = obj->m_tickEnabled && obj->IsAlive();
+        const bool registered = obj->m_tickIndex >= 0;
+
+        if (wanted == registered)
+            return;
+
+        if (wanted)
+        {
+            obj->m_tickIndex = (int32_t)m_tickObjects.size();
+            m_tickObjects.push_back(obj);
+        }
+        else
+        {
+            const size_t index = (size_t)obj->m_tickIndex;
+            m_tickObjects[index] = m_tickObjects.back();
+            m_tickObjects[index]->m_tickIndex = (int32_t)index;
+            m_tickObjects.pop_back();
+            obj->m_tickIndex = -1;
         }
     }
 
+    void Scene::UnregisterTicks(GameObject *obj)
+    {
+        // Called from ~GameObject, never while the tick lists are iterated
+        obj->m_isAlive = false;
+        ApplyTick(obj);
+        for (auto &component : obj->m_components)
+            ApplyTick(component.get());
+    }
+
     void Scene::Clear()
     {
+        m_staticBatcher.Clear();
         m_objects.clear();
+        for (auto &bucket : m_transformBuckets)
+            bucket.clear();
+        m_tickObjects.clear();
+        for (size_t i = 0; i < kPhaseCount; ++i)
+        {
+            m_serialComponents[i].clear();
+            m_parallelComponents[i].clear();
+        }
     }
 
     GameObject *Scene::CreateObject(const std::string &name, GameObject *parent)
@@ -33,11 +264,205 @@ namespace eng
         auto obj = new GameObject();
         obj->SetName(name);
         obj->m_scene = this;
-        SetParent(obj, parent);
+        AddObject(obj, parent);
         return obj;
     }
 
+    void Scene::CollectMeshes(GameObject *obj, bool staticOnly, std::vector<MeshComponent *> &out)
+    {
+        if (!obj->IsAlive())
+            return;
+
+        if (!staticOnly || obj->IsStatic())
+        {
+            for (auto &component : obj->m_components)
+            {
+                if (component->GetTypeId() == MeshComponent::TypeId())
+                    out.push_back(static_cast<MeshComponent *>(component.get()));
+            }
+        }
+
+        for (auto &child : obj->m_children)
+            CollectMeshes(child.get(), staticOnly, out);
+    }
+
+    void Scene::BuildStaticBatches()
+    {
+        if (m_updating)
+        {
+            SDL_Log("Scene::BuildStaticBatches ignored: called during Update");
+            return;
+        }
+
+        // Batches are built from resolved world transforms
+        FlushChanges();
+
+        std::vector<MeshComponent *> meshes;
+        for (auto &obj : m_objects)
+            CollectMeshes(obj.get(), true, meshes);
+
+        m_staticBatcher.Build(meshes);
+
+        // Occluders are rasterized from the copy every frame, imposter bakes
+        // may still be queued behind a texture
+        meshes.clear();
+        for (auto &obj : m_objects)
+            CollectMeshes(obj.get(), false, meshes);
+
+        std::vector<const Mesh *> keep;
+        for (auto *component : meshes)
+        {
+            if (component->IsOccluder() || component->GetImposterDistance() > 0.f)
+                keep.push_back(component->GetMesh().get());
+        }
+        std::sort(keep.begin(), keep.end());
+
+        size_t released = 0;
+        for (auto *component : meshes)
+        {
+            Mesh *mesh = component->GetMesh().get();
+            if (!mesh || mesh->GetVertices().empty() || std::binary_search(keep.begin(), keep.end(), mesh))
+                continue;
+
+            mesh->ReleaseCpuData();
+            ++released;
+        }
+        SDL_Log("Scene: released the CPU copies of %zu meshes", released);
+    }
+
+    bool Scene::IsUpdating() const
+    {
+        return m_updating;
+    }
+
+    void Scene::AddObject(GameObject *obj, GameObject *parent)
+    {
+        if (!m_updating)
+        {
+            ApplySetParent(obj, parent);
+            ForceTransformUpdate(obj);
+            RefreshTicks(obj);
+            return;
+        }
+
+        // Not in the tree until the sync point, but world transforms
+        // should already resolve against the requested parent.
+        obj->m_parent = parent;
+        RecordCommand(CommandType::Create, obj, parent);
+        ForceTransformUpdate(obj);
+        RefreshTicks(obj);
+    }
+
     bool Scene::SetParent(GameObject *obj, GameObject *parent)
+    {
+        if (!m_updating)
+        {
+            const bool result = ApplySetParent(obj, parent);
+            if (result)
+                ForceTransformUpdate(obj);
+            return result;
+        }
+
+        RecordCommand(CommandType::SetParent, obj, parent);
+        return true;
+    }
+
+    void Scene::DestroyObject(GameObject *obj)
+    {
+        if (!m_updating)
+        {
+            obj->m_isAlive = false;
+            m_needsSweep = true;
+            return;
+        }
+
+        RecordCommand(CommandType::Destroy, obj, nullptr);
+    }
+
+    void Scene::RecordCommand(CommandType type, GameObject *obj, GameObject *parent, Component *component)
+    {
+        SceneCommand command;
+        command.type = type;
+        command.sequence = m_commandSequence.fetch_add(1, std::memory_order_relaxed);
+        command.object = obj;
+        command.parent = parent;
+        command.component = component;
+
+        m_commandBuckets[JobSystem::GetThreadIndex()].push_back(command);
+    }
+
+    void Scene::ApplyCommands()
+    {
+        m_pendingCommands.clear();
+        for (auto &bucket : m_commandBuckets)
+        {
+            m_pendingCommands.insert(m_pendingCommands.end(), bucket.begin(), bucket.end());
+            bucket.clear();
+        }
+
+        if (m_pendingCommands.empty())
+            return;
+
+        std::sort(m_pendingCommands.begin(), m_pendingCommands.end(),
+                  [](const SceneCommand &a, const SceneCommand &b)
+                  {
+                      if (a.type != b.type)
+                          return a.type < b.type;
+                      return a.sequence < b.sequence;
+                  });
+
+        bool anyDestroyed = false;
+        for (auto &command : m_pendingCommands)
+        {
+            switch (command.type)
+            {
+            case CommandType::Create:
+                // Pending objects are not in any container yet
+                command.object->m_parent = nullptr;
+                ApplySetParent(command.object, command.parent);
+                ForceTransformUpdate(command.object);
+                break;
+            case CommandType::SetParent:
+                if (ApplySetParent(command.object, command.parent))
+                    ForceTransformUpdate(command.object);
+                break;
+            case CommandType::RefreshTick:
+                if (command.component)
+                    ApplyTick(command.component);
+                else
+                    ApplyTick(command.object);
+                break;
+            case CommandType::Destroy:
+                // Only flag here: a destroyed ancestor would free the subtree
+                // while later commands still point into it.
+                command.object->m_isAlive = false;
+                anyDestroyed = true;
+                break;
+            }
+        }
+
+        m_pendingCommands.clear();
+
+        if (anyDestroyed)
+            m_needsSweep = true;
+    }
+
+    void Scene::SweepDestroyed(std::vector<std::unique_ptr<GameObject>> &objects)
+    {
+        for (auto it = objects.begin(); it != objects.end();)
+        {
+            if (!(*it)->IsAlive())
+            {
+                it = objects.erase(it);
+                continue;
+            }
+
+            SweepDestroyed((*it)->m_children);
+            ++it;
+        }
+    }
+
+    bool Scene::ApplySetParent(GameObject *obj, GameObject *parent)
     {
         bool result = false;
         auto currentParent = obj->GetParent();
@@ -178,31 +603,24 @@ namespace eng
         return m_mainCamera;
     }
 
-    std::vector<LightData> Scene::CollectLights()
+    std::span<const LightData> Scene::GetLights() const
     {
-        std::vector<LightData> lights;
-        for (auto &obj : m_objects)
-        {
-            CollectLightsRecursive(obj.get(), lights);
-        }
+        return m_lights.GetItems();
+    }
 
-        return lights;
+    Scene::LightHandle Scene::AddLight(const LightData &light)
+    {
+        return m_lights.Add(light);
     }
 
-    void Scene::CollectLightsRecursive(GameObject *obj, std::vector<LightData> &out)
+    void Scene::UpdateLight(LightHandle handle, const LightData &light)
     {
-        if (auto light = obj->GetComponent<LightComponent>())
-        {
-            LightData data;
-            data.color = light->GetColor();
-            data.position = obj->GetWordPosition();
-            out.push_back(data);
-        }
+        m_lights.Get(handle) = light;
+    }
 
-        for (auto &child : obj->m_children)
-        {
-            CollectLightsRecursive(child.get(), out);
-        }
+    void Scene::RemoveLight(LightHandle handle)
+    {
+        m_lights.Remove(handle);
     }
 
 }
\ No newline at end of file
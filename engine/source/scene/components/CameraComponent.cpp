@@ -7,10 +7,6 @@
 namespace eng
 {
 
-    void CameraComponent::Update(float DeltaTime)
-    {
-    }
-
     glm::mat4 CameraComponent::GetViewMatrix() const
     {
         glm::mat4 mat = glm::mat4(1.f);
@@ -31,4 +27,19 @@ namespace eng
         return glm::perspective(glm::radians(m_fov), aspect, m_nearPlane, m_farPlane);
     }
 
+    float CameraComponent::GetFov() const
+    {
+        return m_fov;
+    }
+
+    float CameraComponent::GetNearPlane() const
+    {
+        return m_nearPlane;
+    }
+
+    float CameraComponent::GetFarPlane() const
+    {
+        return m_farPlane;
+    }
+
 }
\ No newline at end of file
@@ -1,19 +1,86 @@
 #include "scene/components/LightComponent.h"
 
+#include "scene/GameObject.h"
+
 namespace eng
 {
 
-    void LightComponent::Update(float DeltaTime)
+    LightComponent::~LightComponent()
     {
+        if (m_scene)
+        {
+            m_scene->RemoveLight(m_light);
+        }
     }
 
     void LightComponent::SetColor(const glm::vec3 &color)
     {
         m_color = color;
+
+        if (m_scene)
+        {
+            SyncLight();
+        }
     }
 
     const glm::vec3 &LightComponent::GetColor() const
     {
         return m_color;
     }
+
+    void LightComponent::SetRadius(float radius)
+    {
+        m_radius = radius;
+
+        if (m_scene)
+        {
+            SyncLight();
+        }
+    }
+
+    float LightComponent::GetRadius() const
+    {
+        return m_radius;
+    }
+
+    void LightComponent::SetIntensity(float intensity)
+    {
+        m_intensity = intensity;
+
+        if (m_scene)
+        {
+            SyncLight();
+        }
+    }
+
+    float LightComponent::GetIntensity() const
+    {
+        return m_intensity;
+    }
+
+    void LightComponent::OnTransformChanged()
+    {
+        SyncLight();
+    }
+
+    void LightComponent::SyncLight()
+    {
+        LightData data;
+        data.color = m_color;
+        data.position = m_owner->GetWordPosition();
+        data.radius = m_radius;
+        data.intensity = m_intensity;
+
+        if (!m_scene)
+        {
+            m_scene = m_owner->GetScene();
+            if (m_scene)
+            {
+                m_light = m_scene->AddLight(data);
+            }
+            return;
+        }
+
+        m_scene->UpdateLight(m_light, data);
+    }
 }
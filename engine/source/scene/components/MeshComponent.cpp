@@ -2,10 +2,21 @@
 
 #include "render/Material.h"
 #include "render/Mesh.h"
-#include "render/RenderQueue.h"
+#include "render/StaticBatcher.h"
 #include "scene/GameObject.h"
+#include "scene/Scene.h"
+#include "scene/components/CameraComponent.h"
 #include "Engine.h"
 
+#include <SDL3/SDL.h>
+
+#include <glm/geometric.hpp>
+#include <glm/trigonometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 namespace eng
 {
 
@@ -13,22 +24,165 @@ namespace eng
         : m_material(material),
           m_mesh(mesh)
     {
+        if (m_mesh && m_mesh->GetLodCount() > 1)
+        {
+            SetTickRate(kLodTickRate);
+            SetTickEnabled(true);
+        }
+    }
+
+    MeshComponent::~MeshComponent()
+    {
+        if (m_batcher)
+        {
+            m_batcher->Remove(this);
+        }
+
+        if (m_proxy != RenderScene::kInvalidProxy)
+        {
+            Engine::GetInstance().GetRenderScene().RemoveProxy(m_proxy);
+        }
+    }
+
+    void MeshComponent::SetBatched(StaticBatcher *batcher)
+    {
+        m_batcher = batcher;
+
+        if (m_batcher && m_proxy != RenderScene::kInvalidProxy)
+        {
+            Engine::GetInstance().GetRenderScene().RemoveProxy(m_proxy);
+            m_proxy = RenderScene::kInvalidProxy;
+        }
+        else if (!m_batcher)
+        {
+            OnTransformChanged();
+        }
+    }
+
+    void MeshComponent::SetOccluder(bool occluder)
+    {
+        m_occluder = occluder;
+
+        if (m_proxy != RenderScene::kInvalidProxy)
+        {
+            Engine::GetInstance().GetRenderScene().SetOccluder(m_proxy, m_occluder);
+        }
     }
 
-    void eng::MeshComponent::Update(float DeltaTime)
+    void MeshComponent::SetImposterDistance(float distance)
+    {
+        m_imposterDistance = std::max(distance, 0.f);
+
+        if (m_imposterDistance == 0.f && m_imposter)
+        {
+            m_imposter = nullptr;
+            if (m_proxy != RenderScene::kInvalidProxy)
+                Engine::GetInstance().GetRenderScene().SetImposter(m_proxy, nullptr);
+        }
+
+        // Bake now rather than when the camera first moves away
+        if (m_imposterDistance > 0.f)
+            Engine::GetInstance().GetVulkanContext().GetImposterRenderer().GetOrBake(m_mesh, m_material);
+
+        const bool tick = m_imposterDistance > 0.f || (m_mesh && m_mesh->GetLodCount() > 1);
+        SetTickRate(kLodTickRate);
+        SetTickEnabled(tick);
+    }
+
+    void MeshComponent::OnTransformChanged()
     {
         if (!m_material || !m_mesh)
         {
             return;
         }
 
-        RenderCommand command;
-        command.material = m_material.get();
-        command.mesh = m_mesh.get();
-        command.modelMatrix = GetOwner()->GetWorldTransform();
+        if (m_batcher)
+        {
+            SDL_Log("MeshComponent: static object '%s' moved after batching, drawn on its own again",
+                    GetOwner()->GetName().c_str());
+            m_batcher->Remove(this);
+            m_batcher = nullptr;
+        }
+
+        auto &renderScene = Engine::GetInstance().GetRenderScene();
+        const glm::mat4 world = GetOwner()->GetWorldTransform();
+
+        if (m_proxy == RenderScene::kInvalidProxy)
+        {
+            m_proxy = renderScene.AddProxy(m_mesh.get(), m_material.get(), world);
+            if (m_occluder)
+                renderScene.SetOccluder(m_proxy, true);
+            if (m_lod != 0)
+                renderScene.SetLod(m_proxy, m_lod);
+            if (m_imposter)
+                renderScene.SetImposter(m_proxy, m_imposter);
+        }
+        else
+        {
+            renderScene.UpdateTransform(m_proxy, world);
+        }
+    }
+
+    void MeshComponent::Update(float deltaTime)
+    {
+        if (m_proxy == RenderScene::kInvalidProxy || (m_mesh->GetLodCount() < 2 && m_imposterDistance == 0.f))
+            return;
 
-        auto &renderQueue = Engine::GetInstance().GetRenderQueue();
-        renderQueue.Submit(command);
+        GameObject *cameraObject = GetOwner()->GetScene()->GetMainCamera();
+        auto *camera = cameraObject ? cameraObject->GetComponent<CameraComponent>() : nullptr;
+        if (!camera)
+            return;
+
+        const glm::mat4 world = GetOwner()->GetWorldTransform();
+        const AABB &bounds = m_mesh->GetBounds();
+        const float scale = std::max(glm::length(glm::vec3(world[0])),
+                                     std::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+
+        const glm::vec3 center = glm::vec3(world * glm::vec4((bounds.min + bounds.max) * 0.5f, 1.f));
+        const float radius = glm::length(bounds.max - bounds.min) * 0.5f * scale;
+        const float distance = glm::length(center - cameraObject->GetWordPosition());
+
+        // Bounding sphere radius over the half height of the view at that distance
+        const float tanHalfFov = std::tan(glm::radians(camera->GetFov()) * 0.5f);
+        const float screenSize = distance > radius ? radius / (distance * tanHalfFov) : std::numeric_limits<float>::max();
+
+        auto &renderScene = Engine::GetInstance().GetRenderScene();
+
+        const uint32_t lod = SelectLod(screenSize);
+        if (lod != m_lod)
+        {
+            m_lod = lod;
+            renderScene.SetLod(m_proxy, m_lod);
+        }
+
+        if (m_imposterDistance > 0.f)
+        {
+            const float threshold = m_imposter ? m_imposterDistance * kLodHysteresis : m_imposterDistance;
+            const bool far = distance > threshold;
+            if (far != (m_imposter != nullptr))
+            {
+                // Geometry until the atlas exists, meshes that cannot be baked keep it
+                const Imposter *imposter = far ? Engine::GetInstance().GetVulkanContext().GetImposterRenderer().Get(m_mesh, m_material)
+                                               : nullptr;
+                if (imposter != m_imposter)
+                {
+                    m_imposter = imposter;
+                    renderScene.SetImposter(m_proxy, m_imposter);
+                }
+            }
+        }
+    }
+
+    uint32_t MeshComponent::SelectLod(float screenSize) const
+    {
+        // Errors grow with the level, take the coarsest one that still passes
+        for (uint32_t lod = m_mesh->GetLodCount() - 1; lod > 0; --lod)
+        {
+            const float threshold = lod > m_lod ? kLodErrorThreshold * kLodHysteresis : kLodErrorThreshold;
+            if (m_mesh->GetLod(lod).error * screenSize < threshold)
+                return lod;
+        }
+        return 0;
     }
 
-}
\ No newline at end of file
+}
@@ -9,6 +9,11 @@
 
 namespace eng
 {
+    PlayerControllerComponent::PlayerControllerComponent()
+    {
+        SetTickEnabled(true);
+    }
+
     void PlayerControllerComponent::Update(float DeltaTime)
     {
         auto &input = Engine::GetInstance().GetInputManager();
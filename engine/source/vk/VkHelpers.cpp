@@ -35,6 +35,11 @@ namespace eng::vkutil
         ai.allocationSize = req.size;
         ai.memoryTypeIndex = FindMemoryType(gpu, req.memoryTypeBits, memProps);
 
+        VkMemoryAllocateFlagsInfo flags{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO};
+        flags.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
+        if (usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT)
+            ai.pNext = &flags;
+
         vkCheck(vkAllocateMemory(device, &ai, nullptr, &outMem), "vkAllocateMemory failed");
         vkCheck(vkBindBufferMemory(device, outBuf, outMem, 0), "vkBindBufferMemory failed");
     }
@@ -122,19 +122,30 @@ namespace eng
         return e;
     }
 
-    VkFormat Swapchain::findSupportedDepthFormat(VkPhysicalDevice gpu)
+    VkFormat Swapchain::findSupportedDepthFormat(VkPhysicalDevice gpu, bool &outSampleable)
     {
         const VkFormat candidates[] = {
             VK_FORMAT_D32_SFLOAT,
             VK_FORMAT_D32_SFLOAT_S8_UINT,
             VK_FORMAT_D24_UNORM_S8_UINT};
 
-        for (VkFormat f : candidates)
+        // Prefer a format the Hi-Z pass can sample
+        const VkFormatFeatureFlags requirements[] = {
+            VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT,
+            VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT};
+
+        for (VkFormatFeatureFlags required : requirements)
         {
-            VkFormatProperties p{};
-            vkGetPhysicalDeviceFormatProperties(gpu, f, &p);
-            if (p.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
-                return f;
+            for (VkFormat f : candidates)
+            {
+                VkFormatProperties p{};
+                vkGetPhysicalDeviceFormatProperties(gpu, f, &p);
+                if ((p.optimalTilingFeatures & required) == required)
+                {
+                    outSampleable = (required & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+                    return f;
+                }
+            }
         }
 
         throw std::runtime_error("No supported depth format");
@@ -193,12 +204,16 @@ namespace eng
     {
         destroyDepthResources();
 
-        m_depthFormat = findSupportedDepthFormat(m_gpu);
+        m_depthFormat = findSupportedDepthFormat(m_gpu, m_depthSampleable);
+
+        VkImageUsageFlags usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        if (m_depthSampleable)
+            usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
 
         CreateImage(m_gpu, m_device,
                     m_extent.width, m_extent.height,
                     m_depthFormat,
-                    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+                    usage,
                     m_msaaSamples,
                     m_depthImage,
                     m_depthMemory);
@@ -322,65 +337,84 @@ namespace eng
     }
     void Swapchain::createRenderPass()
     {
-        VkAttachmentDescription colorMsaa{};
-        colorMsaa.format = m_format;
-        colorMsaa.samples = m_msaaSamples;
-        colorMsaa.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        colorMsaa.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        colorMsaa.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-        colorMsaa.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        colorMsaa.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        colorMsaa.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-        VkAttachmentDescription depth{};
-        depth.format = m_depthFormat;
-        depth.samples = m_msaaSamples;
-        depth.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        depth.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        depth.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-        depth.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        depth.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        depth.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-        VkAttachmentDescription colorResolve{};
-        colorResolve.format = m_format;
-        colorResolve.samples = VK_SAMPLE_COUNT_1_BIT;
-        colorResolve.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-        colorResolve.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-        colorResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-        colorResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        colorResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        colorResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-        VkAttachmentReference colorRef{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
-        VkAttachmentReference depthRef{1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
-        VkAttachmentReference resolveRef{2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
-
-        VkSubpassDescription sub{};
-        sub.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-        sub.colorAttachmentCount = 1;
-        sub.pColorAttachments = &colorRef;
-        sub.pResolveAttachments = &resolveRef;
-        sub.pDepthStencilAttachment = &depthRef;
-
-        VkSubpassDependency dep{};
-        dep.srcSubpass = VK_SUBPASS_EXTERNAL;
-        dep.dstSubpass = 0;
-        dep.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-        dep.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-        dep.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
-        VkAttachmentDescription attachments[3] = {colorMsaa, depth, colorResolve};
-
-        VkRenderPassCreateInfo rp{VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO};
-        rp.attachmentCount = 3;
-        rp.pAttachments = attachments;
-        rp.subpassCount = 1;
-        rp.pSubpasses = &sub;
-        rp.dependencyCount = 1;
-        rp.pDependencies = &dep;
-
-        vkutil::vkCheck(vkCreateRenderPass(m_device, &rp, nullptr, &m_renderPass), "vkCreateRenderPass failed");
+        // Color and depth are stored so a second, compatible pass (renderPassLoad)
+        // can continue drawing after the Hi-Z pyramid was built mid-frame.
+        auto create = [this](bool load) -> VkRenderPass
+        {
+            VkAttachmentDescription colorMsaa{};
+            colorMsaa.format = m_format;
+            colorMsaa.samples = m_msaaSamples;
+            colorMsaa.loadOp = load ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+            colorMsaa.storeOp = load ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+            colorMsaa.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            colorMsaa.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            colorMsaa.initialLayout = load ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+            colorMsaa.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+            VkAttachmentDescription depth{};
+            depth.format = m_depthFormat;
+            depth.samples = m_msaaSamples;
+            depth.loadOp = load ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+            depth.storeOp = load ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+            depth.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            depth.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            depth.initialLayout = load ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+            depth.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+            VkAttachmentDescription colorResolve{};
+            colorResolve.format = m_format;
+            colorResolve.samples = VK_SAMPLE_COUNT_1_BIT;
+            colorResolve.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            colorResolve.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            colorResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            colorResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            colorResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            colorResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+            VkAttachmentReference colorRef{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+            VkAttachmentReference depthRef{1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+            VkAttachmentReference resolveRef{2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+
+            VkSubpassDescription sub{};
+            sub.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+            sub.colorAttachmentCount = 1;
+            sub.pColorAttachments = &colorRef;
+            sub.pResolveAttachments = &resolveRef;
+            sub.pDepthStencilAttachment = &depthRef;
+
+            VkSubpassDependency dep{};
+            dep.srcSubpass = VK_SUBPASS_EXTERNAL;
+            dep.dstSubpass = 0;
+            dep.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+            dep.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+            dep.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+            if (load)
+            {
+                // Wait for the first pass and the Hi-Z reads of its depth
+                dep.srcStageMask |= VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+                dep.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+                dep.dstStageMask |= VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+                dep.dstAccessMask |= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+            }
+
+            VkAttachmentDescription attachments[3] = {colorMsaa, depth, colorResolve};
+
+            VkRenderPassCreateInfo rp{VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO};
+            rp.attachmentCount = 3;
+            rp.pAttachments = attachments;
+            rp.subpassCount = 1;
+            rp.pSubpasses = &sub;
+            rp.dependencyCount = 1;
+            rp.pDependencies = &dep;
+
+            VkRenderPass renderPass = VK_NULL_HANDLE;
+            vkutil::vkCheck(vkCreateRenderPass(m_device, &rp, nullptr, &renderPass), "vkCreateRenderPass failed");
+            return renderPass;
+        };
+
+        m_renderPass = create(false);
+        m_renderPassLoad = create(true);
     }
 
     void Swapchain::createFramebuffers()
@@ -426,7 +460,8 @@ namespace eng
         ci.format = m_format;
         ci.tiling = VK_IMAGE_TILING_OPTIMAL;
         ci.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        ci.usage = VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        // Not transient: its contents carry over into renderPassLoad
+        ci.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
         ci.samples = m_msaaSamples;
         ci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
@@ -469,6 +504,10 @@ namespace eng
             vkDestroyRenderPass(m_device, m_renderPass, nullptr);
         m_renderPass = VK_NULL_HANDLE;
 
+        if (m_renderPassLoad)
+            vkDestroyRenderPass(m_device, m_renderPassLoad, nullptr);
+        m_renderPassLoad = VK_NULL_HANDLE;
+
         for (auto v : m_views)
             vkDestroyImageView(m_device, v, nullptr);
         m_views.clear();
@@ -604,6 +643,11 @@ namespace eng
         m_programs.clear();
 
         destroyCameraUBO();
+        destroyLightBuffers();
+        m_indirectRenderer.Destroy();
+        m_hiz.Destroy();
+        m_imposters.Destroy();
+        m_virtualTextures.Destroy();
         destroyPerImageSync();
         destroyTextureDescriptors();
 
@@ -828,6 +872,8 @@ namespace eng
         out.viewMatrix = cameraComponent->GetViewMatrix();
         out.projectionMatrix = cameraComponent->GetProjectionMatrix(aspect);
         out.position = cameraObject->GetWordPosition();
+        out.nearPlane = cameraComponent->GetNearPlane();
+        out.farPlane = cameraComponent->GetFarPlane();
     }
 
     void VulkanContext::updateCameraUBO(const CameraData &cameraData)
@@ -864,10 +910,13 @@ namespace eng
 
         VkDescriptorPoolSize ps{};
         ps.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        ps.descriptorCount = 256; // enough for now
+        // One per texture, plus the ones a streaming change retires
+        ps.descriptorCount = 1024;
 
+        // Textures give their set back when destroyed
         VkDescriptorPoolCreateInfo pi{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
-        pi.maxSets = 256;
+        pi.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+        pi.maxSets = 1024;
         pi.poolSizeCount = 1;
         pi.pPoolSizes = &ps;
 
@@ -922,6 +971,151 @@ namespace eng
         return set;
     }
 
+    void VulkanContext::FreeTextureSet(VkDescriptorSet set)
+    {
+        // Sets outliving the pool went with it
+        if (m_textureDescPool && set)
+            vkFreeDescriptorSets(m_device, m_textureDescPool, 1, &set);
+    }
+
+    void VulkanContext::createLightBuffers()
+    {
+        const VkDescriptorType types[kLightBindingCount] = {
+            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER};
+
+        const VkDeviceSize sizes[kLightBindingCount] = {
+            sizeof(ClusteredLighting::Params),
+            sizeof(ClusteredLighting::GpuLight) * ClusteredLighting::kMaxLights,
+            sizeof(ClusteredLighting::GpuCluster) * ClusteredLighting::kClusterCount,
+            sizeof(uint32_t) * ClusteredLighting::kMaxLightIndices};
+
+        VkDescriptorSetLayoutBinding bindings[kLightBindingCount]{};
+        for (uint32_t i = 0; i < kLightBindingCount; ++i)
+        {
+            bindings[i].binding = i;
+            bindings[i].descriptorType = types[i];
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        }
+
+        VkDescriptorSetLayoutCreateInfo li{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+        li.bindingCount = kLightBindingCount;
+        li.pBindings = bindings;
+
+        vkutil::vkCheck(vkCreateDescriptorSetLayout(m_device, &li, nullptr, &m_lightSetLayout),
+                        "vkCreateDescriptorSetLayout (lights) failed");
+
+        VkDescriptorPoolSize ps[2]{};
+        ps[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        ps[0].descriptorCount = FrameSync::MAX_FRAMES;
+        ps[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        ps[1].descriptorCount = FrameSync::MAX_FRAMES * (kLightBindingCount - 1);
+
+        VkDescriptorPoolCreateInfo pi{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+        pi.maxSets = FrameSync::MAX_FRAMES;
+        pi.poolSizeCount = 2;
+        pi.pPoolSizes = ps;
+
+        vkutil::vkCheck(vkCreateDescriptorPool(m_device, &pi, nullptr, &m_lightDescPool),
+                        "vkCreateDescriptorPool (lights) failed");
+
+        std::vector<VkDescriptorSetLayout> layouts(FrameSync::MAX_FRAMES, m_lightSetLayout);
+        VkDescriptorSetAllocateInfo ai{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+        ai.descriptorPool = m_lightDescPool;
+        ai.descriptorSetCount = FrameSync::MAX_FRAMES;
+        ai.pSetLayouts = layouts.data();
+
+        m_lightSets.resize(FrameSync::MAX_FRAMES);
+        vkutil::vkCheck(vkAllocateDescriptorSets(m_device, &ai, m_lightSets.data()),
+                        "vkAllocateDescriptorSets (lights) failed");
+
+        m_lightFrames.resize(FrameSync::MAX_FRAMES);
+        for (int f = 0; f < FrameSync::MAX_FRAMES; ++f)
+        {
+            auto &frame = m_lightFrames[f];
+
+            VkDescriptorBufferInfo infos[kLightBindingCount]{};
+            VkWriteDescriptorSet writes[kLightBindingCount]{};
+
+            for (uint32_t i = 0; i < kLightBindingCount; ++i)
+            {
+                const VkBufferUsageFlags usage = types[i] == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER
+                                                     ? VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT
+                                                     : VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
+                vkutil::CreateBuffer(m_gpu, m_device, sizes[i], usage,
+                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                     frame.buffers[i], frame.memories[i]);
+
+                vkutil::vkCheck(vkMapMemory(m_device, frame.memories[i], 0, sizes[i], 0, &frame.mapped[i]),
+                                "vkMapMemory light buffer failed");
+
+                // Empty clusters until the first frame is built
+                std::memset(frame.mapped[i], 0, (size_t)sizes[i]);
+
+                infos[i].buffer = frame.buffers[i];
+                infos[i].offset = 0;
+                infos[i].range = sizes[i];
+
+                writes[i] = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+                writes[i].dstSet = m_lightSets[f];
+                writes[i].dstBinding = i;
+                writes[i].descriptorCount = 1;
+                writes[i].descriptorType = types[i];
+                writes[i].pBufferInfo = &infos[i];
+            }
+
+            vkUpdateDescriptorSets(m_device, kLightBindingCount, writes, 0, nullptr);
+        }
+    }
+
+    void VulkanContext::destroyLightBuffers()
+    {
+        if (!m_device)
+            return;
+
+        for (auto &frame : m_lightFrames)
+        {
+            for (uint32_t i = 0; i < kLightBindingCount; ++i)
+            {
+                if (frame.mapped[i])
+                    vkUnmapMemory(m_device, frame.memories[i]);
+                if (frame.buffers[i])
+                    vkDestroyBuffer(m_device, frame.buffers[i], nullptr);
+                if (frame.memories[i])
+                    vkFreeMemory(m_device, frame.memories[i], nullptr);
+            }
+        }
+        m_lightFrames.clear();
+        m_lightSets.clear();
+
+        if (m_lightDescPool)
+            vkDestroyDescriptorPool(m_device, m_lightDescPool, nullptr);
+        m_lightDescPool = VK_NULL_HANDLE;
+
+        if (m_lightSetLayout)
+            vkDestroyDescriptorSetLayout(m_device, m_lightSetLayout, nullptr);
+        m_lightSetLayout = VK_NULL_HANDLE;
+    }
+
+    void VulkanContext::updateLightBuffers()
+    {
+        const uint32_t fi = m_sync.frameIndex();
+        if (fi >= m_lightFrames.size())
+            return;
+
+        auto &frame = m_lightFrames[fi];
+        const auto &cl = m_clusteredLighting;
+
+        std::memcpy(frame.mapped[0], &cl.GetParams(), sizeof(ClusteredLighting::Params));
+        std::memcpy(frame.mapped[1], cl.GetLights().data(), cl.GetLights().size() * sizeof(ClusteredLighting::GpuLight));
+        std::memcpy(frame.mapped[2], cl.GetClusters().data(), cl.GetClusters().size() * sizeof(ClusteredLighting::GpuCluster));
+        std::memcpy(frame.mapped[3], cl.GetLightIndices().data(), cl.GetLightIndices().size() * sizeof(uint32_t));
+    }
+
     VulkanContext::QueueFamilies VulkanContext::findQueueFamilies(VkPhysicalDevice gpu, VkSurfaceKHR surface)
     {
         QueueFamilies out;
@@ -971,12 +1165,28 @@ namespace eng
 
         createCameraUBO();
         createTextureDescriptors();
+        createLightBuffers();
+        Engine::GetInstance().GetGraphicsAPI().GetGeometryPool().SetDeviceAddresses(m_vertexPullingSupported);
+        m_indirectRenderer.Init(*this, m_gpuDrivenSupported, FrameSync::MAX_FRAMES);
 
         m_swapchain.create(m_gpu, m_device, m_surface, window, m_qGraphics, m_qPresent, m_msaaSamples);
 
         m_cmdPool.create(m_device, m_qGraphics);
         m_cmdPool.allocate((uint32_t)m_swapchain.imageCount());
 
+        m_imposters.Init(*this, FrameSync::MAX_FRAMES);
+        m_virtualTextures.Init(*this, m_fragmentStoresSupported, FrameSync::MAX_FRAMES);
+        m_virtualTextures.Resize(m_swapchain.extent());
+
+        if (m_indirectRenderer.IsEnabled())
+        {
+            m_hiz.Init(*this);
+            m_hiz.Resize(m_swapchain);
+            m_indirectRenderer.SetPyramid(m_hiz);
+            // Depth first, so the color pass shades each pixel once
+            m_indirectRenderer.SetDepthPrepass(true);
+        }
+
         m_sync.create(m_device);
         createPerImageSync();
     }
@@ -1111,21 +1321,49 @@ namespace eng
 
         const char *devExts[] = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 
-        VkPhysicalDeviceFeatures supported{};
-        vkGetPhysicalDeviceFeatures(m_gpu, &supported);
+        VkPhysicalDeviceVulkan12Features supported12{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+        VkPhysicalDeviceFeatures2 supported2{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+        supported2.pNext = &supported12;
+        vkGetPhysicalDeviceFeatures2(m_gpu, &supported2);
+        const VkPhysicalDeviceFeatures &supported = supported2.features;
+
+        VkPhysicalDeviceVulkan12Features enabled12{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+        VkPhysicalDeviceFeatures2 enabled2{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+        enabled2.pNext = &enabled12;
 
-        VkPhysicalDeviceFeatures enabled{};
+        VkPhysicalDeviceFeatures &enabled = enabled2.features;
         if (supported.samplerAnisotropy)
             enabled.samplerAnisotropy = VK_TRUE;
         if (supported.sampleRateShading)
             enabled.sampleRateShading = VK_TRUE;
+        // KTX2/DDS textures; Texture decodes them on the CPU without it
+        if (supported.textureCompressionBC)
+            enabled.textureCompressionBC = VK_TRUE;
+
+        // GPU driven rendering (IndirectRenderer), lavapipe exposes all three
+        m_gpuDrivenSupported = supported12.drawIndirectCount && supported.multiDrawIndirect && supported.drawIndirectFirstInstance;
+        if (m_gpuDrivenSupported)
+        {
+            enabled12.drawIndirectCount = VK_TRUE;
+            enabled.multiDrawIndirect = VK_TRUE;
+            enabled.drawIndirectFirstInstance = VK_TRUE;
+        }
+
+        m_vertexPullingSupported = m_gpuDrivenSupported && supported12.bufferDeviceAddress;
+        if (m_vertexPullingSupported)
+            enabled12.bufferDeviceAddress = VK_TRUE;
+
+        // Virtual texture feedback is written from fragment shaders
+        m_fragmentStoresSupported = supported.fragmentStoresAndAtomics;
+        if (m_fragmentStoresSupported)
+            enabled.fragmentStoresAndAtomics = VK_TRUE;
 
         VkDeviceCreateInfo ci{VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO};
+        ci.pNext = &enabled2;
         ci.queueCreateInfoCount = (uint32_t)qcis.size();
         ci.pQueueCreateInfos = qcis.data();
         ci.enabledExtensionCount = 1;
         ci.ppEnabledExtensionNames = devExts;
-        ci.pEnabledFeatures = &enabled;
 
         vkutil::vkCheck(vkCreateDevice(m_gpu, &ci, nullptr, &m_device), "vkCreateDevice failed");
 
@@ -1158,26 +1396,61 @@ namespace eng
         rbi.clearValueCount = 2;
         rbi.pClearValues = clears;
 
-        vkCmdBeginRenderPass(cb, &rbi, VK_SUBPASS_CONTENTS_INLINE);
-
         CameraData cameraData{};
         buildCameraData(window, cameraData);
         updateCameraUBO(cameraData);
 
+        auto *scene = Engine::GetInstance().GetScene();
+        auto lights = scene->GetLights();
+
+        const VkExtent2D extent = m_swapchain.extent();
+        m_clusteredLighting.Build(lights, cameraData, extent.width, extent.height);
+        updateLightBuffers();
+
+        auto &renderScene = Engine::GetInstance().GetRenderScene();
+        Engine::GetInstance().GetTextureManager().GetStreamer().RequestMips(renderScene, cameraData, (float)extent.height);
+        m_virtualTextures.BeginFrame(cb, m_sync.frameIndex());
+
+        // Compute culling has to be recorded outside the render pass
+        m_indirectRenderer.Cull(cb, m_sync.frameIndex(), renderScene,
+                                cameraData.projectionMatrix * cameraData.viewMatrix, cameraData.position);
+
+        vkCmdBeginRenderPass(cb, &rbi, VK_SUBPASS_CONTENTS_INLINE);
+
         auto &api = Engine::GetInstance().GetGraphicsAPI();
         api.Begin(cb);
         api.SetCurrentCameraSet(CurrentCameraSet());
+        api.SetCurrentLightSet(CurrentLightSet());
 
-        std::vector<LightData> lights;
-        auto *scene = Engine::GetInstance().GetScene();
-        lights = scene->CollectLights();
+        m_indirectRenderer.Draw(api, m_sync.frameIndex(), cameraData);
 
         auto &rq = Engine::GetInstance().GetRenderQueue();
-        rq.Draw(api, cameraData, lights);
+        rq.Draw(api, renderScene, cameraData, m_indirectRenderer.IsEnabled());
+
+        m_imposters.Draw(cb, m_sync.frameIndex(), CurrentCameraSet(), renderScene, cameraData);
 
         api.End();
 
         vkCmdEndRenderPass(cb);
+        m_virtualTextures.EndFrame(cb);
+
+        // Second phase: rebuild Hi-Z from this depth and draw what it no longer hides
+        if (m_indirectRenderer.NeedsLatePass())
+        {
+            m_hiz.Build(cb);
+            m_indirectRenderer.CullLate(cb, m_sync.frameIndex());
+
+            rbi.renderPass = m_swapchain.renderPassLoad();
+            vkCmdBeginRenderPass(cb, &rbi, VK_SUBPASS_CONTENTS_INLINE);
+
+            api.Begin(cb);
+            api.SetCurrentCameraSet(CurrentCameraSet());
+            api.SetCurrentLightSet(CurrentLightSet());
+            m_indirectRenderer.Draw(api, m_sync.frameIndex(), cameraData, true);
+            api.End();
+
+            vkCmdEndRenderPass(cb);
+        }
 
         vkutil::vkCheck(vkEndCommandBuffer(cb), "vkEndCommandBuffer failed");
     }
@@ -1206,6 +1479,14 @@ namespace eng
 
         m_swapchain.recreate(window);
         RecreateAllPrograms();
+        m_imposters.Recreate(m_swapchain.renderPass());
+        m_virtualTextures.Resize(m_swapchain.extent());
+
+        if (m_indirectRenderer.IsEnabled())
+        {
+            m_hiz.Resize(m_swapchain);
+            m_indirectRenderer.SetPyramid(m_hiz);
+        }
 
         m_cmdPool.reset();
         m_cmdPool.allocate((uint32_t)m_swapchain.imageCount());
@@ -1227,6 +1508,10 @@ namespace eng
         VkFence fence = m_sync.inFlightFence();
         vkutil::vkCheck(vkWaitForFences(m_device, 1, &fence, VK_TRUE, UINT64_MAX), "vkWaitForFences failed");
 
+        Engine::GetInstance().GetGraphicsAPI().GetGeometryPool().NextFrame();
+        Engine::GetInstance().GetTextureManager().NextFrame();
+        m_imposters.NextFrame();
+
         uint32_t imageIndex = 0;
         VkResult acq = vkAcquireNextImageKHR(
             m_device,
@@ -13,4 +13,5 @@ public:
 
 private:
     eng::Scene *m_scene = nullptr;
+    bool m_pullingKeyHeld = false;
 };
\ No newline at end of file
@@ -27,6 +27,11 @@ bool Game::Init()
 
     graphicsAPI.SetClearColor(1.f, 1.f, 1.f, 1.f);
 
+    // The GPU driven path fetches vertices from the geometry pool where supported, F2 toggles it
+    auto &indirect = eng::Engine::GetInstance().GetVulkanContext().GetIndirectRenderer();
+    indirect.SetVertexPulling(true);
+    SDL_Log("Vertex pulling: %s", indirect.IsVertexPulling() ? "on" : "unsupported");
+
     auto material = eng::Material::Load("materials/brick.mat");
 
     auto mesh = eng::Mesh::CreateCube();
@@ -35,16 +40,23 @@ bool Game::Init()
     // objectA->AddComponent(new eng::MeshComponent(material, mesh));
     // objectA->SetPosition(glm::vec3(1.f, 0.f, -5.f));
 
+    // The cubes are cheap to rasterize and big enough to hide things: use them as occluders
     auto objectB = m_scene->CreateObject("ObjectB");
-    objectB->AddComponent(new eng::MeshComponent(material, mesh));
+    auto meshB = new eng::MeshComponent(material, mesh);
+    meshB->SetOccluder(true);
+    objectB->AddComponent(meshB);
     objectB->SetPosition(glm::vec3(0.f, 2.f, 2.f));
     objectB->SetRotation(glm::vec3(0.f, 2.f, 0.f));
+    objectB->SetStatic(true);
 
     auto objectC = m_scene->CreateObject("ObjectC");
-    objectC->AddComponent(new eng::MeshComponent(material, mesh));
+    auto meshC = new eng::MeshComponent(material, mesh);
+    meshC->SetOccluder(true);
+    objectC->AddComponent(meshC);
     objectC->SetPosition(glm::vec3(-2.f, 0.f, 0.f));
     objectC->SetRotation(glm::vec3(1.f, 0.f, 1.f));
     objectC->SetScale(glm::vec3(1.5f, 1.5f, 1.5f));
+    objectC->SetStatic(true);
 
     // auto suzanneMesh = eng::Mesh::Load("models/suzanne/Suzanne.gltf");
     // auto suzanneMaterial = eng::Material::Load("materials/suzanne.mat");
@@ -55,6 +67,7 @@ bool Game::Init()
 
     auto suzanneObject = eng::GameObject::LoadGLTF("models/suzanne/Suzanne.gltf");
     suzanneObject->SetPosition(glm::vec3(0.f, 0.f, -5.f));
+    suzanneObject->SetStatic(true);
 
     auto gun = eng::GameObject::LoadGLTF("models/sten_gunmachine_carbine/scene.gltf");
     gun->SetParent(camera);
@@ -63,6 +76,7 @@ bool Game::Init()
 
     auto makarov = eng::GameObject::LoadGLTF("models/makarov/scene.gltf");
     makarov->SetScale(glm::vec3(.01f, .01f, .01f));
+    makarov->SetStatic(true);
 
     auto light = m_scene->CreateObject("Light");
     auto lightComponent = new eng::LightComponent();
@@ -70,11 +84,22 @@ bool Game::Init()
     light->AddComponent(lightComponent);
     light->SetPosition(glm::vec3(0.f, 5.f, 0.f));
 
+    m_scene->BuildStaticBatches();
+
     return true;
 }
 
 void Game::Update(float DeltaTime)
 {
+    const bool pullingKey = eng::Engine::GetInstance().GetInputManager().IsKeyPressed(SDL_SCANCODE_F2);
+    if (pullingKey && !m_pullingKeyHeld)
+    {
+        auto &indirect = eng::Engine::GetInstance().GetVulkanContext().GetIndirectRenderer();
+        indirect.SetVertexPulling(!indirect.IsVertexPulling());
+        SDL_Log("Vertex pulling: %s", indirect.IsVertexPulling() ? "on" : "off");
+    }
+    m_pullingKeyHeld = pullingKey;
+
     m_scene->Update(DeltaTime);
 }
 
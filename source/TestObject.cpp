@@ -63,6 +63,8 @@ TestObject::TestObject()
     auto mesh = std::make_shared<eng::Mesh>(layout, vertices, indices);
 
     AddComponent(new eng::MeshComponent(material, mesh));
+
+    SetTickEnabled(true);
 }
 
 void TestObject::Update(float DeltaTime)
@@ -0,0 +1,292 @@
+#include "jobs/JobSystem.h"
+#include "render/OcclusionBuffer.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    double SecondsSince(Clock::time_point start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    // Some arithmetic the compiler cannot drop, a few tens of nanoseconds
+    uint32_t Work(uint32_t seed)
+    {
+        for (int i = 0; i < 64; ++i)
+        {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+        }
+        return seed;
+    }
+
+    constexpr size_t kItems = 1 << 22;
+    constexpr size_t kGrain = 1024;
+    // Jobs per wave of the fan out test, under the deque capacity
+    constexpr size_t kWave = 2048;
+    constexpr size_t kWaves = 256;
+    constexpr int kRepeats = 5;
+
+    // Best of kRepeats, so one preempted run does not decide the result
+    template <typename Fn>
+    double Best(Fn &&fn)
+    {
+        double best = 1e30;
+        for (int i = 0; i < kRepeats; ++i)
+        {
+            const auto start = Clock::now();
+            fn();
+            best = std::min(best, SecondsSince(start));
+        }
+        return best;
+    }
+
+    // ParallelFor over kItems items, and kWaves waves of kWave small jobs
+    // submitted from the main thread, which the workers can only get by
+    // stealing. One row per worker count, speedup against a serial loop.
+    int BenchJobs(uint32_t maxWorkers)
+    {
+        std::atomic<uint32_t> sink{0};
+
+        auto serialLoop = [&]()
+        {
+            uint32_t acc = 0;
+            for (size_t i = 0; i < kItems; ++i)
+                acc += Work((uint32_t)i + 1);
+            sink += acc;
+        };
+        const double serial = Best(serialLoop);
+
+        std::printf("%zu items, grain %zu, %zu stolen jobs per run, serial %.1f ms\n", kItems, kGrain, kWave * kWaves, serial * 1000.0);
+        std::printf("%8s%16s%10s%16s\n", "threads", "items/s", "speedup", "stolen jobs/s");
+
+        for (uint32_t workers = 1; workers <= maxWorkers; ++workers)
+        {
+            eng::JobSystem jobs;
+            jobs.Init(workers);
+
+            auto parallelFor = [&]()
+            {
+                auto range = [&](size_t begin, size_t end)
+                {
+                    uint32_t acc = 0;
+                    for (size_t i = begin; i < end; ++i)
+                        acc += Work((uint32_t)i + 1);
+                    sink += acc;
+                };
+                jobs.ParallelFor(kItems, kGrain, range);
+            };
+            const double forSeconds = Best(parallelFor);
+
+            auto fanOut = [&]()
+            {
+                for (size_t wave = 0; wave < kWaves; ++wave)
+                {
+                    eng::JobCounter counter;
+                    for (size_t i = 0; i < kWave; ++i)
+                    {
+                        auto job = [&sink, i]()
+                        { sink += Work((uint32_t)i + 1); };
+                        jobs.Run(job, &counter);
+                    }
+                    jobs.Wait(counter);
+                }
+            };
+            const double fanOutSeconds = Best(fanOut);
+
+            std::printf("%8u%16.3g%10.2f%16.3g\n", jobs.GetThreadCount(), kItems / forSeconds, serial / forSeconds,
+                        (double)(kWave * kWaves) / fanOutSeconds);
+            jobs.Shutdown();
+        }
+
+        std::printf("(checksum %u)\n", sink.load());
+        return 0;
+    }
+
+    // Fixed occlusion scene: a ground plane, walls and a field of rotated
+    // boxes, some crossing the near plane, seen from a few cameras.
+    struct OcclusionScene
+    {
+        std::vector<float> boxPositions;
+        std::vector<uint32_t> boxIndices;
+        std::vector<float> quadPositions;
+        std::vector<uint32_t> quadIndices;
+        std::vector<eng::Occluder> occluders;
+        std::vector<eng::AABB> probes;
+    };
+
+    constexpr uint32_t kBoxes = 2000;
+    constexpr uint32_t kWalls = 24;
+    constexpr uint32_t kViews = 8;
+    constexpr uint32_t kProbeGrid = 32;
+
+    OcclusionScene MakeOcclusionScene()
+    {
+        OcclusionScene scene;
+
+        for (int i = 0; i < 8; ++i)
+        {
+            scene.boxPositions.push_back((i & 1) ? 0.5f : -0.5f);
+            scene.boxPositions.push_back((i & 2) ? 0.5f : -0.5f);
+            scene.boxPositions.push_back((i & 4) ? 0.5f : -0.5f);
+        }
+        scene.boxIndices = {0, 1, 3, 0, 3, 2, 4, 6, 7, 4, 7, 5, 0, 4, 5, 0, 5, 1,
+                            2, 3, 7, 2, 7, 6, 0, 2, 6, 0, 6, 4, 1, 5, 7, 1, 7, 3};
+        scene.quadPositions = {-0.5f, -0.5f, 0.f, 0.5f, -0.5f, 0.f, 0.5f, 0.5f, 0.f, -0.5f, 0.5f, 0.f};
+        scene.quadIndices = {0, 1, 2, 0, 2, 3};
+
+        uint32_t seed = 0x12345678u;
+        auto random = [&seed]()
+        {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            return (float)(seed >> 8) / (float)(1u << 24);
+        };
+
+        eng::Occluder ground;
+        ground.positions = scene.quadPositions;
+        ground.indices = scene.quadIndices;
+        ground.transform = glm::scale(glm::rotate(glm::mat4(1.f), glm::radians(-90.f), glm::vec3(1.f, 0.f, 0.f)),
+                                      glm::vec3(400.f, 400.f, 1.f));
+        scene.occluders.push_back(ground);
+
+        for (uint32_t i = 0; i < kWalls; ++i)
+        {
+            eng::Occluder wall;
+            wall.positions = scene.quadPositions;
+            wall.indices = scene.quadIndices;
+            glm::mat4 m = glm::translate(glm::mat4(1.f), glm::vec3(random() * 160.f - 80.f, 4.f, random() * 160.f - 80.f));
+            m = glm::rotate(m, random() * 6.2831853f, glm::vec3(0.f, 1.f, 0.f));
+            wall.transform = glm::scale(m, glm::vec3(8.f + random() * 24.f, 8.f, 1.f));
+            scene.occluders.push_back(wall);
+        }
+
+        for (uint32_t i = 0; i < kBoxes; ++i)
+        {
+            eng::Occluder box;
+            box.positions = scene.boxPositions;
+            box.indices = scene.boxIndices;
+            glm::mat4 m = glm::translate(glm::mat4(1.f), glm::vec3(random() * 200.f - 100.f, random() * 6.f, random() * 200.f - 100.f));
+            m = glm::rotate(m, random() * 6.2831853f, glm::normalize(glm::vec3(random() - 0.5f, 1.f, random() - 0.5f)));
+            box.transform = glm::scale(m, glm::vec3(0.5f + random() * 4.f, 0.5f + random() * 4.f, 0.5f + random() * 4.f));
+            scene.occluders.push_back(box);
+        }
+
+        for (uint32_t z = 0; z < kProbeGrid; ++z)
+        {
+            for (uint32_t x = 0; x < kProbeGrid; ++x)
+            {
+                eng::AABB probe;
+                probe.min = glm::vec3(x * 6.f - 96.f, 0.5f + random() * 2.f, z * 6.f - 96.f);
+                probe.max = probe.min + glm::vec3(0.5f + random() * 2.f);
+                scene.probes.push_back(probe);
+            }
+        }
+        return scene;
+    }
+
+    glm::mat4 OcclusionView(uint32_t view)
+    {
+        const float angle = 6.2831853f * (float)view / (float)kViews;
+        const glm::vec3 eye(std::cos(angle) * 90.f, 2.f + (float)(view % 3) * 6.f, std::sin(angle) * 90.f);
+        const glm::mat4 proj = glm::perspective(glm::radians(60.f), 16.f / 9.f, 0.1f, 500.f);
+        return proj * glm::lookAt(eye, glm::vec3(0.f, 2.f, 0.f), glm::vec3(0.f, 1.f, 0.f));
+    }
+
+    // Renders the scene with the scalar path and the ENGINE_SIMD one, which
+    // must agree bit for bit on every depth and every visibility answer.
+    int BenchOcclusion(uint32_t workers)
+    {
+        eng::JobSystem jobs;
+        jobs.Init(workers);
+        const OcclusionScene scene = MakeOcclusionScene();
+
+        eng::OcclusionBuffer scalar;
+        eng::OcclusionBuffer simd;
+        scalar.Init();
+        simd.Init();
+        scalar.SetScalar(true);
+
+        std::printf("%ux%u, %zu occluders, %u lanes (%s)\n", scalar.GetWidth(), scalar.GetHeight(),
+                    scene.occluders.size(), eng::OcclusionBuffer::kSimdLanes, eng::OcclusionBuffer::kSimdName);
+        std::printf("%6s%12s%14s%12s%10s%12s%12s\n", "view", "triangles", "scalar ms", "simd ms", "speedup", "bad depth", "bad tests");
+
+        size_t failures = 0;
+        for (uint32_t view = 0; view < kViews; ++view)
+        {
+            const glm::mat4 viewProj = OcclusionView(view);
+
+            auto renderScalar = [&]()
+            { scalar.Render(scene.occluders, viewProj, jobs); };
+            auto renderSimd = [&]()
+            { simd.Render(scene.occluders, viewProj, jobs); };
+            const double scalarSeconds = Best(renderScalar);
+            const double simdSeconds = Best(renderSimd);
+
+            const auto &a = scalar.GetDepth();
+            const auto &b = simd.GetDepth();
+            size_t badDepth = 0;
+            for (size_t i = 0; i < a.size(); ++i)
+                badDepth += std::memcmp(&a[i], &b[i], sizeof(float)) != 0 ? 1 : 0;
+
+            size_t badTests = 0;
+            for (const auto &probe : scene.probes)
+                badTests += scalar.IsVisible(probe) != simd.IsVisible(probe) ? 1 : 0;
+
+            failures += badDepth + badTests;
+            std::printf("%6u%12u%14.3f%12.3f%10.2f%12zu%12zu\n", view, scalar.GetTriangleCount(), scalarSeconds * 1000.0,
+                        simdSeconds * 1000.0, scalarSeconds / simdSeconds, badDepth, badTests);
+        }
+
+        jobs.Shutdown();
+        std::printf(failures == 0 ? "scalar and SIMD paths match\n" : "MISMATCH between the scalar and SIMD paths\n");
+        return failures == 0 ? 0 : 1;
+    }
+
+    void PrintUsage()
+    {
+        std::fprintf(stderr,
+                     "usage: enginebench --jobs [max workers]\n"
+                     "       enginebench --occlusion [workers]\n"
+                     "Workers default to hardware_concurrency - 1; the main thread is counted\n"
+                     "in the thread column. --occlusion exits with 1 when the scalar and SIMD\n"
+                     "rasterizers differ.\n");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 2 && std::string(argv[1]) == "--jobs" && argc <= 3)
+    {
+        const uint32_t hw = std::thread::hardware_concurrency();
+        const uint32_t maxWorkers = argc == 3 ? (uint32_t)std::max(1, std::atoi(argv[2])) : std::max(hw, 2u) - 1;
+        return BenchJobs(maxWorkers);
+    }
+
+    if (argc >= 2 && std::string(argv[1]) == "--occlusion" && argc <= 3)
+    {
+        // 0 lets the job system pick
+        const uint32_t workers = argc == 3 ? (uint32_t)std::max(1, std::atoi(argv[2])) : 0;
+        return BenchOcclusion(workers);
+    }
+
+    PrintUsage();
+    return 1;
+}
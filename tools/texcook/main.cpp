@@ -0,0 +1,242 @@
+#include "graphics/BlockCompression.h"
+#include "graphics/MipGenerator.h"
+#include "graphics/TextureContainer.h"
+#include "graphics/VirtualTextureFile.h"
+#include "jobs/JobSystem.h"
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace
+{
+    struct FormatInfo
+    {
+        const char *name;
+        VkFormat unorm;
+        VkFormat srgb;
+        // Channels that carry data, compared by the benchmark
+        uint32_t channels;
+    };
+
+    constexpr FormatInfo kFormats[] = {
+        {"bc1", VK_FORMAT_BC1_RGBA_UNORM_BLOCK, VK_FORMAT_BC1_RGBA_SRGB_BLOCK, 3},
+        {"bc3", VK_FORMAT_BC3_UNORM_BLOCK, VK_FORMAT_BC3_SRGB_BLOCK, 4},
+        {"bc4", VK_FORMAT_BC4_UNORM_BLOCK, VK_FORMAT_BC4_UNORM_BLOCK, 1},
+        {"bc5", VK_FORMAT_BC5_UNORM_BLOCK, VK_FORMAT_BC5_UNORM_BLOCK, 2},
+        {"bc7", VK_FORMAT_BC7_UNORM_BLOCK, VK_FORMAT_BC7_SRGB_BLOCK, 4},
+    };
+
+    const FormatInfo *FindFormat(const std::string &name)
+    {
+        for (const auto &format : kFormats)
+            if (name == format.name)
+                return &format;
+        return nullptr;
+    }
+
+    bool IsSourceImage(const std::filesystem::path &path)
+    {
+        auto ext = path.extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c)
+                       { return (char)std::tolower(c); });
+        return ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".tga" || ext == ".bmp";
+    }
+
+    bool LoadImage(const std::filesystem::path &path, bool srgb, eng::TextureImage &out)
+    {
+        int width = 0, height = 0, channels = 0;
+        stbi_uc *pixels = stbi_load(path.string().c_str(), &width, &height, &channels, STBI_rgb_alpha);
+        if (!pixels)
+        {
+            std::fprintf(stderr, "texcook: cannot read %s: %s\n", path.string().c_str(), stbi_failure_reason());
+            return false;
+        }
+
+        out.format = srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+        out.width = (uint32_t)width;
+        out.height = (uint32_t)height;
+        out.levels = {{0, (size_t)width * height * 4, out.width, out.height}};
+        out.data.assign(pixels, pixels + out.levels[0].size);
+        stbi_image_free(pixels);
+        return true;
+    }
+
+    double Psnr(const eng::TextureImage &a, const eng::TextureImage &b, uint32_t channels)
+    {
+        const auto &level = a.levels[0];
+        double sum = 0.0;
+        for (size_t i = 0; i < (size_t)level.width * level.height; ++i)
+            for (uint32_t ch = 0; ch < channels; ++ch)
+            {
+                const double d = (double)a.data[i * 4 + ch] - b.data[i * 4 + ch];
+                sum += d * d;
+            }
+        const double mse = sum / ((double)level.width * level.height * channels);
+        return mse <= 0.0 ? 99.0 : 10.0 * std::log10(255.0 * 255.0 / mse);
+    }
+
+    int Cook(const std::filesystem::path &input, std::filesystem::path output, const FormatInfo &format, bool srgb, bool mips,
+             bool virtualTexture, eng::JobSystem &jobs)
+    {
+        if (output.empty())
+            output = std::filesystem::path(input).replace_extension(virtualTexture ? ".vtex" : ".ktx2");
+
+        eng::TextureImage image;
+        if (!LoadImage(input, srgb, image))
+            return 1;
+        // Virtual textures always carry every level down to a single tile
+        if (mips || virtualTexture)
+            eng::GenerateMipChain(image, &jobs);
+
+        if (virtualTexture)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            if (!eng::WriteVirtualTexture(output, image, srgb ? format.srgb : format.unorm, &jobs))
+                return 1;
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::printf("%s -> %s (%s tiles, %ux%u, %u levels, %.1f ms)\n", input.string().c_str(), output.string().c_str(), format.name,
+                        image.width, image.height, eng::VirtualTextureFile::LevelCount(image.width, image.height), seconds * 1000.0);
+            return 0;
+        }
+
+        eng::TextureImage compressed;
+        const auto start = std::chrono::steady_clock::now();
+        if (!eng::CompressTexture(image, srgb ? format.srgb : format.unorm, compressed, &jobs))
+            return 1;
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (!eng::WriteKtx2(output, compressed))
+            return 1;
+        std::printf("%s -> %s (%s, %ux%u, %zu levels, %.1f ms)\n", input.string().c_str(), output.string().c_str(), format.name,
+                    image.width, image.height, image.levels.size(), seconds * 1000.0);
+        return 0;
+    }
+
+    // Level 0 of every image under directory in every format: PSNR against
+    // the source over the channels the format keeps, and encode throughput.
+    int Bench(const std::filesystem::path &directory, eng::JobSystem &jobs)
+    {
+        std::vector<std::filesystem::path> files;
+        for (const auto &entry : std::filesystem::recursive_directory_iterator(directory))
+            if (entry.is_regular_file() && IsSourceImage(entry.path()))
+                files.push_back(entry.path());
+        std::sort(files.begin(), files.end());
+        if (files.empty())
+        {
+            std::fprintf(stderr, "texcook: no images under %s\n", directory.string().c_str());
+            return 1;
+        }
+
+        std::printf("%zu images, %u threads, %s\n", files.size(), jobs.GetThreadCount(), eng::kBlockEncoderSimdName);
+        std::printf("%-40s", "image");
+        for (const auto &format : kFormats)
+            std::printf("%10s", format.name);
+        std::printf("\n");
+
+        constexpr size_t kFormatCount = std::size(kFormats);
+        double psnrSum[kFormatCount]{}, seconds[kFormatCount]{};
+        double pixels = 0.0;
+
+        for (const auto &file : files)
+        {
+            eng::TextureImage image;
+            if (!LoadImage(file, false, image))
+                continue;
+            pixels += (double)image.width * image.height;
+
+            std::printf("%-40s", file.filename().string().substr(0, 39).c_str());
+            for (size_t f = 0; f < kFormatCount; ++f)
+            {
+                eng::TextureImage compressed, decoded;
+                const auto start = std::chrono::steady_clock::now();
+                eng::CompressTexture(image, kFormats[f].unorm, compressed, &jobs);
+                seconds[f] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+                eng::DecompressTexture(compressed, decoded);
+                const double psnr = Psnr(image, decoded, kFormats[f].channels);
+                psnrSum[f] += psnr;
+                std::printf("%10.2f", psnr);
+            }
+            std::printf("\n");
+        }
+
+        std::printf("%-40s", "mean PSNR (dB)");
+        for (size_t f = 0; f < kFormatCount; ++f)
+            std::printf("%10.2f", psnrSum[f] / (double)files.size());
+        std::printf("\n%-40s", "throughput (MPix/s)");
+        for (size_t f = 0; f < kFormatCount; ++f)
+            std::printf("%10.2f", pixels / 1e6 / std::max(seconds[f], 1e-9));
+        std::printf("\n");
+        return 0;
+    }
+
+    void PrintUsage()
+    {
+        std::fprintf(stderr,
+                     "usage: texcook [--format bc1|bc3|bc4|bc5|bc7] [--srgb] [--no-mips] <input> [output.ktx2]\n"
+                     "       texcook --virtual [--format bc1|bc3|bc4|bc5|bc7] [--srgb] <input> [output.vtex]\n"
+                     "       texcook --bench <directory>\n"
+                     "Without an output the file is written next to the input. Virtual textures\n"
+                     "need power of two sizes of at least 128.\n");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const FormatInfo *format = FindFormat("bc7");
+    bool srgb = false;
+    bool mips = true;
+    bool virtualTexture = false;
+    std::filesystem::path bench;
+    std::vector<std::filesystem::path> paths;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--format" && i + 1 < argc)
+        {
+            format = FindFormat(argv[++i]);
+            if (!format)
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+        else if (arg == "--srgb")
+            srgb = true;
+        else if (arg == "--no-mips")
+            mips = false;
+        else if (arg == "--virtual")
+            virtualTexture = true;
+        else if (arg == "--bench" && i + 1 < argc)
+            bench = argv[++i];
+        else if (!arg.starts_with("--"))
+            paths.push_back(arg);
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if (bench.empty() && (paths.empty() || paths.size() > 2))
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    eng::JobSystem jobs;
+    jobs.Init();
+    const int result = bench.empty() ? Cook(paths[0], paths.size() > 1 ? paths[1] : std::filesystem::path(), *format, srgb, mips, virtualTexture, jobs)
+                                     : Bench(bench, jobs);
+    jobs.Shutdown();
+    return result;
+}